@@ -2,352 +2,747 @@
  * File: "afsm.cpp" (Finite-State Machine class)
  */
 //-----------------------------------------------------------------------------
+#include "config.h" // TIME_FUNC(), TIME_FACTOR
 #include "afsm.h"
-#include "print.h"
-#include "global.h" // FIXME
+//-----------------------------------------------------------------------------
+// TIME_FUNC() value to microseconds (wrap safe for differences)
+#define AFSM_US(t) ((uint32_t) (t) * (uint32_t) (1000 / TIME_FACTOR))
 //-----------------------------------------------------------------------------
 const char * const afsm_mode_string[AFSM_MODES] = AFSM_MODE_STRING;
 //-----------------------------------------------------------------------------
+const char * const afsm_event_string[AFSM_EVENTS] = AFSM_EVENT_STRING;
+//-----------------------------------------------------------------------------
 // FSM default options
 const afsm_pars_t afsm_pars_default = {
   AFSM_CW, // mode: AFSM_CW, AFSM_OOK, AFSM_TX, AFSM_RX,
-           //       AFSM_RQ, AFSM_RP, AFSM_RM, AFSM_RS, AFSM_AD, AFSM_SG
+           //       AFSM_RQ, AFSM_RP, AFSM_RM, AFSM_RS, AFSM_AD, AFSM_SG,
+           //       AFSM_SC, AFSM_TD, AFSM_MS
 
   4000,   // t: TX period [ms]
   
   100,    // dt: CW time [ms]
   50,     // dc: OOK code chip time [ms]
+  0,      // dcu: OOK code chip time by hardware timer [us] (0 - use dc)
   2,      // wut: radio wakeup time [ms]
 
   AFSM_SWEEP_MIN, // sweep_min: minimal frequency [kHz]
   AFSM_SWEEP_MAX, // sweep_max: maximal frequency [kHz]
-  AFSM_SWEEP_F    // sweep_f: sweep factor [kHz/sec = kHz/ms]
+  AFSM_SWEEP_F,   // sweep_f: sweep factor [kHz/sec = kHz/ms]
+
+  SCAN_FREQ_MIN,  // scan_min: first channel frequency [kHz]
+  SCAN_FREQ_MAX,  // scan_max: last channel frequency [kHz]
+  SCAN_STEP,      // scan_step: channel step [kHz]
+  SCAN_DWELL,     // scan_dwell: dwell time on each channel [ms]
+  SCAN_SAMPLES    // scan_samples: RSSI samples on each channel
 };
 //-----------------------------------------------------------------------------
-// FSM period timer (form txrx_start periodic rise)
-void AFsm::start_fsm(unsigned long t)
+// transition table: action[mode][event]
+//  1. initial state (wait period timer): txrx=0, tmr=NONE
+//  2. wakeup radio pause: txrx=0, tmr=WAKEUP
+//  3. TX/RX data/code: txrx=1, tmr=TICK (CW/OOK/SG/SC) or NONE (wait IRQ)
+const AFsm::action_t AFsm::action[AFSM_MODES][AFSM_EVENTS] = {
+  // START             STOP              PERIOD            WAKEUP
+  // TICK              TX_DONE           RX_DONE           TIMEOUT
+  // RANGING           CAD
+  { // CW - periodic continuous wave beeper
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_cw,
+    &AFsm::a_cw_tick, &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // OOK - periodic on-off keying transmitter
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_ook,
+    &AFsm::a_ook_tick,&AFsm::a_none,    &AFsm::a_none,    &AFsm::a_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // TX - periodic transmitter
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_send,
+    &AFsm::a_none,    &AFsm::a_done,    &AFsm::a_none,    &AFsm::a_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // RX - continuous receiver
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_recv,
+    &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_recv,    &AFsm::a_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // RQ - periodic requester
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_send,
+    &AFsm::a_none,    &AFsm::a_listen,  &AFsm::a_rq_done, &AFsm::a_rq_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // RP - continuous responder
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_recv,
+    &AFsm::a_none,    &AFsm::a_recv,    &AFsm::a_reply,   &AFsm::a_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // RM - periodic ranging master
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_ranging,
+    &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_ranging_lost,
+    &AFsm::a_ranging_next,&AFsm::a_none },
+  { // RS - continuous ranging slave
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_ranging_rx,
+    &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_ranging_slot,
+    &AFsm::a_ranging_hop,&AFsm::a_none },
+  { // AR - continuous advanced ranging
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_ranging_rx,
+    &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_timeout,
+    &AFsm::a_ranging_done,&AFsm::a_none },
+  { // SG - sweep generator
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_sg,
+    &AFsm::a_sg_tick, &AFsm::a_none,    &AFsm::a_none,    &AFsm::a_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // SC - spectrum scanner
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_scan,
+    &AFsm::a_scan_tick,&AFsm::a_none,    &AFsm::a_none,    &AFsm::a_timeout,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // TD - TDMA slot node
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_slot,
+    &AFsm::a_slot_tx, &AFsm::a_slot_rx, &AFsm::a_none,    &AFsm::a_slot_rx,
+    &AFsm::a_none,    &AFsm::a_none },
+  { // MS - mesh relay node
+    &AFsm::a_start,   &AFsm::a_stop,    &AFsm::a_period,  &AFsm::a_mesh,
+    &AFsm::a_mesh_cad,&AFsm::a_mesh_done,&AFsm::a_none,    &AFsm::a_mesh_done,
+    &AFsm::a_none,    &AFsm::a_mesh_send },
+};
+//-----------------------------------------------------------------------------
+// put event to queue and run it now (from IRQ handler)
+void AFsm::event(uint8_t ev)
 {
-  uint8_t restore = 0;
+  post(ev);
+  dispatch(TIME_FUNC());
+}
+//-----------------------------------------------------------------------------
+// run all queued events
+void AFsm::dispatch(unsigned long t)
+{
+  while (_cnt)
+  {
+    uint8_t ev = _queue[_head];
+    _head = (uint8_t) (_head + 1) % AFSM_QUEUE_SIZE;
+    _cnt--;
 
+    if (pars->mode >= AFSM_MODES || ev >= AFSM_EVENTS) continue;
+    int8_t retv = (this->*action[pars->mode][ev])(t);
+    if (_cb != (afsm_cb_t) NULL) _cb(ev, retv, t);
+  }
+}
+//-----------------------------------------------------------------------------
+// periodic call from main loop (t = TIME_FUNC())
+void AFsm::yield(unsigned long t)
+{
+  // deferred stop (wait wakeup pause finish)
+  if (_stop && tmr != AFSM_EV_WAKEUP)
+  {
+    _stop = 0;
+    post(AFSM_EV_STOP);
+  }
+
+  // period timer (64-bit period and unsigned delta: TIME_FUNC() wrap safe)
   if (_run)
   {
-    if (_stop /*&& !txrx*/ && !wus) // FIXME
-    { // stop period timer
-      _stop      = 0;
-      _run       = 0;
-      txrx_start = 0;
-      restore    = 1;
-      txrx       = 0; // FIXME 
-    }
-    else if (((long)(t - _t)) >= pars->t * TIME_FACTOR)
+    uint64_t period = (uint64_t) pars->t * TIME_FACTOR;
+    _acc += (uint32_t) (t - _t);
+    _t = t;
+    if (_acc >= period)
     {
-      _t += pars->t * TIME_FACTOR;
+      _acc -= period;
       txrx_start = 1;
     }
   }
-  else if (_start)
-  { // start period timer
-    _start     = 0;
-    _run       = 1;
-    _t         = t;
-    txrx_start = 1;
+
+  if (txrx_start && !txrx && tmr == AFSM_EV_NONE)
+  { // state 1 -> state 2
+    txrx_start = 0;
+    post(AFSM_EV_PERIOD);
   }
-  else if (_stop)
+
+  // TDMA own slot (receiver is on in state 3)
+  if (pars->mode == AFSM_TD && txrx && !power && tmr == AFSM_EV_NONE &&
+      tdma != (tdma_t*) NULL && tdma_due(tdma, AFSM_US(t)))
+    post(AFSM_EV_TICK);
+
+  // mesh own/relay packet (receiver is on in state 3)
+  if (pars->mode == AFSM_MS && txrx && !power && tmr == AFSM_EV_NONE &&
+      mesh != (mesh_t*) NULL && mesh_due(mesh, AFSM_US(t)))
+    post(AFSM_EV_TICK);
+
+  // wakeup/tick timer
+  if (tmr != AFSM_EV_NONE &&
+      (uint32_t) (t - this->t) >= (uint64_t) dt * TIME_FACTOR)
   {
-    _stop = 0;
-    restore = 1;
+    if (tmr == AFSM_EV_WAKEUP)
+    { // state 2 -> state 3
+      this->t = t;
+      txrx    = 1;
+    }
+    else
+      this->t += dt * TIME_FACTOR;
+
+    post(tmr);
+    tmr = AFSM_EV_NONE; // action restart timer if need
   }
-      
-  if (restore) sx128x_restore(radio);
+
+  // OOK code by hardware timer finished
+  if (chip_hw && ook->done)
+  {
+    ook->done = 0;
+    post(AFSM_EV_TICK);
+  }
+
+  dispatch(t);
 }
 //-----------------------------------------------------------------------------
-// FSM TX/RX timer has 3 state:
-//  1. initial state (wait  txrx_start): txrx=0, wus=0
-//  2. Wakeup radio pause: txrx=0, wus=wut
-//  3. TX/RX data/code: txrx=1, wus=0
-void AFsm::txrx_fsm(unsigned long t)
+// no action
+int8_t AFsm::a_none(unsigned long t)
 {
-  int8_t retv = SX128X_ERR_NONE;
+  (void) t;
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// start command => start period timer
+int8_t AFsm::a_start(unsigned long t)
+{
+  if (_run) return SX128X_ERR_NONE;
 
-  if (txrx)
-  { // state 3
-    if (((long)(t - this->t)) >= dt * TIME_FACTOR)
-    { // CW/OOK/SG interval finish
-      if (pars->mode == AFSM_CW)
-      { // CW beep finish => go to state 1
-        retv = sleep();
-      }
-      else if (pars->mode == AFSM_OOK)
-      { // OOK code beeper
-        if (++code_cnt >= *code_size)
-        { // TX OOK code finish => go to state 1
-          retv = sleep();
-        }
-        else
-        { // next OOK chip
-          uint8_t next_chip = code[code_cnt] != '0' ? 1 : 0;
-          if (power != next_chip) retv = wave(next_chip);
-        }
-      }
-      else if (pars->mode == AFSM_SG)
-      { // sweep generator
-        freq += dt * pars->sweep_f; // ms * Hz/ms = Hz
-        if (freq < (pars->sweep_min * 1000) ||
-            freq > (pars->sweep_max * 1000)) // FIXME
-        { // sweep finish => go to state 1
-          sx128x_set_frequency(radio, sweep_save); // restore frequency
-          retv = sleep();
-        }
-        else
-        { // set next frequency
-#if 0     // FIXME: debug print
-          if (Opt.verbose)
-          {
-            mrl_clear(&Mrl);
-            print_uval("freq=", freq);
-            mrl_refresh(&Mrl);
-          }
-#endif
-          retv = sx128x_set_frequency(radio, freq);
-        }
-      }
-      else
-      {
-        // do nothing
-      }
-      this->t += dt * TIME_FACTOR;
-    } // if ((long)(t - this->t) >= dt * TIME_FACTOR)
-  }
-  else if (!txrx && wus)
-  { // state 2
-    if (((long)(t - this->t)) >= wus * TIME_FACTOR)
-    { // goto TX/RX (state 3)
-      this->t = t;
-      wus     = 0;
-      txrx    = 1;
-      if (pars->mode == AFSM_CW)
-      { // CW mode start
-        dt = pars->dt;
-        retv = wave(1);
-      }
-      else if (pars->mode == AFSM_OOK)
-      { // OOK mode start
-        dt = pars->dc;
-        code_cnt = 0;
-        retv = wave(code[code_cnt] != '0');
-      }
-      else if (pars->mode == AFSM_TX || pars->mode == AFSM_RQ)
-      { // TX or requester -> send packet)
-        t_tx_start = t;
-        power = 1;
-        led->on();
-        setRXEN(0);
-        setTXEN(1);
-        retv = sx128x_send(radio, data, *data_size, *fixed,
-                           Opt.tx_timeout, SX128X_TIME_BASE_1MS);
-      }
-      else if (pars->mode == AFSM_RM)
-      { // ranging master
-        t_tx_start = t;
-        power = 1;
-        led->on();
-        setRXEN(0);
-        setTXEN(1);
-        retv = sx128x_tx(radio, SX128X_TX_TIMEOUT_SINGLE, SX128X_TIME_BASE_1MS);
-      }
-      else if (pars->mode == AFSM_RS)
-      { // ranging slave
-        _run = 0; // stop periodic timer
-        txrx = 0; // stop TX/RX timer
-        setRXEN(1);
-        setTXEN(0);
-        retv = sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
-      }
-      else if (pars->mode == AFSM_RX || pars->mode == AFSM_RP)
-      { // RX or responder mode -> go to continous receive mode
-        uint8_t size = *fixed ? *data_size : 0;
-        _run = 0; // continous receive mode => stop periodic timer
-        txrx = 0; // stop TX/RX timer
-        setRXEN(1);
-        setTXEN(0);
-        retv = sx128x_recv(radio, size, *fixed,
-                           SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
-      }
-      else if (pars->mode == AFSM_SG)
-      { // start sweep generator
-        if (pars->sweep_f > 0)
-          freq = pars->sweep_min;
-        else if (pars->sweep_f < 0)
-          freq = pars->sweep_max;
-        else // pars->sweep == 0 (?!)
-          freq = (pars->sweep_min + pars->sweep_max) / 2;
-
-        freq *= 1000; // kHz -> Hz
-        dt = 1; // 1 ms FIXME!
-        
-        sweep_save = sx128x_get_frequency(radio); // save frequency
-#if 0   // FIXME: debug print
-        if (Opt.verbose)
-        {
-          mrl_clear(&Mrl);
-          print_uval("freq=", freq);
-          mrl_refresh(&Mrl);
-        }
-#endif
-        sx128x_set_frequency(radio, freq);
-        retv = wave(1);
-      }
-    } // if (((long)(t - this->t)) >= wus * TIME_FACTOR)
+#ifdef SX128X_USE_RANGING
+  // mega fix - set ranging mode and role
+  if (pars->mode == AFSM_RM || pars->mode == AFSM_RS || pars->mode == AFSM_AR)
+  {
+    if (sx128x_get_mode(radio) != SX128X_PACKET_TYPE_RANGING)
+      // change radio mode to Ranging
+      sx128x_mode(radio, SX128X_PACKET_TYPE_RANGING);
+
+    if (pars->mode == AFSM_AR) { // start advanced ranging
+      sx128x_set_advanced_ranging(radio, 1);
+    } else { // classic ranging => set role
+      sx128x_ranging_role(radio, pars->mode == AFSM_RM ? 0x01 : // master
+                                                         0x00); // slave
+    }
   }
-  else if (txrx_start)
-  { // state 1 -> goto state 2 (wakeup radio)
-    if (Opt.verbose >= 3)
-    {
-      print_uval("\rtxrx_start: t=", t);
-      mrl_refresh(&Mrl);
+  else if (pars->mode != AFSM_SG)
+  {
+    if (sx128x_get_mode(radio) == SX128X_PACKET_TYPE_RANGING) {
+      sx128x_set_advanced_ranging(radio, 0); // off advanced ranging
+      sx128x_mode(radio, SX128X_PACKET_TYPE_LORA); // LoRa by default
     }
-    txrx_start  = 0;
-    wus         = pars->wut ? pars->wut : 1;
-    txrx        = 0;
-    this->t     = t;
-    retv = wakeup();
   }
+#endif
+
+  _run       = 1;
+  _t         = t;
+  _acc       = 0;
+  txrx_start = 1;
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// stop command => stop period timer and restore radio
+int8_t AFsm::a_stop(unsigned long t)
+{
+  (void) t;
+  if (tmr == AFSM_EV_WAKEUP)
+  { // stop after wakeup pause
+    _stop = 1;
+    return SX128X_ERR_NONE;
+  }
+
+  if (pars->mode == AFSM_SC && txrx)
+    sx128x_set_frequency(radio, sweep_save); // interrupted scan
 
-  if (retv != SX128X_ERR_NONE) {
-    mrl_clear(&Mrl);
-    print_ival("error in AFsm::txrx_fsm(): err=", retv);
-    mrl_refresh(&Mrl);
+  if (chip_hw)
+  { // interrupted OOK code by hardware timer
+    chip_hw = 0;
+    _chip_timer(0);
   }
+
+  if (rng != (range_t*) NULL)
+    rng->active = 0; // interrupted ranging session (not reported)
+
+  if (pos != (pos_t*) NULL)
+    pos->active = 0; // interrupted anchor cycle (not reported)
+
+  if (tdma != (tdma_t*) NULL)
+    tdma->active = 0; // no slots and no beacons
+
+  if (mesh != (mesh_t*) NULL)
+    mesh->active = 0; // no own packets and no relays
+
+  _run       = 0;
+  txrx_start = 0;
+  txrx       = 0;
+  tmr        = AFSM_EV_NONE;
+  return sx128x_restore(radio);
 }
 //-----------------------------------------------------------------------------
-// TX done by TxDone interrupt
-void AFsm::tx_done()
+// period timer => wakeup radio (go to state 2)
+int8_t AFsm::a_period(unsigned long t)
 {
-  int8_t retv = SX128X_ERR_NONE;
-  
+  txrx = 0;
+  timer(AFSM_EV_WAKEUP, t, pars->wut ? pars->wut : 1);
+  return wakeup();
+}
+//-----------------------------------------------------------------------------
+// RX/TX timeout
+int8_t AFsm::a_timeout(unsigned long t)
+{
+  (void) t;
   led->off();
-  power = 0;
+  txrx = power = 0;
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// CW mode start
+int8_t AFsm::a_cw(unsigned long t)
+{
+  timer(AFSM_EV_TICK, t, pars->dt);
+  return wave(1);
+}
+//-----------------------------------------------------------------------------
+// CW beep finish => go to state 1
+int8_t AFsm::a_cw_tick(unsigned long t)
+{
+  (void) t;
+  return sleep();
+}
+//-----------------------------------------------------------------------------
+// OOK mode start
+int8_t AFsm::a_ook(unsigned long t)
+{
+  int8_t retv;
 
-  if (pars->mode == AFSM_TX && _run)
-  { // TX mode => go to state 1 and sleep
-    retv = sleep();
+  if (ook == (ook_t*) NULL || ook->size == 0)
+  { // OOK code not set
+    sleep();
+    return SX128X_ERR_BAD_CALL;
   }
-  else if (pars->mode == AFSM_RQ && _run)
-  { // requester mode => go to state 1 and RX after TX
-    txrx = 0;
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_recv(radio, *fixed ? *data_size : 0, *fixed,
-                       pars->t / 2, SX128X_TIME_BASE_1MS); // FIXME: timeout = period / 2 [ms]
+
+  retv = wave(ook_chip(ook, 0));
+
+  if (pars->dcu && _chip_timer != NULL)
+  { // next chips by hardware timer, yield() waits `ook->done`
+    tmr = AFSM_EV_NONE;
+    if (retv == SX128X_ERR_NONE)
+      retv = _chip_timer(pars->dcu < OOK_CHIP_MIN ? OOK_CHIP_MIN : pars->dcu);
+    if (retv != SX128X_ERR_NONE)
+      sleep();
+    else
+      chip_hw = 1;
+    return retv;
   }
-  else if (pars->mode == AFSM_RP)
-  { // responder mode => goto state 1 and RX after TX
-    _run = 0;
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_recv(radio, *fixed ? *data_size : 0, *fixed,
-                       SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+
+  // next chips by main loop (`dc` [ms])
+  ook_begin(ook, AFSM_US(t), pars->dc * 1000);
+  timer(AFSM_EV_TICK, t, pars->dc);
+  return retv;
+}
+//-----------------------------------------------------------------------------
+// next OOK chip or finish code => go to state 1
+int8_t AFsm::a_ook_tick(unsigned long t)
+{
+  int8_t next_chip;
+
+  if (chip_hw)
+  { // code finished by hardware timer
+    chip_hw = 0;
+    _chip_timer(0);
+    return sleep();
   }
-  else if (pars->mode == AFSM_RS && _run)
-  { // ranging slave => go to state 1 and RX
-    print_str("!!! Delete THIS CODE !!!\r\n"); // FIXME
-    txrx = 0;
-    _run = 0;
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+
+  next_chip = ook_next(ook, AFSM_US(t));
+  if (next_chip == OOK_END) return sleep();
+
+  timer(AFSM_EV_TICK, this->t, dt);
+  return power != next_chip ? wave(next_chip) : SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// start sweep generator
+int8_t AFsm::a_sg(unsigned long t)
+{
+  if (pars->sweep_f > 0)
+    freq = pars->sweep_min;
+  else if (pars->sweep_f < 0)
+    freq = pars->sweep_max;
+  else // pars->sweep == 0 (?!)
+    freq = (pars->sweep_min + pars->sweep_max) / 2;
+
+  freq *= 1000; // kHz -> Hz
+  timer(AFSM_EV_TICK, t, 1); // 1 ms FIXME!
+
+  sweep_save = sx128x_get_frequency(radio); // save frequency
+  sx128x_set_frequency(radio, freq);
+  return wave(1);
+}
+//-----------------------------------------------------------------------------
+// next sweep frequency or finish => go to state 1
+int8_t AFsm::a_sg_tick(unsigned long t)
+{
+  (void) t;
+  freq += dt * pars->sweep_f; // ms * Hz/ms = Hz
+  if (freq < (pars->sweep_min * 1000) ||
+      freq > (pars->sweep_max * 1000)) // FIXME
+  { // sweep finish
+    sx128x_set_frequency(radio, sweep_save); // restore frequency
+    return sleep();
   }
-  else if (pars->mode == AFSM_AR)
-  { // advanced ranging (?!) => go to state 1 and RX
-    print_str("!!! Delete THIS CODE !!!\r\n"); // FIXME
-    txrx = 0;
-    _run = 0;
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+
+  timer(AFSM_EV_TICK, this->t, dt);
+  return sx128x_set_frequency(radio, freq);
+}
+//-----------------------------------------------------------------------------
+// start spectrum scan from first channel
+int8_t AFsm::a_scan(unsigned long t)
+{
+  if (scan == (scan_t*) NULL)
+  { // scanner not set
+    sleep();
+    return SX128X_ERR_BAD_CALL;
   }
 
-  if (retv != SX128X_ERR_NONE) print_ival("error in AFsm::tx_done(): err=", retv);
+  scan_plan(scan, pars->scan_min, pars->scan_max, pars->scan_step);
+  scan_begin(scan, t);
+  scan_ch = 0;
+
+  sweep_save = sx128x_get_frequency(radio); // save frequency
+  rx_path();
+  timer(AFSM_EV_TICK, t, pars->scan_dwell ? pars->scan_dwell : 1);
+  return scan_rx(scan_ch);
 }
 //-----------------------------------------------------------------------------
-// RX done by RxDone interrupt
-void AFsm::rx_done()
+// sample RSSI and go to next channel or finish => go to state 1
+int8_t AFsm::a_scan_tick(unsigned long t)
 {
+  uint8_t i, rssi;
   int8_t retv = SX128X_ERR_NONE;
-  
-  if (pars->mode == AFSM_RP) led->on();
-  else                       led->blink();
-
-  if (pars->mode == AFSM_RX)
-  { // RX mode => next RX
-    _run = txrx = 0;
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_recv(radio, *fixed ? *data_size : 0, *fixed,
-                       SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+
+  for (i = 0; i < pars->scan_samples && retv == SX128X_ERR_NONE; i++)
+  {
+    retv = sx128x_rssi_lora(radio, &rssi);
+    if (retv == SX128X_ERR_NONE) scan_add(scan, scan_ch, rssi);
   }
-  else if (pars->mode == AFSM_RQ && _run)
-  { // requester mode => go to state 1 and sleep
-    txrx = 0;
-    retv = sleep();
+
+  if (retv != SX128X_ERR_NONE || ++scan_ch >= scan->channels)
+  { // scan finish
+    if (retv == SX128X_ERR_NONE) scan_end(scan, t);
+    sx128x_standby(radio, SX128X_STANDBY_RC); // stop continuous RX
+    sx128x_set_frequency(radio, sweep_save);  // restore frequency
+    sleep();
+    return retv;
   }
-  else if (pars->mode == AFSM_RP)
-  { // responder mode => go to TX
-    //t_tx_start = t_rx_done;
-    t_tx_start = TIME_FUNC(); // FIXME
-    power = 1;
-    setRXEN(0);
-    setTXEN(1);
-    retv = sx128x_send(radio, data, *data_size, *fixed,
-                       Opt.tx_timeout, SX128X_TIME_BASE_1MS);
+
+  timer(AFSM_EV_TICK, this->t, dt);
+  return scan_rx(scan_ch);
+}
+//-----------------------------------------------------------------------------
+// TX or requester -> send packet
+int8_t AFsm::a_send(unsigned long t)
+{
+  t_tx_start = t;
+  tx_len = *data_size;
+  power = 1;
+  led->on();
+  tx_path();
+  return sx128x_send(radio, tx_frame(t), *data_size, *fixed,
+                     *tx_timeout, SX128X_TIME_BASE_1MS);
+}
+//-----------------------------------------------------------------------------
+// RX or responder -> go to continuous receive mode (stop period timer)
+int8_t AFsm::a_recv(unsigned long t)
+{
+  (void) t;
+  _run = txrx = 0;
+  rx_path();
+  return sx128x_recv(radio, *fixed ? *data_size : 0, *fixed,
+                     SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+}
+//-----------------------------------------------------------------------------
+// requester TX done => RX answer (go to state 1)
+int8_t AFsm::a_listen(unsigned long t)
+{
+  (void) t;
+  if (!_run) return SX128X_ERR_NONE;
+  txrx = 0;
+  rx_path();
+  return sx128x_recv(radio, *fixed ? *data_size : 0, *fixed,
+                     pars->t / 2, SX128X_TIME_BASE_1MS); // FIXME: timeout = period / 2 [ms]
+}
+//-----------------------------------------------------------------------------
+// responder RX done => send answer
+int8_t AFsm::a_reply(unsigned long t)
+{
+  t_tx_start = t;
+  tx_len = *data_size;
+  power = 1;
+  tx_path();
+  return sx128x_send(radio, tx_frame(t), *data_size, *fixed,
+                     *tx_timeout, SX128X_TIME_BASE_1MS);
+}
+//-----------------------------------------------------------------------------
+// periodic exchange done => go to state 1 and sleep
+int8_t AFsm::a_done(unsigned long t)
+{
+  (void) t;
+  return _run ? sleep() : SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// requester RX done => sleep (go to state 1) or next request now (flood)
+int8_t AFsm::a_rq_done(unsigned long t)
+{
+  if (_run && _flood) return a_send(t); // radio is in standby after RX
+  return a_done(t);
+}
+//-----------------------------------------------------------------------------
+// requester TX/RX timeout => idle (go to state 1) or next request now (flood)
+int8_t AFsm::a_rq_timeout(unsigned long t)
+{
+  if (_run && _flood) return a_send(t);
+  return a_timeout(t);
+}
+//-----------------------------------------------------------------------------
+// ranging master start (first exchange of session)
+int8_t AFsm::a_ranging(unsigned long t)
+{
+  uint32_t addr;
+
+  t_tx_start = t;
+  power = 1;
+  led->on();
+  if (rng != (range_t*) NULL && pos != (pos_t*) NULL &&
+      pos_begin(pos, t, &addr))
+  { // first anchor of cycle (session even for single shot)
+    int8_t retv = sx128x_ranging_master_address_update(radio, addr);
+    if (retv != SX128X_ERR_NONE) return retv;
+    range_begin(rng, t);
   }
-  else if (pars->mode == AFSM_RM && _run)
-  { // ranging master mode => go to state 1 and sleep
-    print_str("!!! Delete THIS CODE !!!\r\n"); // FIXME
-    retv = sleep();
+  else if (rng != (range_t*) NULL && rng->count > 1)
+    range_begin(rng, t);
+  if (div != (rdiv_t*) NULL) rdiv_reset(div); // slave is parked on channel
+  tx_path();
+  return ranging_tx(t);
+}
+//-----------------------------------------------------------------------------
+// ranging master result => re-arm next exchange or finish session
+int8_t AFsm::a_ranging_next(unsigned long t)
+{
+  if (rng != (range_t*) NULL && rng->active)
+  {
+    if (range_next(rng))
+    { // chip is in STDBY_RC after result read, TX path is kept
+      if (div != (rdiv_t*) NULL) rdiv_next(div); // slave hops after response
+      return ranging_tx(t);
+    }
+    range_end(rng, t);
+    if (next_anchor(t)) return SX128X_ERR_NONE;
   }
-  else if (pars->mode == AFSM_RS || pars->mode == AFSM_AR)
-  { // ranging slave or advanced ranging mode => next RX
-    print_str("!!! Delete THIS CODE !!!\r\n"); // FIXME
-    _run = txrx = 0;
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+  return a_done(t);
+}
+//-----------------------------------------------------------------------------
+// ranging master timeout => re-arm next exchange or finish session
+int8_t AFsm::a_ranging_lost(unsigned long t)
+{
+  if (rng != (range_t*) NULL && rng->active)
+  {
+    if (range_next(rng))
+    { // slave hops after silent RX window
+      if (div != (rdiv_t*) NULL) rdiv_next(div);
+      return ranging_tx(t);
+    }
+    range_end(rng, t);
+    if (next_anchor(t)) return SX128X_ERR_NONE;
   }
+  return a_timeout(t);
+}
+//-----------------------------------------------------------------------------
+// ranging session finished => session to next anchor of cycle
+// (return 1 if started, only request address is written by SPI)
+int8_t AFsm::next_anchor(unsigned long t)
+{
+  uint32_t addr;
 
-  if (retv != SX128X_ERR_NONE) print_ival("error in AFsm::rx_done(): err=", retv);
+  if (pos == (pos_t*) NULL || !pos_next(pos, rng, t, &addr)) return 0;
+  range_begin(rng, t);
+  if (div != (rdiv_t*) NULL) rdiv_reset(div); // next anchor is parked
+  if (sx128x_ranging_master_address_update(radio, addr) != SX128X_ERR_NONE ||
+      ranging_tx(t) != SX128X_ERR_NONE)
+  {
+    rng->active = pos->active = 0; // cycle is broken (not reported)
+    return 0;
+  }
+  return 1;
 }
 //-----------------------------------------------------------------------------
-// ranging done interrupt
-void AFsm::ranging_done()
+// ranging slave or advanced ranging -> continuous receive (stop period timer)
+int8_t AFsm::a_ranging_rx(unsigned long t)
 {
-  int8_t retv = SX128X_ERR_NONE;
-  
-  if (pars->mode == AFSM_RM && _run)
-  { // ranging master done => 
-    retv = sleep();
+  (void) t;
+  _run = txrx = 0;
+  rx_path();
+  if (pars->mode == AFSM_RS && div != (rdiv_t*) NULL && div->on)
+  { // park on first channel of schedule
+    int8_t retv = div_tune(rdiv_reset(div));
+    if (retv != SX128X_ERR_NONE) return retv;
   }
-  else if (pars->mode == AFSM_RS)
-  { // ranging  => next RX
-    print_str("!!! Delete THIS CODE !!!\r\n"); // FIXME
-    _run = txrx = 0;
-    led->blink();
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+  return sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+}
+//-----------------------------------------------------------------------------
+// advanced ranging done => next RX
+int8_t AFsm::a_ranging_done(unsigned long t)
+{
+  led->blink();
+  return a_ranging_rx(t);
+}
+//-----------------------------------------------------------------------------
+// ranging slave (re)start receiver on current channel (after discard):
+// continuous if parked or diversity is off, else RX window
+int8_t AFsm::ranging_listen()
+{
+  uint32_t n;
+
+  if (pars->mode != AFSM_RS || div == (rdiv_t*) NULL || !div->on || div->park)
+    return sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS,
+                     SX128X_TIME_BASE_15_625US);
+
+  n = rdiv_slot_us(div, radio->pars->sf, radio->pars->bw) * 64 / 1000;
+  if (n < 1)      n = 1;
+  if (n > 0xFFFF) n = 0xFFFF;
+  return sx128x_rx(radio, (uint16_t) n, SX128X_TIME_BASE_15_625US);
+}
+//-----------------------------------------------------------------------------
+// ranging slave response done => next channel of schedule
+int8_t AFsm::a_ranging_hop(unsigned long t)
+{
+  (void) t;
+  int8_t retv;
+
+  if (div == (rdiv_t*) NULL || !div->on)
+    return SX128X_ERR_NONE; // continuous RX on one channel
+
+  retv = sx128x_standby(radio, SX128X_STANDBY_XOSC); // stop receiver
+  if (retv == SX128X_ERR_NONE) retv = div_tune(rdiv_next(div));
+  if (retv == SX128X_ERR_NONE) retv = ranging_listen();
+  return retv;
+}
+//-----------------------------------------------------------------------------
+// ranging slave silent RX window => next channel or park on first one
+int8_t AFsm::a_ranging_slot(unsigned long t)
+{
+  (void) t;
+  int8_t retv;
+
+  if (div == (rdiv_t*) NULL || !div->on)
+    return ranging_listen(); // diversity is off in RX window
+
+  // chip is in STDBY_RC after RX timeout
+  retv = div_tune(rdiv_silent(div));
+  if (retv == SX128X_ERR_NONE) retv = ranging_listen();
+  return retv;
+}
+//-----------------------------------------------------------------------------
+// TDMA node start => receive, own slots by scheduler (stop period timer)
+int8_t AFsm::a_slot(unsigned long t)
+{
+  if (tdma == (tdma_t*) NULL)
+  { // scheduler not set
+    sleep();
+    return SX128X_ERR_BAD_CALL;
   }
-  else if (pars->mode == AFSM_AR)
-  { // advanced ranging mode => next RX
-    _run = txrx = 0;
-    led->blink();
-    setRXEN(1);
-    setTXEN(0);
-    retv = sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+
+  tdma_begin(tdma, AFSM_US(t), sx128x_time_on_air(radio, *data_size));
+  return a_slot_rx(t);
+}
+//-----------------------------------------------------------------------------
+// TDMA node TX done or timeout => continuous receive till own slot
+int8_t AFsm::a_slot_rx(unsigned long t)
+{
+  (void) t;
+  _run = power = 0;
+  txrx = 1;
+  led->off();
+  rx_path();
+  return sx128x_recv(radio, *fixed ? *data_size : 0, *fixed,
+                     SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+}
+//-----------------------------------------------------------------------------
+// TDMA own slot => stamp header to TX frame and send (beacon if coordinator)
+int8_t AFsm::a_slot_tx(unsigned long t)
+{
+  tdma_stamp(tdma, tx_frame(t), *data_size, AFSM_US(t));
+  t_tx_start = t;
+  tx_len = *data_size;
+  power = 1;
+  led->on();
+  tx_path();
+  return sx128x_send(radio, frame, *data_size, *fixed,
+                     *tx_timeout, SX128X_TIME_BASE_1MS);
+}
+//-----------------------------------------------------------------------------
+// mesh node start => receive, own packets and relays by mesh (stop period
+// timer, own packet every period if `orig` set)
+int8_t AFsm::a_mesh(unsigned long t)
+{
+  if (mesh == (mesh_t*) NULL)
+  { // relay not set
+    sleep();
+    return SX128X_ERR_BAD_CALL;
   }
-  
-  if (retv != SX128X_ERR_NONE) print_ival("error in AFsm::ranging_done(): err=", retv);
+
+  mesh_begin(mesh, AFSM_US(t), pars->t * 1000);
+  return a_mesh_rx(t);
+}
+//-----------------------------------------------------------------------------
+// mesh node => continuous receive till next own or relay packet
+int8_t AFsm::a_mesh_rx(unsigned long t)
+{
+  (void) t;
+  _run = power = 0;
+  txrx = 1;
+  led->off();
+  rx_path();
+  return sx128x_recv(radio, *fixed ? *data_size : 0, *fixed,
+                     SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
 }
 //-----------------------------------------------------------------------------
+// mesh packet is due => check channel by LoRa CAD (no CAD in other modems)
+int8_t AFsm::a_mesh_cad(unsigned long t)
+{
+  int8_t retv = sx128x_standby(radio, SX128X_STANDBY_XOSC); // stop receiver
 
-/*** end of "afsm.cpp" file ***/
+  if (sx128x_get_mode(radio) != SX128X_PACKET_TYPE_LORA)
+  { // channel is assumed free
+    cad_busy = 0;
+    return a_mesh_send(t);
+  }
+
+  if (retv == SX128X_ERR_NONE) retv = sx128x_cad(radio);
+  if (retv != SX128X_ERR_NONE)
+  { // retry later
+    mesh_busy(mesh, AFSM_US(t));
+    a_mesh_rx(t);
+  }
+  return retv;
+}
+//-----------------------------------------------------------------------------
+// CAD done => send if channel is free, else backoff and receive
+int8_t AFsm::a_mesh_send(unsigned long t)
+{
+  uint8_t size = *data_size;
+  uint8_t *buf;
+
+  if (cad_busy)
+  {
+    mesh_busy(mesh, AFSM_US(t));
+    return a_mesh_rx(t);
+  }
+
+  buf = mesh_tx(mesh, tx_frame(t), &size, AFSM_US(t)); // own to TX frame
+  if (buf == (uint8_t*) NULL) return a_mesh_rx(t); // canceled
+
+  t_tx_start = t;
+  tx_len = size;
+  power = 1;
+  led->on();
+  tx_path();
+  return sx128x_send(radio, buf, size, *fixed,
+                     *tx_timeout, SX128X_TIME_BASE_1MS);
+}
+//-----------------------------------------------------------------------------
+// mesh TX done or timeout => account time on air and receive
+int8_t AFsm::a_mesh_done(unsigned long t)
+{
+  mesh_done(mesh, AFSM_US(t), sx128x_time_on_air(radio, mesh->size));
+  return a_mesh_rx(t);
+}
+//-----------------------------------------------------------------------------
 
+/*** end of "afsm.cpp" file ***/
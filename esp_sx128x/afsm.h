@@ -6,8 +6,16 @@
 #define AFSM_H
 //-----------------------------------------------------------------------------
 #include <stdint.h>
+#include <string.h> // memcpy()
 #include "ablink.h"
 #include "sx128x.h"
+#include "scan.h"
+#include "ook.h"
+#include "range.h"
+#include "pos.h"
+#include "rdiv.h"
+#include "tdma.h"
+#include "mesh.h"
 //-----------------------------------------------------------------------------
 // sweep generator default parameters (Wi-Fi channel #6 +/- 7 MHz)
 #define AFSM_SWEEP_MIN 2430000 // minimal frequency [kHz]
@@ -25,6 +33,9 @@ typedef enum {
   AFSM_RS,     // continuous ranging slave (RS)
   AFSM_AR,     // continuous advanced ranging (AR)
   AFSM_SG,     // sweep generator (SG)
+  AFSM_SC,     // spectrum scanner (SC)
+  AFSM_TD,     // TDMA slot node (TD)
+  AFSM_MS,     // mesh relay node (MS)
   AFSM_MODES   // number of FSM modes 
 } afsm_mode_t; // 0...AFSM_MODES-1
 //-----------------------------------------------------------------------------
@@ -38,72 +49,159 @@ typedef enum {
   "RM - periodic ranging master",             \
   "RS - continuous ranging slave",            \
   "AR - continuous advanced ranging",         \
-  "SG - Sweep Generator" };
+  "SG - Sweep Generator",                     \
+  "SC - spectrum scanner",                    \
+  "TD - TDMA slot node",                      \
+  "MS - mesh relay node" };
 //-----------------------------------------------------------------------------
-#define AFSM_MODE_HELP "0:CW 1:OOK 2:TX 3:RX 4:RQ 5:RP 6:RM 7:RS 8:AR 9:SW"
+#define AFSM_MODE_HELP "0:CW 1:OOK 2:TX 3:RX 4:RQ 5:RP 6:RM 7:RS 8:AR 9:SG 10:SC 11:TD 12:MS"
 //-----------------------------------------------------------------------------
 extern const char * const afsm_mode_string[AFSM_MODES];
 //-----------------------------------------------------------------------------
 // options for FSM
 typedef struct {
   uint8_t  mode;  // AFSM_CW, AFSM_OOK, AFSM_TX, AFSM_RX,
-                  // AFSM_RQ, AFSM_RP, AFSM_RM, AFSM_RS, AFSM_AD, AFSM_SG
+                  // AFSM_RQ, AFSM_RP, AFSM_RM, AFSM_RS, AFSM_AD, AFSM_SG,
+                  // AFSM_SC, AFSM_TD, AFSM_MS
 
   uint32_t t;     // TX period [ms]
   uint32_t dt;    // CW time [ms]
   uint32_t dc;    // OOK code chip time [ms]
+  uint32_t dcu;   // OOK code chip time by hardware timer [us] (0 - use `dc`)
   uint32_t wut;   // radio wakeup time [ms]
 
   // sweep generator (SG)
   uint32_t sweep_min; // minimal frequency [kHz]
   uint32_t sweep_max; // maximal frequency [kHz]
   int32_t  sweep_f;   // sweep factor [kHz/s]
+
+  // spectrum scanner (SC)
+  uint32_t scan_min;     // first channel frequency [kHz]
+  uint32_t scan_max;     // last channel frequency [kHz]
+  uint32_t scan_step;    // channel step [kHz]
+  uint16_t scan_dwell;   // dwell time on each channel [ms]
+  uint8_t  scan_samples; // RSSI samples on each channel
 } afsm_pars_t;
 //-----------------------------------------------------------------------------
 // FSM default options
 extern const afsm_pars_t afsm_pars_default;
 //-----------------------------------------------------------------------------
+// FSM events
+typedef enum {
+  AFSM_EV_START = 0, // start command (CLI, autostart)
+  AFSM_EV_STOP,      // stop command (CLI)
+  AFSM_EV_PERIOD,    // period timer (TX/RX start)
+  AFSM_EV_WAKEUP,    // radio wakeup pause finish
+  AFSM_EV_TICK,      // CW/OOK chip/SG step/SC dwell interval/TD slot start
+  AFSM_EV_TX_DONE,   // TxDone interrupt
+  AFSM_EV_RX_DONE,   // RxDone interrupt
+  AFSM_EV_TIMEOUT,   // RX/TX timeout interrupt
+  AFSM_EV_RANGING,   // ranging done interrupt
+  AFSM_EV_CAD,       // CadDone interrupt
+  AFSM_EVENTS,       // number of FSM events
+  AFSM_EV_NONE = AFSM_EVENTS // no event (timer off)
+} afsm_event_t;
+//-----------------------------------------------------------------------------
+#define AFSM_EVENT_STRING { \
+  "start", "stop", "period", "wakeup", "tick", \
+  "tx_done", "rx_done", "timeout", "ranging", "cad" }
+//-----------------------------------------------------------------------------
+extern const char * const afsm_event_string[AFSM_EVENTS];
+//-----------------------------------------------------------------------------
+#ifndef AFSM_QUEUE_SIZE
+#  define AFSM_QUEUE_SIZE 8 // event queue size
+#endif
+//-----------------------------------------------------------------------------
+// event callback (called after every dispatched event, err - action result)
+typedef void (*afsm_cb_t)(uint8_t ev, int8_t err, unsigned long t);
+//-----------------------------------------------------------------------------
+// TX stamper (puts headers to TX frame of `size` bytes at TX start `t`)
+typedef void (*afsm_stamp_t)(uint8_t *frame, uint8_t size, unsigned long t);
+//-----------------------------------------------------------------------------
 // FSM class
 class AFsm {
 private:
   // pointers to external (global) objects
-  ABlink      *led;       // onboard LED
-  afsm_pars_t *pars;      // FSM options
-  uint8_t     *data;      // RX/TX packet data
-  uint8_t     *data_size; // RX/TX packet data size (bytes)
-  uint8_t     *fixed;     // 1-fixed packet size, 0-variable packet size 
-  const char  *code;      // CW code (like "100101")
-  uint8_t     *code_size; // CW code size (chips) = strlen(code)
-  sx128x_t    *radio;     // SX128x object
+  ABlink      *led;        // onboard LED
+  afsm_pars_t *pars;       // FSM options
+  uint8_t     *data;       // RX/TX packet data
+  uint8_t     *data_size;  // RX/TX packet data size (bytes)
+  uint8_t     *fixed;      // 1-fixed packet size, 0-variable packet size 
+  ook_t       *ook;        // OOK code or NULL
+  sx128x_t    *radio;      // SX128x object
+  uint32_t    *tx_timeout; // TX timeout (0 - disable) [ms]
+
+  // TX frame: copy of `data` with headers (`data` is never changed)
+  uint8_t frame[256];
+
+  // event queue
+  uint8_t _queue[AFSM_QUEUE_SIZE];
+  uint8_t _head;   // index of first event
+  uint8_t _cnt;    // number of events in queue
+  uint32_t _drops; // dropped events (queue overflow)
 
   // period timer
-  uint8_t  _start;  // start period timer command {0|1}
-  int8_t   _stop;   // stop period timer command {0|1}
+  int8_t   _stop;   // deferred stop command {0|1}
   uint8_t  _run;    // state (0 - initial (TX off), 1 - run (TX on))
-  unsigned long _t; // last call for periodic timer
+  unsigned long _t; // last call of period timer
+  uint64_t _acc;    // elapsed time in period (wrap safe) [TIME_FUNC() units]
 
-  // TX/RX FSM
-  uint8_t txrx_start; // start TX timer {0|1}
-  uint8_t txrx;       // TX/RX state {0-RX, 1-TX}
+  // TX/RX timer
+  uint8_t txrx_start; // period timer fired, wait state 1 {0|1}
+  uint8_t txrx;       // TX/RX state {0-idle, 1-TX/RX}
   uint8_t power;      // power 1-on / 0-off
-  uint8_t wus;        // wakeup state (wut or 0)
-  uint16_t code_cnt;  // code counter 0...code_size-1 
-  unsigned long dt;   // CW/chip time (dt or dc) [ms]
-  unsigned long t;    // last call for TXRX FSM
+  uint8_t tmr;        // timer event (AFSM_EV_WAKEUP, AFSM_EV_TICK or AFSM_EV_NONE)
+  uint8_t chip_hw;    // OOK chips by hardware timer {0|1}
+  uint8_t _flood;     // RQ: next request right after reply/timeout {0|1}
+  unsigned long dt;   // timer interval (wut, dt, dc) [ms]
+  unsigned long t;    // timer start
 
   // sweep generator
   uint32_t freq; // current frequency [Hz]
   uint32_t sweep_save; // saved frequency to restore [Hz]
 
+  // spectrum scanner
+  scan_t  *scan;    // scanner statistic or NULL
+  uint16_t scan_ch; // current channel
+
+  // multi-sample ranging session (RM)
+  range_t *rng;     // session and filters or NULL (single shot)
+  pos_t   *pos;     // multi-anchor schedule or NULL (one slave)
+
+  // ranging frequency diversity (RM/RS)
+  rdiv_t  *div;     // channel schedule or NULL (one channel)
+
+  // TDMA slot node (TD)
+  tdma_t  *tdma;    // slot scheduler or NULL
+
+  // mesh relay node (MS)
+  mesh_t  *mesh;    // flooding relay or NULL
+  uint8_t  cad_busy; // last CAD result {0-free|1-detected}
+
   uint8_t sleep_ready; // ready to sleep flag {0|1}
 
   unsigned long t_tx_start;  // TX start time
+  uint8_t       tx_len;      // last TX frame size [bytes]
   unsigned long t_tx_done;   // TX done time
   unsigned long t_rx_done;   // RX done time
   unsigned long t_rx_done_p; // RX done time (previous)
 
   void (*_setRXEN)(uint8_t rxen); // set RXEN or NULL
   void (*_setTXEN)(uint8_t txen); // set TXEN or NULL
+  afsm_cb_t _cb;                  // event callback or NULL
+  afsm_stamp_t _stamp;            // TX stamper or NULL
+  int8_t (*_chip_timer)(uint32_t us); // start (us > 0)/stop OOK chip timer or NULL
+
+  // action of transition table
+  typedef int8_t (AFsm::*action_t)(unsigned long t);
+  static const action_t action[AFSM_MODES][AFSM_EVENTS];
+
+  // start timer: `ev` fired after `ms` from `t0`
+  void timer(uint8_t ev, unsigned long t0, unsigned long ms) {
+    tmr = ev;
+    t   = t0;
+    dt  = ms;
+  }
 
   // TX wave ON/OFF
   int8_t wave(uint8_t on) {
@@ -117,6 +215,7 @@ private:
   int8_t sleep() {
     int8_t retv = sx128x_sleep(radio, SX128X_SLEEP_OFF_RETENTION);
     led->set(txrx = power = 0);
+    tmr = AFSM_EV_NONE;
     sleep_ready = 1;
     return retv;
   }
@@ -130,8 +229,92 @@ private:
     return retv;
   }
 
-  void start_fsm(unsigned long t); // form txrx_start
-  void txrx_fsm(unsigned long t);  // TX/RX FSM after txrx_start
+  // copy packet data to TX frame and stamp headers at TX start `t`
+  uint8_t *tx_frame(unsigned long t) {
+    memcpy((void*) frame, (const void*) data, *data_size);
+    if (_stamp != (afsm_stamp_t) NULL) _stamp(frame, *data_size, t);
+    return frame;
+  }
+
+  // switch antenna to RX
+  void rx_path() {
+    setRXEN(1);
+    setTXEN(0);
+  }
+
+  // switch antenna to TX
+  void tx_path() {
+    setRXEN(0);
+    setTXEN(1);
+  }
+
+  // tune to scanner channel by precomputed code and start RX
+  int8_t scan_rx(uint16_t ch) {
+    int8_t retv = sx128x_standby(radio, SX128X_STANDBY_XOSC);
+    if (retv == SX128X_ERR_NONE)
+      retv = sx128x_set_frequency_code(radio, scan->code[ch]);
+    if (retv == SX128X_ERR_NONE)
+      retv = sx128x_rx(radio, SX128X_RX_TIMEOUT_CONTINUOUS,
+                       SX128X_TIME_BASE_1MS);
+    return retv;
+  }
+
+  // tune to ranging diversity channel by precomputed code (TX/RX is off)
+  int8_t div_tune(uint8_t ch) {
+    if (rng != (range_t*) NULL) rng->ch = ch; // channel of next sample
+    return sx128x_set_frequency_code(radio, div->code[ch]);
+  }
+
+  // ranging master request on channel of current exchange
+  int8_t ranging_tx(unsigned long t) {
+    int8_t retv = SX128X_ERR_NONE;
+    if (div != (rdiv_t*) NULL && div->on) retv = div_tune(rdiv_channel(div));
+    t_tx_start = t;
+    if (retv == SX128X_ERR_NONE)
+      retv = sx128x_tx(radio, SX128X_TX_TIMEOUT_SINGLE, SX128X_TIME_BASE_1MS);
+    return retv;
+  }
+
+  // actions (look transition table in "afsm.cpp")
+  int8_t a_none(unsigned long t);
+  int8_t a_start(unsigned long t);
+  int8_t a_stop(unsigned long t);
+  int8_t a_period(unsigned long t);
+  int8_t a_timeout(unsigned long t);
+  int8_t a_cw(unsigned long t);
+  int8_t a_cw_tick(unsigned long t);
+  int8_t a_ook(unsigned long t);
+  int8_t a_ook_tick(unsigned long t);
+  int8_t a_sg(unsigned long t);
+  int8_t a_sg_tick(unsigned long t);
+  int8_t a_scan(unsigned long t);
+  int8_t a_scan_tick(unsigned long t);
+  int8_t a_send(unsigned long t);
+  int8_t a_recv(unsigned long t);
+  int8_t a_listen(unsigned long t);
+  int8_t a_reply(unsigned long t);
+  int8_t a_done(unsigned long t);
+  int8_t a_rq_done(unsigned long t);
+  int8_t a_rq_timeout(unsigned long t);
+  int8_t a_ranging(unsigned long t);
+  int8_t a_ranging_next(unsigned long t);
+  int8_t a_ranging_lost(unsigned long t);
+  int8_t a_ranging_rx(unsigned long t);
+  int8_t a_ranging_done(unsigned long t);
+  int8_t a_ranging_hop(unsigned long t);
+  int8_t a_ranging_slot(unsigned long t);
+  int8_t a_slot(unsigned long t);
+  int8_t a_slot_rx(unsigned long t);
+  int8_t a_slot_tx(unsigned long t);
+  int8_t a_mesh(unsigned long t);
+  int8_t a_mesh_rx(unsigned long t);
+  int8_t a_mesh_cad(unsigned long t);
+  int8_t a_mesh_send(unsigned long t);
+  int8_t a_mesh_done(unsigned long t);
+  int8_t next_anchor(unsigned long t);
+
+  // run all queued events
+  void dispatch(unsigned long t);
 
 public:
   // set RXEN
@@ -150,97 +333,156 @@ public:
              uint8_t     *data,         // RX/TX packet data
              uint8_t     *data_size,    // RX/TX packet data size (bytes)
              uint8_t     *fixed,        // 1-fixed packet size, 0-variable packet size 
-             const char  *code,         // OOK code (like "100101")
-             uint8_t     *code_size,    // OOK code size (chips) = strlen(code)
+             ook_t       *ook,          // OOK code or NULL
              sx128x_t    *radio,        // SX128x object
+             uint32_t    *tx_timeout,   // TX timeout (0 - disable) [ms]
              void (*rxen)(uint8_t),     // set RXEN or NULL
-             void (*txen)(uint8_t))     // set TXEN or NULL
+             void (*txen)(uint8_t),     // set TXEN or NULL
+             afsm_cb_t   cb = NULL)     // event callback or NULL
   {
     // save pointers to external (global) objects
-    this->led       = led;
-    this->pars      = pars;
-    this->data      = data;
-    this->data_size = data_size;
-    this->fixed     = fixed;
-    this->code      = code;
-    this->code_size = code_size;
-    this->radio     = radio;
+    this->led        = led;
+    this->pars       = pars;
+    this->data       = data;
+    this->data_size  = data_size;
+    this->fixed      = fixed;
+    this->ook        = ook;
+    this->radio      = radio;
+    this->tx_timeout = tx_timeout;
 
     _setRXEN = rxen;
     _setTXEN = txen;
+    _cb      = cb;
+
+    _chip_timer = NULL; // OOK chips by loop only
+    _stamp      = NULL; // TX frame is copy of data
+    _flood      = 0;    // RQ by period timer
+
+    // event queue
+    _head  = 0;
+    _cnt   = 0;
+    _drops = 0;
 
     // period timer
-    _start = 0; // start timer command
-    _stop  = 0; // stop timer command
-    _run   = 0; // state (0-initial (TX off), 1-run (TX on))
-    _t     = 0;
-
-    // TX/RX FSM
-    txrx_start = 0; // start TX timer flag
-    txrx       = 0; // TX/RX state 
-    power      = 0; // power on/off
-    wus        = 0; // wakeup state (wut or 0)
-    code_cnt   = 0; // code counter 0...code_size-1 
-    dt         = 0; // CW/chip time (dt or dc) [ms]
+    _stop = 0; // deferred stop command
+    _run  = 0; // state (0-initial (TX off), 1-run (TX on))
+    _t    = 0;
+    _acc  = 0;
+
+    // TX/RX timer
+    txrx_start = 0;            // period timer flag
+    txrx       = 0;            // TX/RX state 
+    power      = 0;            // power on/off
+    tmr        = AFSM_EV_NONE; // timer off
+    chip_hw    = 0;            // OOK chips by loop
+    dt         = 0;            // timer interval [ms]
     t          = 0;
  
     sleep_ready = 1; // ready to sleep
+
+    scan    = (scan_t*) NULL; // spectrum scanner off
+    scan_ch = 0;
+
+    rng = (range_t*) NULL; // single shot ranging
+    pos = (pos_t*)   NULL; // one ranging slave
+    div = (rdiv_t*)  NULL; // one ranging channel
+
+    tdma = (tdma_t*) NULL; // TDMA scheduler is not set
+
+    mesh     = (mesh_t*) NULL; // mesh relay is not set
+    cad_busy = 0;
   }
 
-  // FSM start
-  void start() {
-    if (!_run) {
-      _start = 1;
-    
-#ifdef SX128X_USE_RANGING
-      // mega fix - set ranging mode and role
-      if (pars->mode == AFSM_RM || pars->mode == AFSM_RS ||
-          pars->mode == AFSM_AR)
-      {
-        if (sx128x_get_mode(radio) != SX128X_PACKET_TYPE_RANGING)
-          // change radio mode to Ranging
-          sx128x_mode(radio, SX128X_PACKET_TYPE_RANGING);
-      
-        if (pars->mode == AFSM_AR) { // start advanced ranging
-          sx128x_set_advanced_ranging(radio, 1);
-        } else { // classic ranging => set role
-          sx128x_ranging_role(radio, pars->mode == AFSM_RM ? 0x01 : // master
-                                                             0x00); // slave
-        }
-      }
-      else if (pars->mode == AFSM_CW || pars->mode == AFSM_OOK ||
-               pars->mode == AFSM_RX || pars->mode == AFSM_TX  ||
-               pars->mode == AFSM_RQ || pars->mode == AFSM_RP)
-      {
-        if (sx128x_get_mode(radio) == SX128X_PACKET_TYPE_RANGING) {
-          sx128x_set_advanced_ranging(radio, 0); // off advanced ranging
-          sx128x_mode(radio, SX128X_PACKET_TYPE_LORA); // LoRa by default
-        }
-      }
-#endif
-    }
+  // set spectrum scanner statistic (SC mode)
+  void scanner(scan_t *scan) { this->scan = scan; }
+
+  // set ranging session (RM mode): `rng->count` exchanges back-to-back
+  // per period, results are added by range_add() before ranging_done()
+  void ranger(range_t *rng) { this->rng = rng; }
+
+  // set multi-anchor schedule (RM mode, needs ranger()): one session per
+  // anchor of `pos->list` per period, position is solved at cycle end
+  void anchors(pos_t *pos) { this->pos = pos; }
+
+  // set ranging frequency diversity (RM/RS modes): master tunes channel of
+  // schedule before every exchange, slave hops after every response
+  void diversity(rdiv_t *div) { this->div = div; }
+
+  // set TDMA slot scheduler (TD mode): continuous RX, own TX in slot of
+  // `tdma` by disciplined clock (beacon in slot 0 if coordinator)
+  void scheduler(tdma_t *tdma) { this->tdma = tdma; }
+
+  // set mesh relay (MS mode): continuous RX, own packets every period and
+  // rebroadcasts of `mesh` after random delay and free channel by LoRa CAD
+  void relay(mesh_t *mesh) { this->mesh = mesh; }
+
+  // set OOK chip timer: fn(us) starts chips of `ook` with period `us`
+  // (calls ook_begin()/ook_next()), fn(0) stops it; FSM waits `ook->done`
+  void chip_timer(int8_t (*fn)(uint32_t us)) { _chip_timer = fn; }
+
+  // set requester flood mode (RQ): next request is sent right after reply
+  // or reply timeout (radio is not put to sleep, no wakeup pause)
+  void flood(uint8_t on) { _flood = on; }
+
+  // set TX stamper: fn(frame, size, t) puts protocol headers to copy of
+  // packet data right before send (TX/RQ/RP modes)
+  void stamper(afsm_stamp_t fn) { _stamp = fn; }
+
+  // put event to queue (run by next yield() or IRQ event)
+  void post(uint8_t ev) {
+    if (_cnt >= AFSM_QUEUE_SIZE) { _drops++; return; }
+    _queue[(uint8_t) (_head + _cnt++) % AFSM_QUEUE_SIZE] = ev;
   }
+
+  // put event to queue and run it now (from IRQ handler)
+  void event(uint8_t ev);
+
+  // get number of dropped events
+  uint32_t drops() const { return _drops; }
+
+  // FSM start
+  void start() { post(AFSM_EV_START); }
   
   // FSM stop
   void stop() {
-    _stop = 1;
     led->off();
+    post(AFSM_EV_STOP);
   }
 
   // get run state
   uint8_t run() const { return _run; }
 
-  // set TX start time and LED on
-  void tx_start(unsigned long t) {
+  // get FSM mode
+  uint8_t mode() const { return pars->mode; }
+
+  // OOK chips by hardware timer now (timer callback uses radio) {0|1}
+  uint8_t chip_busy() const { return chip_hw; }
+
+  // get last TX start time
+  unsigned long tx_start_time() const { return t_tx_start; }
+
+  // get last TX frame (copy of data with headers, TX/RQ/RP/TD/MS modes)
+  const uint8_t *last_frame() const { return frame; }
+
+  // get last TX frame size [bytes] (own, reply or mesh relay)
+  uint8_t tx_size() const { return tx_len; }
+
+  // set TX start time, TX frame size and LED on
+  void tx_start(unsigned long t, uint8_t size) {
     led->on();
     t_tx_start = t;
+    tx_len     = size;
   }
 
   // TX done by TxDone interrupt
   unsigned long tx_done_dt(unsigned long irq_t) {
     return (t_tx_done = irq_t) - t_tx_start;
   }
-  void tx_done();
+  void tx_done() {
+    led->off();
+    power = 0;
+    event(AFSM_EV_TX_DONE);
+  }
   
   // RX done by RxDone interrupt
   unsigned long rx_done_dt(unsigned long irq_t) {
@@ -248,22 +490,30 @@ public:
     t_rx_done = irq_t;
     return t_rx_done - t_rx_done_p;
   }
-  void rx_done();
+  void rx_done() {
+    if (pars->mode == AFSM_RP) led->on();
+    else                       led->blink();
+    event(AFSM_EV_RX_DONE);
+  }
 
   // ranging done interrupt
-  void ranging_done();
+  void ranging_done() { event(AFSM_EV_RANGING); }
+
+  // CAD done interrupt (busy - CadDetected)
+  void cad_done(uint8_t busy) {
+    cad_busy = busy;
+    event(AFSM_EV_CAD);
+  }
   
+  // ranging slave (re)start receiver on current channel (after discard):
+  // continuous if parked or diversity is off, else RX window
+  int8_t ranging_listen();
+
   // RX/TX timeout interrupt
-  void rxtx_timeout() {
-    led->off();
-    txrx = power = 0;
-  }
+  void rxtx_timeout() { event(AFSM_EV_TIMEOUT); }
 
-  // periodic call from main loop (t = millis())
-  void yield(unsigned long t) {
-    start_fsm(t); // form txrx_start timer
-    txrx_fsm(t);  // TX/RX FSM 
-  }
+  // periodic call from main loop (t = TIME_FUNC())
+  void yield(unsigned long t);
 };
 //-----------------------------------------------------------------------------
 #endif // AFSM_H
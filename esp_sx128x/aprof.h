@@ -0,0 +1,96 @@
+/*
+ * Main loop profiler (CPU cycles per stage)
+ * File: "aprof.h"
+ */
+
+#pragma once
+#ifndef APROF_H
+#define APROF_H
+//-----------------------------------------------------------------------------
+#include <Arduino.h>
+#include "config.h"
+#include "lat.h"
+//-----------------------------------------------------------------------------
+// loop() stages
+typedef enum {
+  APROF_LED = 0, // Led.yield()
+  APROF_TICKER,  // Ticker.yield()
+  APROF_FSM,     // Fsm.yield()
+  APROF_IRQ,     // sx128x_irq()
+  APROF_RING,    // rx_ring_yield()
+  APROF_PRINT,   // capture_yield() + print_yield()
+  APROF_CLI,     // cli_loop()
+  APROF_MISC,    // button, autostart
+  APROF_MQTT,    // Mqtt.loop()
+  APROF_LOOP,    // whole loop()
+  APROF_STAGES   // number of stages
+} aprof_stage_t;
+//-----------------------------------------------------------------------------
+#define APROF_STAGE_STRING { \
+  "led", "ticker", "fsm", "irq", "ring", "print", "cli", "misc", "mqtt", "loop" }
+//-----------------------------------------------------------------------------
+#ifdef USE_PROF
+#  define PROF_BEGIN(stage) Prof.begin(stage)
+#  define PROF_END(stage)   Prof.end(stage)
+#else
+#  define PROF_BEGIN(stage) // profiler off
+#  define PROF_END(stage)   // profiler off
+#endif
+//-----------------------------------------------------------------------------
+// main loop profiler class
+class AProf {
+private:
+  uint32_t   _t0[APROF_STAGES];    // start cycles of stages
+  lat_hist_t _hist[APROF_STAGES];  // histograms [cycles]
+  unsigned long _max_ms[APROF_STAGES]; // time of maximum [ms]
+
+  // worst offender (excluding whole loop)
+  uint8_t  _worst;         // stage
+  uint32_t _worst_cycles;  // duration [cycles]
+  unsigned long _worst_ms; // time [ms]
+
+public:
+  // clear all statistic
+  void reset() {
+    for (int i = 0; i < APROF_STAGES; i++) {
+      lat_clear(&_hist[i]);
+      _max_ms[i] = 0;
+    }
+    _worst        = APROF_LOOP;
+    _worst_cycles = 0;
+    _worst_ms     = 0;
+  }
+
+  // start stage
+  void begin(uint8_t stage) {
+    _t0[stage] = ESP.getCycleCount();
+  }
+
+  // finish stage
+  void end(uint8_t stage) {
+    uint32_t dt = ESP.getCycleCount() - _t0[stage];
+    lat_hist_t *h = &_hist[stage];
+    if (h->cnt == 0 || dt > h->max) _max_ms[stage] = millis();
+    lat_add(h, dt);
+    if (stage != APROF_LOOP && dt > _worst_cycles) {
+      _worst        = stage;
+      _worst_cycles = dt;
+      _worst_ms     = millis();
+    }
+  }
+
+  // get histogram of stage [cycles]
+  const lat_hist_t *hist(uint8_t stage) const { return &_hist[stage]; }
+
+  // get time of stage maximum [ms]
+  unsigned long max_ms(uint8_t stage) const { return _max_ms[stage]; }
+
+  // get worst offender
+  uint8_t worst() const { return _worst; }
+  uint32_t worst_cycles() const { return _worst_cycles; }
+  unsigned long worst_ms() const { return _worst_ms; }
+};
+//-----------------------------------------------------------------------------
+#endif // APROF_H
+
+/*** end of "aprof.h" file ***/
@@ -0,0 +1,138 @@
+/*
+ * Advanced Ranging passive capture log: ring of compact exchange records
+ * and batched binary frames (capture stream framing)
+ * File: "arlog.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "arlog.h"
+#include "crc8.h"
+//-----------------------------------------------------------------------------
+#define ARLOG_SYNC0 0xA5 // same as CAPTURE_SYNC0
+#define ARLOG_SYNC1 0x5A // same as CAPTURE_SYNC1
+#define ARLOG_MASK  (ARLOG_SIZE - 1)
+//-----------------------------------------------------------------------------
+// put 32-bit value (little endian)
+static inline uint8_t *arlog_u32(uint8_t *p, uint32_t v)
+{
+  *p++ = (uint8_t) (v      );
+  *p++ = (uint8_t) (v >>  8);
+  *p++ = (uint8_t) (v >> 16);
+  *p++ = (uint8_t) (v >> 24);
+  return p;
+}
+//-----------------------------------------------------------------------------
+// get 32-bit value (little endian)
+static inline uint32_t arlog_get32(const uint8_t *p)
+{
+  return  (uint32_t) p[0]        | ((uint32_t) p[1] <<  8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+// init log (off, empty)
+void arlog_init(arlog_t *self)
+{
+  memset((void*) self, 0, sizeof(arlog_t));
+}
+//-----------------------------------------------------------------------------
+// add exchange (return 0 if ring is full and exchange is dropped)
+uint8_t arlog_push(arlog_t *self, uint32_t t, uint32_t addr, uint32_t raw,
+                   uint8_t rssi)
+{
+  uint16_t head = self->head, used = (uint16_t) (head - self->tail);
+  arlog_rec_t *r;
+
+  if (used >= ARLOG_SIZE)
+  {
+    self->drops++;
+    return 0;
+  }
+
+  r = &self->r[head & ARLOG_MASK];
+  r->t    = t;
+  r->addr = addr;
+  r->raw  = raw & 0xFFFFFF;
+  r->rssi = rssi;
+
+  self->head = (uint16_t) (head + 1); // publish record
+  self->events++;
+  if (++used > self->peak) self->peak = used;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// records in ring
+uint16_t arlog_count(const arlog_t *self)
+{
+  return (uint16_t) (self->head - self->tail);
+}
+//-----------------------------------------------------------------------------
+// move up to ARLOG_BATCH records to frame (size >= ARLOG_FRAME_MAX),
+// return frame size (0 if ring is empty)
+uint16_t arlog_pack(arlog_t *self, uint8_t *frame)
+{
+  uint16_t n = arlog_count(self), len, tail = self->tail, i;
+  uint8_t *p = frame;
+
+  if (n == 0) return 0;
+  if (n > ARLOG_BATCH) n = ARLOG_BATCH;
+  len = ARLOG_HEAD + n * ARLOG_REC;
+
+  *p++ = ARLOG_SYNC0;
+  *p++ = ARLOG_SYNC1;
+  *p++ = (uint8_t) (len     );
+  *p++ = (uint8_t) (len >> 8);
+
+  *p++ = ARLOG_TYPE;
+  *p++ = (uint8_t) n;
+  *p++ = (uint8_t) (self->drops     );
+  *p++ = (uint8_t) (self->drops >> 8);
+
+  for (i = 0; i < n; i++)
+  {
+    const arlog_rec_t *r = &self->r[(uint16_t) (tail + i) & ARLOG_MASK];
+    p = arlog_u32(p, r->t);
+    p = arlog_u32(p, r->addr);
+    *p++ = (uint8_t) (r->raw      );
+    *p++ = (uint8_t) (r->raw >>  8);
+    *p++ = (uint8_t) (r->raw >> 16);
+    *p++ = r->rssi;
+  }
+  self->tail = (uint16_t) (tail + n); // free records
+
+  *p = crc8(frame + 2, len + 2);
+  self->frames++;
+  return len + 5;
+}
+//-----------------------------------------------------------------------------
+// unpack frame (after sync and CRC check) to `rec` (ARLOG_BATCH records),
+// return number of records (0 if frame is not log frame), `drops` - counter
+uint8_t arlog_unpack(const uint8_t *frame, uint16_t size, arlog_rec_t *rec,
+                     uint16_t *drops)
+{
+  const uint8_t *p = frame + 4;
+  uint16_t len;
+  uint8_t n, i;
+
+  if (size < 5 + ARLOG_HEAD || frame[0] != ARLOG_SYNC0 ||
+      frame[1] != ARLOG_SYNC1) return 0;
+  len = (uint16_t) frame[2] | ((uint16_t) frame[3] << 8);
+  n = p[1];
+  if (p[0] != ARLOG_TYPE || n == 0 || n > ARLOG_BATCH ||
+      len != ARLOG_HEAD + n * ARLOG_REC || size < len + 5 ||
+      crc8(frame + 2, len + 2) != frame[len + 4]) return 0;
+
+  *drops = (uint16_t) p[2] | ((uint16_t) p[3] << 8);
+  for (p += ARLOG_HEAD, i = 0; i < n; i++, p += ARLOG_REC)
+  {
+    rec[i].t    = arlog_get32(p);
+    rec[i].addr = arlog_get32(p + 4);
+    rec[i].raw  = (uint32_t) p[8] | ((uint32_t) p[9] << 8) |
+                  ((uint32_t) p[10] << 16);
+    rec[i].rssi = p[11];
+  }
+  return n;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "arlog.c" file ***/
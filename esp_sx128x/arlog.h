@@ -0,0 +1,90 @@
+/*
+ * Advanced Ranging passive capture log: ring of compact exchange records
+ * and batched binary frames (capture stream framing)
+ * File: "arlog.h"
+ */
+
+#pragma once
+#ifndef ARLOG_H
+#define ARLOG_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+//-----------------------------------------------------------------------------
+// frame (same framing as "capture.h", all fields little endian):
+//   0xA5 0x5A          - sync
+//   len   (2 bytes)    - size of record [bytes]
+//   record (len bytes) - see below
+//   crc   (1 byte)     - CRC8 of len and record (look "crc8.c")
+//
+// record:
+//   type       (1 byte)  - ARLOG_TYPE (capture record has version 1 here)
+//   n          (1 byte)  - exchanges in frame (1...ARLOG_BATCH)
+//   drops      (2 bytes) - dropped exchanges counter (low 16 bits)
+//   n times:
+//     t        (4 bytes) - AdvancedRangingDone time [us]
+//     addr     (4 bytes) - received request address
+//     raw      (3 bytes) - raw 24-bit ranging result
+//     rssi     (1 byte)  - RSSI = -rssi/2 [dBm]
+//-----------------------------------------------------------------------------
+#ifndef ARLOG_SIZE
+#  define ARLOG_SIZE 128 // ring size (power of 2) [records]
+#endif
+
+#define ARLOG_TYPE  0x80 // record type (not capture version)
+#define ARLOG_BATCH   16 // maximal exchanges in frame
+#define ARLOG_HEAD     4 // record header size [bytes]
+#define ARLOG_REC     12 // one exchange size [bytes]
+#define ARLOG_FRAME_MAX (4 + ARLOG_HEAD + ARLOG_BATCH * ARLOG_REC + 1)
+//-----------------------------------------------------------------------------
+// one Advanced Ranging exchange
+typedef struct arlog_rec_ {
+  uint32_t t;    // AdvancedRangingDone time [us]
+  uint32_t addr; // received request address
+  uint32_t raw;  // raw 24-bit result
+  uint8_t  rssi; // RSSI = -rssi/2 [dBm]
+} arlog_rec_t;
+//-----------------------------------------------------------------------------
+// capture log (one producer - IRQ handler, one consumer - main loop)
+typedef struct arlog_ {
+  uint8_t on;                   // 1 - log and stream (no console print)
+  arlog_rec_t r[ARLOG_SIZE];
+  volatile uint16_t head;       // next record to write
+  volatile uint16_t tail;       // next record to send
+  uint32_t events;              // logged exchanges
+  uint32_t drops;               // exchanges dropped by full ring
+  uint32_t frames;              // packed frames
+  uint16_t peak;                // maximal ring usage [records]
+} arlog_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init log (off, empty)
+void arlog_init(arlog_t *self);
+//-----------------------------------------------------------------------------
+// add exchange (return 0 if ring is full and exchange is dropped)
+uint8_t arlog_push(arlog_t *self, uint32_t t, uint32_t addr, uint32_t raw,
+                   uint8_t rssi);
+//-----------------------------------------------------------------------------
+// records in ring
+uint16_t arlog_count(const arlog_t *self);
+//-----------------------------------------------------------------------------
+// move up to ARLOG_BATCH records to frame (size >= ARLOG_FRAME_MAX),
+// return frame size (0 if ring is empty)
+uint16_t arlog_pack(arlog_t *self, uint8_t *frame);
+//-----------------------------------------------------------------------------
+// unpack frame (after sync and CRC check) to `rec` (ARLOG_BATCH records),
+// return number of records (0 if frame is not log frame), `drops` - counter
+uint8_t arlog_unpack(const uint8_t *frame, uint16_t size, arlog_rec_t *rec,
+                     uint16_t *drops);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // ARLOG_H
+
+/*** end of "arlog.h" file ***/
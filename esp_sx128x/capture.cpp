@@ -0,0 +1,149 @@
+/*
+ * Binary packet capture stream over Serial/USB-CDC
+ * File: "capture.cpp"
+ */
+
+//-----------------------------------------------------------------------------
+#include <Arduino.h>
+#include <string.h>
+#include "config.h"
+#include "capture.h"
+#include "crc8.h"
+//-----------------------------------------------------------------------------
+#if 1000 % (TIME_FACTOR) != 0
+#  error TIME_FACTOR must divide 1000 (capture time in microseconds)
+#endif
+//-----------------------------------------------------------------------------
+static uint8_t  capture_on  = 0; // capture stream state
+static uint32_t capture_cnt = 0; // sent frames counter
+static uint8_t  capture_buf[CAPTURE_FRAME_MAX]; // frame to send
+static uint16_t capture_len = 0; // frame size [bytes]
+static uint16_t capture_pos = 0; // already sent bytes
+//-----------------------------------------------------------------------------
+// on/off capture stream
+void capture_enable(uint8_t enable)
+{
+  capture_on = enable;
+}
+//-----------------------------------------------------------------------------
+// get capture stream state
+uint8_t capture_enabled()
+{
+  return capture_on;
+}
+//-----------------------------------------------------------------------------
+// get number of sent frames
+uint32_t capture_frames()
+{
+  return capture_cnt;
+}
+//-----------------------------------------------------------------------------
+// put 32-bit value (little endian)
+static inline uint8_t *capture_u32(uint8_t *p, uint32_t v)
+{
+  *p++ = (uint8_t) (v      );
+  *p++ = (uint8_t) (v >>  8);
+  *p++ = (uint8_t) (v >> 16);
+  *p++ = (uint8_t) (v >> 24);
+  return p;
+}
+//-----------------------------------------------------------------------------
+// pack received packet to capture frame (return frame size)
+uint16_t capture_pack(const rx_pkt_t *pkt, uint8_t *frame)
+{
+  const sx128x_rx_t *rx = &pkt->rx;
+  uint16_t len = CAPTURE_HEAD + pkt->size;
+  uint8_t flags = 0, *p = frame;
+
+  if (rx->crc_ok)    flags |= 0x01;
+  if (rx->lora)
+  {
+    flags |= 0x02;
+    if (rx->hdr.fixed) flags |= 0x04;
+    if (rx->hdr.crc)   flags |= 0x08;
+  }
+
+  *p++ = CAPTURE_SYNC0;
+  *p++ = CAPTURE_SYNC1;
+  *p++ = (uint8_t) (len     );
+  *p++ = (uint8_t) (len >> 8);
+
+  *p++ = CAPTURE_VERSION;
+  // TIME_FUNC() ticks to us (integer factor keeps 32-bit wrap)
+  p = capture_u32(p, (uint32_t) pkt->t * (uint32_t) (1000 / (TIME_FACTOR)));
+  *p++ = pkt->mode;
+  *p++ = flags;
+  *p++ = rx->lora ? rx->hdr.cr : 0;
+  *p++ = rx->rssi;
+  *p++ = rx->lora ? rx->rssi_inst : 0;
+  *p++ = rx->lora ? (uint8_t) rx->snr : 0;
+  p = capture_u32(p, rx->lora ? (uint32_t) rx->fei : 0);
+  *p++ = rx->lora ? 0 : rx->pkt_status;
+  *p++ = rx->lora ? 0 : rx->pkt_errors;
+  *p++ = rx->lora ? 0 : rx->sync_addrs;
+  *p++ = pkt->size;
+
+  memcpy((void*) p, (const void*) pkt->data, pkt->size);
+  p += pkt->size;
+
+  *p = crc8(frame + 2, len + 2);
+  return len + 5;
+}
+//-----------------------------------------------------------------------------
+// send received packet as binary frame (RX ring subscriber)
+uint8_t capture_cb(const rx_pkt_t *pkt, void *context)
+{
+  (void) context;
+  if (!capture_on) return 1; // skip
+  if (capture_len) return 0; // busy (try again later)
+
+  capture_len = capture_pack(pkt, capture_buf);
+  capture_pos = 0;
+  capture_cnt++;
+  capture_yield();
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// send ready binary frame (return 0 if busy, try again later)
+uint8_t capture_frame(const uint8_t *frame, uint16_t len)
+{
+  if (capture_len) return 0; // busy
+  if (len > CAPTURE_FRAME_MAX) len = CAPTURE_FRAME_MAX;
+
+  memcpy((void*) capture_buf, (const void*) frame, len);
+  capture_len = len;
+  capture_pos = 0;
+  capture_cnt++;
+  capture_yield();
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// send pending frame while UART/USB-CDC has room (call from main loop)
+void capture_yield()
+{
+  int room;
+  if (!capture_len) return;
+
+  room = Serial.availableForWrite();
+  if (room > capture_len - capture_pos) room = capture_len - capture_pos;
+  if (room <= 0) return;
+
+  Serial.write(capture_buf + capture_pos, room);
+  capture_pos += room;
+  if (capture_pos >= capture_len) capture_len = 0; // done
+}
+//-----------------------------------------------------------------------------
+// frame is partly sent (don't interleave with console output)
+uint8_t capture_busy()
+{
+  return capture_len != 0;
+}
+//-----------------------------------------------------------------------------
+// send rest of pending frame (wait UART/USB-CDC room) before direct output
+void capture_flush()
+{
+  while (capture_len) capture_yield();
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "capture.cpp" file ***/
@@ -0,0 +1,81 @@
+/*
+ * Binary packet capture stream over Serial/USB-CDC
+ * File: "capture.h"
+ */
+
+#pragma once
+#ifndef CAPTURE_H
+#define CAPTURE_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+// capture frame (all fields little endian):
+//   0xA5 0x5A          - sync
+//   len   (2 bytes)    - size of record [bytes]
+//   record (len bytes) - see below
+//   crc   (1 byte)     - CRC8 of len and record (look "crc8.c")
+//
+// record:
+//   version    (1 byte)  - CAPTURE_VERSION
+//   t          (4 bytes) - RxDone time [us] (TIME_FUNC() converted to us,
+//                          wraps at 2^32 us)
+//   mode       (1 byte)  - 0-GFSK, 1-LoRa, 2-Ranging, 3-FLRC, 4-BLE
+//   flags      (1 byte)  - bit0: crc_ok, bit1: lora, bit2: hdr.fixed,
+//                          bit3: hdr.crc
+//   cr         (1 byte)  - LoRa header Code Rate
+//   rssi       (1 byte)  - RSSI = -rssi/2 [dBm]
+//   rssi_inst  (1 byte)  - RSSI = -rssi_inst/2 [dBm] (LoRa/Ranging)
+//   snr        (1 byte)  - SNR = snr/4 [dB] (LoRa/Ranging)
+//   fei        (4 bytes) - FEI [Hz] (LoRa/Ranging)
+//   pkt_status (1 byte)  - GFSK/FLRC/BLE packet status
+//   pkt_errors (1 byte)  - GFSK/FLRC/BLE packet errors
+//   sync_addrs (1 byte)  - GFSK/FLRC/BLE syncAddrs code
+//   size       (1 byte)  - payload size [bytes]
+//   payload    (size bytes)
+//-----------------------------------------------------------------------------
+#define CAPTURE_SYNC0   0xA5
+#define CAPTURE_SYNC1   0x5A
+#define CAPTURE_VERSION 1
+#define CAPTURE_HEAD    19 // record header size (without payload) [bytes]
+#define CAPTURE_FRAME_MAX (4 + CAPTURE_HEAD + RX_RING_DATA_SIZE + 1)
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// on/off capture stream
+void capture_enable(uint8_t enable);
+//-----------------------------------------------------------------------------
+// get capture stream state
+uint8_t capture_enabled();
+//-----------------------------------------------------------------------------
+// get number of sent frames
+uint32_t capture_frames();
+//-----------------------------------------------------------------------------
+// pack received packet to capture frame (return frame size)
+uint16_t capture_pack(const rx_pkt_t *pkt, uint8_t *frame);
+//-----------------------------------------------------------------------------
+// send received packet as binary frame (RX ring subscriber)
+uint8_t capture_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+// send ready binary frame (return 0 if busy, try again later)
+uint8_t capture_frame(const uint8_t *frame, uint16_t len);
+//-----------------------------------------------------------------------------
+// send pending frame while UART/USB-CDC has room (call from main loop)
+void capture_yield();
+//-----------------------------------------------------------------------------
+// frame is partly sent (don't interleave with console output)
+uint8_t capture_busy();
+//-----------------------------------------------------------------------------
+// send rest of pending frame (wait UART/USB-CDC room) before direct output
+void capture_flush();
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // CAPTURE_H
+
+/*** end of "capture.h" file ***/
@@ -19,6 +19,7 @@
 #include "sx128x_hw_arduino.h"
 #include "wifi.h"
 #include "mqtt.h"
+#include "capture.h"
 //-----------------------------------------------------------------------------
 #ifdef ARDUINO_USBCDC
 #  include "usbcdc.h"
@@ -54,7 +55,7 @@ int cli_prompt_len = 2; // strlen("$ ")
 // Arduino wrapper for MicroRL
 static void cli_print(const char *str)
 {
-  Serial.print(str);
+  print_str(str);
 }
 //-----------------------------------------------------------------------------
 // получить код нажатой клавиши
@@ -72,6 +73,22 @@ int cli_inkey()
 #endif
 }
 //-----------------------------------------------------------------------------
+// OOK chips by hardware timer use radio/SPI from other core => no radio
+// commands until FSM is stopped (return 1 if rejected)
+static uint8_t cli_chip_busy()
+{
+  if (!Fsm.chip_busy()) return 0;
+  print_str("error: OOK code by timer is on air, stop FSM first (Ctrl+C)\r\n");
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// command uses radio/SPI or changes OOK code (flags of "cli_tree.h")
+static uint8_t cli_radio_cmd(const cli_cmd_t *cmd, int argc)
+{
+  if (cmd->flags & CLI_RADIO_ARG) return argc > 0;
+  return cmd->flags & CLI_RADIO;
+}
+//-----------------------------------------------------------------------------
 // execute callback for microrl library
 static void cli_execute_cb(int argc, char * const argv[])
 {
@@ -94,14 +111,21 @@ static void cli_execute_cb(int argc, char * const argv[])
     } // while
   } // for
 
+  print_log_wait(1); // don't drop CLI output
+
   if (found != (cli_cmd_t*) NULL) // command found
-    found->fn(argc - arg_shift, argv + arg_shift, found);
+  {
+    if (!cli_radio_cmd(found, argc - arg_shift) || !cli_chip_busy())
+      found->fn(argc - arg_shift, argv + arg_shift, found);
+  }
   else
   {
     print_str("command ");
     print_str(argv[0]);
     print_str(" not found\r\n");
   }
+
+  print_log_wait(0);
 }
 //-----------------------------------------------------------------------------
 #ifdef MRL_USE_COMPLETE
@@ -286,6 +310,17 @@ void cli_verbose(int argc, char* const argv[], const cli_cmd_t *cmd)
   print_ival("verbose=", Opt.verbose);
 }
 //-----------------------------------------------------------------------------
+void cli_cap(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // cap [0|1]
+  if (argc)
+  {
+    capture_enable(!!mrl_str2int(argv[0], 0, 0));
+    return; // binary stream may start just now
+  }
+  print_ival("cap=", capture_enabled());
+  print_uval("frames=", capture_frames());
+}
+//-----------------------------------------------------------------------------
 void cli_led(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // led {0|1}
   if (argc == 1)
@@ -368,12 +403,82 @@ void cli_sys_time(int argc, char* const argv[], const cli_cmd_t *cmd)
   print_uval("ticks    = ", Ticks);
   print_uval("millis() = ", ms);
   print_uval("micros() = ", us);
+  print_uval("TIME_FUNC() = ", TIME_FUNC());
 }
 //-----------------------------------------------------------------------------
+void cli_sys_log(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // sys log
+  uint32_t drops;
+  uint16_t used, peak;
+  print_log_stat(&drops, &used, &peak);
+  print_uval("log size: ", PRINT_LOG_SIZE);
+  print_uval("used: ",     used);
+  print_uval("peak: ",     peak);
+  print_uval("drops: ",    drops);
+}
+//-----------------------------------------------------------------------------
+#ifdef USE_PROF
+void cli_sys_prof(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // sys prof
+  static const char * const stage_str[APROF_STAGES] = APROF_STAGE_STRING;
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  int i;
+
+  if (mhz == 0) mhz = 1;
+  print_str("stage: cnt min avg p99 max [us] (max at ms)\r\n");
+  for (i = 0; i < APROF_STAGES; i++)
+  {
+    const lat_hist_t *h = Prof.hist(i);
+    print_str(stage_str[i]);
+    print_str(": ");   print_uint(h->cnt);
+    print_chr(' ');    print_uint((h->cnt ? h->min : 0) / mhz);
+    print_chr(' ');    print_uint(lat_mean(h) / mhz);
+    print_chr(' ');    print_uint(lat_percentile(h, 990) / mhz);
+    print_chr(' ');    print_uint(h->max / mhz);
+    print_str(" (");   print_uint(Prof.max_ms(i));
+    print_str(")\r\n");
+  }
+
+  print_str("worst: ");
+  print_str(stage_str[Prof.worst()]);
+  print_str(" cycles=");  print_uint(Prof.worst_cycles());
+  print_str(" us=");      print_uint(Prof.worst_cycles() / mhz);
+  print_str(" ms=");      print_uint(Prof.worst_ms());
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_sys_prof_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // sys prof reset
+  Prof.reset();
+}
+#endif // USE_PROF
+//-----------------------------------------------------------------------------
 void cli_sys_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // sys reset
   Reset();
 }
+//-----------------------------------------------------------------------------
+void cli_sys_ring(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // sys ring [reset]
+  uint8_t i;
+  if (argc > 0 && !strcmp(argv[0], "reset"))
+  {
+    rx_ring_reset(&RxRing);
+    return;
+  }
+  print_uval("RX ring size: ", RX_RING_SIZE);
+  print_uval("packets: ",      RxRing.cnt);
+  print_uval("drops: ",        RxRing.drops);
+  for (i = 0; i < RxRing.subs; i++)
+  {
+    const rx_sub_t *sub = &RxRing.sub[i];
+    print_str(sub->name);
+    print_str(": cnt=");     print_uint(sub->cnt);
+    print_str(" drops=");    print_uint(sub->drops);
+    print_str(" pending=");  print_uint(rx_ring_pending(&RxRing, i));
+    print_eol();
+  }
+}
 //=============================================================================
 void cli_eeprom_erase(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // eeprom erase
@@ -784,7 +889,7 @@ void cli_radio_tx(int argc, char* const argv[], const cli_cmd_t *cmd)
   retv = sx128x_tx(&Radio, timeout, base);
   if (retv != SX128X_ERR_NONE) return;
 
-  Fsm.tx_start(TIME_FUNC());
+  Fsm.tx_start(TIME_FUNC(), Opt.data_size);
 
   print_str("TX: timeout=0x");
   print_hex(timeout, 4);
@@ -1367,6 +1472,10 @@ void cli_ranging_calib(int argc, char* const argv[], const cli_cmd_t *cmd)
     retv = sx128x_ranging_set_calibration(&Radio, calib);
     if (retv != SX128X_ERR_NONE) return;
 
+    // keep by table cell of current BW/SF (else next sx128x_mod_lora() resets)
+    *sx128x_ranging_calib_cell(Radio.pars, Radio.pars->bw, Radio.pars->sf) =
+      (uint16_t) calib;
+
     print_str("set ");
   }
 
@@ -1377,12 +1486,47 @@ void cli_ranging_calib(int argc, char* const argv[], const cli_cmd_t *cmd)
   print_str(")\r\n");
 }
 //-----------------------------------------------------------------------------
+void cli_ranging_table(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // ranging table [SF BW calib]
+  static const uint16_t bws[SX128X_CALIB_BWS] = { 406, 812, 1625 };
+  uint8_t i, j;
+
+  if (argc >= 3)
+  { // set one cell
+    uint8_t  sf = (uint8_t)  mrl_str2int(argv[0], 0, 10);
+    uint16_t bw = (uint16_t) mrl_str2int(argv[1], 0, 10);
+    *sx128x_ranging_calib_cell(Radio.pars, bw, sf) =
+      (uint16_t) mrl_str2int(argv[2], 0, 0);
+    print_str("set (applied by next LoRa modulation setup)\r\n");
+  }
+
+  print_str("ranging calibration (SF");
+  for (j = 0; j < SX128X_CALIB_SFS; j++)
+  {
+    print_str(j ? "/" : "");
+    print_uint(SX128X_CALIB_SF_MIN + j);
+  }
+  print_str("):\r\n");
+  for (i = 0; i < SX128X_CALIB_BWS; i++)
+  {
+    print_str("  BW=");
+    print_uint(bws[i]);
+    print_str("kHz:");
+    for (j = 0; j < SX128X_CALIB_SFS; j++)
+    {
+      print_str(" ");
+      print_uint(Radio.pars->calib[i][j]);
+    }
+    print_eol();
+  }
+}
+//-----------------------------------------------------------------------------
 void cli_ranging_result(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // ranging result [filter]
   int8_t   retv;
   uint8_t  filter = 2; // result type (0-off, 1-on, 2-as-is)
   uint32_t result;     // raw result
-  int32_t  distance;   // distance [dm]
+  int32_t  distance;   // distance [cm]
   uint8_t  rssi;       // RSSI of last exchange
 
   if (argc > 0) filter = (uint8_t) mrl_str2int(argv[0], filter, 0);
@@ -1394,7 +1538,7 @@ void cli_ranging_result(int argc, char* const argv[], const cli_cmd_t *cmd)
   print_hex((unsigned) result, 8);
   print_str(" distance=");
   print_int((int) distance);
-  print_str("dm RSSI=");
+  print_str("cm RSSI=");
   print_uint((unsigned) rssi);
   print_str(" filter=");
   print_str(filter == 0 ? "OFF" :
@@ -1839,6 +1983,13 @@ void cli_fixed(int argc, char* const argv[], const cli_cmd_t *cmd)
   print_ival("fixed: ", Opt.radio.fixed);
 }
 //-----------------------------------------------------------------------------
+// warn if enabled PER/ping/hop headers don't fit to TX data
+static void cli_data_check()
+{
+  if (Opt.data_size < tx_hdr_size())
+    print_uval("warning: headers are not sent, data size < ", tx_hdr_size());
+}
+//-----------------------------------------------------------------------------
 void cli_data(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // data [b0 b1..]
   int i;
@@ -1859,6 +2010,7 @@ void cli_data(int argc, char* const argv[], const cli_cmd_t *cmd)
   }
 
   print_ival(" size=", Opt.data_size);
+  cli_data_check();
 }
 //-----------------------------------------------------------------------------
 void cli_data_fill(int argc, char* const argv[], const cli_cmd_t *cmd)
@@ -1872,6 +2024,7 @@ void cli_data_fill(int argc, char* const argv[], const cli_cmd_t *cmd)
   print_str("data: size=");
   print_int(Opt.data_size);
   print_hval(" value=0x", value, 2);
+  cli_data_check();
 }
 //-----------------------------------------------------------------------------
 void cli_data_size(int argc, char* const argv[], const cli_cmd_t *cmd)
@@ -1880,22 +2033,105 @@ void cli_data_size(int argc, char* const argv[], const cli_cmd_t *cmd)
   if (Opt.data_size > OPT_DATA_SIZE) Opt.data_size = OPT_DATA_SIZE;
   Opt.radio.payload_size = Opt.data_size;
   print_uval("data size=", Opt.data_size);
+  cli_data_check();
+}
+//-----------------------------------------------------------------------------
+// print OOK code (first chips), generator and chip time
+static void cli_code_print()
+{
+  char buf[65];
+  uint16_t n = ook_str(&Ook, buf, sizeof(buf) - 1, 0);
+
+  print_str("code: ");  print_str(ook_gen_string[Ook.gen]);
+  if (Ook.gen != OOK_GEN_STR) { print_str("/"); print_uint(Ook.arg); }
+  print_str(" size=");  print_uint(Ook.size);
+  if (Opt.fsm.dcu)
+  { print_str(" chip="); print_uint(Opt.fsm.dcu); print_str("us (timer)"); }
+  else
+  { print_str(" chip="); print_uint(Opt.fsm.dc);  print_str("ms (loop)"); }
+  print_eol();
+  print_str(buf);
+  if (n < Ook.size) print_str("...");
+  print_eol();
 }
 //-----------------------------------------------------------------------------
 void cli_code(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // code [101001]
   if (argc > 0)
-  { // set OOK code
-    int i, size = strlen(argv[0]);
-    if (size > sizeof(Opt.code) - 1) size = sizeof(Opt.code) - 1; 
-    memcpy((void*) Opt.code, (const void*) argv[0], size);
-    Opt.code[size] = '\0';
-    Opt.code_size = size;
-    for (i = 0; i < size; i++) if (Opt.code[i] != '0') Opt.code[i] = '1';
+  { // set OOK code (long code is not saved)
+    uint16_t size = ook_set_str(&Ook, argv[0]);
+    if (size <= OPT_CODE_SIZE)
+    {
+      ook_str(&Ook, Opt.code, size, 0);
+      Opt.code_size = size;
+      Opt.code_gen  = OOK_GEN_STR;
+      Opt.code_arg  = 0;
+    }
+    else
+      print_uval("warning: not saved, saved code size <= ", OPT_CODE_SIZE);
+  }
+  cli_code_print();
+}
+//-----------------------------------------------------------------------------
+void cli_code_barker(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // code barker [N]
+  if (argc > 0)
+  {
+    uint8_t len = mrl_str2int(argv[0], 13, 10);
+    if (!ook_barker(&Ook, len))
+    {
+      print_str("error: Barker code length is 2, 3, 4, 5, 7, 11 or 13\r\n");
+      return;
+    }
+    Opt.code_gen = OOK_GEN_BARKER;
+    Opt.code_arg = len;
+  }
+  cli_code_print();
+}
+//-----------------------------------------------------------------------------
+void cli_code_mseq(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // code mseq [DEG]
+  if (argc > 0)
+  {
+    uint8_t deg = mrl_str2int(argv[0], 7, 10);
+    if (!ook_mseq(&Ook, deg))
+    {
+      print_str("error: M-sequence degree is 2...12\r\n");
+      return;
+    }
+    Opt.code_gen = OOK_GEN_MSEQ;
+    Opt.code_arg = deg;
   }
-  print_str("code: ");
-  print_str(Opt.code);
-  print_str("\r\n");
+  cli_code_print();
+}
+//-----------------------------------------------------------------------------
+void cli_code_us(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // code us [us]
+  if (argc > 0)
+  {
+    Opt.fsm.dcu = mrl_str2int(argv[0], 0, 10);
+    if (Opt.fsm.dcu && Opt.fsm.dcu < OOK_CHIP_MIN) Opt.fsm.dcu = OOK_CHIP_MIN;
+  }
+  if (Opt.fsm.dcu) print_uval("chip time by timer [us]: ", Opt.fsm.dcu);
+  else             print_uval("chip time by loop [ms]: ",  Opt.fsm.dc);
+}
+//-----------------------------------------------------------------------------
+void cli_code_jit(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // code jit [reset]
+  if (argc > 0 && !strcmp(argv[0], "reset"))
+  {
+    ook_stat_reset(&Ook);
+    return;
+  }
+  print_str("jitter [us]: n=");  print_uint(Ook.n);
+  if (Ook.n)
+  {
+    print_str(" mean="); print_int((long) (Ook.jsum / (int64_t) Ook.n));
+    print_str(" min=");  print_int(Ook.jmin);
+    print_str(" max=");  print_int(Ook.jmax);
+    print_str(" rms=");  print_uint(ook_rms(&Ook));
+  }
+  print_eol();
 }
 //-----------------------------------------------------------------------------
 void cli_status(int argc, char* const argv[], const cli_cmd_t *cmd)
@@ -2011,7 +2247,7 @@ void cli_send(int argc, char* const argv[], const cli_cmd_t *cmd)
                      Opt.radio.fixed, timeout, SX128X_TIME_BASE_1MS);
   if (retv != SX128X_ERR_NONE) return;
 
-  Fsm.tx_start(TIME_FUNC());
+  Fsm.tx_start(TIME_FUNC(), Opt.data_size);
 
   print_str("send: size="); print_uint(Opt.data_size);
   print_str(" fixed=");     print_uint(Opt.radio.fixed);
@@ -2042,7 +2278,7 @@ void cli_recv(int argc, char* const argv[], const cli_cmd_t *cmd)
 }
 //=============================================================================
 void cli_mode(int argc, char* const argv[], const cli_cmd_t *cmd)
-{ // mode [0..9]
+{ // mode [0..11]
   if (argc > 0) {
     print_str("set ");
     Opt.fsm.mode = (uint8_t) LIMIT(mrl_str2int(argv[0], 0, 10), 0, AFSM_MODES-1);
@@ -2109,6 +2345,528 @@ void cli_autostart(int argc, char* const argv[], const cli_cmd_t *cmd)
   print_str("sec\r\n");
 }
 //=============================================================================
+void cli_ping(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // ping [0|1]
+  char buf[128];
+  int i;
+
+  if (argc)
+  {
+    Ping.on = !!mrl_str2int(argv[0], 0, 0);
+    Fsm.flood(Ping.on && Ping.flood);
+    if (Ping.on && Opt.data_size < tx_hdr_size())
+    { // room for ping header (and hop header)
+      Opt.data_size = Opt.radio.payload_size = tx_hdr_size();
+      print_uval("data size=", Opt.data_size);
+    }
+    print_str("set ");
+  }
+  print_ival("ping=", Ping.on);
+  print_ival("flood=", Ping.flood);
+
+  for (i = 0; i < PING_MODES; i++)
+  {
+    const ping_res_t *res = &Ping.res[i];
+    if (res->sent == 0) continue;
+
+    ping_format(res, buf, sizeof(buf));
+    print_str(ping_mode_string[i]);
+    print_str(": ");
+    print_str(buf);
+    print_eol();
+
+    lat_format(&res->rtt, buf, sizeof(buf));
+    print_str(ping_mode_string[i]);
+    print_str(" rtt: ");
+    print_str(buf);
+    print_eol();
+  }
+}
+//-----------------------------------------------------------------------------
+void cli_ping_flood(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // ping flood [0|1]
+  if (argc)
+  {
+    Ping.flood = !!mrl_str2int(argv[0], 0, 0);
+    Fsm.flood(Ping.on && Ping.flood);
+    print_str("set ");
+  }
+  print_ival("flood=", Ping.flood);
+}
+//-----------------------------------------------------------------------------
+void cli_ping_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // ping reset
+  ping_reset(&Ping);
+}
+//-----------------------------------------------------------------------------
+void cli_ping_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // ping pub
+  char topic[32], buf[128];
+  int i;
+  for (i = 0; i < PING_MODES; i++)
+  {
+    const ping_res_t *res = &Ping.res[i];
+    if (res->sent == 0) continue;
+
+    snprintf(topic, sizeof(topic), MQTT_TOPIC "/ping/%s", ping_mode_string[i]);
+    ping_format(res, buf, sizeof(buf));
+    if (!Mqtt.publish(topic, buf, false)) break;
+
+    snprintf(topic, sizeof(topic), MQTT_TOPIC "/ping/%s/rtt", ping_mode_string[i]);
+    lat_format(&res->rtt, buf, sizeof(buf));
+    if (!Mqtt.publish(topic, buf, false)) break;
+  }
+  if (i < PING_MODES) print_str("MQTT publish FAIL\r\n");
+}
+//=============================================================================
+static uint32_t cli_hop_freq = 0; // base frequency to restore [Hz]
+//-----------------------------------------------------------------------------
+// format hopping state (one line without EOL)
+static int cli_hop_format(char *buf, size_t size)
+{
+  return snprintf(buf, size,
+    "idx=%lu ch=%u freq=%lukHz used=%u/%u map=%08lX%08lX sync=%u "
+    "hops=%lu banned=%lu restored=%lu resync=%lu lost=%lu",
+    (unsigned long) Hop.idx, (unsigned) Hop.ch,
+    (unsigned long) hop_freq(&Hop, Hop.ch),
+    (unsigned) Hop.ngood, (unsigned) Hop.n,
+    (unsigned long) (uint32_t) (Hop.map >> 32), (unsigned long) (uint32_t) Hop.map,
+    (unsigned) Hop.sync, (unsigned long) Hop.hops, (unsigned long) Hop.banned,
+    (unsigned long) Hop.restored, (unsigned long) Hop.resync,
+    (unsigned long) Hop.lost);
+}
+//-----------------------------------------------------------------------------
+void cli_hop(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // hop [0|1]
+  char buf[160];
+  if (argc)
+  {
+    uint8_t on = !!mrl_str2int(argv[0], 0, 0);
+    if (on && !Hop.on)
+    { // start from first hop
+      cli_hop_freq = sx128x_get_frequency(&Radio);
+      hop_reset(&Hop);
+    }
+    else if (!on && Hop.on)
+      sx128x_set_frequency(&Radio, cli_hop_freq); // restore frequency
+    Hop.on = on;
+
+    if (Hop.on && Opt.data_size < tx_hdr_size())
+    { // room for hop header (and PER/ping header)
+      Opt.data_size = Opt.radio.payload_size = tx_hdr_size();
+      print_uval("data size=", Opt.data_size);
+    }
+    print_str("set ");
+  }
+  print_ival("hop=", Hop.on);
+  print_str("plan: Fmin=");  print_uint(Hop.fmin);
+  print_str("kHz step=");    print_uint(Hop.step);
+  print_str("kHz n=");       print_uint(Hop.n);
+  print_str(" seed=");       print_uint(Hop.seed);
+  print_eol();
+  cli_hop_format(buf, sizeof(buf));
+  print_str(buf);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_hop_plan(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // hop plan [Fmin[kHz] Fmax[kHz] step[kHz]]
+  uint32_t fmin = Hop.fmin, step = Hop.step;
+  uint32_t fmax = hop_freq(&Hop, Hop.n - 1);
+  if (argc > 0) fmin = mrl_str2int(argv[0], HOP_FREQ_MIN, 10);
+  if (argc > 1) fmax = mrl_str2int(argv[1], HOP_FREQ_MAX, 10);
+  if (argc > 2) step = mrl_str2int(argv[2], HOP_STEP,     10);
+  if (argc > 0) hop_plan(&Hop, fmin, fmax, step, Hop.seed);
+
+  print_str("hop: Fmin=");   print_uint(Hop.fmin);
+  print_str("kHz Fmax=");    print_uint(hop_freq(&Hop, Hop.n - 1));
+  print_str("kHz step=");    print_uint(Hop.step);
+  print_str("kHz channels="); print_uint(Hop.n);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_hop_seed(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // hop seed [N]
+  if (argc > 0)
+  {
+    hop_plan(&Hop, Hop.fmin, hop_freq(&Hop, Hop.n - 1), Hop.step,
+             mrl_str2int(argv[0], HOP_SEED, 0));
+    print_str("set ");
+  }
+  print_uval("seed=", Hop.seed);
+}
+//-----------------------------------------------------------------------------
+void cli_hop_adapt(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // hop adapt [0|1 PER[%] min]
+  if (argc > 0) Hop.adapt   = !!mrl_str2int(argv[0], 1, 0);
+  if (argc > 1) Hop.per_max = (uint8_t) LIMIT(mrl_str2int(argv[1], HOP_PER_MAX, 10), 1, 100);
+  if (argc > 2) Hop.min_ch  = (uint8_t) LIMIT(mrl_str2int(argv[2], HOP_MIN_CH, 10), 1, HOP_CHANNELS);
+
+  print_str("hop: adapt=");  print_uint(Hop.adapt);
+  print_str(" per_max=");    print_uint(Hop.per_max);
+  print_str("% min_ch=");    print_uint(Hop.min_ch);
+  print_str(" window=");     print_uint(Hop.window);
+  print_str(" probation=");  print_uint(Hop.probation);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_hop_map(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // hop map
+  uint8_t i;
+  print_str("ch freq[kHz] used tx ok PER[%] RSSI[dBm]\r\n");
+  for (i = 0; i < Hop.n; i++)
+  {
+    const hop_ch_t *q = &Hop.q[i];
+    int8_t per = hop_per(&Hop, i);
+    print_uint(i);
+    print_str(" ");  print_uint(hop_freq(&Hop, i));
+    print_str(" ");  print_uint((Hop.map >> i) & 1);
+    print_str(" ");  print_uint(q->tx_total);
+    print_str(" ");  print_uint(q->ok_total);
+    print_str(" ");  print_int(per);
+    print_str(" ");
+    if (q->rssi) print_rssi((uint8_t) ((q->rssi + 4) >> 3));
+    else         print_str("-");
+    print_eol();
+  }
+}
+//-----------------------------------------------------------------------------
+void cli_hop_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // hop reset
+  hop_reset(&Hop);
+}
+//-----------------------------------------------------------------------------
+void cli_hop_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // hop pub
+  char buf[160];
+  cli_hop_format(buf, sizeof(buf));
+  if (!Mqtt.publish(MQTT_TOPIC "/hop", buf, false))
+    print_str("MQTT publish FAIL\r\n");
+}
+//=============================================================================
+// format TDMA state (one line without EOL)
+static int cli_tdma_format(char *buf, size_t size)
+{
+  return snprintf(buf, size,
+    "slot=%u sync=%u offset=%ldus drift=%ldppb err=%ldus err_max=%luus "
+    "jit=%luus guard=%uus beacons=%lu sent=%lu rx=%lu late=%lu resync=%lu "
+    "lost=%lu",
+    (unsigned) Tdma.slot, (unsigned) Tdma.sync, (long) Tdma.offset,
+    (long) Tdma.drift, (long) Tdma.err, (unsigned long) Tdma.err_max,
+    (unsigned long) (Tdma.jit >> 4), (unsigned) Tdma.guard,
+    (unsigned long) Tdma.beacons, (unsigned long) Tdma.sent,
+    (unsigned long) Tdma.rx, (unsigned long) Tdma.late,
+    (unsigned long) Tdma.resync, (unsigned long) Tdma.lost);
+}
+//-----------------------------------------------------------------------------
+void cli_tdma(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // tdma
+  char buf[200];
+  print_ival("tdma=", Tdma.active);
+  print_str("frame: slots=");  print_uint(Tdma.slots);
+  print_str(" slot=");         print_uint(Tdma.slot_us);
+  print_str("us frame=");      print_uint(tdma_frame_us(&Tdma));
+  print_str("us toa=");        print_uint(Tdma.toa);
+  print_str("us");
+  print_eol();
+  if (Opt.data_size < TDMA_HDR_SIZE)
+    print_uval("warning: payload size < ", TDMA_HDR_SIZE);
+  cli_tdma_format(buf, sizeof(buf));
+  print_str(buf);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_tdma_slot(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // tdma slot [N]
+  if (argc > 0)
+  {
+    Tdma.slot = (uint8_t) LIMIT(mrl_str2int(argv[0], 0, 10), 0, 255);
+    tdma_reset(&Tdma);
+    print_str("set ");
+  }
+  print_uval("slot=", Tdma.slot);
+}
+//-----------------------------------------------------------------------------
+void cli_tdma_frame(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // tdma frame [slots slot_us]
+  if (argc > 0) Tdma.slots   = (uint8_t) LIMIT(mrl_str2int(argv[0], TDMA_SLOTS, 10), 2, 255);
+  if (argc > 1) Tdma.slot_us = (uint32_t) LIMIT(mrl_str2int(argv[1], TDMA_SLOT_US, 10), 100, 10000000);
+  if (argc > 0) tdma_reset(&Tdma);
+
+  print_str("tdma: slots=");   print_uint(Tdma.slots);
+  print_str(" slot=");         print_uint(Tdma.slot_us);
+  print_str("us frame=");      print_uint(tdma_frame_us(&Tdma));
+  print_str("us");
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_tdma_guard(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // tdma guard [us rx_delay]
+  if (argc > 0) Tdma.guard_min = (uint16_t) LIMIT(mrl_str2int(argv[0], TDMA_GUARD_MIN, 10), 0, 65535);
+  if (argc > 1) Tdma.rx_delay  = (int16_t) LIMIT(mrl_str2int(argv[1], TDMA_RX_DELAY, 10), -32768, 32767);
+
+  print_str("tdma: guard_min="); print_uint(Tdma.guard_min);
+  print_str("us rx_delay=");     print_int(Tdma.rx_delay);
+  print_str("us");
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_tdma_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // tdma reset
+  tdma_reset(&Tdma);
+}
+//-----------------------------------------------------------------------------
+void cli_tdma_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // tdma pub
+  char buf[200];
+  cli_tdma_format(buf, sizeof(buf));
+  if (!Mqtt.publish(MQTT_TOPIC "/tdma", buf, false))
+    print_str("MQTT publish FAIL\r\n");
+}
+//=============================================================================
+// format mesh relay state (one line without EOL)
+static int cli_mesh_format(char *buf, size_t size)
+{
+  return snprintf(buf, size,
+    "addr=%u seq=%u sent=%lu rx=%lu dups=%lu echo=%lu queued=%lu "
+    "relayed=%lu expired=%lu full=%lu supp=%lu busy=%lu drop=%lu "
+    "evict=%lu air=%lums",
+    (unsigned) Mesh.addr, (unsigned) Mesh.seq, (unsigned long) Mesh.sent,
+    (unsigned long) Mesh.rx, (unsigned long) Mesh.dups,
+    (unsigned long) Mesh.echo, (unsigned long) Mesh.queued,
+    (unsigned long) Mesh.relayed, (unsigned long) Mesh.expired,
+    (unsigned long) Mesh.full, (unsigned long) Mesh.supp_cnt,
+    (unsigned long) Mesh.busy, (unsigned long) Mesh.drop,
+    (unsigned long) Mesh.evict, (unsigned long) (Mesh.air / 1000));
+}
+//-----------------------------------------------------------------------------
+void cli_mesh(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // mesh
+  char buf[240];
+  print_ival("mesh=", Mesh.active);
+  print_str("relay: ttl=");   print_uint(Mesh.ttl);
+  print_str(" relay=");       print_uint(Mesh.relay);
+  print_str(" orig=");        print_uint(Mesh.orig);
+  print_str(" delay=");       print_uint(Mesh.delay);
+  print_str("us tries=");     print_uint(Mesh.tries);
+  print_str(" supp=");        print_uint(Mesh.supp);
+  print_str(" cache=");       print_uint(Mesh.used);
+  print_str("/");             print_uint(MESH_CACHE);
+  print_eol();
+  if (Mesh.rx)
+  {
+    print_str("last: origin="); print_uint(Mesh.last_origin);
+    print_str(" seq=");         print_uint(Mesh.last_seq);
+    print_str(" hops=");        print_uint(Mesh.last_hops);
+    print_eol();
+  }
+  if (Opt.data_size < MESH_HDR_SIZE)
+    print_uval("warning: payload size < ", MESH_HDR_SIZE);
+  cli_mesh_format(buf, sizeof(buf));
+  print_str(buf);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_mesh_addr(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // mesh addr [A]
+  if (argc > 0)
+  {
+    Mesh.addr = (uint16_t) LIMIT(mrl_str2int(argv[0], 1, 0), 0, 65535);
+    mesh_reset(&Mesh);
+    print_str("set ");
+  }
+  print_uval("addr=", Mesh.addr);
+}
+//-----------------------------------------------------------------------------
+void cli_mesh_relay(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // mesh relay [ttl relay orig]
+  if (argc > 0) Mesh.ttl   = (uint8_t) LIMIT(mrl_str2int(argv[0], MESH_TTL, 10), 0, 255);
+  if (argc > 1) Mesh.relay = (uint8_t) !!mrl_str2int(argv[1], 1, 10);
+  if (argc > 2) Mesh.orig  = (uint8_t) !!mrl_str2int(argv[2], 1, 10);
+
+  print_str("mesh: ttl=");    print_uint(Mesh.ttl);
+  print_str(" relay=");       print_uint(Mesh.relay);
+  print_str(" orig=");        print_uint(Mesh.orig);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_mesh_delay(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // mesh delay [us tries supp]
+  if (argc > 0) Mesh.delay = (uint32_t) LIMIT(mrl_str2int(argv[0], MESH_DELAY, 10), 0, 10000000);
+  if (argc > 1) Mesh.tries = (uint8_t)  LIMIT(mrl_str2int(argv[1], MESH_TRIES, 10), 1, 255);
+  if (argc > 2) Mesh.supp  = (uint8_t)  LIMIT(mrl_str2int(argv[2], MESH_SUPP, 10), 0, 255);
+
+  print_str("mesh: delay=");  print_uint(Mesh.delay);
+  print_str("us tries=");     print_uint(Mesh.tries);
+  print_str(" supp=");        print_uint(Mesh.supp);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_mesh_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // mesh reset
+  mesh_reset(&Mesh);
+}
+//-----------------------------------------------------------------------------
+void cli_mesh_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // mesh pub
+  char buf[240];
+  cli_mesh_format(buf, sizeof(buf));
+  if (!Mqtt.publish(MQTT_TOPIC "/mesh", buf, false))
+    print_str("MQTT publish FAIL\r\n");
+}
+//=============================================================================
+// format value [1/16] with one decimal digit
+static const char *cli_nbr_q4(char *buf, size_t size, int16_t v)
+{
+  long d = ((long) v * 10 + (v < 0 ? -8 : 8)) / 16; // [1/10], rounded
+  snprintf(buf, size, "%s%ld.%ld", d < 0 ? "-" : "",
+           (d < 0 ? -d : d) / 10, (d < 0 ? -d : d) % 10);
+  return buf;
+}
+//-----------------------------------------------------------------------------
+// format neighbor (one line without EOL), `t` - local time [ms]
+static int cli_nbr_format(char *buf, size_t size, const nbr_ent_t *e,
+                          uint32_t t)
+{
+  char rssi[12], snr[12], etx[12];
+  uint16_t x = nbr_etx(e);
+
+  if (x == NBR_ETX_MAX) snprintf(etx, sizeof(etx), "inf");
+  else                  snprintf(etx, sizeof(etx), "%u.%02u", x / 100, x % 100);
+
+  return snprintf(buf, size,
+    "addr=%u rssi=%s snr=%s etx=%s acks=%u/%u rx=%lu lost=%lu age=%lums",
+    (unsigned) e->addr, cli_nbr_q4(rssi, sizeof(rssi), e->rssi),
+    cli_nbr_q4(snr, sizeof(snr), e->snr), etx, (unsigned) e->acks,
+    (unsigned) e->hist_n, (unsigned long) e->rx, (unsigned long) e->lost,
+    (unsigned long) (t - e->seen));
+}
+//-----------------------------------------------------------------------------
+// format neighbor table state (one line without EOL)
+static int cli_nbr_state(char *buf, size_t size)
+{
+  return snprintf(buf, size,
+    "num=%u/%u timeout=%lums rx=%lu added=%lu expired=%lu evict=%lu "
+    "restart=%lu",
+    (unsigned) Nbr.num, (unsigned) NBR_MAX, (unsigned long) Nbr.timeout,
+    (unsigned long) Nbr.rx, (unsigned long) Nbr.added,
+    (unsigned long) Nbr.expired, (unsigned long) Nbr.evict,
+    (unsigned long) Nbr.restart);
+}
+//-----------------------------------------------------------------------------
+void cli_nbr(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // nbr
+  char buf[160];
+  uint32_t t = (uint32_t) (tstamp_ns() / 1000000);
+  int i;
+
+  nbr_expire(&Nbr, t);
+  cli_nbr_state(buf, sizeof(buf));
+  print_str(buf);
+  print_eol();
+
+  for (i = 0; i < NBR_SIZE; i++)
+  {
+    if (!Nbr.ent[i].used) continue;
+    cli_nbr_format(buf, sizeof(buf), &Nbr.ent[i], t);
+    print_str(buf);
+    print_eol();
+  }
+
+  if (!Mesh.orig || Opt.data_size < MESH_HDR_SIZE)
+    print_str("warning: neighbors are learned by own mesh packets (FSM mode MS)\r\n");
+}
+//-----------------------------------------------------------------------------
+void cli_nbr_timeout(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // nbr timeout [ms]
+  if (argc > 0)
+  {
+    Nbr.timeout = (uint32_t) LIMIT(mrl_str2int(argv[0], NBR_TIMEOUT, 10), 0, 86400000);
+    print_str("set ");
+  }
+  print_uval("timeout=", Nbr.timeout);
+}
+//-----------------------------------------------------------------------------
+void cli_nbr_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // nbr reset
+  nbr_reset(&Nbr);
+}
+//-----------------------------------------------------------------------------
+void cli_nbr_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // nbr pub
+  char topic[32], buf[160];
+  uint32_t t = (uint32_t) (tstamp_ns() / 1000000);
+  int i;
+
+  nbr_expire(&Nbr, t);
+  cli_nbr_state(buf, sizeof(buf));
+  if (!Mqtt.publish(MQTT_TOPIC "/nbr", buf, false))
+  {
+    print_str("MQTT publish FAIL\r\n");
+    return;
+  }
+
+  for (i = 0; i < NBR_SIZE; i++)
+  {
+    const nbr_ent_t *e = &Nbr.ent[i];
+    if (!e->used) continue;
+
+    snprintf(topic, sizeof(topic), MQTT_TOPIC "/nbr/%u", (unsigned) e->addr);
+    cli_nbr_format(buf, sizeof(buf), e, t);
+    if (!Mqtt.publish(topic, buf, false))
+    {
+      print_str("MQTT publish FAIL\r\n");
+      break;
+    }
+  }
+}
+//=============================================================================
+static const char *cli_ts_mode[TSTAMP_MODEMS] =
+  { "GFSK", "LoRa", "Ranging", "FLRC", "BLE" };
+//-----------------------------------------------------------------------------
+void cli_ts(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // ts
+  char buf[160];
+  uint64_t now = tstamp_ns();
+  uint8_t i;
+
+  snprintf(buf, sizeof(buf),
+           "clock=%s %luHz now=%lluns tx=%lluns(%s) rx=%lluns(%s)",
+           tstamp_name(), (unsigned long) tstamp_hz(),
+           (unsigned long long) now,
+           (unsigned long long) Tstamp.tx, cli_ts_mode[Tstamp.tx_mode],
+           (unsigned long long) Tstamp.rx, cli_ts_mode[Tstamp.rx_mode]);
+  print_str(buf);
+  print_eol();
+
+  print_str("mode delay_tx[ns] delay_rx[ns] tx_ovh[ns] tx_ovh_avg[ns] tx_cnt\r\n");
+  for (i = 0; i < TSTAMP_MODEMS; i++)
+  {
+    print_str(cli_ts_mode[i]);
+    print_str(" ");  print_int(Tstamp.delay[i].tx);
+    print_str(" ");  print_int(Tstamp.delay[i].rx);
+    print_str(" ");  print_int(Tstamp.ovh[i]);
+    print_str(" ");  print_int(Tstamp.ovh_avg[i] / 8);
+    print_str(" ");  print_uint(Tstamp.ovh_cnt[i]);
+    print_eol();
+  }
+}
+//-----------------------------------------------------------------------------
+void cli_ts_delay(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // ts delay [mode tx[ns] rx[ns]]
+  uint8_t mode = sx128x_get_mode(&Radio);
+  if (argc > 0) mode = (uint8_t) LIMIT(mrl_str2int(argv[0], mode, 10), 0, TSTAMP_MODEMS - 1);
+  if (mode >= TSTAMP_MODEMS) mode = 0;
+  if (argc > 1) Tstamp.delay[mode].tx = mrl_str2int(argv[1], TSTAMP_TX_DELAY, 10);
+  if (argc > 2) Tstamp.delay[mode].rx = mrl_str2int(argv[2], TSTAMP_RX_DELAY, 10);
+
+  print_str("ts: mode=");  print_str(cli_ts_mode[mode]);
+  print_str(" tx=");       print_int(Tstamp.delay[mode].tx);
+  print_str("ns rx=");     print_int(Tstamp.delay[mode].rx);
+  print_str("ns");
+  print_eol();
+}
+//=============================================================================
 void cli_wifi_ssid(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // wifi ssid [SSID]
   if (argc > 0) strncpy(Opt.wifi_ssid, argv[0], OPT_WIFI - 1);
@@ -2181,6 +2939,7 @@ void cli_mqtt_status(int argc, char* const argv[], const cli_cmd_t *cmd)
 //-----------------------------------------------------------------------------
 void cli_mqtt_state(int argc, char* const argv[], const cli_cmd_t *cmd)
 { // mqtt state
+  print_flush(); // deferred log and capture frame before direct output
   Serial.print("MQTT state=");
   Serial.print(Mqtt.state());
   Serial.print(" [");
@@ -2217,6 +2976,684 @@ void cli_mqtt_unsub(int argc, char* const argv[], const cli_cmd_t *cmd)
     if (!Mqtt.unsubscribe(argv[0]))
       print_str("MQTT unsubscribe FAIL\r\n");
 }
+//-----------------------------------------------------------------------------
+void cli_mqtt_rx(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // mqtt rx [0|1]
+  if (argc > 0)
+    mqtt_rx_enable(!!mrl_str2int(argv[0], 0, 0));
+  else
+  {
+    print_ival("rx=", mqtt_rx_enabled());
+    print_uval("fails=", mqtt_rx_fails());
+  }
+}
+//=============================================================================
+// print histogram summary (and all bins if `bins` != 0)
+static void cli_stats_hist_print(const char *name, const stats_hist_t *h,
+                                 uint8_t bins)
+{
+  int i;
+  print_str(name);
+  print_str(": cnt=");  print_uint(h->cnt);
+  if (h->cnt)
+  {
+    print_str(" min=");   print_int(h->vmin);
+    print_str(" mean=");  print_int(stats_hist_mean(h));
+    print_str(" p50=");   print_int(stats_hist_percentile(h, 50));
+    print_str(" p90=");   print_int(stats_hist_percentile(h, 90));
+    print_str(" p99=");   print_int(stats_hist_percentile(h, 99));
+    print_str(" max=");   print_int(h->vmax);
+  }
+  print_eol();
+  if (!bins) return;
+
+  print_uval("  <min: ", h->under);
+  for (i = 0; i < STATS_BINS; i++)
+  {
+    if (!h->bin[i]) continue;
+    print_str("  ");
+    print_int(h->min + h->step * i);
+    print_str("...");
+    print_int(h->min + h->step * (i + 1) - 1);
+    print_str(": ");
+    print_uint(h->bin[i]);
+    print_eol();
+  }
+  print_uval("  >max: ", h->over);
+}
+//-----------------------------------------------------------------------------
+void cli_stats(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // stats
+  static const char * const mode_str[STATS_MODES] = {
+    "GFSK", "LoRa", "Ranging", "FLRC", "BLE" };
+  uint8_t i;
+  for (i = 0; i < STATS_MODES; i++)
+  {
+    const stats_cnt_t *c = &Stats.cnt[i];
+    int16_t per = stats_per(&Stats, i);
+    if (!c->tx && !c->rx && !c->timeout && !c->ranging) continue;
+    print_str(mode_str[i]);
+    print_str(": tx=");      print_uint(c->tx);
+    print_str(" rx=");       print_uint(c->rx);
+    print_str(" ok=");       print_uint(c->rx_ok);
+    print_str(" crc_err=");  print_uint(c->crc_err);
+    print_str(" hdr_err=");  print_uint(c->hdr_err);
+    print_str(" sync_err="); print_uint(c->sync_err);
+    print_str(" timeout=");  print_uint(c->timeout);
+    print_str(" ranging=");  print_uint(c->ranging);
+    if (per >= 0)
+    {
+      print_str(" lost=");   print_uint(c->lost);
+      print_str(" dup=");    print_uint(c->dup);
+      print_str(" reord=");  print_uint(c->reorder);
+      print_str(" PER=");    print_dint(per);
+      print_chr('%');
+    }
+    print_eol();
+  }
+  cli_stats_hist_print("RSSI[dBm]", &Stats.rssi, 0);
+  cli_stats_hist_print("SNR[dB/4]", &Stats.snr,  0);
+  cli_stats_hist_print("FEI[Hz]",   &Stats.fei,  0);
+  cli_stats_hist_print("dT[ms]",    &Stats.dt,   0);
+}
+//-----------------------------------------------------------------------------
+void cli_stats_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // stats reset
+  stats_reset(&Stats);
+}
+//-----------------------------------------------------------------------------
+void cli_stats_hist(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // stats hist [rssi|snr|fei|dt]
+  const char *name = argc > 0 ? argv[0] : "rssi";
+  if      (!strcmp(name, "rssi")) cli_stats_hist_print("RSSI[dBm]", &Stats.rssi, 1);
+  else if (!strcmp(name, "snr"))  cli_stats_hist_print("SNR[dB/4]", &Stats.snr,  1);
+  else if (!strcmp(name, "fei"))  cli_stats_hist_print("FEI[Hz]",   &Stats.fei,  1);
+  else if (!strcmp(name, "dt"))   cli_stats_hist_print("dT[ms]",    &Stats.dt,   1);
+  else print_str("bad histogram name (use rssi|snr|fei|dt)\r\n");
+}
+//-----------------------------------------------------------------------------
+void cli_stats_seq(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // stats seq [offset]
+  if (argc)
+  {
+    Stats.seq_offset = mrl_str2int(argv[0], -1, 0);
+    Stats.seq_offset = LIMIT(Stats.seq_offset, -1, RX_RING_DATA_SIZE - 2);
+    Stats.seq_valid  = 0;
+    print_str("set ");
+  }
+  print_ival("seq_offset=", Stats.seq_offset);
+}
+//=============================================================================
+// print PER window
+static void cli_per_print(const char *name, const per_win_t *w)
+{
+  char buf[160];
+  per_format(w, buf, sizeof(buf));
+  print_str(name);
+  print_str(": ");
+  print_str(buf);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_per(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // per [0|1]
+  if (argc)
+  {
+    Per.on = !!mrl_str2int(argv[0], 0, 0);
+    if (Per.on && Opt.data_size < tx_hdr_size())
+    { // room for PER header (and hop header)
+      Opt.data_size = Opt.radio.payload_size = tx_hdr_size();
+      print_uval("data size=", Opt.data_size);
+    }
+    print_str("set ");
+  }
+  print_ival("per=", Per.on);
+  print_uval("window=", Per.window);
+  print_uval("tx_seq=", Per.tx_seq);
+  cli_per_print("cur", &Per.cur);
+  cli_per_print("last", &Per.last);
+  cli_per_print("total", &Per.total);
+}
+//-----------------------------------------------------------------------------
+void cli_per_win(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // per win [N]
+  if (argc)
+  {
+    Per.window = mrl_str2int(argv[0], PER_WINDOW, 10);
+    if (Per.window == 0) Per.window = 1;
+    print_str("set ");
+  }
+  print_uval("window=", Per.window);
+}
+//-----------------------------------------------------------------------------
+void cli_per_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // per reset
+  per_reset(&Per);
+}
+//-----------------------------------------------------------------------------
+void cli_per_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // per pub
+  char buf[160];
+  per_format(&Per.total, buf, sizeof(buf));
+  if (!Mqtt.publish(MQTT_TOPIC "/per/total", buf, false))
+  {
+    print_str("MQTT publish FAIL\r\n");
+    return;
+  }
+  per_format(&Per.last, buf, sizeof(buf));
+  if (!Mqtt.publish(MQTT_TOPIC "/per", buf, false))
+    print_str("MQTT publish FAIL\r\n");
+}
+//=============================================================================
+// latency histograms names
+static const char * const cli_lat_name[] = { "tx", "turn", "rtt", "irq" };
+//-----------------------------------------------------------------------------
+// latency histograms by index 0...3
+static lat_hist_t *cli_lat_hist(int i)
+{
+  lat_hist_t * const h[] = {
+    &Latency.tx, &Latency.turn, &Latency.rtt, &Latency.irq };
+  return h[i];
+}
+//-----------------------------------------------------------------------------
+void cli_lat(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // lat
+  char buf[128];
+  int i;
+  for (i = 0; i < 4; i++)
+  {
+    lat_format(cli_lat_hist(i), buf, sizeof(buf));
+    print_str(cli_lat_name[i]);
+    print_str(": ");
+    print_str(buf);
+    print_eol();
+  }
+}
+//-----------------------------------------------------------------------------
+void cli_lat_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // lat reset
+  int i;
+  for (i = 0; i < 4; i++) lat_clear(cli_lat_hist(i));
+}
+//-----------------------------------------------------------------------------
+void cli_lat_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // lat pub
+  char topic[32], buf[128];
+  int i;
+  for (i = 0; i < 4; i++)
+  {
+    snprintf(topic, sizeof(topic), MQTT_TOPIC "/lat/%s", cli_lat_name[i]);
+    lat_format(cli_lat_hist(i), buf, sizeof(buf));
+    if (!Mqtt.publish(topic, buf, false))
+    {
+      print_str("MQTT publish FAIL\r\n");
+      break;
+    }
+  }
+}
+//=============================================================================
+void cli_scan(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // scan
+  char buf[64];
+  int16_t best = scan_best(&Scan);
+  uint16_t i;
+
+  print_str(scan_csv_head);
+  print_eol();
+  for (i = 0; i < Scan.channels; i++)
+  {
+    scan_csv(&Scan, i, buf, sizeof(buf));
+    print_str(buf);
+    print_eol();
+  }
+
+  print_str("# sweeps="); print_uint(Scan.sweeps);
+  print_str(" time=");    print_uint(Scan.time / 1000);
+  print_str("ms best=");  print_int(best);
+  if (best >= 0)
+  {
+    print_str(" freq=");  print_uint(scan_freq(&Scan, best));
+    print_str("kHz");
+  }
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_scan_plan(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // scan plan [Fmin[kHz] Fmax[kHz] step[kHz]]
+  if (argc > 0) Opt.fsm.scan_min  = mrl_str2int(argv[0], SCAN_FREQ_MIN, 10);
+  if (argc > 1) Opt.fsm.scan_max  = mrl_str2int(argv[1], SCAN_FREQ_MAX, 10);
+  if (argc > 2) Opt.fsm.scan_step = mrl_str2int(argv[2], SCAN_STEP,     10);
+  if (argc > 0)
+    scan_plan(&Scan, Opt.fsm.scan_min, Opt.fsm.scan_max, Opt.fsm.scan_step);
+
+  print_str("scan: Fmin=");  print_uint(Opt.fsm.scan_min);
+  print_str("kHz Fmax=");    print_uint(Opt.fsm.scan_max);
+  print_str("kHz step=");    print_uint(Opt.fsm.scan_step);
+  print_str("kHz channels="); print_uint(Scan.channels);
+  if (Scan.channels >= SCAN_CHANNELS)
+    print_str(" (limited)");
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_scan_dwell(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // scan dwell [ms N]
+  if (argc > 0)
+    Opt.fsm.scan_dwell   = (uint16_t) LIMIT(mrl_str2int(argv[0], SCAN_DWELL, 10),
+                                            1, 65535);
+  if (argc > 1)
+    Opt.fsm.scan_samples = (uint8_t) LIMIT(mrl_str2int(argv[1], SCAN_SAMPLES, 10),
+                                           1, 255);
+
+  print_str("scan: dwell="); print_uint(Opt.fsm.scan_dwell);
+  print_str("ms samples=");  print_uint(Opt.fsm.scan_samples);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_scan_thr(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // scan thr [dBm]
+  if (argc > 0)
+  {
+    Scan.thr = (uint8_t) LIMIT(-2 * mrl_str2int(argv[0], -SCAN_THRESHOLD / 2, 10),
+                               0, 255);
+    print_str("set ");
+  }
+  print_str("thr=");
+  print_rssi(Scan.thr);
+  print_str("dBm\r\n");
+}
+//-----------------------------------------------------------------------------
+void cli_scan_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // scan reset
+  scan_reset(&Scan);
+}
+//-----------------------------------------------------------------------------
+void cli_scan_pub(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // scan pub
+  char buf[MQTT_BUFFER_SIZE / 2];
+  int len = 0;
+  uint16_t i = 0;
+
+  // CSV rows in chunks (every chunk starts with header)
+  while (i < Scan.channels)
+  {
+    if (len == 0)
+      len = snprintf(buf, sizeof(buf), "%s\n", scan_csv_head);
+
+    len += scan_csv(&Scan, i, buf + len, sizeof(buf) - len - 1);
+    buf[len++] = '\n';
+    buf[len]   = '\0';
+    i++;
+
+    if (i >= Scan.channels || sizeof(buf) - len < 48)
+    {
+      if (!Mqtt.publish(MQTT_TOPIC "/scan", buf, false))
+      {
+        print_str("MQTT publish FAIL\r\n");
+        return;
+      }
+      len = 0;
+    }
+  }
+}
+//=============================================================================
+void cli_range(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // range [N]
+  if (argc > 0)
+  {
+    int n = mrl_str2int(argv[0], RANGE_COUNT, 10);
+    Range.count = n < 1 ? 1 : n > RANGE_SAMPLES ? RANGE_SAMPLES : n;
+  }
+  print_uval("range: count=", Range.count);
+
+  if (!Range.sessions) return;
+  print_str("sessions=");   print_uint(Range.sessions);
+  print_str(" n=");         print_uint(Range.samples);
+  print_str(" lost=");      print_uint(Range.lost);
+  print_str(" gated=");     print_uint(Range.gated);
+  print_str(" time=");      print_uint(Range.time);
+  print_str("us rate=");    print_uint(Range.rate);
+  print_str("/s\r\nmedian="); print_distance_cm(Range.median);
+  print_str("m trim=");     print_distance_cm(Range.trimmed);
+  print_str("m kf=");       print_distance_cm(Range.kalman);
+  print_str("m rms=");      print_distance_cm(range_isqrt(Range.var));
+  print_str("m krms=");     print_distance_cm(range_isqrt(Range.kvar));
+  print_str("m RSSI=");     print_rssi(Range.rssi);
+  print_str("dBm\r\n");
+  if (Range.chans > 1)
+  {
+    print_str("channels=");   print_uint(Range.chans);
+    print_str(" chmed=");     print_distance_cm(Range.chmed);
+    print_str("m\r\n");
+  }
+}
+//-----------------------------------------------------------------------------
+void cli_range_trim(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // range trim [%]
+  if (argc > 0)
+  {
+    int trim = mrl_str2int(argv[0], RANGE_TRIM, 10);
+    Range.trim = trim < 0 ? 0 : trim > 49 ? 49 : trim;
+  }
+  print_uval("range: trim=", Range.trim);
+}
+//-----------------------------------------------------------------------------
+void cli_range_kf(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // range kf [Q R]
+  if (argc > 0) Range.kf_q = mrl_str2int(argv[0], RANGE_KF_Q, 10);
+  if (argc > 1) Range.kf_r = mrl_str2int(argv[1], RANGE_KF_R, 10);
+  if (Range.kf_r == 0) Range.kf_r = 1;
+  if (argc > 0) range_kf_reset(&Range);
+
+  print_str("range: kf Q=");  print_uint(Range.kf_q);
+  print_str(" R=");           print_uint(Range.kf_r);
+  print_str(" (cm^2)\r\n");
+}
+//-----------------------------------------------------------------------------
+void cli_range_reset(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // range reset
+  range_kf_reset(&Range);
+}
+//-----------------------------------------------------------------------------
+void cli_range_cal(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // range cal [m|stop]
+  if (argc > 0)
+  {
+    if (strcmp(argv[0], "stop") == 0)
+    {
+      if (RangeCal.step > RANGE_CAL_OFF && RangeCal.step < RANGE_CAL_DONE)
+      { // restore start calibration
+        *sx128x_ranging_calib_cell(&Opt.radio, Opt.radio.bw, Opt.radio.sf) =
+          (uint16_t) RangeCal.c0;
+      }
+      RangeCal.step = RANGE_CAL_OFF;
+    }
+    else
+    {
+      int32_t d = mrl_str2int(argv[0], 0, 10) * 100; // m -> cm
+      range_cal_begin(&RangeCal, d,
+                      sx128x_ranging_calib_value(&Opt.radio));
+      range_kf_reset(&Range);
+      if (Range.count < 2)
+        print_str("range cal: warning: single shot (use \"range N\")\r\n");
+    }
+  }
+
+  print_str("range cal: step=");  print_uint(RangeCal.step);
+  print_str(" d=");               print_distance_cm(RangeCal.d);
+  print_str("m calib=");          print_uint(RangeCal.c0);
+  if (RangeCal.step >= RANGE_CAL_CHECK)
+  {
+    print_str(" -> ");            print_uint(RangeCal.c);
+  }
+  if (RangeCal.step == RANGE_CAL_DONE)
+  {
+    print_str(" err=");           print_distance_cm(RangeCal.err);
+    print_str("m");
+  }
+  print_eol();
+}
+//=============================================================================
+void cli_pos(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // pos [0|1]
+  if (argc > 0)
+  {
+    Opt.pos.on = !!mrl_str2int(argv[0], 0, 0);
+    print_str("set ");
+  }
+  print_uval("pos=", Opt.pos.on);
+
+  if (!Pos.fixes && !Pos.fails) return;
+  print_str("fixes=");      print_uint(Pos.fixes);
+  print_str(" fails=");     print_uint(Pos.fails);
+  print_str(" time=");      print_uint(Pos.time);
+  print_str("us rate=");    print_uint(Pos.rate);
+  print_str("/s\r\n");
+  if (Pos.err != POS_ERR_NONE)
+  {
+    print_ival("err=", Pos.err);
+    return;
+  }
+  print_str("x=");          print_distance(Pos.fix.x);
+  print_str("m y=");        print_distance(Pos.fix.y);
+  print_str("m z=");        print_distance(Pos.fix.z);
+  print_str("m rms=");      print_distance(Pos.fix.rms);
+  print_str("m used=");     print_uint(Pos.fix.used);
+  print_str(" iter=");      print_uint(Pos.fix.iter);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_pos_dim(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // pos dim [2|3]
+  if (argc > 0)
+  {
+    Opt.pos.dim = mrl_str2int(argv[0], POS_DIM, 10) == 3 ? 3 : 2;
+    print_str("set ");
+  }
+  print_uval("pos dim=", Opt.pos.dim);
+}
+//-----------------------------------------------------------------------------
+void cli_pos_anchor(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // pos anchor [i addr x y [z]]
+  uint8_t i;
+
+  if (argc >= 4)
+  {
+    pos_anchor_t *a;
+    i = (uint8_t) mrl_str2int(argv[0], 0, 10);
+    if (i > Opt.pos.n || i >= POS_ANCHORS)
+    {
+      print_str("error: anchor index\r\n");
+      return;
+    }
+    if (Pos.active)
+    {
+      print_str("error: stop FSM first\r\n");
+      return;
+    }
+    a = &Opt.pos.a[i];
+    a->addr = (uint32_t) mrl_str2int(argv[1], 0, 0);
+    a->x    = mrl_str2int(argv[2], 0, 10);
+    a->y    = mrl_str2int(argv[3], 0, 10);
+    a->z    = argc > 4 ? mrl_str2int(argv[4], 0, 10) : 0;
+    if (i == Opt.pos.n) Opt.pos.n++;
+  }
+
+  for (i = 0; i < Opt.pos.n; i++)
+  {
+    const pos_anchor_t *a = &Opt.pos.a[i];
+    print_str("anchor #");  print_uint(i);
+    print_str(" 0x");       print_hex(a->addr, 8);
+    print_str(" x=");       print_distance(a->x);
+    print_str("m y=");      print_distance(a->y);
+    print_str("m z=");      print_distance(a->z);
+    print_str("m\r\n");
+  }
+  if (Opt.pos.n == 0) print_str("no anchors\r\n");
+}
+//-----------------------------------------------------------------------------
+void cli_pos_del(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // pos del i
+  uint8_t i;
+  if (argc < 1) return;
+  if (Pos.active)
+  {
+    print_str("error: stop FSM first\r\n");
+    return;
+  }
+  i = (uint8_t) mrl_str2int(argv[0], 0, 10);
+  if (i >= Opt.pos.n) return;
+  for (Opt.pos.n--; i < Opt.pos.n; i++) Opt.pos.a[i] = Opt.pos.a[i + 1];
+  print_uval("anchors=", Opt.pos.n);
+}
+//-----------------------------------------------------------------------------
+void cli_pos_clear(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // pos clear
+  if (Pos.active)
+  {
+    print_str("error: stop FSM first\r\n");
+    return;
+  }
+  Opt.pos.n = 0;
+}
+//=============================================================================
+static uint32_t cli_rdiv_freq = 0; // base frequency to restore [Hz]
+//-----------------------------------------------------------------------------
+void cli_rdiv(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // rdiv [0|1]
+  if (argc)
+  {
+    uint8_t on = !!mrl_str2int(argv[0], 0, 0);
+    if (on && !Rdiv.on)
+    { // master and slave start from first channel
+      cli_rdiv_freq = sx128x_get_frequency(&Radio);
+      rdiv_reset(&Rdiv);
+    }
+    else if (!on && Rdiv.on)
+      sx128x_set_frequency(&Radio, cli_rdiv_freq); // restore frequency
+    Rdiv.on = on;
+
+    if (Rdiv.on && Fsm.mode() == AFSM_RM && Range.count < Rdiv.n)
+      print_str("warning: session is shorter than channel list "
+                "(use \"range N\")\r\n");
+    print_str("set ");
+  }
+  print_ival("rdiv=", Rdiv.on);
+  print_str("plan: Fmin=");  print_uint(Rdiv.fmin);
+  print_str("kHz step=");    print_uint(Rdiv.step);
+  print_str("kHz n=");       print_uint(Rdiv.n);
+  print_str(" slot=");       print_uint(Rdiv.slot);
+  print_str(" (");           print_uint(rdiv_slot_us(&Rdiv, Opt.radio.sf,
+                                                     Opt.radio.bw));
+  print_str("us)\r\nch=");  print_uint(rdiv_channel(&Rdiv));
+  print_str(" idx=");        print_uint(Rdiv.idx);
+  print_str(" park=");       print_uint(Rdiv.park);
+  print_str(" hops=");       print_uint(Rdiv.hops);
+  print_str(" parks=");      print_uint(Rdiv.parks);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_rdiv_plan(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // rdiv plan [Fmin[kHz] Fmax[kHz] step[kHz]]
+  uint32_t fmin = Rdiv.fmin, step = Rdiv.step;
+  uint32_t fmax = rdiv_freq(&Rdiv, Rdiv.n - 1);
+  if (argc > 0) fmin = mrl_str2int(argv[0], RDIV_FREQ_MIN, 10);
+  if (argc > 1) fmax = mrl_str2int(argv[1], RDIV_FREQ_MAX, 10);
+  if (argc > 2) step = mrl_str2int(argv[2], RDIV_STEP,     10);
+  if (argc > 0) rdiv_plan(&Rdiv, fmin, fmax, step);
+
+  print_str("rdiv: Fmin=");   print_uint(Rdiv.fmin);
+  print_str("kHz Fmax=");     print_uint(rdiv_freq(&Rdiv, Rdiv.n - 1));
+  print_str("kHz step=");     print_uint(Rdiv.step);
+  print_str("kHz channels="); print_uint(Rdiv.n);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_rdiv_slot(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // rdiv slot [symbols]
+  if (argc > 0)
+  {
+    int slot = mrl_str2int(argv[0], RDIV_SLOT, 10);
+    Rdiv.slot = slot < 1 ? 1 : slot > 0xFFFF ? 0xFFFF : slot;
+  }
+  print_str("rdiv: slot=");  print_uint(Rdiv.slot);
+  print_str(" (");           print_uint(rdiv_slot_us(&Rdiv, Opt.radio.sf,
+                                                     Opt.radio.bw));
+  print_str("us)\r\n");
+}
+//=============================================================================
+void cli_arlog(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // arlog [0|1]
+  if (argc)
+  {
+    ArLog.on = !!mrl_str2int(argv[0], 0, 0);
+    if (ArLog.on && Fsm.mode() != AFSM_AR)
+      print_str("warning: FSM mode is not AR (use \"mode 8\")\r\n");
+    print_str("set ");
+  }
+  print_ival("arlog=", ArLog.on);
+  print_str("events=");   print_uint(ArLog.events);
+  print_str(" drops=");   print_uint(ArLog.drops);
+  print_str(" frames=");  print_uint(ArLog.frames);
+  print_str(" pending="); print_uint(arlog_count(&ArLog));
+  print_str(" peak=");    print_uint(ArLog.peak);
+  print_eol();
+}
+//-----------------------------------------------------------------------------
+void cli_arlog_clear(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // arlog clear
+  uint8_t on = ArLog.on;
+  arlog_init(&ArLog);
+  ArLog.on = on;
+}
+//=============================================================================
+#ifdef SX128X_USE_TRACE
+void cli_trace(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // trace [0|1]
+  if (argc)
+  {
+    Trace.on = !!mrl_str2int(argv[0], 0, 0);
+    print_str("set ");
+  }
+  print_ival("trace=", Trace.on);
+  print_uval("records=", Trace.cnt);
+}
+//-----------------------------------------------------------------------------
+void cli_trace_dump(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // trace dump
+  uint16_t i, n = sx128x_trace_num(&Trace);
+  for (i = 0; i < n; i++)
+  {
+    const sx128x_trace_rec_t *r = sx128x_trace_get(&Trace, i);
+    print_str("trace: t=");   print_uint(r->t);
+    print_str(" op=0x");      print_hex(r->opcode, 2);
+    print_str(" len=");       print_uint(r->len);
+    print_str(" busy=");      print_uint(r->busy);
+    print_str(" xfer=");      print_uint(r->xfer);
+    print_str(" err=");       print_int(r->err);
+    print_eol();
+  }
+}
+//-----------------------------------------------------------------------------
+void cli_trace_stat(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // trace stat
+  uint8_t done[32]; // bitmap of printed opcodes
+  uint16_t i, j, n = sx128x_trace_num(&Trace);
+
+  memset((void*) done, 0, sizeof(done));
+  print_str("opcode: cnt busy_sum busy_max xfer_sum xfer_max [us]\r\n");
+  for (i = 0; i < n; i++)
+  {
+    uint8_t op = sx128x_trace_get(&Trace, i)->opcode;
+    uint32_t cnt = 0, busy = 0, busy_max = 0, xfer = 0, xfer_max = 0;
+    if (done[op >> 3] & (1 << (op & 7))) continue;
+    done[op >> 3] |= 1 << (op & 7);
+
+    for (j = i; j < n; j++)
+    {
+      const sx128x_trace_rec_t *r = sx128x_trace_get(&Trace, j);
+      if (r->opcode != op) continue;
+      cnt++;
+      busy += r->busy;
+      xfer += r->xfer;
+      if (busy_max < r->busy) busy_max = r->busy;
+      if (xfer_max < r->xfer) xfer_max = r->xfer;
+    }
+
+    print_str("0x");  print_hex(op, 2);
+    print_str(": ");  print_uint(cnt);
+    print_chr(' ');   print_uint(busy);
+    print_chr(' ');   print_uint(busy_max);
+    print_chr(' ');   print_uint(xfer);
+    print_chr(' ');   print_uint(xfer_max);
+    print_eol();
+  }
+}
+//-----------------------------------------------------------------------------
+void cli_trace_clear(int argc, char* const argv[], const cli_cmd_t *cmd)
+{ // trace clear
+  sx128x_trace_clear(&Trace);
+}
+#endif // SX128X_USE_TRACE
 //=============================================================================
 #ifdef MRL_USE_CTRL_C
 // Ctrl+C callback
@@ -2282,19 +3719,19 @@ void cli_loop()
   else if (key == CLI_KEYCODE_CTRL_T) // Ctrl+T pressed
   {
     print_str("\r\n^T\r\n");
-    cli_radio_restore(0, NULL, NULL);
+    if (!cli_chip_busy()) cli_radio_restore(0, NULL, NULL);
     mrl_refresh(&Mrl);
   }
   else if (key == CLI_KEYCODE_CTRL_D) // Ctrl+D pressed
   {
     print_str("\r\n^D\r\n");
-    cli_radio_standby(0, NULL, NULL);
+    if (!cli_chip_busy()) cli_radio_standby(0, NULL, NULL);
     mrl_refresh(&Mrl);
   }
   else if (key == CLI_KEYCODE_CTRL_Z) // Ctrl+Z pressed
   {
     print_str("\r\n^Z\r\n");
-    cli_radio_sleep(0, NULL, NULL);
+    if (!cli_chip_busy()) cli_radio_sleep(0, NULL, NULL);
     mrl_refresh(&Mrl);
   }
   else if (key == CLI_KEYCODE_CTRL_V) // Ctrl+V pressed
@@ -2306,7 +3743,7 @@ void cli_loop()
   else if (key == CLI_KEYCODE_CTRL_Y) // Ctrl+Y pressed
   {
     print_str("\r\n^Y\r\n");
-    cli_radio_wave(0, NULL, NULL);
+    if (!cli_chip_busy()) cli_radio_wave(0, NULL, NULL);
     mrl_refresh(&Mrl);
   }
   else if (key == CLI_KEYCODE_CTRL_Q) // Ctrl+Q pressed
@@ -11,6 +11,10 @@
 //-----------------------------------------------------------------------------
 //#define CLI_HELP
 //-----------------------------------------------------------------------------
+// command flags
+#define CLI_RADIO     1 // uses radio/SPI (rejected while OOK chips by timer)
+#define CLI_RADIO_ARG 2 // uses radio/SPI or changes OOK code with arguments
+//-----------------------------------------------------------------------------
 // command/options description structure
 typedef struct cli_cmd_ cli_cmd_t;
 
@@ -19,6 +23,7 @@ struct cli_cmd_ {
   int16_t parent_id; // parent ID for options (or -1 for root)
   void (*fn)(int argc, char* const argv[], const cli_cmd_t*); // callback function
   const char *name;  // command/option name
+  uint8_t flags;     // CLI_RADIO | CLI_RADIO_ARG
 #ifdef CLI_HELP
   const char *args;  // arguments for help
   const char *help;  // help (description) string 
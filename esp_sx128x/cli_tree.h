@@ -7,175 +7,270 @@
 #define CLI_TREE_H
 //-----------------------------------------------------------------------------
 #ifdef CLI_HELP
-#  define _F(id, parent_id, func, name, args, help) \
-   { id, parent_id, func, name, args, help }, // CLI help ON
+#  define _F(id, parent_id, flags, func, name, args, help) \
+   { id, parent_id, func, name, flags, args, help }, // CLI help ON
 #else
-#  define _F(id, parent_id, func, name, args, help) \
-   { id, parent_id, func, name }, // CLI help OFF
+#  define _F(id, parent_id, flags, func, name, args, help) \
+   { id, parent_id, func, name, flags }, // CLI help OFF
 #endif
 
-#define _O(id, parent_id, func, name, args, help)
+#define _O(id, parent_id, flags, func, name, args, help)
 //-----------------------------------------------------------------------------
 // all commands and options tree
 cli_cmd_t const cli_tree[] = {
-  //  ID   Par Callback             Name          Args                 Help
+  //  ID   Par Flags          Callback             Name          Args                 Help
 #ifdef CLI_HELP
-  _F(  0,  -1, cli_help,            "help",       "",                  "print this help (Ctrl+X)")
+  _F(  0,  -1, 0,             cli_help,            "help",       "",                  "print this help (Ctrl+X)")
+#endif
+  _F(  1,  -1, 0,             cli_version,         "version",    "",                  "print version")
+  _F(  2,  -1, 0,             cli_clear,           "clear",      "",                  "clear screen (Ctrl+L)")
+  _F(  3,  -1, 0,             cli_verbose,         "verbose",    " [n]",              "set/get verbose leval 0...3")
+  _F(  4,  -1, 0,             cli_cap,             "cap",        " [0|1]",            "on/off binary packet capture stream")
+
+  _F( 10,  -1, 0,             cli_led,             "led",        " {0|1}",            "1=on/0=off LED")
+  _F( 11,  10, 0,             cli_led_blink,       "blink",      " [N]",              "blink LED N times")
+  _F( 12,  -1, 0,             cli_pin,             "pin",        " gpio [0|1]",       "read/write digital pin")
+
+  _F( 20,  -1, 0,             cli_help,            "sys",        "",                  "system information")
+  _F( 21,  20, 0,             cli_sys_info,        "info",       "",                  "print system information")
+  _F( 22,  20, 0,             cli_sys_time,        "time",       "",                  "print system time and ticks")
+  _F( 23,  20, 0,             cli_sys_log,         "log",        "",                  "print deferred console log statistic")
+  _F( 24,  20, 0,             cli_sys_reset,       "reset",      "",                  "full system reset MCU")
+  _F( 25,  20, 0,             cli_sys_ring,        "ring",       " [reset]",          "print/reset RX packet ring counters")
+#ifdef USE_PROF
+  _F( 26,  20, 0,             cli_sys_prof,        "prof",       "",                  "print main loop profiler statistic")
+  _F( 27,  26, 0,             cli_sys_prof_reset,  "reset",      "",                  "reset main loop profiler")
 #endif
-  _F(  1,  -1, cli_version,         "version",    "",                  "print version")
-  _F(  2,  -1, cli_clear,           "clear",      "",                  "clear screen (Ctrl+L)")
-  _F(  3,  -1, cli_verbose,         "verbose",    " [n]",              "set/get verbose leval 0...3")
-
-  _F( 10,  -1, cli_led,             "led",        " {0|1}",            "1=on/0=off LED")
-  _F( 11,  10, cli_led_blink,       "blink",      " [N]",              "blink LED N times")
-  _F( 12,  -1, cli_pin,             "pin",        " gpio [0|1]",       "read/write digital pin")
-
-  _F( 20,  -1, cli_help,            "sys",        "",                  "system information")
-  _F( 21,  20, cli_sys_info,        "info",       "",                  "print system information")
-  _F( 22,  20, cli_sys_time,        "time",       "",                  "print system time and ticks")
-  _F( 24,  20, cli_sys_reset,       "reset",      "",                  "full system reset MCU")
   
-  _F( 30,  -1, cli_help,            "eeprom",     "",                  "EEPROM commands")
-  _F( 31,  30, cli_eeprom_erase,    "erase",      "",                  "erase options region of EEPROM")
-  _F( 32,  30, cli_eeprom_write,    "write",      "",                  "write all options to EEPROM (Ctrl+W)")
-  _F( 33,  30, cli_eeprom_read,     "read",       "",                  "read all options from EEPROM")
-  _F( 34,  30, cli_eeprom_delete,   "delete",     "",                  "delete last options record from EEPROM")
-  _F( 35,  30, cli_eeprom_diff,     "diff",       "",                  "find differece between current options and saved in EEPROM")
-  _F( 36,  30, cli_eeprom_dump,     "dump",       " [offset size]",    "hex dump region in EEPROM")
-
-  _F( 37,  -1, cli_def,             "def",        "",                  "set to default all options (opt_t)")
+  _F( 30,  -1, 0,             cli_help,            "eeprom",     "",                  "EEPROM commands")
+  _F( 31,  30, 0,             cli_eeprom_erase,    "erase",      "",                  "erase options region of EEPROM")
+  _F( 32,  30, 0,             cli_eeprom_write,    "write",      "",                  "write all options to EEPROM (Ctrl+W)")
+  _F( 33,  30, 0,             cli_eeprom_read,     "read",       "",                  "read all options from EEPROM")
+  _F( 34,  30, 0,             cli_eeprom_delete,   "delete",     "",                  "delete last options record from EEPROM")
+  _F( 35,  30, 0,             cli_eeprom_diff,     "diff",       "",                  "find differece between current options and saved in EEPROM")
+  _F( 36,  30, 0,             cli_eeprom_dump,     "dump",       " [offset size]",    "hex dump region in EEPROM")
+
+  _F( 37,  -1, CLI_RADIO,     cli_def,             "def",        "",                  "set to default all options (opt_t)")
   
-  _F( 50,  -1, cli_help,            "hw",         "",                  "hardware direct/status commands")
-  _F( 51,  50, cli_hw_reset,        "reset",      " [t1 t2]",          "hardware reset SX128x by NRST")
-  _F( 52,  50, cli_hw_rxen,         "rxen",       " [0|1]",            "1-set/0-reset RXEN line (on/off LNA)")
-  _F( 53,  50, cli_hw_txen,         "txen",       " [0|1]",            "1-set/0-reset TXEN line (on/off PowerAmp)")
-  _F( 54,  50, cli_hw_busy,         "busy",       "",                  "get BUSY status")
-
-  _F( 55,  -1, cli_spi,             "spi",        " [b0 b1..]",        "exchange bytes (b0 b1...) by SPI")
-
-  _F( 60,  -1, cli_help,            "radio",      "",                  "SX128x radio module commands")
-  _F( 61,  60, cli_radio_status,    "status",     "",                  "get status")
-  _F( 62,  61, cli_radio_stat_last, "last",       "",                  "get last status")
-  _F( 63,  60, cli_radio_ver,       "ver",        "",                  "get firmware version (16 bits)")
-  _F( 64,  60, cli_radio_sleep,     "sleep",      " [config]",         "set Sleep mode (Ctrl+Z)")
-  _F( 65,  60, cli_radio_standby,   "standby",    " [config]",         "set Standby mode (Ctrl+D)")
-  _F( 66,  60, cli_radio_wakeup,    "wakeup",     " [config]",         "set Standby mode (no BUSY wait)")
-  _F( 67,  60, cli_radio_mode,      "mode",       " [mode]",           "set/get mode (packet type)")
-  _F( 68,  60, cli_radio_save,      "save",       " ",                 "save context")
-  _F( 69,  60, cli_radio_fs,        "fs",         "",                  "set FS mode")
-  _F( 70,  60, cli_radio_tx,        "tx",         " [to base]",        "set TX mode")
-  _F( 71,  60, cli_radio_rx,        "rx",         " [to base]",        "set RX mode")
+  _F( 50,  -1, 0,             cli_help,            "hw",         "",                  "hardware direct/status commands")
+  _F( 51,  50, CLI_RADIO,     cli_hw_reset,        "reset",      " [t1 t2]",          "hardware reset SX128x by NRST")
+  _F( 52,  50, CLI_RADIO,     cli_hw_rxen,         "rxen",       " [0|1]",            "1-set/0-reset RXEN line (on/off LNA)")
+  _F( 53,  50, CLI_RADIO,     cli_hw_txen,         "txen",       " [0|1]",            "1-set/0-reset TXEN line (on/off PowerAmp)")
+  _F( 54,  50, CLI_RADIO,     cli_hw_busy,         "busy",       "",                  "get BUSY status")
+
+  _F( 55,  -1, CLI_RADIO,     cli_spi,             "spi",        " [b0 b1..]",        "exchange bytes (b0 b1...) by SPI")
+
+  _F( 60,  -1, 0,             cli_help,            "radio",      "",                  "SX128x radio module commands")
+  _F( 61,  60, CLI_RADIO,     cli_radio_status,    "status",     "",                  "get status")
+  _F( 62,  61, CLI_RADIO,     cli_radio_stat_last, "last",       "",                  "get last status")
+  _F( 63,  60, CLI_RADIO,     cli_radio_ver,       "ver",        "",                  "get firmware version (16 bits)")
+  _F( 64,  60, CLI_RADIO,     cli_radio_sleep,     "sleep",      " [config]",         "set Sleep mode (Ctrl+Z)")
+  _F( 65,  60, CLI_RADIO,     cli_radio_standby,   "standby",    " [config]",         "set Standby mode (Ctrl+D)")
+  _F( 66,  60, CLI_RADIO,     cli_radio_wakeup,    "wakeup",     " [config]",         "set Standby mode (no BUSY wait)")
+  _F( 67,  60, CLI_RADIO,     cli_radio_mode,      "mode",       " [mode]",           "set/get mode (packet type)")
+  _F( 68,  60, CLI_RADIO,     cli_radio_save,      "save",       " ",                 "save context")
+  _F( 69,  60, CLI_RADIO,     cli_radio_fs,        "fs",         "",                  "set FS mode")
+  _F( 70,  60, CLI_RADIO,     cli_radio_tx,        "tx",         " [to base]",        "set TX mode")
+  _F( 71,  60, CLI_RADIO,     cli_radio_rx,        "rx",         " [to base]",        "set RX mode")
 
 #if defined(SX128X_USE_LORA) || defined(SX128X_RANGING)
-  _F( 72,  60, cli_radio_cad,       "cad",        "",                  "set LoRa CAD mode")
+  _F( 72,  60, CLI_RADIO,     cli_radio_cad,       "cad",        "",                  "set LoRa CAD mode")
 #endif // SX128X_USE_LORA || SX128X_RANGING
 
-  _F( 73,  60, cli_radio_freq,      "freq",       " [Hz]",             "set/get RF frequency SX [Hz]")
-  _F( 74,  60, cli_radio_pwr,       "pwr",        " [dBm us]",         "set/get TX power level [dBm] and rampTime [us]")
-  _F( 75,  60, cli_radio_lna,       "lna",        " [1|0]",            "on/off/get LNA boost")
-  _F( 76,  60, cli_radio_gain,      "gain",       " [rx_gain]",        "set RX gain (0-AGC, 1-min, 13-max")
-  _F( 77,  60, cli_radio_dcdc,      "dcdc",       " [1|0]",            "DC-DC 0=off/1=on")
-  _F( 78,  60, cli_radio_auto_fs,   "auto_fs",    " {0|1}",            "set auto FS: 1-enable, 0-disable")
-  _F( 79,  60, cli_radio_irq,       "irq",        " [mask]",           "get/clear by MASK IRQ status")
-  _F( 80,  60, cli_radio_rxdc,      "rxdc",       " [rx sleep base]",  "set RX duty cycle")
-  _F( 81,  60, cli_radio_wave,      "wave",       "",                  "set TX Continuous Wave (RF tone) mode (Ctrl+Y)")
-  _F( 82,  60, cli_radio_preamble,  "preamble",   "",                  "set TX Continuous Preamble mode")
-  _F( 93,  60, cli_radio_reg,       "reg",        " [addr val]",       "read/write register")
-  _F( 94,  60, cli_radio_restore,   "restore",    "",                  "restore all parameters (Ctrl+T)")
+  _F( 73,  60, CLI_RADIO,     cli_radio_freq,      "freq",       " [Hz]",             "set/get RF frequency SX [Hz]")
+  _F( 74,  60, CLI_RADIO,     cli_radio_pwr,       "pwr",        " [dBm us]",         "set/get TX power level [dBm] and rampTime [us]")
+  _F( 75,  60, CLI_RADIO,     cli_radio_lna,       "lna",        " [1|0]",            "on/off/get LNA boost")
+  _F( 76,  60, CLI_RADIO,     cli_radio_gain,      "gain",       " [rx_gain]",        "set RX gain (0-AGC, 1-min, 13-max")
+  _F( 77,  60, CLI_RADIO,     cli_radio_dcdc,      "dcdc",       " [1|0]",            "DC-DC 0=off/1=on")
+  _F( 78,  60, CLI_RADIO,     cli_radio_auto_fs,   "auto_fs",    " {0|1}",            "set auto FS: 1-enable, 0-disable")
+  _F( 79,  60, CLI_RADIO,     cli_radio_irq,       "irq",        " [mask]",           "get/clear by MASK IRQ status")
+  _F( 80,  60, CLI_RADIO,     cli_radio_rxdc,      "rxdc",       " [rx sleep base]",  "set RX duty cycle")
+  _F( 81,  60, CLI_RADIO,     cli_radio_wave,      "wave",       "",                  "set TX Continuous Wave (RF tone) mode (Ctrl+Y)")
+  _F( 82,  60, CLI_RADIO,     cli_radio_preamble,  "preamble",   "",                  "set TX Continuous Preamble mode")
+  _F( 93,  60, CLI_RADIO,     cli_radio_reg,       "reg",        " [addr val]",       "read/write register")
+  _F( 94,  60, CLI_RADIO,     cli_radio_restore,   "restore",    "",                  "restore all parameters (Ctrl+T)")
 
 #if defined(SX128X_USE_LORA) || defined(SX128X_USE_GFSK)
-  _F( 95,  60, cli_radio_lp,        "lp",         " {0|1}",            "set Long Preamble: 1-enable, 0-disable")
+  _F( 95,  60, CLI_RADIO,     cli_radio_lp,        "lp",         " {0|1}",            "set Long Preamble: 1-enable, 0-disable")
 #endif // SX128X_USE_LORA || SX128X_USE_GFSK
 
 #if defined(SX128X_USE_LORA) || defined(SX128X_RANGING)
-  _F(100,  -1, cli_help,            "lora",       "",                  "set/get LoRa params/results")
-  _F(101, 100, cli_lora_mod,        "mod",        " [BW SF CR ]",      "set/get LoRa modulation params")
-  _F(102, 100, cli_lora_packet,     "packet",     " [PR CRC INV]",     "set/get LoRa packet pars (Preamble, CRC, invertIQ)")
-  _F(103, 100, cli_lora_sw,         "sw",         " [SW]",             "set/get LoRa SyncWord (0x12 or 0x34)")
-  _F(104, 100, cli_lora_cad,        "cad",        " [sym_num]",        "set LoRa CAD mode sym_num [1...16]")
-  _F(105, 100, cli_lora_fei,        "fei",        "",                  "get LoRa frequency error indicator [Hz]")
-  _F(106, 100, cli_lora_rssi,       "rssi",       "",                  "get LoRa instantaneous RSSI")
+  _F(100,  -1, 0,             cli_help,            "lora",       "",                  "set/get LoRa params/results")
+  _F(101, 100, CLI_RADIO,     cli_lora_mod,        "mod",        " [BW SF CR ]",      "set/get LoRa modulation params")
+  _F(102, 100, CLI_RADIO,     cli_lora_packet,     "packet",     " [PR CRC INV]",     "set/get LoRa packet pars (Preamble, CRC, invertIQ)")
+  _F(103, 100, CLI_RADIO,     cli_lora_sw,         "sw",         " [SW]",             "set/get LoRa SyncWord (0x12 or 0x34)")
+  _F(104, 100, CLI_RADIO,     cli_lora_cad,        "cad",        " [sym_num]",        "set LoRa CAD mode sym_num [1...16]")
+  _F(105, 100, CLI_RADIO,     cli_lora_fei,        "fei",        "",                  "get LoRa frequency error indicator [Hz]")
+  _F(106, 100, CLI_RADIO,     cli_lora_rssi,       "rssi",       "",                  "get LoRa instantaneous RSSI")
 #endif // SX128X_USE_LORA || SX128X_RANGING
 
 #ifdef SX128X_USE_RANGING
-  _F(110,  -1, cli_ranging,         "ranging",    " [role MA SA SM]",  "set/get Ranging [Role, MasterAddr, SlaveAddr, SlaveMode]")
-  _F(111, 110, cli_ranging_advanced, "advanced",  " {1|0}",            "get/set Advanced Ranging [0-off, 1-on]")
-  _F(112, 110, cli_ranging_calib,   "calib",      " [calibration]",    "set/get Ranging calibration")
-  _F(113, 110, cli_ranging_result,  "result",     " [filter]",         "get Ranging result (filter: 0-Raw, 1-Filtered, 2-as-is)")
+  _F(110,  -1, CLI_RADIO,     cli_ranging,         "ranging",    " [role MA SA SM]",  "set/get Ranging [Role, MasterAddr, SlaveAddr, SlaveMode]")
+  _F(111, 110, CLI_RADIO,     cli_ranging_advanced, "advanced",  " {1|0}",            "get/set Advanced Ranging [0-off, 1-on]")
+  _F(112, 110, CLI_RADIO,     cli_ranging_calib,   "calib",      " [calibration]",    "set/get Ranging calibration")
+  _F(113, 110, CLI_RADIO,     cli_ranging_result,  "result",     " [filter]",         "get Ranging result (filter: 0-Raw, 1-Filtered, 2-as-is)")
+  _F(114, 110, CLI_RADIO,     cli_ranging_table,   "table",      " [SF BW calib]",    "set/get Ranging calibration table by SF/BW (0 - use calib)")
 #endif // SX128X_USE_RANGING
 
 #ifdef SX128X_USE_FLRC
-  _F(120,  -1, cli_help,            "flrc",       "",                  "set/get FLRC params/results")
-  _F(121, 120, cli_flrc_mod,        "mod",        " [BR CR BT]",       "set/get FLRC modulation params")
-  _F(122, 120, cli_flrc_packet,     "packet",     " [PR SW SWM CRC]",  "set/get FLRC packet pars")
-  _F(123, 120, cli_flrc_swt,        "swt",        " [0..15]",          "get/set SyncWord Tolerance in FLRC")
-  _F(124, 120, cli_flrc_sw,         "sw",         " [SW1 SW2 SW3]",    "get/set SyncWord 1..3 in FLRC")
+  _F(120,  -1, 0,             cli_help,            "flrc",       "",                  "set/get FLRC params/results")
+  _F(121, 120, CLI_RADIO,     cli_flrc_mod,        "mod",        " [BR CR BT]",       "set/get FLRC modulation params")
+  _F(122, 120, CLI_RADIO,     cli_flrc_packet,     "packet",     " [PR SW SWM CRC]",  "set/get FLRC packet pars")
+  _F(123, 120, CLI_RADIO,     cli_flrc_swt,        "swt",        " [0..15]",          "get/set SyncWord Tolerance in FLRC")
+  _F(124, 120, CLI_RADIO,     cli_flrc_sw,         "sw",         " [SW1 SW2 SW3]",    "get/set SyncWord 1..3 in FLRC")
 #endif // SX128X_USE_FLRC
 
 #ifdef SX128X_USE_GFSK
-  _F(130,  -1, cli_help,            "gfsk",       "",                  "set/get GFSK params/results")
-  _F(131, 130, cli_gfsk_mod,        "mod",        " [BR DSB MI BT]",   "set/get GFSK modulation params")
-  _F(132, 130, cli_gfsk_packet,     "packet",     " [PR SWL SWM CRC W]","set/get GFSK packet pars")
-  _F(133, 130, cli_gfsk_swt,        "swt",        " [0..15]",          "get/set SyncWord Tolerance in GFSK")
-  _F(134, 130, cli_gfsk_sw,         "sw",         " [SW1 SW2 SW3]",    "get/set SyncWord 1..3 in GFSK")
+  _F(130,  -1, 0,             cli_help,            "gfsk",       "",                  "set/get GFSK params/results")
+  _F(131, 130, CLI_RADIO,     cli_gfsk_mod,        "mod",        " [BR DSB MI BT]",   "set/get GFSK modulation params")
+  _F(132, 130, CLI_RADIO,     cli_gfsk_packet,     "packet",     " [PR SWL SWM CRC W]","set/get GFSK packet pars")
+  _F(133, 130, CLI_RADIO,     cli_gfsk_swt,        "swt",        " [0..15]",          "get/set SyncWord Tolerance in GFSK")
+  _F(134, 130, CLI_RADIO,     cli_gfsk_sw,         "sw",         " [SW1 SW2 SW3]",    "get/set SyncWord 1..3 in GFSK")
 #endif // SX128X_USE_GFSK
 
 #ifdef SX128X_USE_BLE
-  _F(140,  -1, cli_ble,             "ble",        " [ST TST CRC W]",   "set/get BLE params")
-  _F(141, 140, cli_ble_auto_tx,     "auto_tx",    " [delay]",          "set BLE auto TX delay [us], 0=off")
+  _F(140,  -1, CLI_RADIO,     cli_ble,             "ble",        " [ST TST CRC W]",   "set/get BLE params")
+  _F(141, 140, CLI_RADIO,     cli_ble_auto_tx,     "auto_tx",    " [delay]",          "set BLE auto TX delay [us], 0=off")
 #endif // SX128X_USE_BLE
 
-  _F(150,  -1, cli_help,            "buffer",     "",                  "TX/RX buffer commands")
-  _F(151, 150, cli_buffer_base,     "base",       " TxAd RxAd",        "set TX/RX buffer base addreses")
-  _F(152, 150, cli_buffer_read,     "read",       " Ad [Num]",         "read from RX/TX buffer")
-  _F(153, 150, cli_buffer_write,    "write",      " Ad [b0 b1..]",     "write data to RX/TX buffer")
+  _F(150,  -1, 0,             cli_help,            "buffer",     "",                  "TX/RX buffer commands")
+  _F(151, 150, CLI_RADIO,     cli_buffer_base,     "base",       " TxAd RxAd",        "set TX/RX buffer base addreses")
+  _F(152, 150, CLI_RADIO,     cli_buffer_read,     "read",       " Ad [Num]",         "read from RX/TX buffer")
+  _F(153, 150, CLI_RADIO,     cli_buffer_write,    "write",      " Ad [b0 b1..]",     "write data to RX/TX buffer")
 
-  _F(160,  -1, cli_tx_timeout,      "tx_timeout", " [ms]",             "get/set TX timeout [ms]")
+  _F(160,  -1, 0,             cli_tx_timeout,      "tx_timeout", " [ms]",             "get/set TX timeout [ms]")
 
-  _F(165,  -1, cli_fixed,           "fixed",      " [0|1]",            "get/set fixed/variable size of send packet")
+  _F(165,  -1, 0,             cli_fixed,           "fixed",      " [0|1]",            "get/set fixed/variable size of send packet")
   
-  _F(170,  -1, cli_data,            "data",       " [b0 b1..]",        "get/set TX data bytes")
-  _F(171, 170, cli_data_fill,       "fill",       " [size value]",     "fill TX data bytes")
-  _F(172, 170, cli_data_size,       "size",       " [size]",           "get/set RX/TX data size")
+  _F(170,  -1, 0,             cli_data,            "data",       " [b0 b1..]",        "get/set TX data bytes")
+  _F(171, 170, 0,             cli_data_fill,       "fill",       " [size value]",     "fill TX data bytes")
+  _F(172, 170, 0,             cli_data_size,       "size",       " [size]",           "get/set RX/TX data size")
   
-  _F(175,  -1, cli_code,            "code",       " [101001]",         "get/set OOK code")
+  _F(175,  -1, CLI_RADIO_ARG, cli_code,            "code",       " [101001]",         "get/set OOK code (up to 4096 chips, saved up to 15)")
+  _F(176, 175, CLI_RADIO,     cli_code_barker,     "barker",     " [N]",              "set Barker code of length N (2, 3, 4, 5, 7, 11, 13)")
+  _F(177, 175, CLI_RADIO,     cli_code_mseq,       "mseq",       " [DEG]",            "set M-sequence of LFSR degree DEG (2...12, 2^DEG-1 chips)")
+  _F(178, 175, 0,             cli_code_us,         "us",         " [us]",             "get/set chip time by hardware timer [us] (0 - FSM dC[ms] by loop), no radio commands on air")
+  _F(179, 175, 0,             cli_code_jit,        "jit",        " [reset]",          "print/reset chip edge jitter statistic [us]")
 
-  _F(180,  -1, cli_status,          "status",     "",                  "get packet status")
+  _F(180,  -1, CLI_RADIO,     cli_status,          "status",     "",                  "get packet status")
 
-  _F(190,  -1, cli_send,            "send",       " [to]",             "send packet [timeout] (Strl+S)")
-  _F(191,  -1, cli_recv,            "recv",       " [size to]",        "receive packet [timeout] (Strl+V)")
+  _F(190,  -1, CLI_RADIO,     cli_send,            "send",       " [to]",             "send packet [timeout] (Strl+S)")
+  _F(191,  -1, CLI_RADIO,     cli_recv,            "recv",       " [size to]",        "receive packet [timeout] (Strl+V)")
   
-  _F(200,  -1, cli_mode,            "mode",       " [0..9]",           "get/set FSM mode (0-CW, 1-OOK, 2-TX, 3-RX, 4-RQ, 5-RP, 6-RM, 7-RS, 8-AR, 9-SG)")
+  _F(200,  -1, 0,             cli_mode,            "mode",       " [0..12]",          "get/set FSM mode (0-CW, 1-OOK, 2-TX, 3-RX, 4-RQ, 5-RP, 6-RM, 7-RS, 8-AR, 9-SG, 10-SC, 11-TD, 12-MS)")
   
-  _F(201,  -1, cli_fsm,             "fsm",        " [T dT dC WUT]",    "get/set FSM parameters (T-period[ms], dT-CW[ms], dC-code[ms], WUT-wakeup time[ms])")
+  _F(201,  -1, 0,             cli_fsm,             "fsm",        " [T dT dC WUT]",    "get/set FSM parameters (T-period[ms], dT-CW[ms], dC-code[ms], WUT-wakeup time[ms])")
   
-  _F(202,  -1, cli_sweep,           "sweep",      " [Fmin Fmax S]",    "get/set sweep generator pars (Fmin/Fmax - kHz, S - kHz/sec)")
+  _F(202,  -1, 0,             cli_sweep,           "sweep",      " [Fmin Fmax S]",    "get/set sweep generator pars (Fmin/Fmax - kHz, S - kHz/sec)")
   
-  _F(203,  -1, cli_start,           "start",      "",                  "start FSM loop (Ctrl+S)")
-  _F(204,  -1, cli_stop,            "stop",       "",                  "stop FSM loop (Ctrl+C)")
-
-  _F(205,  -1, cli_autostart,       "autostart",  " [1|0 delay]",      "get/set autostart on reboot flag and delay [sec]")
-
-  _F(240,  -1, cli_help,            "wifi",       "",                  "Wi-Fi options")
-  _F(241, 240, cli_wifi_ssid,       "ssid",       " [SSID]",           "get/set Wi-Fi SSID")
-  _F(242, 240, cli_wifi_passwd,     "passwd",     " [passwd]",         "get/set Wi-Fi password")
-  _F(243, 240, cli_wifi_disable,    "disable",    "",                  "disable Wi-Fi (reset SSID)")
-  _F(244, 240, cli_wifi_connect,    "connect",    "",                  "Wi-Fi connect")
-  _F(245, 240, cli_wifi_disconnect, "disconnect", "",                  "Wi-Fi disconnect")
-  _F(246, 240, cli_wifi_status,     "status",     "",                  "print Wi-Fi status")
+  _F(203,  -1, 0,             cli_start,           "start",      "",                  "start FSM loop (Ctrl+S)")
+  _F(204,  -1, 0,             cli_stop,            "stop",       "",                  "stop FSM loop (Ctrl+C)")
+
+  _F(205,  -1, 0,             cli_autostart,       "autostart",  " [1|0 delay]",      "get/set autostart on reboot flag and delay [sec]")
+
+  _F(206,  -1, 0,             cli_ping,            "ping",       " [0|1]",            "on/off ping-pong RTT benchmark (RQ: stamp, RP: echo), print results")
+  _F(207, 206, 0,             cli_ping_flood,      "flood",      " [0|1]",            "get/set flood mode (next request right after reply, T/2 - reply timeout)")
+  _F(208, 206, 0,             cli_ping_reset,      "reset",      "",                  "reset ping results of all modems")
+  _F(209, 206, 0,             cli_ping_pub,        "pub",        "",                  "publish ping results to MQTT")
+
+  _F(210,  -1, CLI_RADIO_ARG, cli_hop,             "hop",        " [0|1]",            "on/off frequency hopping (TX/RQ: leader, RX/RP: follower), print state")
+  _F(211, 210, 0,             cli_hop_plan,        "plan",       " [Fmin Fmax step]", "get/set hop channel plan (Fmin/Fmax/step - kHz)")
+  _F(212, 210, 0,             cli_hop_seed,        "seed",       " [N]",              "get/set hop sequence seed (same on both ends)")
+  _F(213, 210, 0,             cli_hop_adapt,       "adapt",      " [0|1 PER min]",    "get/set adaptation (blacklist PER threshold [%], minimal channels)")
+  _F(214, 210, 0,             cli_hop_map,         "map",        "",                  "print channel quality map")
+  _F(215, 210, 0,             cli_hop_reset,       "reset",      "",                  "reset channel map, quality and sync")
+  _F(216, 210, 0,             cli_hop_pub,         "pub",        "",                  "publish hopping state to MQTT")
+
+  _F(217,  -1, 0,             cli_tdma,            "tdma",       "",                  "print TDMA state (FSM mode 11-TD)")
+  _F(218, 217, 0,             cli_tdma_slot,       "slot",       " [N]",              "get/set own slot (0 - coordinator sends beacons)")
+  _F(219, 217, 0,             cli_tdma_frame,      "frame",      " [slots slot_us]",  "get/set frame of coordinator (slots with beacon, slot length [us])")
+  _F(220, 217, 0,             cli_tdma_guard,      "guard",      " [us rx_delay]",    "get/set minimal guard time and RxDone delay [us]")
+  _F(221, 217, 0,             cli_tdma_reset,      "reset",      "",                  "reset synchronization and statistic")
+  _F(222, 217, 0,             cli_tdma_pub,        "pub",        "",                  "publish TDMA state to MQTT")
+
+  _F(261,  -1, 0,             cli_mesh,            "mesh",       "",                  "print mesh relay state (FSM mode 12-MS)")
+  _F(262, 261, 0,             cli_mesh_addr,       "addr",       " [A]",              "get/set own address (origin of own packets)")
+  _F(263, 261, 0,             cli_mesh_relay,      "relay",      " [ttl relay orig]", "get/set TTL of own packets, on/off relay and own packets every period")
+  _F(264, 261, 0,             cli_mesh_delay,      "delay",      " [us tries supp]",  "get/set random relay delay, CAD attempts and copies to cancel relay (0-off)")
+  _F(265, 261, 0,             cli_mesh_reset,      "reset",      "",                  "reset duplicate cache, relay queue and statistic")
+  _F(266, 261, 0,             cli_mesh_pub,        "pub",        "",                  "publish mesh relay state to MQTT")
+
+  _F(225,  -1, 0,             cli_nbr,             "nbr",        "",                  "print neighbor table (RSSI/SNR EWMA, ETX, age)")
+  _F(226, 225, 0,             cli_nbr_timeout,     "timeout",    " [ms]",             "get/set silence to drop neighbor (0 - never), checked once per second")
+  _F(227, 225, 0,             cli_nbr_reset,       "reset",      "",                  "drop all neighbors and reset statistic")
+  _F(228, 225, 0,             cli_nbr_pub,         "pub",        "",                  "publish neighbor table to MQTT")
+
+  _F(223,  -1, 0,             cli_ts,              "ts",         "",                  "print timestamp clock, last TxDone/RxDone (end of packet on air) and TX overhead (not used by TDMA)")
+  _F(224, 223, 0,             cli_ts_delay,        "delay",      " [mode tx rx]",     "get/set TxDone/RxDone delay of packet type [ns] (0-GFSK ... 4-BLE, 0 - no compensation until calibrated)")
+
+  _F(240,  -1, 0,             cli_help,            "wifi",       "",                  "Wi-Fi options")
+  _F(241, 240, 0,             cli_wifi_ssid,       "ssid",       " [SSID]",           "get/set Wi-Fi SSID")
+  _F(242, 240, 0,             cli_wifi_passwd,     "passwd",     " [passwd]",         "get/set Wi-Fi password")
+  _F(243, 240, 0,             cli_wifi_disable,    "disable",    "",                  "disable Wi-Fi (reset SSID)")
+  _F(244, 240, 0,             cli_wifi_connect,    "connect",    "",                  "Wi-Fi connect")
+  _F(245, 240, 0,             cli_wifi_disconnect, "disconnect", "",                  "Wi-Fi disconnect")
+  _F(246, 240, 0,             cli_wifi_status,     "status",     "",                  "print Wi-Fi status")
   
-  _F(250,  -1, cli_help,            "mqtt",       "",                  "MQTT options")
-  _F(251, 250, cli_mqtt_server,     "server",     " [HOST PORT ID]",   "get/set MQTT server options")
-  _F(252, 250, cli_mqtt_client,     "client",     " [USER KEY]",       "get/set MQTT client options")
-  _F(253, 250, cli_mqtt_connect,    "connect",    "",                  "connect to MQTT broker")
-  _F(254, 250, cli_mqtt_disconnect, "disconnect", "",                  "disconnect from MQTT broker")
-  _F(255, 250, cli_mqtt_status,     "status",     "",                  "print MQTT connection status")
-  _F(256, 250, cli_mqtt_state,      "state",      "",                  "print MQTT state (integer)")
-  _F(257, 250, cli_mqtt_pub,        "pub",        " [Topic MSG RTN]",  "publish message")
-  _F(258, 250, cli_mqtt_sub,        "sub",        " [Topic QoS]",      "subscribe topic")
-  _F(259, 250, cli_mqtt_unsub,      "unsub",      " [Topic]",          "unsubscribe topic")
-
-  _F( -1,  -1, NULL,                NULL,         NULL,                NULL)
+  _F(250,  -1, 0,             cli_help,            "mqtt",       "",                  "MQTT options")
+  _F(251, 250, 0,             cli_mqtt_server,     "server",     " [HOST PORT ID]",   "get/set MQTT server options")
+  _F(252, 250, 0,             cli_mqtt_client,     "client",     " [USER KEY]",       "get/set MQTT client options")
+  _F(253, 250, 0,             cli_mqtt_connect,    "connect",    "",                  "connect to MQTT broker")
+  _F(254, 250, 0,             cli_mqtt_disconnect, "disconnect", "",                  "disconnect from MQTT broker")
+  _F(255, 250, 0,             cli_mqtt_status,     "status",     "",                  "print MQTT connection status")
+  _F(256, 250, 0,             cli_mqtt_state,      "state",      "",                  "print MQTT state (integer)")
+  _F(257, 250, 0,             cli_mqtt_pub,        "pub",        " [Topic MSG RTN]",  "publish message")
+  _F(258, 250, 0,             cli_mqtt_sub,        "sub",        " [Topic QoS]",      "subscribe topic")
+  _F(259, 250, 0,             cli_mqtt_unsub,      "unsub",      " [Topic]",          "unsubscribe topic")
+  _F(260, 250, 0,             cli_mqtt_rx,         "rx",         " [0|1]",            "on/off publish received packets")
+
+  _F(270,  -1, 0,             cli_stats,           "stats",      "",                  "print link statistics")
+  _F(271, 270, 0,             cli_stats_reset,     "reset",      "",                  "reset link statistics")
+  _F(272, 270, 0,             cli_stats_hist,      "hist",       " [rssi|snr|fei|dt]", "print histogram")
+  _F(273, 270, 0,             cli_stats_seq,       "seq",        " [offset]",         "set/get offset of 16-bit sequence counter in payload (-1 - off)")
+
+  _F(274,  -1, 0,             cli_per,             "per",        " [0|1]",            "on/off PER tester (TX: stamp payload, RX: count), print windows")
+  _F(275, 274, 0,             cli_per_win,         "win",        " [N]",              "get/set PER window size [packets]")
+  _F(276, 274, 0,             cli_per_reset,       "reset",      "",                  "reset PER tester (TX sequence, RX windows)")
+  _F(277, 274, 0,             cli_per_pub,         "pub",        "",                  "publish PER total and last window to MQTT")
+
+  _F(280,  -1, 0,             cli_lat,             "lat",        "",                  "print latency percentiles [us] (tx, turn, rtt, irq)")
+  _F(281, 280, 0,             cli_lat_reset,       "reset",      "",                  "reset latency histograms")
+  _F(282, 280, 0,             cli_lat_pub,         "pub",        "",                  "publish latency percentiles to MQTT")
+
+  _F(283,  -1, 0,             cli_scan,            "scan",       "",                  "print spectrum scanner results (CSV, FSM mode 10-SC)")
+  _F(284, 283, 0,             cli_scan_plan,       "plan",       " [Fmin Fmax step]", "get/set channel plan (Fmin/Fmax/step - kHz)")
+  _F(285, 283, 0,             cli_scan_dwell,      "dwell",      " [ms N]",           "get/set dwell time on channel [ms] and RSSI samples per dwell")
+  _F(286, 283, 0,             cli_scan_thr,        "thr",        " [dBm]",            "get/set busy threshold [dBm]")
+  _F(287, 283, 0,             cli_scan_reset,      "reset",      "",                  "reset scanner statistic")
+  _F(288, 283, 0,             cli_scan_pub,        "pub",        "",                  "publish scanner results (CSV) to MQTT")
+
+  _F(294,  -1, 0,             cli_range,           "range",      " [N]",              "get/set ranging session size (FSM mode RM, 1 - single shot), print last result")
+  _F(295, 294, 0,             cli_range_trim,      "trim",       " [%]",              "get/set trimmed mean cut on each side [%]")
+  _F(296, 294, 0,             cli_range_kf,        "kf",         " [Q R]",            "get/set Kalman process/measurement noise [cm^2]")
+  _F(297, 294, 0,             cli_range_reset,     "reset",      "",                  "reset Kalman filter state")
+  _F(298, 294, 0,             cli_range_cal,       "cal",        " [m|stop]",         "calibrate ranging at known distance [m] (current SF/BW)")
+
+  _F(230,  -1, 0,             cli_pos,             "pos",        " [0|1]",            "on/off multi-anchor positioning (FSM mode RM), print last position")
+  _F(231, 230, 0,             cli_pos_dim,         "dim",        " [2|3]",            "get/set positioning dimension")
+  _F(232, 230, 0,             cli_pos_anchor,      "anchor",     " [i addr x y [z]]", "print anchors or set anchor #i (slave address, position [dm])")
+  _F(233, 230, 0,             cli_pos_del,         "del",        " i",                "delete anchor #i")
+  _F(234, 230, 0,             cli_pos_clear,       "clear",      "",                  "delete all anchors")
+
+  _F(235,  -1, CLI_RADIO_ARG, cli_rdiv,            "rdiv",       " [0|1]",            "on/off ranging frequency diversity (FSM modes RM/RS, both ends), print state")
+  _F(236, 235, 0,             cli_rdiv_plan,       "plan",       " [Fmin Fmax step]", "get/set diversity channel plan (Fmin/Fmax/step - kHz, same on both ends)")
+  _F(237, 235, 0,             cli_rdiv_slot,       "slot",       " [symbols]",        "get/set slave RX window on channel (LoRa symbols)")
+
+  _F(238,  -1, 0,             cli_arlog,           "arlog",      " [0|1]",            "on/off Advanced Ranging binary capture log (FSM mode AR, look scripts/arlog2csv.py)")
+  _F(239, 238, 0,             cli_arlog_clear,     "clear",      "",                  "clear capture log and counters")
+
+#ifdef SX128X_USE_TRACE
+  _F(290,  -1, 0,             cli_trace,           "trace",      " [0|1]",            "on/off SPI transaction tracer")
+  _F(291, 290, 0,             cli_trace_dump,      "dump",       "",                  "dump SPI trace records (look scripts/trace2json.py)")
+  _F(292, 290, 0,             cli_trace_stat,      "stat",       "",                  "print SPI trace statistic per opcode")
+  _F(293, 290, 0,             cli_trace_clear,     "clear",      "",                  "clear SPI trace")
+#endif
+
+  _F( -1,  -1, 0,             NULL,                NULL,         NULL,                NULL)
 };
 //-----------------------------------------------------------------------------
 #undef _F
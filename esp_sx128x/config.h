@@ -90,6 +90,8 @@
 //-----------------------------------------------------------------------------
 #define SX128X_USE_EXTRA   // use some extra functions
 #define SX128X_USE_BUGFIX  // use bug fix of known limitations
+#define SX128X_USE_TRACE   // use SPI transaction tracer ("trace" command)
+#define SX128X_TRACE_SIZE 128 // SPI trace ring size (records)
 //-----------------------------------------------------------------------------
 //#define SX128X_DEBUG       // debug print
 //#define SX128X_DEBUG_IRQ   // debug verbose IRQ print
@@ -104,25 +106,54 @@
 #define CLI_HELP
 #define EXTRA
 #define PRINT_SERIAL
+#define USE_PROF            // main loop profiler ("sys prof" command)
+#define PRINT_LOG           // deferred (buffered) console output
+#define PRINT_LOG_SIZE 4096 // deferred log ring size [bytes] (power of 2)
+#define PRINT_LOG_LINE  128 // room reserved by first part of line [bytes]
+#define PRINT_LOG_TIMEOUT 200 // no sink progress in wait mode => drop [ms]
+//-----------------------------------------------------------------------------
+// time source (USE_VCLOCK - simulated clock for host build, look "vclock.h";
+// USE_TSTAMP - 64-bit hardware timer, look "tstamp.h" and "tstamp_timer.h")
+//#define USE_VCLOCK
+#define USE_TSTAMP
+#define TSTAMP_TIMER_NUM 0        // ESP32 timer group timer of timestamps
+#define TSTAMP_TIMER_HZ  40000000 // timestamp clock [Hz] (APB / 2, 25 ns)
+#if defined(USE_VCLOCK)
+#  include "vclock.h"
+#  define CLOCK_MS() vclock_ms()
+#  define CLOCK_US() vclock_us()
+#elif defined(USE_TSTAMP)
+#  include "tstamp.h"
+#  define CLOCK_MS() millis()
+#  define CLOCK_US() ((unsigned long) tstamp_us())
+#else
+#  define CLOCK_MS() millis()
+#  define CLOCK_US() micros()
+#endif
 //-----------------------------------------------------------------------------
 // selected time function
 #if 1
-#define TIME_FUNC() micros()  // us
+#define TIME_FUNC() CLOCK_US()  // us
 #define TIME_FACTOR 1000
 #else
-#define TIME_FUNC() millis()  // ms
+#define TIME_FUNC() CLOCK_MS()  // ms
 #define TIME_FACTOR 1
 #endif
 //-----------------------------------------------------------------------------
 #define OPT_DATA_SIZE 128  // max saved packet size [bytes]
 #define OPT_CODE_SIZE 15   // max saved OOK code size
 //-----------------------------------------------------------------------------
+#define RX_RING_SIZE 8 // RX packet ring size (must be power of 2)
+#define RX_RING_SUBS 10 // RX ring subscribers (not less than RxSubs[] in .ino)
+//-----------------------------------------------------------------------------
 #define OPT_AUTOSTART 0        // auto start FSM TX on reboot {0|1}
 #define OPT_AUTOSTART_DELAY 3  // auto start delay [sec]
 //-----------------------------------------------------------------------------
 #define WIFI_TIMEOUT 15 // Wi-Fi connetion timeout [seconds]
 #define MQTT_RETRIES 0  // MQTT connetion retries times (0 - no retries)
 #define MQTT_CHECK_PERIOD 60 // MQTT check connection period [seconds] 
+#define MQTT_BUFFER_SIZE 768 // MQTT packet buffer size [bytes]
+#define MQTT_TOPIC "sx128x"  // MQTT topic prefix
 //-----------------------------------------------------------------------------
 #endif // CONFIG_H
 
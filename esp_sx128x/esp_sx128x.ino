@@ -15,6 +15,8 @@
 #include "tfs.h"
 #include "wifi.h"
 #include "mqtt.h"
+#include "capture.h"
+#include "ook_timer.h"
 //-----------------------------------------------------------------------------
 #ifdef ARDUINO_USBCDC
 #  include "usbcdc.h"
@@ -46,11 +48,264 @@ void ticker_callback() {
   Ticks++;
 }
 //-----------------------------------------------------------------------------
+// RX ring subscribers (in order of delivery)
+static const struct {
+  rx_ring_cb_t cb;
+  void *context;
+  const char *name;
+} RxSubs[] = {
+  { sx128x_irq_print_cb, NULL,            "console" },
+  { mqtt_rx_cb,          NULL,            "mqtt"    },
+  { capture_cb,          NULL,            "capture" },
+  { stats_rx_cb,         (void*) &Stats,  "stats"   },
+  { per_rx_cb,           (void*) &Per,    "per"     },
+  { ping_rx_cb,          (void*) &Ping,   "ping"    },
+  { hop_rx_cb,           (void*) &Hop,    "hop"     },
+  { tdma_rx_cb,          (void*) &Tdma,   "tdma"    },
+  { mesh_rx_cb,          (void*) &Mesh,   "mesh"    },
+  { nbr_rx_cb,           (void*) &Nbr,    "nbr"     },
+};
+
+#define RX_SUBS (sizeof(RxSubs) / sizeof(RxSubs[0]))
+
+static_assert(RX_SUBS <= RX_RING_SUBS,
+              "RX_RING_SUBS (config.h) is less than number of RX subscribers");
+//-----------------------------------------------------------------------------
+static uint8_t HopRx = 0; // hop follower receiver is running {0|1}
+//-----------------------------------------------------------------------------
+// tune radio to current hop channel (rx=1: restart continuous RX)
+int8_t hop_tune(uint8_t rx)
+{
+  int8_t retv = SX128X_ERR_NONE;
+  if (rx) retv = sx128x_standby(&Radio, SX128X_STANDBY_XOSC);
+  if (retv == SX128X_ERR_NONE)
+    retv = sx128x_set_frequency_code(&Radio, Hop.code[Hop.ch]);
+  if (retv == SX128X_ERR_NONE && rx)
+    retv = sx128x_rx(&Radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_1MS);
+  return retv;
+}
+//-----------------------------------------------------------------------------
+// FSM TX stamper: headers to TX frame at TX start (Opt.data is not changed)
+void fsm_stamp(uint8_t *frame, uint8_t size, unsigned long t)
+{
+  if (size < tx_hdr_size()) return; // headers overlap => send data as is
+
+  if (Per.on && Fsm.mode() == AFSM_TX)
+    per_stamp(&Per, frame, size, t);
+
+  if (Ping.on && Fsm.mode() == AFSM_RQ) // request
+    ping_stamp(&Ping, sx128x_get_mode(&Radio), frame, size, t);
+  else if (Ping.on && Fsm.mode() == AFSM_RP) // reply
+    ping_echo(Ping.req, Ping.req_size, frame, size);
+
+  if (Hop.on && (Fsm.mode() == AFSM_TX || Fsm.mode() == AFSM_RQ ||
+                 (Fsm.mode() == AFSM_RP && Hop.reply)))
+    hop_stamp(&Hop, frame, size); // leader hop or follower reply (tail)
+}
+//-----------------------------------------------------------------------------
+// FSM event callback (print errors and debug trace)
+void fsm_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  if (Hop.on)
+  {
+    uint8_t mode = Fsm.mode();
+    if (ev == AFSM_EV_PERIOD && (mode == AFSM_TX || mode == AFSM_RQ))
+    { // leader: next channel before send (radio is in standby after wakeup)
+      // (no hop if header is not sent: followers could not sync)
+      if (Opt.data_size >= tx_hdr_size())
+      {
+        hop_next(&Hop, mode == AFSM_RQ);
+        if (err == SX128X_ERR_NONE) err = hop_tune(0);
+      }
+    }
+    else if (mode == AFSM_RX || mode == AFSM_RP)
+    { // follower
+      if (ev == AFSM_EV_WAKEUP)
+      { // receiver started => current (parking) channel
+        HopRx = 1;
+        if (err == SX128X_ERR_NONE) err = hop_tune(1);
+      }
+      else if (ev == AFSM_EV_STOP)
+        HopRx = 0;
+      else if (Hop.follow &&
+               ((ev == AFSM_EV_TX_DONE && mode == AFSM_RP) ||
+                (ev == AFSM_EV_RX_DONE && mode == AFSM_RX)))
+      { // exchange done => next channel
+        hop_follow(&Hop);
+        if (err == SX128X_ERR_NONE) err = hop_tune(1);
+      }
+    }
+  }
+
+  if (err != SX128X_ERR_NONE)
+  {
+    mrl_clear(&Mrl);
+    print_str("error in AFsm on ");
+    print_str(afsm_event_string[ev]);
+    print_ival(": err=", err);
+    mrl_refresh(&Mrl);
+  }
+  else if (Opt.verbose >= 3 && ev == AFSM_EV_PERIOD)
+  {
+    print_uval("\rtxrx_start: t=", t);
+    mrl_refresh(&Mrl);
+  }
+}
+//-----------------------------------------------------------------------------
+// report closed PER test window (console + MQTT)
+void per_report()
+{
+  char buf[160];
+  Per.ready = 0;
+  per_format(&Per.last, buf, sizeof(buf));
+
+  mrl_clear(&Mrl);
+  print_str("per: ");
+  print_str(buf);
+  print_eol();
+  mrl_refresh(&Mrl);
+
+  if (Mqtt.connected())
+    Mqtt.publish(MQTT_TOPIC "/per", buf, false);
+}
+//-----------------------------------------------------------------------------
+// report finished spectrum scan (console + MQTT)
+void scan_report()
+{
+  char buf[64];
+  int16_t best = scan_best(&Scan);
+  Scan.ready = 0;
+  if (best < 0) return;
+
+  snprintf(buf, sizeof(buf), "sweep=%lu time=%lums best=%d freq=%lukHz",
+           (unsigned long) Scan.sweeps, (unsigned long) (Scan.time / 1000),
+           (int) best, (unsigned long) scan_freq(&Scan, best));
+
+  if (Opt.verbose >= 2)
+  {
+    mrl_clear(&Mrl);
+    print_str("scan: ");
+    print_str(buf);
+    print_eol();
+    mrl_refresh(&Mrl);
+  }
+
+  if (Mqtt.connected())
+    Mqtt.publish(MQTT_TOPIC "/scan/best", buf, false);
+}
+//-----------------------------------------------------------------------------
+// report finished ranging session (console + MQTT)
+void range_report()
+{
+  char buf[192];
+  int len;
+  Range.ready = 0;
+
+  len = snprintf(buf, sizeof(buf),
+           "n=%u lost=%u gated=%u median=%ld trim=%ld kf=%ld rms=%lu "
+           "krms=%lu rssi=-%u.%u rate=%lu",
+           (unsigned) Range.samples, (unsigned) Range.lost,
+           (unsigned) Range.gated, (long) Range.median, (long) Range.trimmed,
+           (long) Range.kalman, (unsigned long) range_isqrt(Range.var),
+           (unsigned long) range_isqrt(Range.kvar),
+           (unsigned) (Range.rssi >> 1), (unsigned) ((Range.rssi & 1) * 5),
+           (unsigned long) Range.rate);
+  if (Range.chans > 1 && len > 0 && len < (int) sizeof(buf))
+    snprintf(buf + len, sizeof(buf) - len, " ch=%u chmed=%ld",
+             (unsigned) Range.chans, (long) Range.chmed);
+
+  mrl_clear(&Mrl);
+  print_str("range[cm]: ");
+  print_str(buf);
+  print_eol();
+  mrl_refresh(&Mrl);
+
+  if (Mqtt.connected())
+    Mqtt.publish(MQTT_TOPIC "/range", buf, false);
+}
+//-----------------------------------------------------------------------------
+// ranging calibration step by finished session (next session uses result)
+void range_cal_report()
+{
+  uint8_t step = RangeCal.step;
+  uint32_t calib = range_cal_step(&RangeCal, Range.median);
+
+  // table cell of current BW/SF is applied by next wakeup (sx128x_set_pars())
+  *sx128x_ranging_calib_cell(&Opt.radio, Opt.radio.bw, Opt.radio.sf) =
+    (uint16_t) calib;
+  range_kf_reset(&Range); // bias is changed
+
+  mrl_clear(&Mrl);
+  print_str("range cal: step=");  print_uint(step);
+  print_str(" median=");          print_distance_cm(Range.median);
+  print_str("m next=");           print_uint(calib);
+  print_eol();
+  if (RangeCal.step == RANGE_CAL_DONE)
+  {
+    print_str("range cal: BW=");  print_uint(Opt.radio.bw);
+    print_str("kHz SF=");         print_uint(Opt.radio.sf);
+    print_str(" calib=");         print_uint(RangeCal.c);
+    print_str(" err=");           print_distance_cm(RangeCal.err);
+    print_str("m (use \"eeprom write\" to keep)\r\n");
+  }
+  else if (RangeCal.step == RANGE_CAL_FAIL)
+    print_str("range cal: FAIL (no slope, calibration restored)\r\n");
+  mrl_refresh(&Mrl);
+}
+//-----------------------------------------------------------------------------
+// report finished anchor cycle (console + MQTT)
+void pos_report()
+{
+  char buf[128];
+  uint8_t i;
+  Pos.ready = 0;
+
+  if (Pos.err == POS_ERR_NONE)
+    snprintf(buf, sizeof(buf),
+             "x=%ld y=%ld z=%ld rms=%lu used=%u iter=%u rate=%lu",
+             (long) Pos.fix.x, (long) Pos.fix.y, (long) Pos.fix.z,
+             (unsigned long) Pos.fix.rms, (unsigned) Pos.fix.used,
+             (unsigned) Pos.fix.iter, (unsigned long) Pos.rate);
+  else
+    snprintf(buf, sizeof(buf), "err=%d used=%u rate=%lu",
+             (int) Pos.err, (unsigned) Pos.fix.used,
+             (unsigned long) Pos.rate);
+
+  mrl_clear(&Mrl);
+  print_str("pos[dm]: ");
+  print_str(buf);
+  print_eol();
+  if (Opt.verbose >= 2)
+    for (i = 0; i < Opt.pos.n; i++)
+    {
+      print_str("  anchor #");  print_uint(i);
+      print_str(" 0x");         print_hex(Opt.pos.a[i].addr, 8);
+      if (Pos.mask & (1u << i))
+      {
+        print_str(" d=");       print_distance(Pos.d[i]);
+        print_str("m");
+        if (Pos.err == POS_ERR_NONE)
+        {
+          print_str(" res=");   print_distance(Pos.fix.res[i]);
+          print_str("m");
+        }
+        print_eol();
+      }
+      else
+        print_str(" lost\r\n");
+    }
+  mrl_refresh(&Mrl);
+
+  if (Mqtt.connected())
+    Mqtt.publish(MQTT_TOPIC "/pos", buf, false);
+}
+//-----------------------------------------------------------------------------
 // MQTT callback
 void mqtt_callback(char *topic, byte *payload, unsigned int length)
 {
   mrl_clear(&Mrl);
   // FIXME: example code
+  print_flush(); // deferred log and capture frame before direct output
   Serial.print("Message arrived [");
   Serial.print(topic);
   Serial.print("] ");
@@ -62,6 +317,9 @@ void mqtt_callback(char *topic, byte *payload, unsigned int length)
 }
 //-----------------------------------------------------------------------------
 void setup() {
+  // don't drop console output while setup
+  print_log_wait(1);
+
   // setup blink LED
   Led.begin(LED_PIN, LED_INVERT, LED_BLINK_ON, LED_BLINK_OFF);
 
@@ -114,6 +372,12 @@ void setup() {
   opt_default(&Opt); // set to default all options
   opt_read_from_flash(&Opt, &Tfs);
 
+#ifdef USE_TSTAMP
+  // timestamps by 64-bit hardware timer (before DIO1 interrupt)
+  if (tstamp_timer_begin() != 0) print_str("hardware timer FAIL\r\n");
+#endif
+  tstamp_link_init(&Tstamp);
+
   // init SPI and SPI pins
   print_str("SX128X_SPI_CLOCK=");  
   print_dint(SX128X_SPI_CLOCK / 100000);  
@@ -137,6 +401,12 @@ void setup() {
                             &Opt.radio, NULL);
   print_ival("sx128x_init() return ", retv);
 
+#ifdef SX128X_USE_TRACE
+  // attach SPI transaction tracer (off by default, look "trace" command)
+  sx128x_trace_init(&Trace, sx128x_hw_time_us);
+  sx128x_set_trace(&Radio, &Trace);
+#endif
+
   // setup onboard button
 #ifdef BUTTON_PIN
   //pinMode(BUTTON_PIN, INPUT);
@@ -156,8 +426,42 @@ void setup() {
   }
   Mqtt.setCallback(mqtt_callback);
 
+  // init link statistics, PER tester, ping-pong benchmark, hopping (off),
+  // TDMA scheduler, mesh relay and neighbor table (look commands)
+  stats_init(&Stats);
+  per_init(&Per);
+  ping_init(&Ping);
+  hop_init(&Hop);
+  tdma_init(&Tdma);
+  mesh_init(&Mesh);
+  nbr_init(&Nbr);
+
+  // init RX packet ring and subscribers
+  rx_ring_init(&RxRing);
+  for (size_t i = 0; i < RX_SUBS; i++)
+  {
+    if (rx_ring_subscribe(&RxRing, RxSubs[i].cb, RxSubs[i].context,
+                          RxSubs[i].name) < 0)
+    { // never by static_assert() above
+      print_str("error: no room for RX ring subscriber \"");
+      print_str(RxSubs[i].name);
+      print_str("\" (RX_RING_SUBS)\r\n");
+    }
+  }
+
+#ifdef USE_PROF
+  // clear main loop profiler
+  Prof.reset();
+#endif
+
+  // clear latency histograms
+  lat_clear(&Latency.tx);
+  lat_clear(&Latency.turn);
+  lat_clear(&Latency.rtt);
+  lat_clear(&Latency.irq);
+
   // setup ticker
-  Ticker.begin(ticker_callback, TICKER_MS, true, millis());
+  Ticker.begin(ticker_callback, TICKER_MS, true, CLOCK_MS());
   Ticks = 0;
 
   // init FSM
@@ -166,11 +470,45 @@ void setup() {
             Opt.data,         // RX/TX packet data
             &Opt.data_size,   // RX/TX packet data size (bytes)
             &Opt.radio.fixed, // 1-fixed packet size, 0-variable packet size 
-            Opt.code,         // OOK code (like "100101")
-            &Opt.code_size,   // OOK code size (chips) = strlen(code)
+            &Ook,             // OOK code (bit-packed)
             &Radio,           // SX128x object
+            &Opt.tx_timeout,  // TX timeout [ms]
             setRXEN,          // set RXEN or NULL
-            setTXEN);         // set TXEN or NULL
+            setTXEN,          // set TXEN or NULL
+            fsm_callback);    // FSM event callback
+
+  // protocol headers to TX frame (copy of Opt.data) at TX start
+  Fsm.stamper(fsm_stamp);
+
+  // TDMA slot scheduler of FSM mode TD
+  Fsm.scheduler(&Tdma);
+
+  // mesh flooding relay of FSM mode MS
+  Fsm.relay(&Mesh);
+
+  // make OOK code, chips by hardware timer if `dcu` set (look "code" command)
+  ook_init(&Ook);
+  ook_make(&Ook, Opt.code_gen, Opt.code_arg, Opt.code);
+  Fsm.chip_timer(ook_timer);
+
+  // init spectrum scanner (FSM mode SC, look "scan" command)
+  scan_init(&Scan);
+  Fsm.scanner(&Scan);
+
+  // init ranging session (FSM mode RM, look "range" command)
+  range_init(&Range);
+  Fsm.ranger(&Range);
+
+  // init multi-anchor positioning (FSM mode RM, look "pos" command)
+  pos_init(&Pos, &Opt.pos);
+  Fsm.anchors(&Pos);
+
+  // init ranging frequency diversity (FSM modes RM/RS, look "rdiv" command)
+  rdiv_init(&Rdiv);
+  Fsm.diversity(&Rdiv);
+
+  // init Advanced Ranging passive capture log (look "arlog" command)
+  arlog_init(&ArLog);
   
   Seconds = 0;
   print_uval("autostart=", Autostart = Opt.autostart);
@@ -204,18 +542,32 @@ void setup() {
   // init CLI (MicroRL)
   cli_init();
   print_flush();
+  print_log_wait(0);
 
   Led.off();
 }
 //-----------------------------------------------------------------------------
 void loop() {
-  unsigned long ms = millis();
+  PROF_BEGIN(APROF_LOOP);
+  tstamp_poll(); // extend timestamp counter
+  unsigned long ms = CLOCK_MS();
   unsigned long t = TIME_FUNC();
+
+  PROF_BEGIN(APROF_LED);
   Led.yield(ms);
+  PROF_END(APROF_LED);
 
+  PROF_BEGIN(APROF_TICKER);
   Ticker.yield(ms);
+  PROF_END(APROF_TICKER);
+
+  PROF_BEGIN(APROF_FSM);
   Fsm.yield(t);
+  if (HopRx && hop_yield(&Hop, t, Opt.fsm.t))
+    hop_tune(1); // follower: next channel by dead reckoning
+  PROF_END(APROF_FSM);
 
+  PROF_BEGIN(APROF_IRQ);
 #ifndef USE_DIO1_INTERRUPT
   // periodic check IRQ (DIO1)
   sx128x_hw_check_dio1();
@@ -223,10 +575,39 @@ void loop() {
  
   // check SX128x IRQ (DIO1) flag
   sx128x_irq();
+  PROF_END(APROF_IRQ);
+
+  // deliver received packets to RX ring subscribers
+  PROF_BEGIN(APROF_RING);
+  rx_ring_yield(&RxRing);
+  if (Per.ready) per_report();
+  if (Scan.ready) scan_report();
+  if (Range.ready)
+  {
+    if (RangeCal.step > RANGE_CAL_OFF && RangeCal.step < RANGE_CAL_DONE)
+      range_cal_report();
+    range_report();
+  }
+  if (Pos.ready) pos_report();
+  PROF_END(APROF_RING);
+
+  // send binary capture frames and deferred console log while UART has room
+  PROF_BEGIN(APROF_PRINT);
+  capture_yield();
+  if (ArLog.on && !capture_busy() && arlog_count(&ArLog))
+  { // pack all pending Advanced Ranging exchanges (up to ARLOG_BATCH)
+    static uint8_t frame[ARLOG_FRAME_MAX];
+    capture_frame(frame, arlog_pack(&ArLog, frame));
+  }
+  print_yield(); // after capture frame
+  PROF_END(APROF_PRINT);
 
   // check user CLI commands
+  PROF_BEGIN(APROF_CLI);
   cli_loop();
+  PROF_END(APROF_CLI);
   
+  PROF_BEGIN(APROF_MISC);
 #ifdef BUTTON_PIN
   // check onboard button
   uint8_t btn = digitalRead(BUTTON_PIN);
@@ -251,13 +632,26 @@ void loop() {
     mrl_refresh(&Mrl);
   }
 
+  // drop silent neighbors once per second (not only on insert/CLI)
+  static uint32_t nbr_sec = 0;
+  if (Seconds != nbr_sec) {
+    nbr_sec = Seconds;
+    nbr_expire(&Nbr, (uint32_t) (tstamp_ns() / 1000000));
+  }
+
+  PROF_END(APROF_MISC);
+
   // check Wi-Fi conection
   //if (Opt.wifi_ssid[0] != '\0')
   //  if (!wifi_connected())
   //    wifi_reconnect();
 
   // MQTT PubSubClient loop
+  PROF_BEGIN(APROF_MQTT);
   Mqtt.loop();
+  PROF_END(APROF_MQTT);
+
+  PROF_END(APROF_LOOP);
 }
 //-----------------------------------------------------------------------------
 #if 0
@@ -19,6 +19,29 @@ uint8_t RXEN;            // RXEN state {0|1}
 uint8_t TXEN;            // TXEN state {0|1}
 AFsm Fsm;                // FSM
 uint8_t Autostart = 0;   // auto start flag
+rx_ring_t RxRing;        // RX packet ring
+stats_t Stats;           // link statistics
+per_t Per;               // PER tester
+ping_t Ping;             // ping-pong RTT benchmark
+scan_t Scan;             // spectrum scanner
+hop_t Hop;               // frequency hopping
+tdma_t Tdma;             // TDMA slot scheduler
+mesh_t Mesh;             // mesh flooding relay
+nbr_t Nbr;               // neighbor table
+tstamp_link_t Tstamp;    // TxDone/RxDone timestamps
+ook_t Ook;               // bit-packed OOK code
+range_t Range;           // multi-sample ranging session
+range_cal_t RangeCal;    // ranging calibration routine
+pos_t Pos;               // multi-anchor positioning
+rdiv_t Rdiv;             // ranging frequency diversity
+arlog_t ArLog;           // Advanced Ranging passive capture log
+lat_link_t Latency;      // latency histograms
+#ifdef SX128X_USE_TRACE
+sx128x_trace_t Trace;    // SPI transaction tracer
+#endif
+#ifdef USE_PROF
+AProf Prof;              // main loop profiler
+#endif
 //-----------------------------------------------------------------------------
 // print SX128x RSSI [dBm]
 void print_rssi(uint8_t rssi)
@@ -68,6 +91,28 @@ void print_distance(int32_t dist)
   print_uint_ex(((unsigned) dist) % 10, 1); // dm
 }
 //-----------------------------------------------------------------------------
+// print Distance [cm -> m]
+void print_distance_cm(int32_t dist)
+{
+  if (dist < 0)
+  {
+    dist = -dist;
+    print_chr('-');
+  }
+  print_uint(((unsigned) dist) / 100); // m
+  print_chr('.');
+  print_uint_ex(((unsigned) dist) % 100, 2); // cm
+}
+//-----------------------------------------------------------------------------
+// minimal TX data size for enabled headers (PER/ping head + hop tail)
+uint8_t tx_hdr_size()
+{
+  uint8_t head = 0;
+  if (Per.on  && head < PER_HDR_SIZE)  head = PER_HDR_SIZE;
+  if (Ping.on && head < PING_HDR_SIZE) head = PING_HDR_SIZE;
+  return head + (Hop.on ? HOP_HDR_SIZE : 0);
+}
+//-----------------------------------------------------------------------------
 
 /*** end of "global.cpp" file ***/
 
@@ -16,6 +16,24 @@
 #include "sx128x_hw_arduino.h"
 #include "opt.h"
 #include "afsm.h"
+#include "rx_ring.h"
+#include "stats.h"
+#include "per.h"
+#include "ping.h"
+#include "scan.h"
+#include "hop.h"
+#include "tdma.h"
+#include "mesh.h"
+#include "nbr.h"
+#include "tstamp.h"
+#include "tstamp_timer.h"
+#include "ook.h"
+#include "range.h"
+#include "pos.h"
+#include "rdiv.h"
+#include "arlog.h"
+#include "lat.h"
+#include "aprof.h"
 //-----------------------------------------------------------------------------
 #ifndef INLINE
 #  define INLINE static inline
@@ -34,6 +52,29 @@ extern uint8_t RXEN;        // RXEN state {0|1}
 extern uint8_t TXEN;        // TXEN state {0|1}
 extern AFsm Fsm;            // FSM
 extern uint8_t Autostart;   // auto start flag
+extern rx_ring_t RxRing;    // RX packet ring
+extern stats_t Stats;       // link statistics
+extern per_t Per;           // PER tester
+extern ping_t Ping;         // ping-pong RTT benchmark
+extern scan_t Scan;         // spectrum scanner
+extern hop_t Hop;           // frequency hopping
+extern tdma_t Tdma;         // TDMA slot scheduler
+extern mesh_t Mesh;         // mesh flooding relay
+extern nbr_t Nbr;           // neighbor table
+extern tstamp_link_t Tstamp; // TxDone/RxDone timestamps
+extern ook_t Ook;           // bit-packed OOK code
+extern range_t Range;       // multi-sample ranging session
+extern range_cal_t RangeCal; // ranging calibration routine
+extern pos_t Pos;           // multi-anchor positioning
+extern rdiv_t Rdiv;         // ranging frequency diversity
+extern arlog_t ArLog;       // Advanced Ranging passive capture log
+extern lat_link_t Latency;  // latency histograms
+#ifdef SX128X_USE_TRACE
+extern sx128x_trace_t Trace; // SPI transaction tracer
+#endif
+#ifdef USE_PROF
+extern AProf Prof;          // main loop profiler
+#endif
 //-----------------------------------------------------------------------------
 #ifdef __cplusplus
 extern "C"
@@ -54,6 +95,12 @@ void print_fei(int32_t fei);
 
 // print Distance [dm -> m]
 void print_distance(int32_t dist);
+
+// print Distance [cm -> m]
+void print_distance_cm(int32_t dist);
+
+// minimal TX data size for enabled headers (PER/ping head + hop tail)
+uint8_t tx_hdr_size();
 //-----------------------------------------------------------------------------
 #ifdef __cplusplus
 }
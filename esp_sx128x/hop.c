@@ -0,0 +1,367 @@
+/*
+ * Adaptive frequency hopping: shared pseudorandom sequence, channel quality
+ * map, blacklisting with switch instant (leader/follower)
+ * File: "hop.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "sx128x.h" // sx128x_freq2code()
+#include "hop.h"
+//-----------------------------------------------------------------------------
+static void hop_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)  v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+//-----------------------------------------------------------------------------
+static uint32_t hop_get32(const uint8_t *p)
+{
+  return ((uint32_t) p[0]      ) | ((uint32_t) p[1] <<  8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+// all channels of plan
+static uint64_t hop_map_all(const hop_t *self)
+{
+  return self->n >= 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << self->n) - 1;
+}
+//-----------------------------------------------------------------------------
+// number of used channels in map
+static uint8_t hop_count(uint64_t map)
+{
+  uint8_t cnt = 0;
+  for (; map; map &= map - 1) cnt++;
+  return cnt;
+}
+//-----------------------------------------------------------------------------
+// set active map and build remap table
+static void hop_set_map(hop_t *self, uint64_t map)
+{
+  uint8_t i;
+  map &= hop_map_all(self);
+  if (map == 0) map = hop_map_all(self);
+
+  self->map   = map;
+  self->ngood = 0;
+  for (i = 0; i < self->n; i++)
+    if (map & ((uint64_t) 1 << i)) self->good[self->ngood++] = i;
+}
+//-----------------------------------------------------------------------------
+// latest map (next if pending)
+static uint64_t hop_map_last(const hop_t *self)
+{
+  return self->map_pending ? self->map_new : self->map;
+}
+//-----------------------------------------------------------------------------
+// leader: schedule map change after HOP_INSTANT hops
+static void hop_change(hop_t *self, uint64_t map)
+{
+  if (map == hop_map_last(self)) return;
+  self->map_new     = map;
+  self->instant     = self->idx + HOP_INSTANT;
+  self->map_pending = 1;
+}
+//-----------------------------------------------------------------------------
+// apply scheduled map at switch instant
+static void hop_apply(hop_t *self)
+{
+  if (self->map_pending && (int32_t) (self->idx - self->instant) >= 0)
+  {
+    hop_set_map(self, self->map_new);
+    self->map_pending = 0;
+  }
+}
+//-----------------------------------------------------------------------------
+// leader: account exchange on channel, blacklist by PER at window end
+static void hop_account(hop_t *self, uint8_t ch, uint8_t ok, uint8_t rssi)
+{
+  hop_ch_t *q = &self->q[ch];
+
+  q->tx++;
+  q->tx_total++;
+  if (ok)
+  {
+    q->ok++;
+    q->ok_total++;
+    // EWMA of RSSI (alpha = 1/8)
+    q->rssi = q->rssi ? q->rssi - (q->rssi >> 3) + rssi : (uint16_t) rssi << 3;
+  }
+
+  if (q->retry && !ok)
+    q->tx = self->window; // retried channel still bad => ban immediately
+  else if (q->tx < self->window)
+    return;
+
+  if (self->adapt &&
+      (uint32_t) (q->tx - q->ok) * 100 > (uint32_t) self->per_max * q->tx)
+  {
+    uint64_t map = hop_map_last(self);
+    uint64_t bit = (uint64_t) 1 << ch;
+    if ((map & bit) && hop_count(map) > self->min_ch)
+    {
+      hop_change(self, map & ~bit);
+      q->bad_at = self->idx;
+      if (q->bans < 255) q->bans++;
+      self->banned++;
+    }
+  }
+  q->tx = q->ok = q->retry = 0;
+}
+//-----------------------------------------------------------------------------
+// init hopping engine (off, default plan, adaptation on)
+void hop_init(hop_t *self)
+{
+  memset((void*) self, 0, sizeof(hop_t));
+  self->adapt     = 1;
+  self->per_max   = HOP_PER_MAX;
+  self->min_ch    = HOP_MIN_CH;
+  self->window    = HOP_WINDOW;
+  self->probation = HOP_PROBATION;
+  hop_plan(self, HOP_FREQ_MIN, HOP_FREQ_MAX, HOP_STEP, HOP_SEED);
+}
+//-----------------------------------------------------------------------------
+// set channel plan and seed: precompute PLL codes and sequence, reset map
+// (return number of channels)
+uint8_t hop_plan(hop_t *self, uint32_t fmin, uint32_t fmax, uint32_t step,
+                 uint32_t seed)
+{
+  uint32_t n, x = seed ? seed : 1;
+  uint8_t i;
+
+  if (step == 0) step = HOP_STEP;
+  n = fmax > fmin ? (fmax - fmin) / step + 1 : 1;
+  if (n > HOP_CHANNELS) n = HOP_CHANNELS;
+
+  self->seed = seed;
+  self->fmin = fmin;
+  self->step = step;
+  self->n    = (uint8_t) n;
+
+  // divisions here => only one SPI write on each hop
+  for (i = 0; i < self->n; i++)
+  {
+    self->code[i] = sx128x_freq2code(hop_freq(self, i) * 1000);
+    self->perm[i] = i;
+  }
+
+  // Fisher-Yates shuffle by xorshift32 (same sequence on both ends)
+  for (i = self->n - 1; i > 0; i--)
+  {
+    uint8_t j, t;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    j = (uint8_t) (x % (uint32_t) (i + 1));
+    t = self->perm[i]; self->perm[i] = self->perm[j]; self->perm[j] = t;
+  }
+
+  hop_reset(self);
+  return self->n;
+}
+//-----------------------------------------------------------------------------
+// reset channel map, quality and synchronization
+void hop_reset(hop_t *self)
+{
+  memset((void*) self->q, 0, sizeof(self->q));
+  hop_set_map(self, hop_map_all(self));
+  self->map_new     = self->map;
+  self->instant     = 0;
+  self->map_pending = 0;
+  self->idx         = 0;
+  self->ch          = hop_channel(self, 0);
+  self->pending     = 0;
+  self->sync        = 0;
+  self->follow      = 0;
+  self->reply       = 0;
+  self->miss        = 0;
+  self->park        = 0;
+  self->deadline    = 0;
+  self->hops        = 0;
+  self->banned      = 0;
+  self->restored    = 0;
+  self->resync      = 0;
+  self->lost        = 0;
+}
+//-----------------------------------------------------------------------------
+// channel of hop index by active map
+uint8_t hop_channel(const hop_t *self, uint32_t idx)
+{
+  uint8_t ch = self->perm[idx % self->n];
+  if (self->map & ((uint64_t) 1 << ch)) return ch;
+  // remap unused channel (offset changes every sequence cycle)
+  return self->good[(ch + idx / self->n) % self->ngood];
+}
+//-----------------------------------------------------------------------------
+// channel frequency [kHz]
+uint32_t hop_freq(const hop_t *self, uint8_t ch)
+{
+  return self->fmin + (uint32_t) ch * self->step;
+}
+//-----------------------------------------------------------------------------
+// leader: account last exchange and go to next hop (return channel)
+// (reply = 1 - exchange with reply (RQ), 0 - one way (TX))
+uint8_t hop_next(hop_t *self, uint8_t reply)
+{
+  hop_ch_t *q;
+  uint8_t ch, shift;
+
+  if (self->pending) hop_account(self, self->ch, 0, 0); // no reply
+
+  self->idx++;
+  self->hops++;
+
+  // retry one blacklisted channel after probation (doubled on each ban,
+  // channel off in map learned as follower has no bans: one probation)
+  ch    = (uint8_t) (self->idx % self->n);
+  q     = &self->q[ch];
+  shift = q->bans ? q->bans - 1 : 0;
+  if (shift > HOP_BACKOFF) shift = HOP_BACKOFF;
+  if (!(hop_map_last(self) & ((uint64_t) 1 << ch)) &&
+      self->idx - q->bad_at >= self->probation << shift)
+  {
+    q->tx    = q->ok = 0;
+    q->retry = 1;
+    hop_change(self, hop_map_last(self) | ((uint64_t) 1 << ch));
+    self->restored++;
+  }
+
+  hop_apply(self);
+  self->pending = reply;
+  return self->ch = hop_channel(self, self->idx);
+}
+//-----------------------------------------------------------------------------
+// write hop header to payload tail (return 0 if payload is too small)
+uint8_t hop_stamp(const hop_t *self, uint8_t *data, uint8_t size)
+{
+  uint64_t map = hop_map_last(self);
+  uint32_t off = self->map_pending ? self->instant - self->idx : 0;
+  uint8_t *p;
+  if (size < HOP_HDR_SIZE) return 0;
+  p = data + size - HOP_HDR_SIZE;
+
+  p[0] = HOP_MAGIC;
+  hop_put32(p + 1, self->idx);
+  p[5] = (uint8_t) (off > 255 ? 255 : off);
+  hop_put32(p + 6,  (uint32_t)  map);
+  hop_put32(p + 10, (uint32_t) (map >> 32));
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// leader: account reply (RX ring subscriber, context = hop_t*)
+uint8_t hop_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  hop_t *self = (hop_t*) context;
+  const uint8_t *p;
+
+  if (!self->on || !self->pending || !pkt->rx.crc_ok ||
+      pkt->size < HOP_HDR_SIZE)
+    return 1; // not a reply
+
+  p = pkt->data + pkt->size - HOP_HDR_SIZE;
+  if (p[0] == HOP_MAGIC && hop_get32(p + 1) == self->idx)
+  {
+    hop_account(self, self->ch, 1, pkt->rx.rssi);
+    self->pending = 0;
+  }
+
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// follower: synchronize by received hop header (return 1 if synchronized)
+// (t = TIME_FUNC() of RX, period - leader hop period [ms])
+uint8_t hop_sync(hop_t *self, const uint8_t *data, uint8_t size,
+                 unsigned long t, uint32_t period)
+{
+  const uint8_t *p;
+  uint64_t map;
+
+  if (size < HOP_HDR_SIZE) return 0;
+  p = data + size - HOP_HDR_SIZE;
+  if (p[0] != HOP_MAGIC) return 0;
+
+  map = (uint64_t) hop_get32(p + 6) | ((uint64_t) hop_get32(p + 10) << 32);
+  if (!self->sync) self->resync++;
+
+  self->idx    = hop_get32(p + 1);
+  self->sync   = 1;
+  self->follow = 1;
+  self->miss   = 0;
+
+  if (p[5] == 0)
+  { // map is applied by leader
+    if (map != self->map) hop_set_map(self, map);
+    self->map_pending = 0;
+  }
+  else
+  { // map will be applied at switch instant
+    self->map_new     = map;
+    self->instant     = self->idx + p[5];
+    self->map_pending = 1;
+  }
+
+  self->ch       = hop_channel(self, self->idx);
+  self->deadline = t + (unsigned long) period * TIME_FACTOR * 3 / 2;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// follower: go to next hop after exchange (return channel)
+uint8_t hop_follow(hop_t *self)
+{
+  if (!self->follow) return self->ch;
+  self->follow = 0;
+  self->idx++;
+  self->hops++;
+  hop_apply(self);
+  return self->ch = hop_channel(self, self->idx);
+}
+//-----------------------------------------------------------------------------
+// follower: dead reckoning without packets (call from main loop)
+// (return 1 if channel changed => retune receiver)
+uint8_t hop_yield(hop_t *self, unsigned long t, uint32_t period)
+{
+  unsigned long dt = (unsigned long) period * TIME_FACTOR;
+
+  if (!self->on || self->follow || (long) (t - self->deadline) < 0)
+    return 0;
+
+  if (self->sync)
+  {
+    if (++self->miss > HOP_LOST)
+    { // sync lost => park on current channel
+      self->sync = 0;
+      self->lost++;
+      self->deadline = t + dt * (self->n + 1);
+      return 0;
+    }
+
+    // next hop by leader period
+    self->idx++;
+    self->hops++;
+    hop_apply(self);
+    self->ch = hop_channel(self, self->idx);
+    self->deadline += dt;
+    return 1;
+  }
+
+  // not synchronized: move parking channel every sequence cycle
+  // (only used channels of last known map are visited by leader often)
+  self->park = (uint8_t) ((self->park + 1) % self->ngood);
+  self->ch   = self->good[self->park];
+  self->deadline = t + dt * (self->n + 1);
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// PER of channel for all time [%] (-1 if unknown)
+int8_t hop_per(const hop_t *self, uint8_t ch)
+{
+  const hop_ch_t *q = &self->q[ch];
+  if (q->tx_total == 0) return -1;
+  return (int8_t) (((uint64_t) (q->tx_total - q->ok_total) * 100 +
+                    q->tx_total / 2) / q->tx_total);
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "hop.c" file ***/
@@ -0,0 +1,156 @@
+/*
+ * Adaptive frequency hopping: shared pseudorandom sequence, channel quality
+ * map, blacklisting with switch instant (leader/follower)
+ * File: "hop.h"
+ */
+
+#pragma once
+#ifndef HOP_H
+#define HOP_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+// hop header at the END of payload (little endian):
+//   [0]     - HOP_MAGIC
+//   [1..4]  - hop index (32 bit)
+//   [5]     - hops before `map` is applied (0 - already applied)
+//   [6..13] - channel map (64 bit, 1 - channel used)
+#define HOP_MAGIC    0xC3
+#define HOP_HDR_SIZE 14
+
+#define HOP_CHANNELS 64 // maximal number of channels (map bits)
+
+// channel plan by default (40 channels of 2 MHz)
+#define HOP_FREQ_MIN 2402000 // first channel frequency [kHz]
+#define HOP_FREQ_MAX 2480000 // last channel frequency [kHz]
+#define HOP_STEP        2000 // channel step [kHz]
+#define HOP_SEED      0x5EED // sequence seed by default
+
+// adaptation by default
+#define HOP_WINDOW        16 // exchanges on channel before PER check
+#define HOP_PER_MAX       30 // blacklist threshold [%]
+#define HOP_MIN_CH         8 // minimal number of used channels
+#define HOP_PROBATION    512 // hops before blacklisted channel is retried
+#define HOP_BACKOFF        3 // max probation doubling for repeatedly bad channel
+#define HOP_INSTANT        8 // hops from map change to switch
+
+#define HOP_LOST          32 // missed hops before follower lose sync
+//-----------------------------------------------------------------------------
+// quality of one channel
+typedef struct hop_ch_ {
+  uint16_t tx;       // exchanges in current window
+  uint16_t ok;       // successful exchanges in current window
+  uint32_t tx_total; // all exchanges
+  uint32_t ok_total; // all successful exchanges
+  uint16_t rssi;     // EWMA of RSSI * 8 (-dBm*2*8, 0 - unknown)
+  uint32_t bad_at;   // hop index of blacklisting
+  uint8_t  bans;     // number of blacklistings (probation backoff)
+  uint8_t  retry;    // 1 - channel is on probation (ban on first loss)
+} hop_ch_t;
+//-----------------------------------------------------------------------------
+// frequency hopping engine
+typedef struct hop_ {
+  uint8_t  on;       // 1 - hopping on
+
+  // channel plan and sequence
+  uint32_t seed;                // sequence seed (same on both ends)
+  uint32_t fmin;                // first channel frequency [kHz]
+  uint32_t step;                // channel step [kHz]
+  uint8_t  n;                   // number of channels
+  uint32_t code[HOP_CHANNELS];  // precomputed PLL codes of channels
+  uint8_t  perm[HOP_CHANNELS];  // pseudorandom permutation of channels
+
+  // channel map
+  uint64_t map;                 // active map (1 - channel used)
+  uint8_t  good[HOP_CHANNELS];  // used channels (remap table)
+  uint8_t  ngood;               // number of used channels
+  uint64_t map_new;             // next map
+  uint32_t instant;             // hop index to apply `map_new`
+  uint8_t  map_pending;         // 1 - `map_new` not applied yet
+
+  // current hop
+  uint32_t idx;      // hop index
+  uint8_t  ch;       // channel
+  uint8_t  pending;  // leader: wait reply on `ch`
+
+  // adaptation (leader)
+  uint8_t  adapt;     // 1 - blacklist bad channels
+  uint8_t  per_max;   // blacklist threshold [%]
+  uint8_t  min_ch;    // minimal number of used channels
+  uint16_t window;    // exchanges on channel before PER check
+  uint32_t probation; // hops before blacklisted channel is retried
+  hop_ch_t q[HOP_CHANNELS];
+
+  // synchronization (follower)
+  uint8_t  sync;           // 1 - follow leader sequence
+  uint8_t  follow;         // 1 - hop received, go to next after exchange
+  uint8_t  reply;          // 1 - last RX synchronized, stamp header to reply
+  uint8_t  miss;           // missed hops after last received
+  uint8_t  park;           // parking position in `good[]` without sync
+  unsigned long deadline;  // next hop by dead reckoning [TIME_FUNC()]
+
+  // statistic
+  uint32_t hops;     // hops
+  uint32_t banned;   // blacklisted channels
+  uint32_t restored; // channels returned from blacklist
+  uint32_t resync;   // follower synchronizations
+  uint32_t lost;     // follower sync losses
+} hop_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init hopping engine (off, default plan, adaptation on)
+void hop_init(hop_t *self);
+//-----------------------------------------------------------------------------
+// set channel plan and seed: precompute PLL codes and sequence, reset map
+// (return number of channels)
+uint8_t hop_plan(hop_t *self, uint32_t fmin, uint32_t fmax, uint32_t step,
+                 uint32_t seed);
+//-----------------------------------------------------------------------------
+// reset channel map, quality and synchronization
+void hop_reset(hop_t *self);
+//-----------------------------------------------------------------------------
+// channel of hop index by active map
+uint8_t hop_channel(const hop_t *self, uint32_t idx);
+//-----------------------------------------------------------------------------
+// channel frequency [kHz]
+uint32_t hop_freq(const hop_t *self, uint8_t ch);
+//-----------------------------------------------------------------------------
+// leader: account last exchange and go to next hop (return channel)
+// (reply = 1 - exchange with reply (RQ), 0 - one way (TX))
+uint8_t hop_next(hop_t *self, uint8_t reply);
+//-----------------------------------------------------------------------------
+// write hop header to payload tail (return 0 if payload is too small)
+uint8_t hop_stamp(const hop_t *self, uint8_t *data, uint8_t size);
+//-----------------------------------------------------------------------------
+// leader: account reply (RX ring subscriber, context = hop_t*)
+uint8_t hop_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+// follower: synchronize by received hop header (return 1 if synchronized)
+// (t = TIME_FUNC() of RX, period - leader hop period [ms])
+uint8_t hop_sync(hop_t *self, const uint8_t *data, uint8_t size,
+                 unsigned long t, uint32_t period);
+//-----------------------------------------------------------------------------
+// follower: go to next hop after exchange (return channel)
+uint8_t hop_follow(hop_t *self);
+//-----------------------------------------------------------------------------
+// follower: dead reckoning without packets (call from main loop)
+// (return 1 if channel changed => retune receiver)
+uint8_t hop_yield(hop_t *self, unsigned long t, uint32_t period);
+//-----------------------------------------------------------------------------
+// PER of channel for all time [%] (-1 if unknown)
+int8_t hop_per(const hop_t *self, uint8_t ch);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // HOP_H
+
+/*** end of "hop.h" file ***/
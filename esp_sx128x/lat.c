@@ -0,0 +1,111 @@
+/*
+ * Log-scale latency histograms (HDR histogram style, fixed memory)
+ * File: "lat.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include <stdio.h>  // snprintf()
+#include "lat.h"
+//-----------------------------------------------------------------------------
+// index of most significant bit (v > 0)
+static inline int lat_msb(uint32_t v)
+{
+  return 31 - __builtin_clz(v);
+}
+//-----------------------------------------------------------------------------
+// value to bin index (-1 if out of range)
+static int lat_index(uint32_t v)
+{
+  int msb, shift;
+  if (v < LAT_SUB) return (int) v;
+
+  msb = lat_msb(v);
+  if (msb > LAT_MSB_MAX) return -1;
+
+  shift = msb - LAT_SUB_BITS;
+  return ((shift + 1) << LAT_SUB_BITS) + (int) ((v >> shift) & (LAT_SUB - 1));
+}
+//-----------------------------------------------------------------------------
+// middle value of bin
+static uint32_t lat_value(int i)
+{
+  int shift;
+  if (i < LAT_SUB) return (uint32_t) i;
+
+  shift = (i >> LAT_SUB_BITS) - 1;
+  return ((uint32_t) (LAT_SUB + (i & (LAT_SUB - 1))) << shift) +
+         ((1UL << shift) >> 1);
+}
+//-----------------------------------------------------------------------------
+// clear histogram
+void lat_clear(lat_hist_t *h)
+{
+  memset((void*) h, 0, sizeof(lat_hist_t));
+}
+//-----------------------------------------------------------------------------
+// add value [us]
+void lat_add(lat_hist_t *h, uint32_t v)
+{
+  int i = lat_index(v);
+
+  if (h->cnt == 0 || v < h->min) h->min = v;
+  if (h->cnt == 0 || v > h->max) h->max = v;
+  h->cnt++;
+  h->sum += v;
+
+  if (i < 0) h->over++;
+  else       h->bin[i]++;
+}
+//-----------------------------------------------------------------------------
+// mean value [us] (0 if empty)
+uint32_t lat_mean(const lat_hist_t *h)
+{
+  if (h->cnt == 0) return 0;
+  return (uint32_t) (h->sum / h->cnt);
+}
+//-----------------------------------------------------------------------------
+// percentile [us] (p in 0.1% units: 500-median, 990-p99, 999-p99.9)
+uint32_t lat_percentile(const lat_hist_t *h, uint16_t p)
+{
+  uint32_t rank, acc = 0;
+  int i;
+
+  if (h->cnt == 0) return 0;
+  if (p > 1000) p = 1000;
+
+  rank = (uint32_t) (((uint64_t) h->cnt * p + 999) / 1000);
+  if (rank == 0) rank = 1;
+
+  for (i = 0; i < LAT_BINS; i++)
+  {
+    acc += h->bin[i];
+    if (rank <= acc)
+    {
+      uint32_t v = lat_value(i);
+      if (v < h->min) v = h->min;
+      if (v > h->max) v = h->max;
+      return v;
+    }
+  }
+
+  return h->max; // overflow
+}
+//-----------------------------------------------------------------------------
+// format "cnt=N min=.. p50=.. p90=.. p99=.. p999=.. max=.. mean=.." [us]
+int lat_format(const lat_hist_t *h, char *buf, size_t size)
+{
+  return snprintf(buf, size,
+                  "cnt=%lu min=%lu p50=%lu p90=%lu p99=%lu p999=%lu max=%lu mean=%lu",
+                  (unsigned long) h->cnt,
+                  (unsigned long) (h->cnt ? h->min : 0),
+                  (unsigned long) lat_percentile(h, 500),
+                  (unsigned long) lat_percentile(h, 900),
+                  (unsigned long) lat_percentile(h, 990),
+                  (unsigned long) lat_percentile(h, 999),
+                  (unsigned long) h->max,
+                  (unsigned long) lat_mean(h));
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "lat.c" file ***/
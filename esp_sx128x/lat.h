@@ -0,0 +1,64 @@
+/*
+ * Log-scale latency histograms (HDR histogram style, fixed memory)
+ * File: "lat.h"
+ */
+
+#pragma once
+#ifndef LAT_H
+#define LAT_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+//-----------------------------------------------------------------------------
+// bins: values 0...LAT_SUB-1 exactly, then LAT_SUB linear sub-bins
+// per power of 2 (relative error <= 1/LAT_SUB)
+#define LAT_SUB_BITS 3                    // 8 sub-bins => 12.5%
+#define LAT_SUB      (1 << LAT_SUB_BITS)
+#define LAT_MSB_MAX  25                   // maximal value ~2^26 us (67 s)
+#define LAT_BINS     ((LAT_MSB_MAX - LAT_SUB_BITS + 2) * LAT_SUB)
+//-----------------------------------------------------------------------------
+// latency histogram [us]
+typedef struct lat_hist_ {
+  uint32_t cnt;  // number of values
+  uint32_t over; // values out of range (more than ~2^26)
+  uint32_t min;  // minimal value [us]
+  uint32_t max;  // maximal value [us]
+  uint64_t sum;  // sum of values [us]
+  uint32_t bin[LAT_BINS];
+} lat_hist_t;
+//-----------------------------------------------------------------------------
+// latency histograms of radio link
+typedef struct lat_link_ {
+  lat_hist_t tx;   // TX start -> TxDone (TX airtime)
+  lat_hist_t turn; // RxDone -> TX start (responder turnaround)
+  lat_hist_t rtt;  // TX start -> RxDone (requester round trip)
+  lat_hist_t irq;  // DIO1 ISR -> IRQ handler in main loop
+} lat_link_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// clear histogram
+void lat_clear(lat_hist_t *h);
+//-----------------------------------------------------------------------------
+// add value [us]
+void lat_add(lat_hist_t *h, uint32_t v);
+//-----------------------------------------------------------------------------
+// mean value [us] (0 if empty)
+uint32_t lat_mean(const lat_hist_t *h);
+//-----------------------------------------------------------------------------
+// percentile [us] (p in 0.1% units: 500-median, 990-p99, 999-p99.9)
+uint32_t lat_percentile(const lat_hist_t *h, uint16_t p);
+//-----------------------------------------------------------------------------
+// format "cnt=N min=.. p50=.. p90=.. p99=.. p999=.. max=.. mean=.." [us]
+int lat_format(const lat_hist_t *h, char *buf, size_t size);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // LAT_H
+
+/*** end of "lat.h" file ***/
@@ -0,0 +1,394 @@
+/*
+ * Lightweight flooding relay (mesh): origin/sequence/TTL header, duplicate
+ * cache (hash set with LRU eviction), rebroadcast by random delay and CAD
+ * File: "mesh.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset(), memcpy()
+#include "mesh.h"
+//-----------------------------------------------------------------------------
+static void mesh_put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)  v;
+  p[1] = (uint8_t) (v >> 8);
+}
+//-----------------------------------------------------------------------------
+static uint16_t mesh_get16(const uint8_t *p)
+{
+  return (uint16_t) p[0] | ((uint16_t) p[1] << 8);
+}
+//-----------------------------------------------------------------------------
+// random number in [0, n) by xorshift32
+static uint32_t mesh_rand(mesh_t *self, uint32_t n)
+{
+  uint32_t x = self->rnd;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  self->rnd = x;
+  return n ? x % n : 0;
+}
+//-----------------------------------------------------------------------------
+// hash bucket of cache key (Fibonacci hashing)
+static uint8_t mesh_hash(uint32_t key)
+{
+  return (uint8_t) ((key * 2654435761u) >> 24) & (MESH_BUCKETS - 1);
+}
+//-----------------------------------------------------------------------------
+// unlink cache entry from LRU list
+static void mesh_lru_unlink(mesh_t *self, uint8_t i)
+{
+  mesh_dup_t *e = &self->dup[i];
+  if (e->prev != MESH_NIL) self->dup[e->prev].next = e->next;
+  else                     self->newest = e->next;
+  if (e->next != MESH_NIL) self->dup[e->next].prev = e->prev;
+  else                     self->oldest = e->prev;
+}
+//-----------------------------------------------------------------------------
+// link cache entry to LRU list as newest
+static void mesh_lru_push(mesh_t *self, uint8_t i)
+{
+  mesh_dup_t *e = &self->dup[i];
+  e->prev = MESH_NIL;
+  e->next = self->newest;
+  if (self->newest != MESH_NIL) self->dup[self->newest].prev = i;
+  else                          self->oldest = i;
+  self->newest = i;
+}
+//-----------------------------------------------------------------------------
+// unlink cache entry from hash bucket
+static void mesh_hash_unlink(mesh_t *self, uint8_t i)
+{
+  uint8_t *p = &self->bucket[mesh_hash(self->dup[i].key)];
+  while (*p != MESH_NIL)
+  {
+    if (*p == i)
+    {
+      *p = self->dup[i].hnext;
+      return;
+    }
+    p = &self->dup[*p].hnext;
+  }
+}
+//-----------------------------------------------------------------------------
+// relay queue entry of packet or MESH_NIL
+static uint8_t mesh_fwd_find(const mesh_t *self, uint32_t key)
+{
+  uint8_t i;
+  for (i = 0; i < MESH_QUEUE; i++)
+    if (self->fwd[i].used && self->fwd[i].key == key) return i;
+  return MESH_NIL;
+}
+//-----------------------------------------------------------------------------
+// CAD/TX state change
+static void mesh_state(mesh_t *self, uint8_t state, uint32_t t)
+{
+  self->state   = state;
+  self->t_state = t;
+}
+//-----------------------------------------------------------------------------
+// own packet done or dropped => next period (skip lost periods)
+static void mesh_own_next(mesh_t *self, uint32_t t)
+{
+  self->own_tries = 0;
+  self->next += self->period;
+  if ((int32_t) (t - self->next) >= 0) self->next = t + self->period;
+}
+//-----------------------------------------------------------------------------
+// init relay (address 1, default options, empty cache)
+void mesh_init(mesh_t *self)
+{
+  memset((void*) self, 0, sizeof(mesh_t));
+  self->addr  = 1;
+  self->ttl   = MESH_TTL;
+  self->relay = 1;
+  self->orig  = 1;
+  self->tries = MESH_TRIES;
+  self->supp  = MESH_SUPP;
+  self->delay = MESH_DELAY;
+  mesh_reset(self);
+}
+//-----------------------------------------------------------------------------
+// reset cache, queue, sequence and statistic (keep options)
+void mesh_reset(mesh_t *self)
+{
+  mesh_t opt = *self;
+  memset((void*) self, 0, sizeof(mesh_t));
+  self->active = opt.active;
+  self->addr   = opt.addr;
+  self->ttl    = opt.ttl;
+  self->relay  = opt.relay;
+  self->orig   = opt.orig;
+  self->tries  = opt.tries;
+  self->supp   = opt.supp;
+  self->delay  = opt.delay;
+  self->period = opt.period;
+  self->next   = opt.next;
+  self->rnd    = opt.rnd ? opt.rnd : 0x9E3779B9u;
+
+  memset((void*) self->bucket, MESH_NIL, sizeof(self->bucket));
+  self->newest = self->oldest = MESH_NIL;
+}
+//-----------------------------------------------------------------------------
+// check packet in duplicate cache: return 1 if seen (entry becomes newest),
+// else add it (oldest entry is evicted if cache is full) and return 0
+uint8_t mesh_seen(mesh_t *self, uint16_t origin, uint16_t seq)
+{
+  uint32_t key = ((uint32_t) origin << 16) | seq;
+  uint8_t h = mesh_hash(key), i;
+  mesh_dup_t *e;
+
+  for (i = self->bucket[h]; i != MESH_NIL; i = self->dup[i].hnext)
+    if (self->dup[i].key == key)
+    { // hit => newest
+      if (self->newest != i)
+      {
+        mesh_lru_unlink(self, i);
+        mesh_lru_push(self, i);
+      }
+      return 1;
+    }
+
+  if (self->used < MESH_CACHE)
+    i = self->used++; // free entry
+  else
+  { // evict least recently used
+    i = self->oldest;
+    mesh_lru_unlink(self, i);
+    mesh_hash_unlink(self, i);
+    self->evict++;
+  }
+
+  e = &self->dup[i];
+  e->key   = key;
+  e->hnext = self->bucket[h];
+  self->bucket[h] = i;
+  mesh_lru_push(self, i);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// start (FSM mode MS): `t` - local time [us], `period` - own packets
+// period [us] (used if `orig` is set)
+void mesh_begin(mesh_t *self, uint32_t t, uint32_t period)
+{
+  uint8_t i;
+
+  self->active = 1;
+  self->period = self->orig ? period : 0;
+  self->rnd   ^= t ^ ((uint32_t) self->addr * 2654435761u); // differ nodes
+  if (self->rnd == 0) self->rnd = 1;
+  self->next      = t + mesh_rand(self, self->period); // random phase
+  self->own_tries = 0;
+  mesh_state(self, MESH_IDLE, t);
+
+  for (i = 0; i < MESH_QUEUE; i++)
+    self->fwd[i].used = 0;
+}
+//-----------------------------------------------------------------------------
+// CAD must start at local time `t` [us] (call from main loop when radio is
+// in RX): return 1 if own or relay packet is due (state => MESH_CAD)
+uint8_t mesh_due(mesh_t *self, uint32_t t)
+{
+  uint8_t i, best = MESH_NIL;
+
+  if (!self->active) return 0;
+
+  if (self->state != MESH_IDLE)
+  { // CAD/TX in progress (IRQ lost => idle)
+    if (t - self->t_state < MESH_WDT) return 0;
+    self->wdt++;
+    mesh_state(self, MESH_IDLE, t);
+  }
+
+  if (self->period && (int32_t) (t - self->next) >= 0)
+    best = MESH_OWN;
+  else
+    for (i = 0; i < MESH_QUEUE; i++)
+    {
+      const mesh_fwd_t *f = &self->fwd[i];
+      if (f->used && (int32_t) (t - f->due) >= 0 &&
+          (best == MESH_NIL || (int32_t) (f->due - self->fwd[best].due) < 0))
+        best = i;
+    }
+
+  if (best == MESH_NIL) return 0;
+  self->cur = best;
+  mesh_state(self, MESH_CAD, t);
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// channel is free: return packet to send (own packet is stamped into `data`
+// of `*size`, relay packet is from queue, `*size` is updated) or NULL
+uint8_t *mesh_tx(mesh_t *self, uint8_t *data, uint8_t *size, uint32_t t)
+{
+  uint8_t *p;
+
+  if (self->state != MESH_CAD) return (uint8_t*) NULL;
+
+  if (self->cur != MESH_OWN)
+  { // rebroadcast
+    mesh_fwd_t *f = &self->fwd[self->cur];
+    if (!f->used)
+    { // suppressed in CAD
+      mesh_state(self, MESH_IDLE, t);
+      return (uint8_t*) NULL;
+    }
+    *size = self->size = f->size;
+    mesh_state(self, MESH_TX, t);
+    return f->data;
+  }
+
+  if (*size < MESH_HDR_SIZE)
+  { // no room for header => skip period
+    mesh_own_next(self, t);
+    mesh_state(self, MESH_IDLE, t);
+    return (uint8_t*) NULL;
+  }
+
+  p = data + *size - MESH_HDR_SIZE;
+  p[0] = MESH_MAGIC;
+  mesh_put16(p + 1, self->addr);
+  mesh_put16(p + 3, ++self->seq);
+  p[5] = self->ttl;
+  p[6] = 0;
+  mesh_seen(self, self->addr, self->seq);
+
+  self->size = *size;
+  mesh_state(self, MESH_TX, t);
+  return data;
+}
+//-----------------------------------------------------------------------------
+// channel is busy (CAD detected): random backoff or drop after `tries`
+void mesh_busy(mesh_t *self, uint32_t t)
+{
+  uint32_t due = t + 1 + mesh_rand(self, self->delay);
+
+  if (self->state != MESH_CAD) return;
+  mesh_state(self, MESH_IDLE, t);
+  self->busy++;
+
+  if (self->cur == MESH_OWN)
+  {
+    if (++self->own_tries < self->tries)
+      self->next = due;
+    else
+    { // skip this period
+      mesh_own_next(self, t);
+      self->drop++;
+    }
+  }
+  else
+  {
+    mesh_fwd_t *f = &self->fwd[self->cur];
+    if (!f->used) return; // suppressed in CAD
+    if (++f->tries < self->tries)
+      f->due = due;
+    else
+    {
+      f->used = 0;
+      self->drop++;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+// TX done or timeout at local time `t` [us], `toa` - time on air [us]
+void mesh_done(mesh_t *self, uint32_t t, uint32_t toa)
+{
+  if (self->state != MESH_TX) return;
+  mesh_state(self, MESH_IDLE, t);
+  self->air += toa;
+
+  if (self->cur == MESH_OWN)
+  {
+    mesh_own_next(self, t);
+    self->sent++;
+  }
+  else
+  {
+    self->fwd[self->cur].used = 0;
+    self->relayed++;
+  }
+}
+//-----------------------------------------------------------------------------
+// received packet with RxDone at local time `t` [us]: drop duplicate or
+// queue for rebroadcast (return 1 if packet has mesh header)
+uint8_t mesh_recv(mesh_t *self, const uint8_t *data, uint8_t size,
+                  uint32_t t)
+{
+  const uint8_t *p;
+  uint16_t origin, seq;
+  uint8_t i;
+  mesh_fwd_t *f;
+
+  if (!self->active || size < MESH_HDR_SIZE) return 0;
+  p = data + size - MESH_HDR_SIZE;
+  if (p[0] != MESH_MAGIC) return 0;
+
+  origin = mesh_get16(p + 1);
+  seq    = mesh_get16(p + 3);
+
+  if (origin == self->addr)
+  { // own packet from relay
+    self->echo++;
+    return 1;
+  }
+
+  if (mesh_seen(self, origin, seq))
+  { // duplicate => count copies of waiting relay
+    self->dups++;
+    i = mesh_fwd_find(self, ((uint32_t) origin << 16) | seq);
+    if (i != MESH_NIL && self->supp && ++self->fwd[i].heard >= self->supp &&
+        !(self->state == MESH_TX && self->cur == i))
+    {
+      self->fwd[i].used = 0;
+      self->supp_cnt++;
+    }
+    return 1;
+  }
+
+  self->rx++;
+  self->last_origin = origin;
+  self->last_seq    = seq;
+  self->last_hops   = p[6];
+
+  if (!self->relay) return 1;
+
+  if (p[5] == 0)
+  { // hop limit
+    self->expired++;
+    return 1;
+  }
+
+  for (i = 0; i < MESH_QUEUE && self->fwd[i].used; i++);
+  if (i == MESH_QUEUE)
+  {
+    self->full++;
+    return 1;
+  }
+
+  f = &self->fwd[i];
+  memcpy((void*) f->data, (const void*) data, size);
+  f->data[size - MESH_HDR_SIZE + 5] = (uint8_t) (p[5] - 1);
+  f->data[size - MESH_HDR_SIZE + 6] = (uint8_t) (p[6] < 255 ? p[6] + 1 : 255);
+  f->used  = 1;
+  f->size  = size;
+  f->heard = 1;
+  f->tries = 0;
+  f->key   = ((uint32_t) origin << 16) | seq;
+  f->due   = t + mesh_rand(self, self->delay);
+  self->queued++;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// RX ring subscriber (context = mesh_t*)
+uint8_t mesh_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  mesh_t *self = (mesh_t*) context;
+  if (pkt->rx.crc_ok) // end of packet on air (compensated RxDone)
+    mesh_recv(self, pkt->data, pkt->size, (uint32_t) (pkt->ts / 1000));
+  return 1;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "mesh.c" file ***/
@@ -0,0 +1,183 @@
+/*
+ * Lightweight flooding relay (mesh): origin/sequence/TTL header, duplicate
+ * cache (hash set with LRU eviction), rebroadcast by random delay and CAD
+ * File: "mesh.h"
+ */
+
+#pragma once
+#ifndef MESH_H
+#define MESH_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+// mesh header at the END of payload (little endian):
+//   [0]    - MESH_MAGIC
+//   [1..2] - origin address
+//   [3..4] - sequence number of origin
+//   [5]    - TTL (relays left, 0 - not relayed)
+//   [6]    - hops from origin (0 - received from origin)
+#define MESH_MAGIC    0x3E
+#define MESH_HDR_SIZE 7
+
+#ifndef MESH_CACHE
+#  define MESH_CACHE 32 // duplicate cache entries (LRU, less than 255)
+#endif
+
+#ifndef MESH_BUCKETS
+#  define MESH_BUCKETS 64 // duplicate cache hash buckets (power of 2)
+#endif
+
+#ifndef MESH_QUEUE
+#  define MESH_QUEUE 4 // relay queue (packets waiting rebroadcast)
+#endif
+
+#if (MESH_BUCKETS & (MESH_BUCKETS - 1)) != 0 || MESH_BUCKETS > 256
+#  error MESH_BUCKETS must be power of 2 and not more than 256
+#endif
+
+#if MESH_CACHE >= 255
+#  error MESH_CACHE must be less than 255
+#endif
+
+// options by default
+#define MESH_TTL        3 // relays of own packet
+#define MESH_DELAY  20000 // random rebroadcast/backoff window [us]
+#define MESH_TRIES      8 // CAD attempts before drop of packet
+#define MESH_SUPP       0 // cancel relay after N copies heard (0 - off)
+
+#define MESH_WDT  1000000 // CAD/TX without IRQ => idle [us]
+
+#define MESH_NIL  0xFF // no cache entry
+#define MESH_OWN  0xFE // own packet in CAD/TX (`cur`)
+
+// CAD/TX state
+#define MESH_IDLE 0 // receiver is on
+#define MESH_CAD  1 // channel activity detection before TX
+#define MESH_TX   2 // transmission
+//-----------------------------------------------------------------------------
+// duplicate cache entry
+typedef struct mesh_dup_ {
+  uint32_t key;   // origin << 16 | sequence
+  uint8_t  hnext; // next entry of hash bucket (MESH_NIL - last)
+  uint8_t  prev;  // newer entry (MESH_NIL - newest)
+  uint8_t  next;  // older entry (MESH_NIL - oldest)
+} mesh_dup_t;
+//-----------------------------------------------------------------------------
+// packet waiting rebroadcast
+typedef struct mesh_fwd_ {
+  uint8_t  used;  // 1 - entry is busy
+  uint8_t  size;  // payload size [bytes]
+  uint8_t  heard; // copies heard (suppression)
+  uint8_t  tries; // busy CAD results
+  uint32_t key;   // origin << 16 | sequence
+  uint32_t due;   // local time of next CAD [us]
+  uint8_t  data[RX_RING_DATA_SIZE]; // payload with header (TTL, hops updated)
+} mesh_fwd_t;
+//-----------------------------------------------------------------------------
+// mesh relay
+typedef struct mesh_ {
+  uint8_t  active;    // 1 - FSM mode MS is running
+
+  // options
+  uint16_t addr;      // own address (origin of own packets)
+  uint8_t  ttl;       // TTL of own packets
+  uint8_t  relay;     // 1 - rebroadcast packets of others
+  uint8_t  orig;      // 1 - send own packet every FSM period
+  uint8_t  tries;     // CAD attempts before drop
+  uint8_t  supp;      // cancel relay after N copies heard (0 - off)
+  uint32_t delay;     // random rebroadcast/backoff window [us]
+
+  // duplicate cache
+  mesh_dup_t dup[MESH_CACHE];
+  uint8_t  bucket[MESH_BUCKETS]; // first entry of hash bucket or MESH_NIL
+  uint8_t  newest, oldest;       // LRU list ends or MESH_NIL
+  uint8_t  used;                 // entries in use
+
+  // relay queue
+  mesh_fwd_t fwd[MESH_QUEUE];
+
+  // own packets
+  uint16_t seq;       // last sequence number
+  uint32_t period;    // period [us] (0 - no own packets)
+  uint32_t next;      // local time of next own CAD [us]
+  uint8_t  own_tries; // busy CAD results of own packet
+
+  // CAD/TX
+  uint8_t  state;     // MESH_IDLE, MESH_CAD, MESH_TX
+  uint8_t  cur;       // relay queue index or MESH_OWN
+  uint8_t  size;      // size of packet in TX [bytes]
+  uint32_t t_state;   // local time of state change [us]
+  uint32_t rnd;       // xorshift32 state
+
+  // last new packet
+  uint16_t last_origin;
+  uint16_t last_seq;
+  uint8_t  last_hops;
+
+  // statistic
+  uint32_t sent;      // own packets sent
+  uint32_t rx;        // new packets of others received
+  uint32_t dups;      // duplicates dropped
+  uint32_t echo;      // own packets heard from relays
+  uint32_t queued;    // packets queued for rebroadcast
+  uint32_t relayed;   // packets rebroadcasted
+  uint32_t expired;   // not relayed (TTL = 0)
+  uint32_t full;      // not relayed (queue is full)
+  uint32_t supp_cnt;  // relays canceled by copies heard
+  uint32_t busy;      // busy CAD results
+  uint32_t drop;      // packets dropped after `tries` busy CAD
+  uint32_t evict;     // cache entries evicted (LRU)
+  uint32_t wdt;       // CAD/TX without IRQ
+  uint64_t air;       // time on air of all TX [us]
+} mesh_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init relay (address 1, default options, empty cache)
+void mesh_init(mesh_t *self);
+//-----------------------------------------------------------------------------
+// reset cache, queue, sequence and statistic (keep options)
+void mesh_reset(mesh_t *self);
+//-----------------------------------------------------------------------------
+// check packet in duplicate cache: return 1 if seen (entry becomes newest),
+// else add it (oldest entry is evicted if cache is full) and return 0
+uint8_t mesh_seen(mesh_t *self, uint16_t origin, uint16_t seq);
+//-----------------------------------------------------------------------------
+// start (FSM mode MS): `t` - local time [us], `period` - own packets
+// period [us] (used if `orig` is set)
+void mesh_begin(mesh_t *self, uint32_t t, uint32_t period);
+//-----------------------------------------------------------------------------
+// CAD must start at local time `t` [us] (call from main loop when radio is
+// in RX): return 1 if own or relay packet is due (state => MESH_CAD)
+uint8_t mesh_due(mesh_t *self, uint32_t t);
+//-----------------------------------------------------------------------------
+// channel is free: return packet to send (own packet is stamped into `data`
+// of `*size`, relay packet is from queue, `*size` is updated) or NULL
+uint8_t *mesh_tx(mesh_t *self, uint8_t *data, uint8_t *size, uint32_t t);
+//-----------------------------------------------------------------------------
+// channel is busy (CAD detected): random backoff or drop after `tries`
+void mesh_busy(mesh_t *self, uint32_t t);
+//-----------------------------------------------------------------------------
+// TX done or timeout at local time `t` [us], `toa` - time on air [us]
+void mesh_done(mesh_t *self, uint32_t t, uint32_t toa);
+//-----------------------------------------------------------------------------
+// received packet with RxDone at local time `t` [us]: drop duplicate or
+// queue for rebroadcast (return 1 if packet has mesh header)
+uint8_t mesh_recv(mesh_t *self, const uint8_t *data, uint8_t size,
+                  uint32_t t);
+//-----------------------------------------------------------------------------
+// RX ring subscriber (context = mesh_t*)
+uint8_t mesh_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // MESH_H
+
+/*** end of "mesh.h" file ***/
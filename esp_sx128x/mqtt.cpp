@@ -10,6 +10,7 @@
 #include "config.h"
 #include "wifi.h"
 #include "mqtt.h"
+#include "print.h"
 #include "ca_root.h" // MQTT_ROOT_CA
 //-----------------------------------------------------------------------------
 // Possible values for PubSubClient state [-4...6] (look "PubSubClient.h")
@@ -33,6 +34,9 @@ static WiFiClientSecure mqtt_wifi;
 //-----------------------------------------------------------------------------
 // MQTT client class
 PubSubClient Mqtt;
+// RX packets uplink state
+static bool mqtt_rx_on = true;
+static uint32_t mqtt_rx_fail = 0;
 //-----------------------------------------------------------------------------
 // return state as string
 const char *mqtt_state(int state)
@@ -50,6 +54,7 @@ bool mqtt_connect(const char *host, uint16_t port,
   // set root CA
   mqtt_wifi.setCACert(mqtt_root_ca);
   
+  print_flush(); // deferred log and capture frame before direct output
   Serial.print("Trying MQTT connection to mqtts://");
   Serial.print(user);
   Serial.print(':');
@@ -62,6 +67,7 @@ bool mqtt_connect(const char *host, uint16_t port,
   Mqtt.setServer(host, port);
   //Mqtt.setCallback(mqtt_callback);
   Mqtt.setClient(mqtt_wifi);
+  Mqtt.setBufferSize(MQTT_BUFFER_SIZE); // RX packets up to 255 bytes
   
   //!!!Mqtt.setKeepAlive(60);
   //!!!Mqtt.setSocketTimeout(180)
@@ -101,6 +107,53 @@ void mqtt_disconnect()
   Mqtt.disconnect();
 }
 //-----------------------------------------------------------------------------
+void mqtt_rx_enable(bool enable)
+{
+  mqtt_rx_on = enable;
+}
+//-----------------------------------------------------------------------------
+bool mqtt_rx_enabled()
+{
+  return mqtt_rx_on;
+}
+//-----------------------------------------------------------------------------
+uint32_t mqtt_rx_fails()
+{
+  return mqtt_rx_fail;
+}
+//-----------------------------------------------------------------------------
+// publish received packet to MQTT_TOPIC "/rx" (RX ring subscriber)
+// message: "t=T mode=M crc=C rssi=R snr=S fei=F size=N data=HEX"
+// (rssi [dBm], snr [dB/4], fei [Hz], data as hex string)
+uint8_t mqtt_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  char msg[96 + RX_RING_DATA_SIZE * 2];
+  const sx128x_rx_t *rx = &pkt->rx;
+  int i, len;
+
+  // drop packet if uplink is off or no connection (never stall RX ring)
+  if (!mqtt_rx_on || !Mqtt.connected()) return 1;
+
+  len = snprintf(msg, sizeof(msg),
+                 "t=%lu mode=%u crc=%u rssi=-%u.%u snr=%d fei=%ld size=%u data=",
+                 pkt->t, (unsigned) pkt->mode, (unsigned) rx->crc_ok,
+                 (unsigned) (rx->rssi >> 1), (unsigned) (rx->rssi & 1) * 5,
+                 (int) rx->snr, (long) rx->fei, (unsigned) pkt->size);
+
+  for (i = 0; i < pkt->size; i++)
+  {
+    msg[len++] = hex[pkt->data[i] >> 4];
+    msg[len++] = hex[pkt->data[i] & 0xF];
+  }
+  msg[len] = '\0';
+
+  if (!Mqtt.publish(MQTT_TOPIC "/rx", (const uint8_t*) msg, len, false))
+    mqtt_rx_fail++;
+
+  return 1;
+}
+//-----------------------------------------------------------------------------
 
 /*** end of "mqtt.cpp" file ***/
 
@@ -7,6 +7,8 @@
 #ifndef MQTT_H
 #define NQTT_H
 //-----------------------------------------------------------------------------
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
 #ifdef __cplusplus
 #include <PubSubClient.h>
 extern PubSubClient Mqtt; // global variable
@@ -22,6 +24,12 @@ bool mqtt_reconnect(const char *id, const char *user, const char *key);
 bool mqtt_connected();
 void mqtt_disconnect();
 //-----------------------------------------------------------------------------
+// RX packets uplink (RX ring subscriber)
+void mqtt_rx_enable(bool enable);
+bool mqtt_rx_enabled();
+uint32_t mqtt_rx_fails(); // publish fails counter
+uint8_t mqtt_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,214 @@
+/*
+ * Neighbor table (open addressing hash by node address) with RSSI/SNR
+ * EWMA, last seen time and link quality (ETX) by ACK history
+ * File: "nbr.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "nbr.h"
+#include "mesh.h"   // MESH_MAGIC, MESH_HDR_SIZE
+//-----------------------------------------------------------------------------
+// home slot of address (Fibonacci hashing)
+static uint8_t nbr_hash(uint16_t addr)
+{
+  return (uint8_t) (((uint32_t) addr * 2654435761u) >> 24) & (NBR_SIZE - 1);
+}
+//-----------------------------------------------------------------------------
+// slot of address or free slot to insert (table is never full)
+static uint8_t nbr_slot(const nbr_t *self, uint16_t addr)
+{
+  uint8_t i = nbr_hash(addr);
+  while (self->ent[i].used && self->ent[i].addr != addr)
+    i = (i + 1) & (NBR_SIZE - 1);
+  return i;
+}
+//-----------------------------------------------------------------------------
+// free slot `i` by backward shift of next entries of probe chain
+// (no tombstones, lookup stays O(1))
+static void nbr_delete(nbr_t *self, uint8_t i)
+{
+  uint8_t j = i, h;
+
+  for (;;)
+  {
+    j = (j + 1) & (NBR_SIZE - 1);
+    if (!self->ent[j].used) break;
+    h = nbr_hash(self->ent[j].addr);
+    if (((j - h) & (NBR_SIZE - 1)) >= ((j - i) & (NBR_SIZE - 1)))
+    { // home slot is not in (i, j] => move entry to hole
+      self->ent[i] = self->ent[j];
+      i = j;
+    }
+  }
+
+  self->ent[i].used = 0;
+  self->num--;
+}
+//-----------------------------------------------------------------------------
+// push result to ACK history
+static void nbr_hist(nbr_ent_t *e, uint8_t ok)
+{
+  if (e->hist_n < NBR_HIST) e->hist_n++;
+  else                      e->acks -= (uint8_t) ((e->hist >> (NBR_HIST - 1)) & 1);
+  e->hist = (e->hist << 1) | (ok ? 1 : 0);
+  e->acks += ok ? 1 : 0;
+  if (ok) e->rx++;
+  else    e->lost++;
+}
+//-----------------------------------------------------------------------------
+// EWMA of signal sample `x` [1/16 dB]
+static int16_t nbr_ewma(int16_t avg, int16_t x)
+{
+  return (int16_t) (avg + ((int32_t) x - avg) / NBR_EWMA);
+}
+//-----------------------------------------------------------------------------
+// init neighbor table (empty, default timeout)
+void nbr_init(nbr_t *self)
+{
+  memset((void*) self, 0, sizeof(nbr_t));
+  self->timeout = NBR_TIMEOUT;
+}
+//-----------------------------------------------------------------------------
+// drop all neighbors and reset statistic (keep timeout)
+void nbr_reset(nbr_t *self)
+{
+  uint32_t timeout = self->timeout;
+  nbr_init(self);
+  self->timeout = timeout;
+}
+//-----------------------------------------------------------------------------
+// find neighbor by address (NULL if unknown), O(1)
+nbr_ent_t *nbr_find(nbr_t *self, uint16_t addr)
+{
+  nbr_ent_t *e = &self->ent[nbr_slot(self, addr)];
+  return e->used ? e : NULL;
+}
+//-----------------------------------------------------------------------------
+// account packet of neighbor `addr` with sequence number `seq` received at
+// local time `t` [ms]: signal EWMA, sequence gaps to ACK history; new
+// neighbor is added (silent or the oldest seen one is dropped if table is
+// full); return neighbor
+nbr_ent_t *nbr_update(nbr_t *self, uint16_t addr, uint16_t seq,
+                      const sx128x_rx_t *rx, uint32_t t)
+{
+  int16_t rssi = (int16_t) (-8 * (int16_t) rx->rssi); // -rssi/2 [dBm]
+  int16_t snr  = rx->lora ? (int16_t) (4 * rx->snr) : 0; // snr/4 [dB]
+  uint8_t i = nbr_slot(self, addr);
+  nbr_ent_t *e = &self->ent[i];
+
+  self->rx++;
+
+  if (!e->used)
+  { // new neighbor (rare path)
+    if (self->num >= NBR_MAX && nbr_expire(self, t) == 0)
+    { // drop the oldest seen
+      uint8_t j, old = 0;
+      for (j = 1; j < NBR_SIZE; j++)
+        if (self->ent[j].used &&
+            (!self->ent[old].used ||
+             (int32_t) (self->ent[j].seen - self->ent[old].seen) < 0))
+          old = j;
+      nbr_delete(self, old);
+      self->evict++;
+    }
+    i = nbr_slot(self, addr); // entries may be moved
+    e = &self->ent[i];
+    memset((void*) e, 0, sizeof(nbr_ent_t));
+    e->used = 1;
+    e->addr = addr;
+    e->seq  = seq;
+    e->rssi = rssi;
+    e->snr  = snr;
+    e->seen = t;
+    nbr_hist(e, 1);
+    self->num++;
+    self->added++;
+    return e;
+  }
+
+  e->rssi = nbr_ewma(e->rssi, rssi);
+  e->snr  = nbr_ewma(e->snr,  snr);
+  e->seen = t;
+
+  if (seq != e->seq)
+  {
+    uint16_t gap = (uint16_t) (seq - e->seq - 1); // lost packets
+    if (gap >= NBR_GAP_MAX)
+    { // long gap (or neighbor restart): history saturated by losses
+      e->hist   = 0;
+      e->hist_n = NBR_HIST;
+      e->acks   = 0;
+      if (gap < 0x8000) e->lost += gap;
+      self->restart++;
+    }
+    else
+      while (gap--) nbr_hist(e, 0);
+    nbr_hist(e, 1);
+    e->seq = seq;
+  }
+  return e;
+}
+//-----------------------------------------------------------------------------
+// add result of unicast exchange to ACK history of known neighbor
+// (`ok` = 1 - ACK received, 0 - no ACK)
+void nbr_ack(nbr_t *self, uint16_t addr, uint8_t ok)
+{
+  nbr_ent_t *e = nbr_find(self, addr);
+  if (e) nbr_hist(e, ok);
+}
+//-----------------------------------------------------------------------------
+// expected transmission count of link [1/100] by ACK history
+// (100 - perfect link, NBR_ETX_MAX - no ACKs)
+uint16_t nbr_etx(const nbr_ent_t *ent)
+{
+  uint32_t n = ent->hist_n, a = ent->acks, etx;
+  if (a == 0) return NBR_ETX_MAX;
+
+  // ETX = 1 / (df * dr), symmetric link: df = dr = acks / n
+  etx = (100 * n * n + a * a / 2) / (a * a);
+  return etx < NBR_ETX_MAX ? (uint16_t) etx : NBR_ETX_MAX;
+}
+//-----------------------------------------------------------------------------
+// drop neighbors silent for `timeout` at local time `t` [ms]
+// (return number of dropped neighbors)
+uint8_t nbr_expire(nbr_t *self, uint32_t t)
+{
+  uint8_t i = 0, cnt = 0;
+
+  if (self->timeout == 0) return 0;
+
+  while (i < NBR_SIZE)
+  {
+    nbr_ent_t *e = &self->ent[i];
+    if (e->used && t - e->seen >= self->timeout)
+    { // next entry may be shifted to this slot => check it again
+      nbr_delete(self, i);
+      self->expired++;
+      cnt++;
+    }
+    else
+      i++;
+  }
+  return cnt;
+}
+//-----------------------------------------------------------------------------
+// RX ring subscriber (context = nbr_t*): mesh packets from origin (hops = 0)
+uint8_t nbr_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  nbr_t *self = (nbr_t*) context;
+  const uint8_t *p;
+
+  if (!pkt->rx.crc_ok || pkt->size < MESH_HDR_SIZE) return 1;
+  p = pkt->data + pkt->size - MESH_HDR_SIZE; // mesh header at the end
+
+  if (p[0] == MESH_MAGIC && p[6] == 0)
+    nbr_update(self,
+               (uint16_t) p[1] | ((uint16_t) p[2] << 8), // origin
+               (uint16_t) p[3] | ((uint16_t) p[4] << 8), // sequence
+               &pkt->rx, (uint32_t) (pkt->ts / 1000000));
+  return 1;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "nbr.c" file ***/
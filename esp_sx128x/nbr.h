@@ -0,0 +1,102 @@
+/*
+ * Neighbor table (open addressing hash by node address) with RSSI/SNR
+ * EWMA, last seen time and link quality (ETX) by ACK history
+ * File: "nbr.h"
+ */
+
+#pragma once
+#ifndef NBR_H
+#define NBR_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+#ifndef NBR_SIZE
+#  define NBR_SIZE 32 // hash slots (power of 2, not more than 256)
+#endif
+
+#if (NBR_SIZE & (NBR_SIZE - 1)) != 0 || NBR_SIZE > 256 || NBR_SIZE < 4
+#  error NBR_SIZE must be power of 2 from 4 to 256
+#endif
+
+#define NBR_MAX (NBR_SIZE * 3 / 4) // neighbors in table (short probe chains)
+
+#define NBR_TIMEOUT 60000 // neighbor is lost after silence [ms] (by default)
+#define NBR_HIST       32 // ACK history window [packets]
+#define NBR_GAP_MAX    16 // bigger sequence jump => history of losses
+#define NBR_EWMA        8 // RSSI/SNR EWMA weight of new sample 1/N
+#define NBR_ETX_MAX 0xFFFF // ETX of link without ACKs [1/100]
+//-----------------------------------------------------------------------------
+// neighbor (slot of hash table)
+typedef struct nbr_ent_ {
+  uint8_t  used;   // 1 - slot is busy
+  uint8_t  hist_n; // valid bits of ACK history (up to NBR_HIST)
+  uint8_t  acks;   // ones in ACK history
+  uint16_t addr;   // node address (key)
+  uint16_t seq;    // last sequence number
+  int16_t  rssi;   // RSSI EWMA [1/16 dBm]
+  int16_t  snr;    // SNR EWMA [1/16 dB] (LoRa/Ranging, 0 - other)
+  uint32_t seen;   // local time of last packet [ms]
+  uint32_t hist;   // ACK history (bit 0 - last, 1 - ACK/packet received)
+  uint32_t rx;     // packets received
+  uint32_t lost;   // packets lost (sequence gaps, no ACK)
+} nbr_ent_t;
+//-----------------------------------------------------------------------------
+// neighbor table
+typedef struct nbr_ {
+  nbr_ent_t ent[NBR_SIZE]; // hash table (linear probing)
+  uint8_t  num;            // neighbors in table
+  uint32_t timeout;        // silence to drop neighbor [ms] (0 - never)
+
+  // statistic
+  uint32_t rx;      // packets accounted
+  uint32_t added;   // new neighbors
+  uint32_t expired; // neighbors dropped by timeout
+  uint32_t evict;   // neighbors dropped by full table (the oldest seen)
+  uint32_t restart; // sequence jumps (long gap or neighbor restart)
+} nbr_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init neighbor table (empty, default timeout)
+void nbr_init(nbr_t *self);
+//-----------------------------------------------------------------------------
+// drop all neighbors and reset statistic (keep timeout)
+void nbr_reset(nbr_t *self);
+//-----------------------------------------------------------------------------
+// find neighbor by address (NULL if unknown), O(1)
+nbr_ent_t *nbr_find(nbr_t *self, uint16_t addr);
+//-----------------------------------------------------------------------------
+// account packet of neighbor `addr` with sequence number `seq` received at
+// local time `t` [ms]: signal EWMA, sequence gaps to ACK history; new
+// neighbor is added (silent or the oldest seen one is dropped if table is
+// full); return neighbor
+nbr_ent_t *nbr_update(nbr_t *self, uint16_t addr, uint16_t seq,
+                      const sx128x_rx_t *rx, uint32_t t);
+//-----------------------------------------------------------------------------
+// add result of unicast exchange to ACK history of known neighbor
+// (`ok` = 1 - ACK received, 0 - no ACK)
+void nbr_ack(nbr_t *self, uint16_t addr, uint8_t ok);
+//-----------------------------------------------------------------------------
+// expected transmission count of link [1/100] by ACK history
+// (100 - perfect link, NBR_ETX_MAX - no ACKs)
+uint16_t nbr_etx(const nbr_ent_t *ent);
+//-----------------------------------------------------------------------------
+// drop neighbors silent for `timeout` at local time `t` [ms]
+// (return number of dropped neighbors)
+uint8_t nbr_expire(nbr_t *self, uint32_t t);
+//-----------------------------------------------------------------------------
+// RX ring subscriber (context = nbr_t*): mesh packets from origin (hops = 0)
+uint8_t nbr_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // NBR_H
+
+/*** end of "nbr.h" file ***/
@@ -0,0 +1,181 @@
+/*
+ * Bit-packed OOK code: generators (string, Barker, M-sequence), chip
+ * playback and timing jitter statistic
+ * File: "ook.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "ook.h"
+//-----------------------------------------------------------------------------
+const char * const ook_gen_string[OOK_GENS] = OOK_GEN_STRING;
+//-----------------------------------------------------------------------------
+// Barker codes (MSB first, "1" - carrier on)
+static const struct { uint8_t len; uint16_t code; } ook_barker_codes[] = {
+  {  2, 0x0002 }, // 10
+  {  3, 0x0006 }, // 110
+  {  4, 0x000D }, // 1101
+  {  5, 0x001D }, // 11101
+  {  7, 0x0072 }, // 1110010
+  { 11, 0x0712 }, // 11100010010
+  { 13, 0x1F35 }, // 1111100110101
+};
+//-----------------------------------------------------------------------------
+// Galois LFSR masks of primitive polynomials (degree 2..12)
+static const uint16_t ook_mseq_mask[OOK_MSEQ_MAX - OOK_MSEQ_MIN + 1] = {
+  0x0003, 0x0006, 0x000C, 0x0014, 0x0030, 0x0060, // 2..7
+  0x00B8, 0x0110, 0x0240, 0x0500, 0x0E08          // 8..12
+};
+//-----------------------------------------------------------------------------
+static void ook_put(ook_t *self, uint16_t i, uint8_t chip)
+{
+  uint8_t bit = (uint8_t) (0x80 >> (i & 7));
+  if (chip) self->bits[i >> 3] |=  bit;
+  else      self->bits[i >> 3] &= ~bit;
+}
+//-----------------------------------------------------------------------------
+// integer square root
+static uint32_t ook_isqrt(uint64_t x)
+{
+  uint64_t r = 0, bit = (uint64_t) 1 << 62;
+  while (bit > x) bit >>= 2;
+  while (bit)
+  {
+    if (x >= r + bit) { x -= r + bit; r = (r >> 1) + bit; }
+    else                r >>= 1;
+    bit >>= 2;
+  }
+  return (uint32_t) r;
+}
+//-----------------------------------------------------------------------------
+// init empty code
+void ook_init(ook_t *self)
+{
+  memset((void*) self, 0, sizeof(ook_t));
+  ook_stat_reset(self);
+}
+//-----------------------------------------------------------------------------
+// set code from "0"/"1" string (non '0' is '1'), return size [chips]
+uint16_t ook_set_str(ook_t *self, const char *str)
+{
+  uint16_t i;
+  for (i = 0; str[i] != '\0' && i < OOK_CHIPS; i++)
+    ook_put(self, i, str[i] != '0');
+  self->size = i;
+  self->gen  = OOK_GEN_STR;
+  self->arg  = 0;
+  return i;
+}
+//-----------------------------------------------------------------------------
+// set Barker code of length 2, 3, 4, 5, 7, 11 or 13 (return size or 0)
+uint16_t ook_barker(ook_t *self, uint8_t len)
+{
+  uint8_t i, j;
+  for (i = 0; i < sizeof(ook_barker_codes) / sizeof(ook_barker_codes[0]); i++)
+  {
+    if (ook_barker_codes[i].len != len) continue;
+    for (j = 0; j < len; j++)
+      ook_put(self, j, (ook_barker_codes[i].code >> (len - 1 - j)) & 1);
+    self->size = len;
+    self->gen  = OOK_GEN_BARKER;
+    self->arg  = len;
+    return len;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// set M-sequence of LFSR degree 2..12 (2^deg - 1 chips), return size or 0
+uint16_t ook_mseq(ook_t *self, uint8_t deg)
+{
+  uint16_t i, n, lfsr = 1, mask;
+
+  if (deg < OOK_MSEQ_MIN || deg > OOK_MSEQ_MAX) return 0;
+  mask = ook_mseq_mask[deg - OOK_MSEQ_MIN];
+  n = (uint16_t) ((1u << deg) - 1);
+
+  for (i = 0; i < n; i++)
+  {
+    uint8_t out = lfsr & 1;
+    ook_put(self, i, out);
+    lfsr >>= 1;
+    if (out) lfsr ^= mask;
+  }
+
+  self->size = n;
+  self->gen  = OOK_GEN_MSEQ;
+  self->arg  = deg;
+  return n;
+}
+//-----------------------------------------------------------------------------
+// make code by generator (str - for OOK_GEN_STR), return size or 0
+uint16_t ook_make(ook_t *self, uint8_t gen, uint8_t arg, const char *str)
+{
+  if (gen == OOK_GEN_BARKER) return ook_barker(self, arg);
+  if (gen == OOK_GEN_MSEQ)   return ook_mseq(self, arg);
+  return ook_set_str(self, str != (const char*) NULL ? str : "");
+}
+//-----------------------------------------------------------------------------
+// print chips [from, from + size) to string of size + 1 bytes
+// (return number of chips)
+uint16_t ook_str(const ook_t *self, char *str, uint16_t size, uint16_t from)
+{
+  uint16_t i;
+  for (i = 0; i < size && from + i < self->size; i++)
+    str[i] = ook_chip(self, from + i) ? '1' : '0';
+  str[i] = '\0';
+  return i;
+}
+//-----------------------------------------------------------------------------
+// start playback: first chip at `t` [us], chip time [us]
+void ook_begin(ook_t *self, uint32_t t, uint32_t chip)
+{
+  self->pos  = 0;
+  self->chip = chip;
+  self->t0   = t;
+  self->done = 0;
+  self->run  = 1;
+}
+//-----------------------------------------------------------------------------
+// chip edge at `t` [us]: account jitter and return next chip {0|1}
+// or OOK_END if code finished (timer sets `done` after carrier off)
+int8_t ook_next(ook_t *self, uint32_t t)
+{
+  int32_t j;
+
+  if (!self->run) return OOK_END;
+
+  // scheduled edges are t0 + k * chip (wrap safe by signed difference)
+  j = (int32_t) (t - self->t0 - (uint32_t) (self->pos + 1) * self->chip);
+  if (j < self->jmin) self->jmin = j;
+  if (j > self->jmax) self->jmax = j;
+  self->jsum  += j;
+  self->jsum2 += (uint64_t) ((int64_t) j * j);
+  self->n++;
+
+  if (++self->pos >= self->size)
+  {
+    self->run = 0;
+    return OOK_END;
+  }
+
+  return (int8_t) ook_chip(self, self->pos);
+}
+//-----------------------------------------------------------------------------
+// reset jitter statistic
+void ook_stat_reset(ook_t *self)
+{
+  self->n     = 0;
+  self->jmin  = INT32_MAX;
+  self->jmax  = INT32_MIN;
+  self->jsum  = 0;
+  self->jsum2 = 0;
+}
+//-----------------------------------------------------------------------------
+// RMS of jitter [us] (0 if no data)
+uint32_t ook_rms(const ook_t *self)
+{
+  return self->n ? ook_isqrt(self->jsum2 / self->n) : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "ook.c" file ***/
@@ -0,0 +1,112 @@
+/*
+ * Bit-packed OOK code: generators (string, Barker, M-sequence), chip
+ * playback and timing jitter statistic
+ * File: "ook.h"
+ */
+
+#pragma once
+#ifndef OOK_H
+#define OOK_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+//-----------------------------------------------------------------------------
+#ifndef INLINE
+#  define INLINE static inline
+#endif
+//-----------------------------------------------------------------------------
+#ifndef OOK_CHIPS
+#  define OOK_CHIPS 4096 // maximal code size [chips] (M-sequence of degree 12)
+#endif
+
+#define OOK_CHIP_MIN   100 // minimal chip time by hardware timer [us]
+#define OOK_MSEQ_MIN     2 // minimal M-sequence degree
+#define OOK_MSEQ_MAX    12 // maximal M-sequence degree (4095 chips)
+
+#define OOK_END (-1) // ook_next(): code finished
+//-----------------------------------------------------------------------------
+// code generators (saved to options)
+typedef enum {
+  OOK_GEN_STR = 0, // "0"/"1" string
+  OOK_GEN_BARKER,  // Barker code (arg - length: 2, 3, 4, 5, 7, 11, 13)
+  OOK_GEN_MSEQ,    // maximum length sequence (arg - LFSR degree 2..12)
+  OOK_GENS         // number of generators
+} ook_gen_t;
+
+#define OOK_GEN_STRING { "str", "barker", "mseq" }
+//-----------------------------------------------------------------------------
+extern const char * const ook_gen_string[OOK_GENS];
+//-----------------------------------------------------------------------------
+// OOK code with playback state and jitter statistic
+typedef struct ook_ {
+  uint8_t  bits[(OOK_CHIPS + 7) / 8]; // chips (MSB first)
+  uint16_t size;                      // code size [chips]
+  uint8_t  gen;                       // generator (OOK_GEN_STR, ...)
+  uint8_t  arg;                       // argument of generator
+
+  // playback (may run in timer task context)
+  volatile uint8_t run;  // 1 - code is playing
+  volatile uint8_t done; // 1 - code finished by timer (FSM waits it)
+  uint16_t pos;          // current chip
+  uint32_t chip;         // chip time [us]
+  uint32_t t0;           // start of first chip [us]
+
+  // jitter of chip edges (actual - scheduled) [us]
+  uint32_t n;      // measured edges
+  int32_t  jmin;   // minimal jitter
+  int32_t  jmax;   // maximal jitter
+  int64_t  jsum;   // sum of jitter
+  uint64_t jsum2;  // sum of squared jitter
+} ook_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init empty code
+void ook_init(ook_t *self);
+//-----------------------------------------------------------------------------
+// set code from "0"/"1" string (non '0' is '1'), return size [chips]
+uint16_t ook_set_str(ook_t *self, const char *str);
+//-----------------------------------------------------------------------------
+// set Barker code of length 2, 3, 4, 5, 7, 11 or 13 (return size or 0)
+uint16_t ook_barker(ook_t *self, uint8_t len);
+//-----------------------------------------------------------------------------
+// set M-sequence of LFSR degree 2..12 (2^deg - 1 chips), return size or 0
+uint16_t ook_mseq(ook_t *self, uint8_t deg);
+//-----------------------------------------------------------------------------
+// make code by generator (str - for OOK_GEN_STR), return size or 0
+uint16_t ook_make(ook_t *self, uint8_t gen, uint8_t arg, const char *str);
+//-----------------------------------------------------------------------------
+// get chip `i` {0|1}
+INLINE uint8_t ook_chip(const ook_t *self, uint16_t i)
+{
+  return (self->bits[i >> 3] >> (7 - (i & 7))) & 1;
+}
+//-----------------------------------------------------------------------------
+// print chips [from, from + size) to string of size + 1 bytes
+// (return number of chips)
+uint16_t ook_str(const ook_t *self, char *str, uint16_t size, uint16_t from);
+//-----------------------------------------------------------------------------
+// start playback: first chip at `t` [us], chip time [us]
+void ook_begin(ook_t *self, uint32_t t, uint32_t chip);
+//-----------------------------------------------------------------------------
+// chip edge at `t` [us]: account jitter and return next chip {0|1}
+// or OOK_END if code finished (timer sets `done` after carrier off)
+int8_t ook_next(ook_t *self, uint32_t t);
+//-----------------------------------------------------------------------------
+// reset jitter statistic
+void ook_stat_reset(ook_t *self);
+//-----------------------------------------------------------------------------
+// RMS of jitter [us] (0 if no data)
+uint32_t ook_rms(const ook_t *self);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // OOK_H
+
+/*** end of "ook.h" file ***/
@@ -0,0 +1,84 @@
+/*
+ * OOK chip timer by ESP32 high resolution timer (esp_timer)
+ * File: "ook_timer.cpp"
+ */
+
+//-----------------------------------------------------------------------------
+#include "esp_timer.h"
+#include "ook_timer.h"
+#include "global.h"
+//-----------------------------------------------------------------------------
+static esp_timer_handle_t OokTimer = NULL;
+static volatile uint8_t   OokBusy  = 0; // callback uses radio now {0|1}
+static uint8_t            OokOn    = 0; // carrier state {0|1}
+//-----------------------------------------------------------------------------
+// chip edge (esp_timer task): next chip or carrier off at code end
+static void ook_timer_cb(void *arg)
+{
+  int8_t chip;
+
+  // stop is waiting while radio is in use (see ook_timer(0))
+  OokBusy = 1;
+  __sync_synchronize();
+
+  if (Ook.run)
+  {
+    chip = ook_next(&Ook, (uint32_t) esp_timer_get_time());
+
+    if (chip == OOK_END)
+    { // last chip finished
+      esp_timer_stop(OokTimer);
+      if (OokOn) sx128x_standby(&Radio, SX128X_STANDBY_RC);
+      OokOn = 0;
+      Ook.done = 1; // FSM goes to sleep
+    }
+    else if (chip != OokOn)
+    {
+      if (chip) sx128x_tx_wave(&Radio);
+      else      sx128x_standby(&Radio, SX128X_STANDBY_RC);
+      OokOn = chip;
+    }
+  }
+
+  __sync_synchronize();
+  OokBusy = 0;
+}
+//-----------------------------------------------------------------------------
+// start chips of global `Ook` from second one with period `us` (first chip
+// is already on air), us = 0 - stop (FSM chip timer, look AFsm::chip_timer())
+int8_t ook_timer(uint32_t us)
+{
+  if (OokTimer == NULL)
+  {
+    esp_timer_create_args_t args = {}; // don't skip late alarms (chip grid)
+    args.callback        = ook_timer_cb;
+    args.arg             = NULL;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name            = "ook";
+    if (esp_timer_create(&args, &OokTimer) != ESP_OK)
+    {
+      OokTimer = NULL;
+      return SX128X_ERR_BAD_CALL;
+    }
+  }
+
+  if (us == 0)
+  { // stop: callback may be in SPI exchange on other core
+    Ook.run = 0;
+    __sync_synchronize();
+    while (OokBusy);
+    esp_timer_stop(OokTimer); // may be stopped already
+    return SX128X_ERR_NONE;
+  }
+
+  esp_timer_stop(OokTimer);
+  OokOn = ook_chip(&Ook, 0);
+  ook_begin(&Ook, (uint32_t) esp_timer_get_time(), us);
+
+  // periodic alarms are scheduled from previous alarm (no drift)
+  return esp_timer_start_periodic(OokTimer, us) == ESP_OK ?
+         SX128X_ERR_NONE : SX128X_ERR_BAD_CALL;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "ook_timer.cpp" file ***/
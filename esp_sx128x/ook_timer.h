@@ -0,0 +1,27 @@
+/*
+ * OOK chip timer by ESP32 high resolution timer (esp_timer)
+ * File: "ook_timer.h"
+ */
+
+#pragma once
+#ifndef OOK_TIMER_H
+#define OOK_TIMER_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// start chips of global `Ook` from second one with period `us` (first chip
+// is already on air), us = 0 - stop (FSM chip timer, look AFsm::chip_timer())
+int8_t ook_timer(uint32_t us);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // OOK_TIMER_H
+
+/*** end of "ook_timer.h" file ***/
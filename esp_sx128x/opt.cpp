@@ -42,10 +42,15 @@ void opt_default(opt_t *opt)
   opt->code_size = sizeof(code);
   memcpy((void*) opt->code, (const void*) code, sizeof(code));
   opt->code[sizeof(code)] = '\0';
+  opt->code_gen = OOK_GEN_STR; // use `code`
+  opt->code_arg = 0;
   
   // FSM options
   memcpy((void*) &opt->fsm, (const void*) &afsm_pars_default,
          sizeof(afsm_pars_t));
+
+  // ranging anchors (positioning off)
+  pos_list_default(&opt->pos);
   
   opt->autostart = OPT_AUTOSTART; // auto start FSM TX on reboot
   opt->delay = OPT_AUTOSTART_DELAY; // auto start delay [sec]
@@ -60,8 +60,12 @@ typedef struct {
 
   char code[OPT_CODE_SIZE + 1]; // OOK code (like "100101")
   uint8_t code_size;            // OOK code size (chips) = strlen(code)
+  uint8_t code_gen;             // OOK code generator (OOK_GEN_STR, ...)
+  uint8_t code_arg;             // argument of generator (length, degree)
 
   afsm_pars_t fsm;              // FSM options
+
+  pos_list_t pos;               // ranging anchors (FSM mode RM)
   
   uint8_t autostart; // auto start FSM TX on reboot {0|1}
   uint32_t delay;    // auto start delay [sec]
@@ -0,0 +1,215 @@
+/*
+ * Packet Error Rate (PER) tester: sequence-numbered payloads, RX windows
+ * File: "per.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include <stdio.h>  // snprintf()
+#include "per.h"
+//-----------------------------------------------------------------------------
+// increment counter of current window and total
+#define PER_INC(self, field) do { (self)->cur.field++; (self)->total.field++; } while (0)
+//-----------------------------------------------------------------------------
+static void per_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)  v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+//-----------------------------------------------------------------------------
+static uint32_t per_get32(const uint8_t *p)
+{
+  return ((uint32_t) p[0]      ) | ((uint32_t) p[1] <<  8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+static void per_win_clear(per_win_t *w, uint32_t n)
+{
+  memset((void*) w, 0, sizeof(per_win_t));
+  w->n = n;
+}
+//-----------------------------------------------------------------------------
+// account unique packet in window
+static void per_win_rx(per_win_t *w, const sx128x_rx_t *rx)
+{
+  if (w->rx == 0 || rx->rssi < w->rssi_min) w->rssi_min = rx->rssi;
+  if (w->rx == 0 || rx->rssi > w->rssi_max) w->rssi_max = rx->rssi;
+  w->rssi_sum += rx->rssi;
+  if (rx->lora)
+  {
+    w->snr_sum += rx->snr;
+    w->snr_cnt++;
+  }
+  w->rx++;
+}
+//-----------------------------------------------------------------------------
+// current jitter estimate [us]
+static uint32_t per_jitter_us(const per_t *self)
+{
+  return (uint32_t) (((uint64_t) (self->jitter >> 4) * 1000) / TIME_FACTOR);
+}
+//-----------------------------------------------------------------------------
+// account unique packet (in order => update jitter)
+static void per_recv(per_t *self, const rx_pkt_t *pkt, uint32_t t_tx,
+                     uint8_t in_order)
+{
+  if (in_order)
+  { // interarrival jitter (RFC 3550, 6.4.1): J += (|D| - J) / 16
+    int32_t d = (int32_t) (((uint32_t) pkt->t - self->t_rx) - (t_tx - self->t_tx));
+    uint32_t ad = (uint32_t) (d < 0 ? -d : d);
+    self->jitter += ad - ((self->jitter + 8) >> 4);
+  }
+  self->t_tx = t_tx;
+  self->t_rx = (uint32_t) pkt->t;
+
+  per_win_rx(&self->cur,   &pkt->rx);
+  per_win_rx(&self->total, &pkt->rx);
+}
+//-----------------------------------------------------------------------------
+// resynchronize by first packet or transmitter restart
+static void per_sync(per_t *self, uint32_t seq)
+{
+  self->seq_valid = 1;
+  self->seq_max   = seq;
+  self->seen      = 1;
+}
+//-----------------------------------------------------------------------------
+// init PER tester (off, default window)
+void per_init(per_t *self)
+{
+  self->on     = 0;
+  self->window = PER_WINDOW;
+  per_reset(self);
+}
+//-----------------------------------------------------------------------------
+// reset TX sequence, RX state and all windows
+void per_reset(per_t *self)
+{
+  self->tx_seq    = 0;
+  self->seq_valid = 0;
+  self->seq_max   = 0;
+  self->seen      = 0;
+  self->t_tx      = 0;
+  self->t_rx      = 0;
+  self->jitter    = 0;
+  self->ready     = 0;
+  per_win_clear(&self->cur,   0);
+  per_win_clear(&self->last,  0);
+  per_win_clear(&self->total, 0);
+}
+//-----------------------------------------------------------------------------
+// stamp TX payload by header (return 0 if payload is too small)
+uint8_t per_stamp(per_t *self, uint8_t *data, uint8_t size, unsigned long t)
+{
+  if (size < PER_HDR_SIZE) return 0;
+  data[0] = PER_MAGIC;
+  per_put32(data + 1, self->tx_seq++);
+  per_put32(data + 5, (uint32_t) t);
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// account received packet (RX ring subscriber, context = per_t*)
+uint8_t per_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  per_t *self = (per_t*) context;
+  uint32_t seq, t_tx, d;
+
+  if (!self->on) return 1;
+
+  if (!pkt->rx.crc_ok)
+  {
+    PER_INC(self, crc_err);
+    return 1;
+  }
+
+  if (pkt->size < PER_HDR_SIZE || pkt->data[0] != PER_MAGIC)
+    return 1; // foreign packet
+
+  seq  = per_get32(pkt->data + 1);
+  t_tx = per_get32(pkt->data + 5);
+
+  if (!self->seq_valid)
+  { // first packet
+    per_sync(self, seq);
+    per_recv(self, pkt, t_tx, 0);
+  }
+  else if ((d = seq - self->seq_max) == 0)
+  { // same as last
+    PER_INC(self, dup);
+  }
+  else if (d < 0x80000000ul)
+  { // new packet (d-1 lost before it)
+    self->cur.lost   += d - 1;
+    self->total.lost += d - 1;
+    self->seen = d >= PER_HISTORY ? 1 : (self->seen << d) | 1;
+    self->seq_max = seq;
+    per_recv(self, pkt, t_tx, 1);
+  }
+  else if ((d = -d) >= PER_HISTORY)
+  { // far in the past => transmitter restarted
+    per_sync(self, seq);
+    per_recv(self, pkt, t_tx, 0);
+  }
+  else if (self->seen & ((uint64_t) 1 << d))
+  { // already received
+    PER_INC(self, dup);
+  }
+  else
+  { // late packet (was counted as lost)
+    self->seen |= (uint64_t) 1 << d;
+    PER_INC(self, reorder);
+    if (self->cur.lost)   self->cur.lost--;
+    if (self->total.lost) self->total.lost--;
+    per_recv(self, pkt, t_tx, 0);
+  }
+
+  // close window
+  if (self->cur.rx + self->cur.lost >= self->window)
+  {
+    self->cur.jitter = self->total.jitter = per_jitter_us(self);
+    self->last = self->cur;
+    self->ready = 1;
+    self->total.n = self->cur.n + 1;
+    per_win_clear(&self->cur, self->total.n);
+  }
+
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// Packet Error Rate of window [0.1%] (-1 if empty)
+int16_t per_rate(const per_win_t *w)
+{
+  uint32_t all = w->rx + w->lost;
+  if (all == 0) return -1;
+  return (int16_t) (((uint64_t) w->lost * 1000 + all / 2) / all);
+}
+//-----------------------------------------------------------------------------
+// format "win=N rx=.. lost=.. dup=.. reord=.. crc=.. per=..%
+//         rssi=best/mean/worst snr=.. jitter=..us" (one line without EOL)
+int per_format(const per_win_t *w, char *buf, size_t size)
+{
+  int16_t  per = per_rate(w);
+  uint32_t rssi = w->rx ? // [0.1 dB]
+    (uint32_t) (((uint64_t) w->rssi_sum * 5 + w->rx / 2) / w->rx) : 0;
+  int32_t  snr  = w->snr_cnt ? // [0.1 dB]
+    (int32_t) (((int64_t) w->snr_sum * 10 / 4) / (int64_t) w->snr_cnt) : 0;
+  uint32_t asnr = (uint32_t) (snr < 0 ? -snr : snr);
+
+  return snprintf(buf, size,
+    "win=%lu rx=%lu lost=%lu dup=%lu reord=%lu crc=%lu per=%d.%d%% "
+    "rssi=-%u.%u/-%lu.%lu/-%u.%u snr=%s%lu.%lu jitter=%luus",
+    (unsigned long) w->n, (unsigned long) w->rx, (unsigned long) w->lost,
+    (unsigned long) w->dup, (unsigned long) w->reorder,
+    (unsigned long) w->crc_err,
+    per < 0 ? 0 : per / 10, per < 0 ? 0 : per % 10,
+    (unsigned) (w->rssi_min >> 1), (unsigned) (w->rssi_min & 1) * 5,
+    (unsigned long) (rssi / 10), (unsigned long) (rssi % 10),
+    (unsigned) (w->rssi_max >> 1), (unsigned) (w->rssi_max & 1) * 5,
+    snr < 0 ? "-" : "", (unsigned long) (asnr / 10), (unsigned long) (asnr % 10),
+    (unsigned long) w->jitter);
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "per.c" file ***/
@@ -0,0 +1,96 @@
+/*
+ * Packet Error Rate (PER) tester: sequence-numbered payloads, RX windows
+ * File: "per.h"
+ */
+
+#pragma once
+#ifndef PER_H
+#define PER_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+// PER test payload header (little endian):
+//   [0]    - PER_MAGIC
+//   [1..4] - sequence number (32 bit)
+//   [5..8] - TX timestamp (TIME_FUNC() at TX start)
+#define PER_MAGIC     0xA5
+#define PER_HDR_SIZE  9
+
+#ifndef PER_WINDOW
+#  define PER_WINDOW 100 // default window [expected packets]
+#endif
+
+#define PER_HISTORY 64 // sequence bitmap depth (duplicate/reorder check)
+//-----------------------------------------------------------------------------
+// statistic of one window
+typedef struct per_win_ {
+  uint32_t n;        // window number (0, 1, 2...)
+  uint32_t rx;       // received unique packets
+  uint32_t lost;     // lost packets (sequence gaps)
+  uint32_t dup;      // duplicated packets
+  uint32_t reorder;  // reordered (late) packets
+  uint32_t crc_err;  // CRC errors
+  uint8_t  rssi_min; // best RSSI = -rssi_min/2 [dBm]
+  uint8_t  rssi_max; // worst RSSI = -rssi_max/2 [dBm]
+  uint32_t rssi_sum; // sum of RSSI (-dBm*2)
+  int32_t  snr_sum;  // sum of SNR [dB/4] (LoRa/Ranging)
+  uint32_t snr_cnt;  // number of SNR values
+  uint32_t jitter;   // RX jitter estimate at window end [us] (RFC 3550)
+} per_win_t;
+//-----------------------------------------------------------------------------
+// PER tester
+typedef struct per_ {
+  uint8_t  on;        // 1 - stamp TX packets and account RX packets
+  uint32_t window;    // window size [expected packets]
+
+  // TX side
+  uint32_t tx_seq;    // next TX sequence number
+
+  // RX side
+  uint8_t  seq_valid; // 1 - `seq_max` is valid
+  uint32_t seq_max;   // highest received sequence number
+  uint64_t seen;      // bitmap of received seq_max, seq_max-1,...
+  uint32_t t_tx;      // TX timestamp of last packet
+  uint32_t t_rx;      // RX time of last packet
+  uint32_t jitter;    // jitter estimate * 16 [TIME_FUNC() units]
+
+  per_win_t cur;      // current window
+  per_win_t last;     // last closed window
+  per_win_t total;    // all windows from reset
+  uint8_t   ready;    // 1 - `last` is closed and not reported yet
+} per_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init PER tester (off, default window)
+void per_init(per_t *self);
+//-----------------------------------------------------------------------------
+// reset TX sequence, RX state and all windows
+void per_reset(per_t *self);
+//-----------------------------------------------------------------------------
+// stamp TX payload by header (return 0 if payload is too small)
+uint8_t per_stamp(per_t *self, uint8_t *data, uint8_t size, unsigned long t);
+//-----------------------------------------------------------------------------
+// account received packet (RX ring subscriber, context = per_t*)
+uint8_t per_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+// Packet Error Rate of window [0.1%] (-1 if empty)
+int16_t per_rate(const per_win_t *w);
+//-----------------------------------------------------------------------------
+// format "win=N rx=.. lost=.. dup=.. reord=.. crc=.. per=..%
+//         rssi=best/mean/worst snr=.. jitter=..us" (one line without EOL)
+int per_format(const per_win_t *w, char *buf, size_t size);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // PER_H
+
+/*** end of "per.h" file ***/
@@ -0,0 +1,157 @@
+/*
+ * Ping-pong RTT benchmark (requester/responder with echoed timestamps)
+ * File: "ping.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memcpy()
+#include <stdio.h>  // snprintf()
+#include "ping.h"
+//-----------------------------------------------------------------------------
+const char * const ping_mode_string[PING_MODES] = {
+  "GFSK", "LoRa", "Ranging", "FLRC", "BLE" };
+//-----------------------------------------------------------------------------
+static void ping_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)  v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+//-----------------------------------------------------------------------------
+static uint32_t ping_get32(const uint8_t *p)
+{
+  return ((uint32_t) p[0]      ) | ((uint32_t) p[1] <<  8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+// init ping benchmark (off, fixed rate)
+void ping_init(ping_t *self)
+{
+  self->on    = 0;
+  self->flood = 0;
+  ping_reset(self);
+}
+//-----------------------------------------------------------------------------
+// reset sequence and results of all modems
+void ping_reset(ping_t *self)
+{
+  int i;
+  self->seq     = 0;
+  self->wait    = 0;
+  self->pending = 0;
+  self->t_valid = 0;
+  self->t       = 0;
+  self->req_size = 0;
+  for (i = 0; i < PING_MODES; i++)
+  {
+    ping_res_t *res = &self->res[i];
+    res->sent = 0;
+    res->recv = 0;
+    res->late = 0;
+    res->time = 0;
+    lat_clear(&res->rtt);
+  }
+}
+//-----------------------------------------------------------------------------
+// stamp request payload (requester, return 0 if payload is too small)
+uint8_t ping_stamp(ping_t *self, uint8_t mode, uint8_t *data, uint8_t size,
+                   unsigned long t)
+{
+  ping_res_t *res;
+  if (size < PING_HDR_SIZE || mode >= PING_MODES) return 0;
+  res = &self->res[mode];
+
+  if (self->t_valid && res->sent)
+    res->time += (uint32_t) (t - self->t); // wrap safe
+  self->t       = t;
+  self->t_valid = 1;
+
+  self->wait    = self->seq;
+  self->pending = 1;
+  res->sent++;
+
+  data[0] = PING_MAGIC_REQ;
+  ping_put32(data + 1, self->seq++);
+  ping_put32(data + 5, (uint32_t) t);
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// save header of received packet if it is request (responder, on RX done)
+// (return 1 if packet is request)
+uint8_t ping_request(ping_t *self, const uint8_t *rx, uint8_t rx_size)
+{
+  self->req_size = 0;
+  if (rx_size < PING_HDR_SIZE || rx[0] != PING_MAGIC_REQ) return 0;
+  memcpy((void*) self->req, (const void*) rx, PING_HDR_SIZE);
+  self->req_size = PING_HDR_SIZE;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// copy received request header to reply payload (responder, before reply)
+// (return 1 if request is echoed)
+uint8_t ping_echo(const uint8_t *rx, uint8_t rx_size,
+                  uint8_t *tx, uint8_t tx_size)
+{
+  if (rx_size < PING_HDR_SIZE || tx_size < PING_HDR_SIZE ||
+      rx[0] != PING_MAGIC_REQ) return 0;
+  tx[0] = PING_MAGIC_REP;
+  memcpy((void*) (tx + 1), (const void*) (rx + 1), PING_HDR_SIZE - 1);
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// account reply (requester RX ring subscriber, context = ping_t*)
+uint8_t ping_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  ping_t *self = (ping_t*) context;
+  ping_res_t *res;
+  uint32_t seq, t;
+
+  if (!self->on || !pkt->rx.crc_ok || pkt->mode >= PING_MODES ||
+      pkt->size < PING_HDR_SIZE || pkt->data[0] != PING_MAGIC_REP)
+    return 1; // not a reply
+
+  res = &self->res[pkt->mode];
+  seq = ping_get32(pkt->data + 1);
+  t   = ping_get32(pkt->data + 5);
+
+  if (self->pending && seq == self->wait)
+  {
+    self->pending = 0;
+    res->recv++;
+    lat_add(&res->rtt, (uint32_t) (((uint64_t) ((uint32_t) pkt->t - t) * 1000) /
+                                   TIME_FACTOR));
+  }
+  else
+    res->late++;
+
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// exchange rate [0.1 1/s] of modem results (0 if unknown)
+uint32_t ping_rate(const ping_res_t *res)
+{
+  uint64_t ms = res->time / TIME_FACTOR;
+  if (ms == 0 || res->sent < 2) return 0;
+  // replies per interval between first and last request
+  return (uint32_t) (((uint64_t) res->recv * 10000 + ms / 2) / ms);
+}
+//-----------------------------------------------------------------------------
+// format "sent=.. recv=.. late=.. loss=..% rate=../s" (one line without EOL)
+int ping_format(const ping_res_t *res, char *buf, size_t size)
+{
+  uint32_t lost = res->sent > res->recv ? res->sent - res->recv : 0;
+  uint32_t loss = res->sent ? (uint32_t)
+    (((uint64_t) lost * 1000 + res->sent / 2) / res->sent) : 0; // [0.1%]
+  uint32_t rate = ping_rate(res);
+
+  return snprintf(buf, size,
+    "sent=%lu recv=%lu late=%lu loss=%lu.%lu%% rate=%lu.%lu/s",
+    (unsigned long) res->sent, (unsigned long) res->recv,
+    (unsigned long) res->late,
+    (unsigned long) (loss / 10), (unsigned long) (loss % 10),
+    (unsigned long) (rate / 10), (unsigned long) (rate % 10));
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "ping.c" file ***/
@@ -0,0 +1,90 @@
+/*
+ * Ping-pong RTT benchmark (requester/responder with echoed timestamps)
+ * File: "ping.h"
+ */
+
+#pragma once
+#ifndef PING_H
+#define PING_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+#include "rx_ring.h"
+#include "lat.h"
+//-----------------------------------------------------------------------------
+// ping payload header (little endian):
+//   [0]    - PING_MAGIC_REQ (request) or PING_MAGIC_REP (reply)
+//   [1..4] - sequence number (32 bit)
+//   [5..8] - requester timestamp (TIME_FUNC() at TX start)
+#define PING_MAGIC_REQ 0x5A
+#define PING_MAGIC_REP 0x5B
+#define PING_HDR_SIZE  9
+
+#define PING_MODES 5 // GFSK, LoRa, Ranging, FLRC, BLE
+//-----------------------------------------------------------------------------
+// results of one modem (packet type)
+typedef struct ping_res_ {
+  uint32_t   sent;    // requests
+  uint32_t   recv;    // replies in time
+  uint32_t   late;    // replies of old requests (after timeout)
+  uint64_t   time;    // time from first to last request [TIME_FUNC() units]
+  lat_hist_t rtt;     // round trip time [us]
+} ping_res_t;
+//-----------------------------------------------------------------------------
+// ping benchmark
+typedef struct ping_ {
+  uint8_t  on;        // 1 - requester stamps, responder echoes
+  uint8_t  flood;     // 1 - next request right after reply/timeout
+  uint32_t seq;       // next request sequence number
+  uint32_t wait;      // sequence number of outstanding request
+  uint8_t  pending;   // 1 - wait reply of `wait` request
+  uint8_t  t_valid;   // 1 - `t` is valid
+  unsigned long t;    // last request time
+  uint8_t  req[PING_HDR_SIZE]; // last received request header (responder)
+  uint8_t  req_size;  // PING_HDR_SIZE - `req` is valid, 0 - no request
+  ping_res_t res[PING_MODES];
+} ping_t;
+//-----------------------------------------------------------------------------
+extern const char * const ping_mode_string[PING_MODES];
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init ping benchmark (off, fixed rate)
+void ping_init(ping_t *self);
+//-----------------------------------------------------------------------------
+// reset sequence and results of all modems
+void ping_reset(ping_t *self);
+//-----------------------------------------------------------------------------
+// stamp request payload (requester, return 0 if payload is too small)
+uint8_t ping_stamp(ping_t *self, uint8_t mode, uint8_t *data, uint8_t size,
+                   unsigned long t);
+//-----------------------------------------------------------------------------
+// save header of received packet if it is request (responder, on RX done)
+// (return 1 if packet is request)
+uint8_t ping_request(ping_t *self, const uint8_t *rx, uint8_t rx_size);
+//-----------------------------------------------------------------------------
+// copy received request header to reply payload (responder, before reply)
+// (return 1 if request is echoed)
+uint8_t ping_echo(const uint8_t *rx, uint8_t rx_size,
+                  uint8_t *tx, uint8_t tx_size);
+//-----------------------------------------------------------------------------
+// account reply (requester RX ring subscriber, context = ping_t*)
+uint8_t ping_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+// exchange rate [0.1 1/s] of modem results (0 if unknown)
+uint32_t ping_rate(const ping_res_t *res);
+//-----------------------------------------------------------------------------
+// format "sent=.. recv=.. late=.. loss=..% rate=../s" (one line without EOL)
+int ping_format(const ping_res_t *res, char *buf, size_t size);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // PING_H
+
+/*** end of "ping.h" file ***/
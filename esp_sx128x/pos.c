@@ -0,0 +1,316 @@
+/*
+ * Multi-anchor ranging positioning: anchor list schedule (one ranging
+ * session per anchor) and fixed-point least-squares trilateration (2D/3D)
+ * File: "pos.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "pos.h"
+//-----------------------------------------------------------------------------
+// TIME_FUNC() units to microseconds
+#define POS_US(dt) ((uint32_t) (dt) * (1000 / TIME_FACTOR))
+//-----------------------------------------------------------------------------
+// rounded integer division
+static int64_t pos_div(int64_t a, int64_t b)
+{
+  return ((a < 0) == (b < 0) ? a + b / 2 : a - b / 2) / b;
+}
+//-----------------------------------------------------------------------------
+// anchor coordinate `k` (0 - x, 1 - y, 2 - z)
+static int32_t pos_coord(const pos_anchor_t *a, uint8_t k)
+{
+  return k == 0 ? a->x : k == 1 ? a->y : a->z;
+}
+//-----------------------------------------------------------------------------
+// solve normal equations A * s = b by Gauss elimination with partial
+// pivoting (elimination factor in Q16), pivots must be at least `min`
+static int8_t pos_gauss(int64_t a[3][3], int64_t b[3], int64_t s[3], uint8_t n,
+                        int64_t min)
+{
+  uint8_t c, r, k;
+
+  for (c = 0; c < n; c++)
+  {
+    uint8_t p = c;
+    for (r = c + 1; r < n; r++)
+      if ((a[r][c] < 0 ? -a[r][c] : a[r][c]) > (a[p][c] < 0 ? -a[p][c] : a[p][c]))
+        p = r;
+
+    if ((a[p][c] < 0 ? -a[p][c] : a[p][c]) < min)
+      return POS_ERR_GEOMETRY;
+
+    if (p != c)
+    {
+      int64_t t;
+      for (k = 0; k < n; k++) { t = a[c][k]; a[c][k] = a[p][k]; a[p][k] = t; }
+      t = b[c]; b[c] = b[p]; b[p] = t;
+    }
+
+    for (r = c + 1; r < n; r++)
+    {
+      int64_t f = pos_div(a[r][c] * 65536, a[c][c]); // |f| <= 1 in Q16
+      for (k = c; k < n; k++) a[r][k] -= pos_div(a[c][k] * f, 65536);
+      b[r] -= pos_div(b[c] * f, 65536);
+    }
+  }
+
+  for (c = n; c-- > 0;)
+  {
+    int64_t v = b[c];
+    for (k = c + 1; k < n; k++) v -= a[c][k] * s[k];
+    s[c] = pos_div(v, a[c][c]);
+  }
+  return POS_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// linear least-squares start point (exact for exact distances): ranges
+// minus range of first anchor `r` give linear equations 2 * c * q = rhs,
+// where c = a - a_r, q = p - a_r; values are scaled to fit int64
+static int8_t pos_linear(const pos_list_t *list, const int32_t *d,
+                         uint16_t mask, uint8_t dim, int64_t p[3])
+{
+  int64_t c[POS_ANCHORS][3], rhs[POS_ANCHORS], a[3][3], b[3], q[3];
+  int64_t cmax = 0, rmax = 0;
+  uint8_t i, k, l, r = POS_ANCHORS, n = 0, sc = 0, sr = 0;
+
+  for (i = 0; i < list->n; i++)
+  {
+    if (!(mask & (1u << i))) continue;
+    if (r == POS_ANCHORS) { r = i; continue; }
+    rhs[n] = (int64_t) d[r] * d[r] - (int64_t) d[i] * d[i];
+    for (k = 0; k < dim; k++)
+    {
+      c[n][k] = pos_coord(&list->a[i], k) - pos_coord(&list->a[r], k);
+      rhs[n] += c[n][k] * c[n][k];
+      if ((c[n][k] < 0 ? -c[n][k] : c[n][k]) > cmax)
+        cmax = c[n][k] < 0 ? -c[n][k] : c[n][k];
+    }
+    n++;
+  }
+
+  // c to 12 bits, equations by 2^(sc+1), right side to 28 bits
+  while ((cmax >> sc) > 4096) sc++;
+  for (i = 0; i < n; i++)
+  {
+    for (k = 0; k < dim; k++) c[i][k] = pos_div(c[i][k], (int64_t) 1 << sc);
+    rhs[i] = pos_div(rhs[i], (int64_t) 2 << sc);
+    if ((rhs[i] < 0 ? -rhs[i] : rhs[i]) > rmax)
+      rmax = rhs[i] < 0 ? -rhs[i] : rhs[i];
+  }
+  while ((rmax >> sr) > ((int64_t) 1 << 28)) sr++;
+
+  memset((void*) a, 0, sizeof(a));
+  memset((void*) b, 0, sizeof(b));
+  for (i = 0; i < n; i++)
+    for (k = 0; k < dim; k++)
+    {
+      for (l = 0; l < dim; l++) a[k][l] += c[i][k] * c[i][l];
+      b[k] += c[i][k] * pos_div(rhs[i], (int64_t) 1 << sr);
+    }
+
+  // degenerated geometry (collinear/coplanar anchors) by pivot
+  if (pos_gauss(a, b, q, dim, 1) != POS_ERR_NONE) return POS_ERR_GEOMETRY;
+
+  for (k = 0; k < dim; k++)
+  { // ill-conditioned geometry may give far point
+    q[k] = pos_coord(&list->a[r], k) + q[k] * ((int64_t) 1 << sr);
+    if (q[k] > POS_MAX || q[k] < -POS_MAX) return POS_ERR_GEOMETRY;
+    p[k] = q[k];
+  }
+  return POS_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// set default anchor list (off, empty)
+void pos_list_default(pos_list_t *list)
+{
+  memset((void*) list, 0, sizeof(pos_list_t));
+  list->dim = POS_DIM;
+}
+//-----------------------------------------------------------------------------
+// init positioning by anchor list
+void pos_init(pos_t *self, const pos_list_t *list)
+{
+  memset((void*) self, 0, sizeof(pos_t));
+  self->list = list;
+}
+//-----------------------------------------------------------------------------
+// start cycle at `t` [TIME_FUNC()], `addr` - first anchor address
+// (return 0 if positioning is off or list is empty)
+uint8_t pos_begin(pos_t *self, unsigned long t, uint32_t *addr)
+{
+  if (!self->list->on || self->list->n == 0) return 0;
+  self->idx    = 0;
+  self->mask   = 0;
+  self->active = 1;
+  self->t0     = t;
+  *addr = self->list->a[0].addr;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// finish cycle at `t`: solve position, set `ready`
+static void pos_end(pos_t *self, unsigned long t)
+{
+  self->active = 0;
+  self->time   = POS_US(t - self->t0);
+  self->rate   = self->time ? 1000000 / self->time : 0;
+
+  // track from last position while it is good
+  self->err = pos_solve(self->list, self->d, self->mask, &self->fix,
+                        self->fixes != 0 && self->err == POS_ERR_NONE);
+  if (self->err == POS_ERR_NONE) self->fixes++;
+  else                           self->fails++;
+  self->ready = 1;
+}
+//-----------------------------------------------------------------------------
+// take finished ranging session of current anchor (clears `rng->ready`),
+// `addr` - next anchor address (return 0 if cycle is finished)
+uint8_t pos_next(pos_t *self, range_t *rng, unsigned long t, uint32_t *addr)
+{
+  if (!self->active) return 0;
+
+  if (rng->samples)
+  {
+    int32_t d = rng->chans > 1 ? rng->chmed : rng->median; // [cm]
+    self->d[self->idx] = (d + (d < 0 ? -5 : 5)) / 10;       // [dm]
+    self->mask |= (uint16_t) 1 << self->idx;
+  }
+  rng->ready = 0; // reported by position
+
+  if (++self->idx < self->list->n)
+  {
+    *addr = self->list->a[self->idx].addr;
+    return 1;
+  }
+
+  pos_end(self, t);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// solve position by distances `d` [dm] of anchors in `mask`
+// (start from linear solution, if geometry is degenerated: `init` = 1 -
+// from `fix` position, else from anchors centroid)
+// Gauss-Newton by ranges: J = (p - a) / |p - a| in Q10, damped normal
+// equations are solved in int64 (coordinates up to +/-2^17 dm)
+int8_t pos_solve(const pos_list_t *list, const int32_t *d, uint16_t mask,
+                 pos_fix_t *fix, uint8_t init)
+{
+  uint8_t dim = list->dim == 3 ? 3 : 2;
+  uint8_t i, k, l, iter;
+  int64_t p[3] = { 0, 0, 0 }, s[3], a[3][3], b[3];
+  uint64_t sum2;
+
+  if (list->n > POS_ANCHORS) return POS_ERR_ANCHORS;
+  mask &= (uint16_t) ((1u << list->n) - 1);
+
+  fix->used = 0;
+  for (i = 0; i < list->n; i++)
+    if (mask & (1u << i))
+    {
+      fix->used++;
+      for (k = 0; k < dim; k++) p[k] += pos_coord(&list->a[i], k);
+    }
+  if (fix->used < dim + 1) return POS_ERR_ANCHORS;
+
+  if (pos_linear(list, d, mask, dim, s) == POS_ERR_NONE)
+    for (k = 0; k < dim; k++) p[k] = s[k];
+  else if (init)
+  {
+    p[0] = fix->x;
+    p[1] = fix->y;
+    p[2] = dim == 3 ? fix->z : 0;
+  }
+  else
+    for (k = 0; k < dim; k++) p[k] = pos_div(p[k], fix->used);
+
+  for (iter = 1; iter <= POS_ITER; iter++)
+  {
+    int64_t step = 0;
+    memset((void*) a, 0, sizeof(a));
+    memset((void*) b, 0, sizeof(b));
+
+    for (i = 0; i < list->n; i++)
+    {
+      int64_t v[3], j[3], e;
+      uint64_t r2 = 0;
+      uint32_t r;
+
+      if (!(mask & (1u << i))) continue;
+
+      for (k = 0; k < dim; k++)
+      {
+        v[k] = p[k] - pos_coord(&list->a[i], k);
+        r2  += (uint64_t) (v[k] * v[k]);
+      }
+      r = pos_isqrt(r2);
+      if (r == 0) continue; // direction is unknown at anchor
+
+      e = (int64_t) d[i] - r;
+      if      (e >  POS_STEP) e =  POS_STEP;
+      else if (e < -POS_STEP) e = -POS_STEP;
+
+      for (k = 0; k < dim; k++) j[k] = pos_div(v[k] * (1 << POS_Q), r);
+      for (k = 0; k < dim; k++)
+      {
+        for (l = 0; l < dim; l++) a[k][l] += j[k] * j[l];
+        b[k] += j[k] * e;
+      }
+    }
+
+    // A in Q20, b in Q10 * dm => s in dm; damping keeps pivots above
+    // POS_DAMP for any non-degenerated geometry
+    for (k = 0; k < dim; k++)
+    {
+      a[k][k] += POS_DAMP;
+      b[k]    *= 1 << POS_Q;
+    }
+    if (pos_gauss(a, b, s, dim, 2 * POS_DAMP) != POS_ERR_NONE)
+      return POS_ERR_GEOMETRY;
+
+    for (k = 0; k < dim; k++)
+    {
+      p[k] += s[k];
+      if ((s[k] < 0 ? -s[k] : s[k]) > step) step = s[k] < 0 ? -s[k] : s[k];
+    }
+    if (step <= POS_EPS) break;
+  }
+
+  fix->iter = iter > POS_ITER ? POS_ITER : iter;
+  fix->x = (int32_t) p[0];
+  fix->y = (int32_t) p[1];
+  fix->z = (int32_t) p[2];
+
+  // residuals
+  for (sum2 = 0, i = 0; i < list->n; i++)
+  {
+    uint64_t r2 = 0;
+    fix->res[i] = 0;
+    if (!(mask & (1u << i))) continue;
+    for (k = 0; k < dim; k++)
+    {
+      int64_t v = p[k] - pos_coord(&list->a[i], k);
+      r2 += (uint64_t) (v * v);
+    }
+    fix->res[i] = d[i] - (int32_t) pos_isqrt(r2);
+    sum2 += (uint64_t) ((int64_t) fix->res[i] * fix->res[i]);
+  }
+  fix->rms = pos_isqrt(sum2 / fix->used);
+  return POS_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// 64-bit integer square root
+uint32_t pos_isqrt(uint64_t x)
+{
+  uint64_t r = 0, bit = (uint64_t) 1 << 62;
+  while (bit > x) bit >>= 2;
+  while (bit)
+  {
+    if (x >= r + bit) { x -= r + bit; r = (r >> 1) + bit; }
+    else                r >>= 1;
+    bit >>= 2;
+  }
+  return (uint32_t) r;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "pos.c" file ***/
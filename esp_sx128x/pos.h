@@ -0,0 +1,110 @@
+/*
+ * Multi-anchor ranging positioning: anchor list schedule (one ranging
+ * session per anchor) and fixed-point least-squares trilateration (2D/3D)
+ * File: "pos.h"
+ */
+
+#pragma once
+#ifndef POS_H
+#define POS_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+#include "range.h"
+//-----------------------------------------------------------------------------
+#ifndef POS_ANCHORS
+#  define POS_ANCHORS 8 // maximal anchors in list
+#endif
+
+#define POS_DIM       2 // dimension by default {2|3}
+#define POS_ITER     10 // maximal Gauss-Newton iterations
+#define POS_EPS       1 // stop if step is less or equal [dm]
+#define POS_Q        10 // unit vector fixed point (Q10)
+#define POS_STEP  16384 // residual limit per iteration [dm]
+#define POS_MAX  131072 // coordinates limit (+/-2^17) [dm]
+#define POS_DAMP (((int64_t) 1 << (2 * POS_Q)) / 64) // diagonal damping
+//-----------------------------------------------------------------------------
+// solver result codes
+#define POS_ERR_NONE      0 // position found
+#define POS_ERR_ANCHORS  -1 // too few anchors with distance (< dim + 1)
+#define POS_ERR_GEOMETRY -2 // singular geometry
+//-----------------------------------------------------------------------------
+// anchor (ranging slave with known position)
+typedef struct pos_anchor_ {
+  uint32_t addr;    // ranging slave address
+  int32_t  x, y, z; // position [dm]
+} pos_anchor_t;
+//-----------------------------------------------------------------------------
+// anchor list (options, saved to flash)
+typedef struct pos_list_ {
+  uint8_t on;  // 1 - ranging master cycles through anchors
+  uint8_t dim; // dimension {2|3}
+  uint8_t n;   // anchors in list
+  pos_anchor_t a[POS_ANCHORS];
+} pos_list_t;
+//-----------------------------------------------------------------------------
+// position fix
+typedef struct pos_fix_ {
+  int32_t  x, y, z;          // position [dm] (z = 0 for 2D)
+  int32_t  res[POS_ANCHORS]; // residuals: measured - solved distance [dm]
+  uint32_t rms;              // RMS of residuals [dm]
+  uint8_t  used;             // anchors in solution
+  uint8_t  iter;             // iterations
+} pos_fix_t;
+//-----------------------------------------------------------------------------
+// positioning schedule (ranging master)
+typedef struct pos_ {
+  const pos_list_t *list;    // anchors
+
+  // current cycle
+  uint8_t  idx;              // current anchor
+  uint8_t  active;           // 1 - cycle in progress
+  unsigned long t0;          // cycle start [TIME_FUNC()]
+  int32_t  d[POS_ANCHORS];   // session median by anchor [dm]
+  uint16_t mask;             // anchors with distance (bit by index)
+
+  // result of last cycle
+  pos_fix_t fix;
+  int8_t   err;              // POS_ERR_*
+  uint32_t time;             // cycle duration [us]
+  uint32_t rate;             // positions per second by cycle duration
+  uint32_t fixes;            // cycles with position
+  uint32_t fails;            // cycles without position
+  uint8_t  ready;            // 1 - cycle finished and not reported yet
+} pos_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// set default anchor list (off, empty)
+void pos_list_default(pos_list_t *list);
+//-----------------------------------------------------------------------------
+// init positioning by anchor list
+void pos_init(pos_t *self, const pos_list_t *list);
+//-----------------------------------------------------------------------------
+// start cycle at `t` [TIME_FUNC()], `addr` - first anchor address
+// (return 0 if positioning is off or list is empty)
+uint8_t pos_begin(pos_t *self, unsigned long t, uint32_t *addr);
+//-----------------------------------------------------------------------------
+// take finished ranging session of current anchor (clears `rng->ready`),
+// `addr` - next anchor address (return 0 if cycle is finished)
+uint8_t pos_next(pos_t *self, range_t *rng, unsigned long t, uint32_t *addr);
+//-----------------------------------------------------------------------------
+// solve position by distances `d` [dm] of anchors in `mask`
+// (start from linear solution, if geometry is degenerated: `init` = 1 -
+// from `fix` position, else from anchors centroid)
+int8_t pos_solve(const pos_list_t *list, const int32_t *d, uint16_t mask,
+                 pos_fix_t *fix, uint8_t init);
+//-----------------------------------------------------------------------------
+// 64-bit integer square root
+uint32_t pos_isqrt(uint64_t x);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // POS_H
+
+/*** end of "pos.h" file ***/
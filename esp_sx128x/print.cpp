@@ -8,12 +8,198 @@
 #include <stdlib.h>
 #include "config.h"
 #include "print.h"
+#include "capture.h" // capture_yield(), capture_busy(), capture_flush()
+//-----------------------------------------------------------------------------
+#if defined(PRINT_LOG) && !defined(PRINT_SERIAL)
+#  undef PRINT_LOG // deferred log needs serial port
+#endif
+
+#ifdef PRINT_LOG
+// deferred log ring: text bytes as is, numbers as compact binary records
+// record: PRINT_LOG_ESC, type, digits, value (sizeof(unsigned long) bytes)
+#define PRINT_LOG_ESC  0x00 // never appears in C string
+#define PRINT_LOG_INT  0    // signed decimal
+#define PRINT_LOG_UINT 1    // unsigned decimal with '0' on the begin
+#define PRINT_LOG_BIN  2    // binary
+#define PRINT_LOG_HEX  3    // hexadecimal
+#define PRINT_LOG_REC  (3 + sizeof(unsigned long)) // record size
+#define PRINT_LOG_MASK (PRINT_LOG_SIZE - 1)
+
+#if (PRINT_LOG_SIZE & PRINT_LOG_MASK) != 0
+#  error PRINT_LOG_SIZE must be power of 2
+#endif
+
+#ifndef PRINT_LOG_LINE
+#  define PRINT_LOG_LINE 128 // room reserved by first part of line [bytes]
+#endif
+
+#ifndef PRINT_LOG_TIMEOUT
+#  define PRINT_LOG_TIMEOUT 200 // no sink progress in wait mode => drop [ms]
+#endif
+
+#if PRINT_LOG_LINE > PRINT_LOG_SIZE / 4
+#  error PRINT_LOG_LINE must be not more than PRINT_LOG_SIZE / 4
+#endif
+
+static uint8_t  print_log_buf[PRINT_LOG_SIZE];
+static uint16_t print_log_head  = 0; // write index
+static uint16_t print_log_tail  = 0; // read index
+static uint8_t  print_log_block = 0; // 1-wait for room, 0-drop
+static uint8_t  print_log_stall = 0; // 1-sink stalled in wait mode => drop
+static uint8_t  print_log_line  = 0; // 1-inside line (first part is put)
+static uint8_t  print_log_skip  = 0; // 1-drop rest of line
+static uint32_t print_log_drop  = 0; // dropped lines counter
+static uint32_t print_log_lost  = 0; // dropped but not reported lines
+static uint16_t print_log_peak  = 0; // maximal used size [bytes]
+//-----------------------------------------------------------------------------
+// used space of log ring [bytes]
+static inline uint16_t print_log_used()
+{
+  return (uint16_t) (print_log_head - print_log_tail) & PRINT_LOG_MASK;
+}
+//-----------------------------------------------------------------------------
+// free space of log ring [bytes] (one byte reserved)
+static inline uint16_t print_log_free()
+{
+  return PRINT_LOG_MASK - print_log_used();
+}
+//-----------------------------------------------------------------------------
+// one step of wait loop: output log, no progress of sink for
+// PRINT_LOG_TIMEOUT (no USB host) => drop mode until sink takes data
+static void print_log_step(uint16_t *used, unsigned long *t)
+{
+  print_yield();
+  if (print_log_used() != *used)
+  {
+    *used = print_log_used();
+    *t    = millis();
+  }
+  else if (millis() - *t >= PRINT_LOG_TIMEOUT)
+    print_log_stall = 1;
+}
+//-----------------------------------------------------------------------------
+// get room for part of line of `size` bytes (wait or drop); first part
+// reserves PRINT_LOG_LINE bytes, so line is whole or dropped as one
+// (`eol` - part ends line)
+static bool print_log_room(uint16_t size, uint8_t eol)
+{
+  uint16_t need = size, used = print_log_used();
+  unsigned long t = millis();
+  bool ok = !print_log_skip; // rest of dropped line
+
+  if (!print_log_line && need < PRINT_LOG_LINE) need = PRINT_LOG_LINE;
+
+  while (ok && print_log_free() < need)
+  {
+    if (!print_log_block || print_log_stall)
+    { // drop under backpressure
+      print_log_drop++;
+      print_log_lost++;
+      ok = false;
+    }
+    else
+      print_log_step(&used, &t);
+  }
+
+  print_log_skip = !ok && !eol;
+  print_log_line = ok && !eol;
+  return ok;
+}
+//-----------------------------------------------------------------------------
+// put bytes to log ring (space checked)
+static void print_log_put(const uint8_t *data, uint16_t size)
+{
+  uint16_t used;
+  while (size--)
+  {
+    print_log_buf[print_log_head] = *data++;
+    print_log_head = (print_log_head + 1) & PRINT_LOG_MASK;
+  }
+  used = print_log_used();
+  if (print_log_peak < used) print_log_peak = used;
+}
+//-----------------------------------------------------------------------------
+// put number record to log ring
+static int print_log_num(uint8_t type, unsigned long i, char digits)
+{
+  uint8_t rec[PRINT_LOG_REC];
+  if (!print_log_room(PRINT_LOG_REC, 0)) return 0;
+  rec[0] = PRINT_LOG_ESC;
+  rec[1] = type;
+  rec[2] = (uint8_t) digits;
+  memcpy((void*) (rec + 3), (const void*) &i, sizeof(unsigned long));
+  print_log_put(rec, PRINT_LOG_REC);
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// get byte from log ring by offset from tail
+static inline uint8_t print_log_peek(uint16_t offset)
+{
+  return print_log_buf[(print_log_tail + offset) & PRINT_LOG_MASK];
+}
+//-----------------------------------------------------------------------------
+// format number record from tail to buffer (return length)
+static int print_log_format(char *buf)
+{
+  char *ptr = buf + 33, digits = (char) print_log_peek(2);
+  uint8_t i, type = print_log_peek(1);
+  unsigned long u;
+  uint8_t *p = (uint8_t*) &u;
+
+  for (i = 0; i < sizeof(unsigned long); i++)
+    *p++ = print_log_peek(3 + i);
+
+  *ptr = '\0';
+  if (type == PRINT_LOG_INT)
+  {
+    long l = (long) u;
+    u = l < 0 ? (unsigned long) -l : (unsigned long) l;
+    do { *--ptr = '0' + (u % 10); u /= 10; } while (u != 0);
+    if (l < 0) *--ptr = '-';
+  }
+  else if (type == PRINT_LOG_UINT)
+  {
+    do { *--ptr = '0' + (u % 10); digits--; u /= 10; } while (u != 0);
+    while (digits-- > 0) *--ptr = '0';
+  }
+  else if (type == PRINT_LOG_BIN)
+  {
+    while (digits-- > 0) { *--ptr = '0' + (u & 1); u >>= 1; }
+  }
+  else // PRINT_LOG_HEX
+  {
+    while (digits-- > 0)
+    {
+      int c = u & 0xf;
+      *--ptr = c < 10 ? c + '0' : c + 'A' - 10;
+      u >>= 4;
+    }
+  }
+
+  memmove((void*) buf, (const void*) ptr, buf + 33 - ptr + 1);
+  return buf + 33 - ptr;
+}
+#endif // PRINT_LOG
 //-----------------------------------------------------------------------------
 // print string
 int print_str(const char *msg)
 {
-#if defined(PRINT_SERIAL)
-  int retv = Serial.print(msg);
+#if defined(PRINT_LOG)
+  int retv = 0;
+  size_t size = strlen(msg);
+  while (size)
+  { // long strings by chunks
+    uint16_t n = size > PRINT_LOG_SIZE / 4 ? PRINT_LOG_SIZE / 4 : size;
+    if (!print_log_room(n, msg[n - 1] == '\n')) break;
+    print_log_put((const uint8_t*) msg, n);
+    msg  += n;
+    size -= n;
+    retv += n;
+  }
+#elif defined(PRINT_SERIAL)
+  int retv;
+  capture_flush(); // don't break binary frame
+  retv = Serial.print(msg);
 #else
   int retv = 0;
 #endif
@@ -29,7 +215,12 @@ int print_eol()
 // print char
 int print_chr(char c)
 {
-#if defined(PRINT_SERIAL)
+#if defined(PRINT_LOG)
+  if (c == '\0' || !print_log_room(1, c == '\n')) return 0;
+  print_log_put((const uint8_t*) &c, 1);
+  return 1;
+#elif defined(PRINT_SERIAL)
+  capture_flush(); // don't break binary frame
   return Serial.print(c);
 #endif
 }
@@ -37,6 +228,9 @@ int print_chr(char c)
 // print long integer value
 int print_int(long i)
 {
+#ifdef PRINT_LOG
+  return print_log_num(PRINT_LOG_INT, (unsigned long) i, 0);
+#else
   char minus = 0;
   char buf[12];
   char *ptr = buf + sizeof(buf) - 1;
@@ -57,11 +251,15 @@ int print_int(long i)
     *--ptr = '-';
 
   return print_str(ptr);
+#endif // !PRINT_LOG
 }
 //-----------------------------------------------------------------------------
 // print unsigned long integer
 int print_uint(unsigned long i)
 {
+#ifdef PRINT_LOG
+  return print_log_num(PRINT_LOG_UINT, i, 0);
+#else
   char buf[12];
   char *ptr = buf + sizeof(buf) - 1;
 
@@ -72,16 +270,20 @@ int print_uint(unsigned long i)
   } while (i != 0);
 
   return print_str(ptr);
+#endif // !PRINT_LOG
 }
 //-----------------------------------------------------------------------------
 // print unsigned long integer with '0' on the begin
 int print_uint_ex(unsigned long i, char digits)
 {
+  if (digits > 10) digits = 10; // 2**32 = 4294967296 
+
+#ifdef PRINT_LOG
+  return print_log_num(PRINT_LOG_UINT, i, digits);
+#else
   char buf[12];
   char *ptr = buf + sizeof(buf) - 1;
 
-  if (digits > 10) digits = 10; // 2**32 = 4294967296 
-
   *ptr = '\0';
   do {
     *--ptr = '0' + (i % 10);
@@ -93,14 +295,19 @@ int print_uint_ex(unsigned long i, char digits)
     *--ptr = '0';
 
   return print_str(ptr);
+#endif // !PRINT_LOG
 }
 //-----------------------------------------------------------------------------
 // print binary unsigned long integer value
 int print_bin(unsigned long i, char digits)
 {
+  if (digits > 32) digits = 32; 
+
+#ifdef PRINT_LOG
+  return print_log_num(PRINT_LOG_BIN, i, digits);
+#else
   char buf[33];
   char *ptr = buf + 32;
-  if (digits > 32) digits = 32; 
 
   *ptr = '\0';
   while (digits-- > 0)
@@ -110,14 +317,19 @@ int print_bin(unsigned long i, char digits)
   }
 
   return print_str(ptr);
+#endif // !PRINT_LOG
 }
 //-----------------------------------------------------------------------------
 // hex print unsigned long integer value
 int print_hex(unsigned long i, char digits)
 {
+  if (digits > 8) digits = 8; 
+
+#ifdef PRINT_LOG
+  return print_log_num(PRINT_LOG_HEX, i, digits);
+#else
   char buf[9];
   char *ptr = buf + 8;
-  if (digits > 8) digits = 8; 
 
   *ptr = '\0';
   while (digits-- > 0)
@@ -132,6 +344,7 @@ int print_hex(unsigned long i, char digits)
   }
 
   return print_str(ptr);
+#endif // !PRINT_LOG
 }
 //-----------------------------------------------------------------------------
 // print long integer as float in NNN.D format [d = (int) (f * 10.)]
@@ -193,11 +406,96 @@ void print_sval(const char *ident, const char *str)
 // flush UART/LPUART or USB-CDC TX buffers
 void print_flush()
 {
+#if defined(PRINT_LOG)
+  uint16_t used;
+  unsigned long t;
+  print_yield(); // sink may be back
+  used = print_log_used();
+  t    = millis();
+  while ((print_log_used() || print_log_lost) && !print_log_stall)
+    print_log_step(&used, &t);
+  if (print_log_stall) return; // no sink (USB host)
+#endif
 #if defined(PRINT_SERIAL)
+  capture_flush();
   Serial.flush();
 #endif
 }
 //-----------------------------------------------------------------------------
+// output deferred log while UART/USB-CDC has room (call from main loop,
+// also called by blocking print and print_flush() wait loops)
+void print_yield()
+{
+#if defined(PRINT_LOG) && defined(PRINT_SERIAL)
+  char buf[64];
+  int n, room;
+
+  // never interleave with binary capture frame: send it first
+  capture_yield();
+  if (capture_busy()) return;
+
+  room = Serial.availableForWrite();
+
+  while (room > 0 && print_log_used())
+  {
+    n = 0;
+    if (print_log_peek(0) == PRINT_LOG_ESC)
+    { // number record
+      char num[34];
+      n = print_log_format(num);
+      if (n > room) break; // wait room for whole number
+      Serial.write((const uint8_t*) num, n);
+      print_log_tail = (print_log_tail + PRINT_LOG_REC) & PRINT_LOG_MASK;
+    }
+    else
+    { // text bytes
+      uint16_t used = print_log_used();
+      while (n < room && n < (int) sizeof(buf) && n < used &&
+             print_log_peek(n) != PRINT_LOG_ESC)
+      {
+        buf[n] = (char) print_log_peek(n);
+        n++;
+      }
+      Serial.write((const uint8_t*) buf, n);
+      print_log_tail = (print_log_tail + n) & PRINT_LOG_MASK;
+    }
+    room -= n;
+    print_log_stall = 0; // sink takes data
+  }
+
+  if (print_log_lost && !print_log_used() && room >= 32)
+  { // report dropped lines
+    char msg[32];
+    n = snprintf(msg, sizeof(msg), "\r\n<log: %lu dropped>\r\n",
+                 (unsigned long) print_log_lost);
+    Serial.write((const uint8_t*) msg, n);
+    print_log_lost = 0;
+  }
+#endif
+}
+//-----------------------------------------------------------------------------
+// set deferred log mode: 1-wait room (CLI), 0-drop on overflow (realtime)
+void print_log_wait(uint8_t wait)
+{
+#ifdef PRINT_LOG
+  print_log_block = wait;
+#endif
+}
+//-----------------------------------------------------------------------------
+// get deferred log statistic
+void print_log_stat(uint32_t *drops, uint16_t *used, uint16_t *peak)
+{
+#ifdef PRINT_LOG
+  *drops = print_log_drop;
+  *used  = print_log_used();
+  *peak  = print_log_peak;
+#else
+  *drops = 0;
+  *used  = 0;
+  *peak  = 0;
+#endif
+}
+//-----------------------------------------------------------------------------
 
 /*** end of "print.cpp" file ***/
 
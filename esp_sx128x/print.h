@@ -68,6 +68,16 @@ void print_sval(const char *ident, const char *str);
 // flush USART/LPUART or USB-CDC TX buffers
 void print_flush(void);
 //-----------------------------------------------------------------------------
+// output deferred log while UART/USB-CDC has room (call from main loop)
+void print_yield(void);
+//-----------------------------------------------------------------------------
+// set deferred log mode: 1-wait room (CLI), 0-drop on overflow (realtime);
+// wait mode drops too if sink takes nothing for PRINT_LOG_TIMEOUT
+void print_log_wait(uint8_t wait);
+//-----------------------------------------------------------------------------
+// get deferred log statistic
+void print_log_stat(uint32_t *drops, uint16_t *used, uint16_t *peak);
+//-----------------------------------------------------------------------------
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,266 @@
+/*
+ * Multi-sample ranging session: N back-to-back exchanges, robust filters
+ * (median, trimmed mean, fixed-point Kalman) and exchange rate
+ * File: "range.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "range.h"
+//-----------------------------------------------------------------------------
+// TIME_FUNC() units to microseconds
+#define RANGE_US(dt) ((uint32_t) (dt) * (1000 / TIME_FACTOR))
+//-----------------------------------------------------------------------------
+// sort distances (insertion sort, n <= RANGE_SAMPLES)
+static void range_sort(int32_t *a, uint8_t n)
+{
+  uint8_t i, j;
+  for (i = 1; i < n; i++)
+  {
+    int32_t v = a[i];
+    for (j = i; j > 0 && a[j - 1] > v; j--) a[j] = a[j - 1];
+    a[j] = v;
+  }
+}
+//-----------------------------------------------------------------------------
+// median of sorted array (mean of two middle values for even n)
+static int32_t range_median(const int32_t *a, uint8_t n)
+{
+  return (n & 1) ? a[n / 2] : (int32_t) (((int64_t) a[n / 2 - 1] + a[n / 2]) / 2);
+}
+//-----------------------------------------------------------------------------
+// rounded integer division
+static int64_t range_div(int64_t a, int64_t b)
+{
+  return ((a < 0) == (b < 0) ? a + b / 2 : a - b / 2) / b;
+}
+//-----------------------------------------------------------------------------
+// lower median of per-channel medians (multipath excess is late only)
+// (return number of channels)
+static uint8_t range_channels(const range_t *self, int32_t *chmed)
+{
+  int32_t d[RANGE_SAMPLES], m[RANGE_SAMPLES];
+  uint8_t i, j, k, c = 0;
+
+  for (i = 0; i < self->n; i++)
+  {
+    uint8_t ch = self->s[i].ch;
+    for (j = 0; j < i && self->s[j].ch != ch; j++);
+    if (j < i) continue; // channel is done
+
+    for (k = 0, j = i; j < self->n; j++)
+      if (self->s[j].ch == ch) d[k++] = self->s[j].d;
+    range_sort(d, k);
+    m[c++] = range_median(d, k);
+  }
+
+  range_sort(m, c);
+  *chmed = c ? m[(c - 1) / 2] : 0;
+  return c;
+}
+//-----------------------------------------------------------------------------
+// init ranging session (default options, Kalman reset)
+void range_init(range_t *self)
+{
+  memset((void*) self, 0, sizeof(range_t));
+  self->count = RANGE_COUNT;
+  self->trim  = RANGE_TRIM;
+  self->kf_q  = RANGE_KF_Q;
+  self->kf_r  = RANGE_KF_R;
+}
+//-----------------------------------------------------------------------------
+// reset Kalman filter state
+void range_kf_reset(range_t *self)
+{
+  self->kx    = 0;
+  self->kp    = 0;
+  self->kmiss = 0;
+}
+//-----------------------------------------------------------------------------
+// start session at `t` [TIME_FUNC()]
+void range_begin(range_t *self, unsigned long t)
+{
+  self->n      = 0;
+  self->tries  = 1; // first exchange is started by caller
+  self->active = 1;
+  self->ch     = 0;
+  self->t0     = t;
+}
+//-----------------------------------------------------------------------------
+// add exchange result (ignored if session is not active)
+void range_add(range_t *self, uint32_t raw, int32_t d, uint8_t rssi)
+{
+  range_sample_t *s;
+  if (!self->active || self->n >= RANGE_SAMPLES) return;
+  s = &self->s[self->n++];
+  s->d    = d;
+  s->raw  = raw;
+  s->rssi = rssi;
+  s->ch   = self->ch;
+}
+//-----------------------------------------------------------------------------
+// account next exchange after result or timeout
+// (return 0 if session is finished - call range_end())
+uint8_t range_next(range_t *self)
+{
+  if (!range_more(self)) return 0;
+  self->tries++;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// session needs next exchange (count not reached, tries <= 2 * count)
+uint8_t range_more(const range_t *self)
+{
+  uint8_t count = self->count > RANGE_SAMPLES ? RANGE_SAMPLES : self->count;
+  return self->active && self->n < count &&
+         (uint16_t) self->tries < (uint16_t) count * 2;
+}
+//-----------------------------------------------------------------------------
+// Kalman filter step by one measurement [cm] (return 0 if gated)
+// (random walk model, x and P in Q8, gain in Q16)
+uint8_t range_kf(range_t *self, int32_t d)
+{
+  int64_t  e;
+  uint64_t s, k;
+
+  if (self->kp == 0 || self->kmiss >= RANGE_KF_MISS)
+  { // (re)start from measurement
+    self->kx    = d * 256;
+    self->kp    = self->kf_r * 256;
+    self->kmiss = 0;
+    return 1;
+  }
+
+  self->kp += self->kf_q * 256; // predict
+
+  e = (int64_t) d * 256 - self->kx;          // innovation [Q8]
+  s = (uint64_t) self->kp + (uint64_t) self->kf_r * 256; // its variance [Q8]
+
+  // gate: e^2 > GATE * S (both sides in Q16)
+  if ((uint64_t) (e < 0 ? -e : e) * (uint64_t) (e < 0 ? -e : e) >
+      (uint64_t) RANGE_KF_GATE * s * 256)
+  {
+    self->kmiss++;
+    return 0;
+  }
+  self->kmiss = 0;
+
+  k = ((uint64_t) self->kp << 16) / s;       // gain [Q16]
+  self->kx += (int32_t) ((e * (int64_t) k) / 65536);
+  self->kp -= (uint32_t) (((uint64_t) self->kp * k) >> 16);
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// finish session at `t`: filter samples, set `ready`
+void range_end(range_t *self, unsigned long t)
+{
+  int32_t d[RANGE_SAMPLES];
+  uint8_t i, n = self->n, cut;
+
+  self->active = 0;
+  self->time   = RANGE_US(t - self->t0);
+  self->rate   = self->time ?
+                 (uint32_t) ((uint64_t) self->tries * 1000000 / self->time) : 0;
+  self->samples = n;
+  self->lost    = (uint8_t) (self->tries - n);
+  self->gated   = 0;
+  self->sessions++;
+  self->ready   = 1;
+
+  if (n == 0)
+  {
+    self->var   = 0;
+    self->chans = 0;
+    return;
+  }
+
+  // Kalman by samples in time order
+  for (i = 0; i < n; i++)
+    if (!range_kf(self, self->s[i].d)) self->gated++;
+  self->kalman = (self->kx + (self->kx < 0 ? -128 : 128)) / 256;
+  self->kvar   = self->kp / 256;
+
+  // median RSSI
+  for (i = 0; i < n; i++) d[i] = self->s[i].rssi;
+  range_sort(d, n);
+  self->rssi = (uint8_t) range_median(d, n);
+
+  // median, trimmed mean and variance
+  for (i = 0; i < n; i++) d[i] = self->s[i].d;
+  range_sort(d, n);
+  self->median = range_median(d, n);
+  self->chans  = range_channels(self, &self->chmed);
+
+  cut = (uint8_t) ((uint16_t) n * (self->trim > 49 ? 49 : self->trim) / 100);
+  {
+    int64_t sum = 0, sum2 = 0, m;
+    for (i = cut; i < n - cut; i++) sum += d[i];
+    m = n - 2 * cut;
+    self->trimmed = (int32_t) ((sum + (sum < 0 ? -m / 2 : m / 2)) / m);
+
+    for (sum = 0, i = 0; i < n; i++) { sum += d[i]; sum2 += (int64_t) d[i] * d[i]; }
+    sum2 = n > 1 ? (sum2 - sum * sum / n) / (n - 1) : 0;
+    self->var = sum2 > (int64_t) UINT32_MAX ? UINT32_MAX : (uint32_t) sum2;
+  }
+}
+//-----------------------------------------------------------------------------
+// integer square root (for RMS print)
+uint32_t range_isqrt(uint32_t x)
+{
+  uint32_t r = 0, bit = (uint32_t) 1 << 30;
+  while (bit > x) bit >>= 2;
+  while (bit)
+  {
+    if (x >= r + bit) { x -= r + bit; r = (r >> 1) + bit; }
+    else                r >>= 1;
+    bit >>= 2;
+  }
+  return r;
+}
+//-----------------------------------------------------------------------------
+// start calibration at known distance `d` [cm] from calibration `c`
+void range_cal_begin(range_cal_t *self, int32_t d, uint32_t c)
+{
+  self->step = RANGE_CAL_BASE;
+  self->d    = d;
+  self->c0   = self->c = (int32_t) c;
+  self->m0   = 0;
+  self->err  = 0;
+}
+//-----------------------------------------------------------------------------
+// next step by session median `m` [cm], return calibration for next session
+uint32_t range_cal_step(range_cal_t *self, int32_t m)
+{
+  int64_t c;
+
+  switch (self->step)
+  {
+    case RANGE_CAL_BASE: // probe step to measure slope
+      self->m0   = m;
+      self->step = RANGE_CAL_PROBE;
+      return (uint32_t) (self->c0 + RANGE_CAL_STEP);
+
+    case RANGE_CAL_PROBE: // c = c0 + (d - m0) / slope
+      if (m == self->m0)
+      {
+        self->step = RANGE_CAL_FAIL;
+        return (uint32_t) self->c0;
+      }
+      c = self->c0 + range_div((int64_t) (self->d - self->m0) * RANGE_CAL_STEP,
+                               m - self->m0);
+      self->c    = (int32_t) (c < 1 ? 1 : c > 0xFFFF ? 0xFFFF : c); // table cell
+      self->step = RANGE_CAL_CHECK;
+      return (uint32_t) self->c;
+
+    case RANGE_CAL_CHECK: // residual
+      self->err  = m - self->d;
+      self->step = RANGE_CAL_DONE;
+      return (uint32_t) self->c;
+
+    default:
+      return (uint32_t) self->c;
+  }
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "range.c" file ***/
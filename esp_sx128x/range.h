@@ -0,0 +1,141 @@
+/*
+ * Multi-sample ranging session: N back-to-back exchanges, robust filters
+ * (median, trimmed mean, fixed-point Kalman) and exchange rate
+ * File: "range.h"
+ */
+
+#pragma once
+#ifndef RANGE_H
+#define RANGE_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+//-----------------------------------------------------------------------------
+#ifndef RANGE_SAMPLES
+#  define RANGE_SAMPLES 64 // maximal exchanges in session
+#endif
+
+#define RANGE_COUNT       1 // exchanges in session by default (1 - single shot)
+#define RANGE_TRIM       25 // trimmed mean: cut on each side [%]
+#define RANGE_KF_Q     1600 // Kalman process noise per sample [cm^2]
+#define RANGE_KF_R    90000 // Kalman measurement noise [cm^2] (3 m RMS)
+#define RANGE_KF_GATE     9 // Kalman innovation gate [sigma^2]
+#define RANGE_KF_MISS     4 // gated samples in row before Kalman restart
+
+#define RANGE_CAL_STEP 64 // calibration probe step (slope measurement)
+//-----------------------------------------------------------------------------
+// one exchange result
+typedef struct range_sample_ {
+  int32_t  d;    // distance [cm]
+  uint32_t raw;  // raw 24-bit result
+  uint8_t  rssi; // RSSI = -rssi/2 [dBm]
+  uint8_t  ch;   // channel (frequency diversity)
+} range_sample_t;
+//-----------------------------------------------------------------------------
+// ranging session with filters
+typedef struct range_ {
+  // options
+  uint8_t  count;   // exchanges in session (1 - single shot)
+  uint8_t  trim;    // trimmed mean cut on each side [%]
+  uint32_t kf_q;    // Kalman process noise per sample [cm^2]
+  uint32_t kf_r;    // Kalman measurement noise [cm^2]
+
+  // current session
+  range_sample_t s[RANGE_SAMPLES];
+  uint8_t  n;       // collected samples
+  uint8_t  tries;   // started exchanges (with timeouts)
+  uint8_t  active;  // 1 - session in progress
+  uint8_t  ch;      // channel of next exchange (set by caller)
+  unsigned long t0; // session start [TIME_FUNC()]
+
+  // Kalman filter (state kept between sessions)
+  int32_t  kx;      // distance [cm * 256]
+  uint32_t kp;      // variance [cm^2 * 256] (0 - not initialized)
+  uint8_t  kmiss;   // gated samples in row
+
+  // result of last session
+  int32_t  median;  // median distance [cm]
+  int32_t  trimmed; // trimmed mean distance [cm]
+  int32_t  kalman;  // Kalman smoothed distance [cm]
+  int32_t  chmed;   // lower median of per-channel medians [cm]
+  uint8_t  chans;   // channels with samples
+  uint32_t var;     // sample variance [cm^2]
+  uint32_t kvar;    // Kalman variance [cm^2]
+  uint8_t  rssi;    // median RSSI (-dBm*2)
+  uint8_t  samples; // good samples
+  uint8_t  lost;    // timeouts
+  uint8_t  gated;   // samples rejected by Kalman gate
+  uint32_t time;    // session duration [us]
+  uint32_t rate;    // exchanges per second
+  uint32_t sessions;// finished sessions
+  uint8_t  ready;   // 1 - session finished and not reported yet
+} range_t;
+//-----------------------------------------------------------------------------
+// calibration routine steps (one ranging session per step)
+#define RANGE_CAL_OFF   0 // not running
+#define RANGE_CAL_BASE  1 // measure with start calibration
+#define RANGE_CAL_PROBE 2 // measure with start calibration + RANGE_CAL_STEP
+#define RANGE_CAL_CHECK 3 // measure with result calibration
+#define RANGE_CAL_DONE  4 // finished (`err` is residual)
+#define RANGE_CAL_FAIL  5 // no slope (distance doesn't depend on calibration)
+//-----------------------------------------------------------------------------
+// calibration by sessions at known distance: measured distance is linear
+// by calibration value (AN1200.29 3.2), slope is measured by probe step
+typedef struct range_cal_ {
+  uint8_t  step; // RANGE_CAL_*
+  int32_t  d;    // known distance [cm]
+  int32_t  c0;   // start calibration
+  int32_t  m0;   // median with `c0` [cm]
+  int32_t  c;    // result calibration
+  int32_t  err;  // residual with `c` [cm]
+} range_cal_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init ranging session (default options, Kalman reset)
+void range_init(range_t *self);
+//-----------------------------------------------------------------------------
+// reset Kalman filter state
+void range_kf_reset(range_t *self);
+//-----------------------------------------------------------------------------
+// start session at `t` [TIME_FUNC()]
+void range_begin(range_t *self, unsigned long t);
+//-----------------------------------------------------------------------------
+// add exchange result (ignored if session is not active)
+void range_add(range_t *self, uint32_t raw, int32_t d, uint8_t rssi);
+//-----------------------------------------------------------------------------
+// account next exchange after result or timeout
+// (return 0 if session is finished - call range_end())
+uint8_t range_next(range_t *self);
+//-----------------------------------------------------------------------------
+// session needs next exchange (count not reached, tries <= 2 * count)
+uint8_t range_more(const range_t *self);
+//-----------------------------------------------------------------------------
+// finish session at `t`: filter samples, set `ready`
+// (multipath excess is frequency selective: median across channels
+// rejects channels with biased samples)
+void range_end(range_t *self, unsigned long t);
+//-----------------------------------------------------------------------------
+// Kalman filter step by one measurement [cm] (return 0 if gated)
+uint8_t range_kf(range_t *self, int32_t d);
+//-----------------------------------------------------------------------------
+// integer square root (for RMS print)
+uint32_t range_isqrt(uint32_t x);
+//-----------------------------------------------------------------------------
+// start calibration at known distance `d` [cm] from calibration `c`
+void range_cal_begin(range_cal_t *self, int32_t d, uint32_t c);
+//-----------------------------------------------------------------------------
+// next step by session median `m` [cm], return calibration for next session
+uint32_t range_cal_step(range_cal_t *self, int32_t m);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // RANGE_H
+
+/*** end of "range.h" file ***/
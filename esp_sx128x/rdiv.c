@@ -0,0 +1,113 @@
+/*
+ * Ranging frequency diversity: shared channel list with precomputed PLL
+ * codes and deterministic per-exchange schedule (master and slave)
+ * File: "rdiv.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "sx128x.h" // sx128x_freq2code()
+#include "rdiv.h"
+//-----------------------------------------------------------------------------
+static uint8_t rdiv_gcd(uint8_t a, uint8_t b)
+{
+  while (b) { uint8_t t = a % b; a = b; b = t; }
+  return a;
+}
+//-----------------------------------------------------------------------------
+// init frequency diversity (off, default plan)
+void rdiv_init(rdiv_t *self)
+{
+  memset((void*) self, 0, sizeof(rdiv_t));
+  self->slot = RDIV_SLOT;
+  rdiv_plan(self, RDIV_FREQ_MIN, RDIV_FREQ_MAX, RDIV_STEP);
+}
+//-----------------------------------------------------------------------------
+// set channel plan: precompute PLL codes and schedule (return channels)
+uint8_t rdiv_plan(rdiv_t *self, uint32_t fmin, uint32_t fmax, uint32_t step)
+{
+  uint32_t n;
+  uint8_t i, stride;
+
+  if (step == 0) step = RDIV_STEP;
+  n = fmax > fmin ? (fmax - fmin) / step + 1 : 1;
+  if (n > RDIV_CHANNELS) n = RDIV_CHANNELS;
+
+  self->fmin = fmin;
+  self->step = step;
+  self->n    = (uint8_t) n;
+
+  // divisions here => only one SPI write on each hop
+  for (i = 0; i < self->n; i++)
+    self->code[i] = sx128x_freq2code(rdiv_freq(self, i) * 1000);
+
+  // neighbour positions are about half of band apart (multipath of close
+  // channels is correlated), stride is coprime with `n` => all channels
+  for (stride = self->n / 2 + 1; stride > 1 && rdiv_gcd(stride, self->n) != 1;
+       stride++);
+  for (i = 0; i < self->n; i++)
+    self->seq[i] = (uint8_t) (((uint16_t) i * stride) % self->n);
+
+  rdiv_reset(self);
+  return self->n;
+}
+//-----------------------------------------------------------------------------
+// channel frequency [kHz]
+uint32_t rdiv_freq(const rdiv_t *self, uint8_t ch)
+{
+  return self->fmin + (uint32_t) ch * self->step;
+}
+//-----------------------------------------------------------------------------
+// start of session (schedule position 0), return channel
+uint8_t rdiv_reset(rdiv_t *self)
+{
+  self->idx    = 0;
+  self->silent = 0;
+  self->park   = 1;
+  return self->seq[0];
+}
+//-----------------------------------------------------------------------------
+// channel of current schedule position
+uint8_t rdiv_channel(const rdiv_t *self)
+{
+  return self->seq[self->idx];
+}
+//-----------------------------------------------------------------------------
+// exchange done (master) or response sent (slave), return next channel
+uint8_t rdiv_next(rdiv_t *self)
+{
+  self->silent = 0;
+  self->park   = 0;
+  if (self->n > 1)
+  {
+    self->idx = (uint8_t) ((self->idx + 1) % self->n);
+    self->hops++;
+  }
+  return self->seq[self->idx];
+}
+//-----------------------------------------------------------------------------
+// slave: silent RX window, return next channel (check `park`)
+uint8_t rdiv_silent(rdiv_t *self)
+{
+  if (self->park) return self->seq[0]; // parked receiver has no window
+
+  if (++self->silent >= self->n)
+  { // master session is finished (or lost)
+    self->parks++;
+    return rdiv_reset(self);
+  }
+
+  self->idx = (uint8_t) ((self->idx + 1) % self->n);
+  self->hops++;
+  return self->seq[self->idx];
+}
+//-----------------------------------------------------------------------------
+// slave RX window [us] by LoRa SF and BW [kHz]
+uint32_t rdiv_slot_us(const rdiv_t *self, uint8_t sf, uint16_t bw)
+{
+  return (uint32_t) ((uint64_t) self->slot * ((uint32_t) 1 << sf) * 1000 /
+                     (bw ? bw : 1));
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "rdiv.c" file ***/
@@ -0,0 +1,86 @@
+/*
+ * Ranging frequency diversity: shared channel list with precomputed PLL
+ * codes and deterministic per-exchange schedule (master and slave)
+ * File: "rdiv.h"
+ */
+
+#pragma once
+#ifndef RDIV_H
+#define RDIV_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+//-----------------------------------------------------------------------------
+#define RDIV_CHANNELS 40 // maximal number of channels
+
+// channel plan by default (8 channels of 10 MHz)
+#define RDIV_FREQ_MIN 2405000 // first channel frequency [kHz]
+#define RDIV_FREQ_MAX 2475000 // last channel frequency [kHz]
+#define RDIV_STEP       10000 // channel step [kHz]
+
+// slave RX window on channel after response or silent window [symbols]
+// (must be longer than request and shorter than master exchange timeout)
+#define RDIV_SLOT 96
+//-----------------------------------------------------------------------------
+// Schedule: every ranging session starts from schedule position 0. Master
+// goes to next position after each exchange (result or timeout). Slave goes
+// to next position after response or silent RX window and parks on position
+// 0 (continuous RX) after `n` silent windows in row, so sessions must be
+// separated by at least `n` windows.
+typedef struct rdiv_ {
+  uint8_t  on;                  // 1 - frequency diversity on
+
+  // channel plan and schedule
+  uint32_t fmin;                // first channel frequency [kHz]
+  uint32_t step;                // channel step [kHz]
+  uint8_t  n;                   // number of channels
+  uint32_t code[RDIV_CHANNELS]; // precomputed PLL codes of channels
+  uint8_t  seq[RDIV_CHANNELS];  // channel by schedule position
+  uint16_t slot;                // slave RX window [symbols]
+
+  // current position
+  uint8_t  idx;                 // schedule position
+  uint8_t  silent;              // slave: silent windows in row
+  uint8_t  park;                // slave: 1 - parked on position 0
+
+  // statistic
+  uint32_t hops;                // channel changes
+  uint32_t parks;               // slave parkings
+} rdiv_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init frequency diversity (off, default plan)
+void rdiv_init(rdiv_t *self);
+//-----------------------------------------------------------------------------
+// set channel plan: precompute PLL codes and schedule (return channels)
+uint8_t rdiv_plan(rdiv_t *self, uint32_t fmin, uint32_t fmax, uint32_t step);
+//-----------------------------------------------------------------------------
+// channel frequency [kHz]
+uint32_t rdiv_freq(const rdiv_t *self, uint8_t ch);
+//-----------------------------------------------------------------------------
+// start of session (schedule position 0), return channel
+uint8_t rdiv_reset(rdiv_t *self);
+//-----------------------------------------------------------------------------
+// channel of current schedule position
+uint8_t rdiv_channel(const rdiv_t *self);
+//-----------------------------------------------------------------------------
+// exchange done (master) or response sent (slave), return next channel
+uint8_t rdiv_next(rdiv_t *self);
+//-----------------------------------------------------------------------------
+// slave: silent RX window, return next channel (check `park`)
+uint8_t rdiv_silent(rdiv_t *self);
+//-----------------------------------------------------------------------------
+// slave RX window [us] by LoRa SF and BW [kHz]
+uint32_t rdiv_slot_us(const rdiv_t *self, uint8_t sf, uint16_t bw);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // RDIV_H
+
+/*** end of "rdiv.h" file ***/
@@ -0,0 +1,105 @@
+/*
+ * RX packet ring with reference-counted slots and subscribers
+ * File: "rx_ring.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+#define RX_RING_MASK (RX_RING_SIZE - 1)
+//-----------------------------------------------------------------------------
+// init RX ring (no subscribers)
+void rx_ring_init(rx_ring_t *self)
+{
+  memset((void*) self, 0, sizeof(rx_ring_t));
+}
+//-----------------------------------------------------------------------------
+// add subscriber (return subscriber index or -1 if no room)
+int8_t rx_ring_subscribe(rx_ring_t *self,
+                         rx_ring_cb_t cb,  // callback function
+                         void *context,    // context for callback or NULL
+                         const char *name) // subscriber name
+{
+  rx_sub_t *sub;
+  if (self->subs >= RX_RING_SUBS) return -1; // no room
+
+  sub = &self->sub[self->subs];
+  sub->cb      = cb;
+  sub->context = context;
+  sub->name    = name;
+  sub->tail    = self->head; // new packets only
+  sub->cnt     = 0;
+  sub->drops   = 0;
+
+  return (int8_t) self->subs++;
+}
+//-----------------------------------------------------------------------------
+// get free slot to write next packet (never fails, never waits)
+// note: the oldest packet not consumed by slow subscriber(s) is dropped
+rx_pkt_t *rx_ring_alloc(rx_ring_t *self)
+{
+  uint8_t idx = self->head & RX_RING_MASK;
+
+  if (self->ref[idx])
+  { // slot is still referenced => drop oldest packet for laggard subscribers
+    uint8_t i;
+    for (i = 0; i < self->subs; i++)
+    {
+      rx_sub_t *sub = &self->sub[i];
+      if ((uint16_t) (self->head - sub->tail) >= RX_RING_SIZE)
+      {
+        sub->tail++;
+        sub->drops++;
+        self->drops++;
+      }
+    }
+    self->ref[idx] = 0;
+  }
+
+  return &self->pkt[idx];
+}
+//-----------------------------------------------------------------------------
+// publish packet written to slot returned by rx_ring_alloc()
+void rx_ring_push(rx_ring_t *self)
+{
+  self->ref[self->head & RX_RING_MASK] = self->subs;
+  self->head++;
+  self->cnt++;
+}
+//-----------------------------------------------------------------------------
+// deliver pending packets to all subscribers (call from main loop)
+void rx_ring_yield(rx_ring_t *self)
+{
+  uint8_t i;
+  for (i = 0; i < self->subs; i++)
+  {
+    rx_sub_t *sub = &self->sub[i];
+    while (sub->tail != self->head)
+    {
+      uint8_t idx = sub->tail & RX_RING_MASK;
+      if (!sub->cb(&self->pkt[idx], sub->context)) break; // busy
+
+      if (self->ref[idx]) self->ref[idx]--;
+      sub->tail++;
+      sub->cnt++;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+// reset all counters
+void rx_ring_reset(rx_ring_t *self)
+{
+  uint8_t i;
+  self->cnt   = 0;
+  self->drops = 0;
+  for (i = 0; i < self->subs; i++)
+  {
+    self->sub[i].cnt   = 0;
+    self->sub[i].drops = 0;
+  }
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "rx_ring.c" file ***/
+
@@ -0,0 +1,103 @@
+/*
+ * RX packet ring with reference-counted slots and subscribers
+ * File: "rx_ring.h"
+ */
+
+#pragma once
+#ifndef RX_RING_H
+#define RX_RING_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+#include "sx128x.h"
+//-----------------------------------------------------------------------------
+#ifndef RX_RING_SIZE
+#  define RX_RING_SIZE 8 // number of slots (must be power of 2)
+#endif
+
+#ifndef RX_RING_SUBS
+#  define RX_RING_SUBS 4 // maximal number of subscribers
+#endif
+
+#if (RX_RING_SIZE & (RX_RING_SIZE - 1)) != 0 || RX_RING_SIZE > 128
+#  error RX_RING_SIZE must be power of 2 and not more than 128
+#endif
+
+#define RX_RING_DATA_SIZE 255 // maximal payload size [bytes]
+//-----------------------------------------------------------------------------
+// received packet (one slot of ring)
+typedef struct rx_pkt_ {
+  unsigned long t;  // RxDone interrupt time (TIME_FUNC())
+  uint64_t ts;      // end of packet on air by compensated RxDone [ns]
+  uint8_t mode;     // packet type: 0-GFSK, 1-LoRa, 2-Ranging, 3-FLRC, 4-BLE
+  uint8_t size;     // real payload size [bytes]
+  sx128x_rx_t rx;   // RX status
+  uint8_t data[RX_RING_DATA_SIZE]; // payload
+} rx_pkt_t;
+//-----------------------------------------------------------------------------
+// subscriber callback
+// return: 1 - packet consumed, 0 - consumer busy (try again later)
+typedef uint8_t (*rx_ring_cb_t)(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+// subscriber (consumer) of received packets
+typedef struct rx_sub_ {
+  rx_ring_cb_t cb;  // callback function
+  void *context;    // optional context for callback or NULL
+  const char *name; // subscriber name (for statistic)
+  uint16_t tail;    // sequence number of next packet to consume
+  uint32_t cnt;     // consumed packets counter
+  uint32_t drops;   // dropped (overwritten) packets counter
+} rx_sub_t;
+//-----------------------------------------------------------------------------
+// RX packet ring
+typedef struct rx_ring_ {
+  rx_pkt_t pkt[RX_RING_SIZE]; // preallocated slots
+  uint8_t  ref[RX_RING_SIZE]; // reference counters of slots
+  uint16_t head;              // sequence number of next pushed packet
+  uint8_t  subs;              // number of subscribers
+  rx_sub_t sub[RX_RING_SUBS]; // subscribers
+  uint32_t cnt;               // pushed packets counter
+  uint32_t drops;             // dropped packets counter (all subscribers)
+} rx_ring_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init RX ring (no subscribers)
+void rx_ring_init(rx_ring_t *self);
+//-----------------------------------------------------------------------------
+// add subscriber (return subscriber index or -1 if no room)
+int8_t rx_ring_subscribe(rx_ring_t *self,
+                         rx_ring_cb_t cb,   // callback function
+                         void *context,     // context for callback or NULL
+                         const char *name); // subscriber name
+//-----------------------------------------------------------------------------
+// get free slot to write next packet (never fails, never waits)
+// note: the oldest packet not consumed by slow subscriber(s) is dropped
+rx_pkt_t *rx_ring_alloc(rx_ring_t *self);
+//-----------------------------------------------------------------------------
+// publish packet written to slot returned by rx_ring_alloc()
+void rx_ring_push(rx_ring_t *self);
+//-----------------------------------------------------------------------------
+// deliver pending packets to all subscribers (call from main loop)
+void rx_ring_yield(rx_ring_t *self);
+//-----------------------------------------------------------------------------
+// reset all counters
+void rx_ring_reset(rx_ring_t *self);
+//-----------------------------------------------------------------------------
+// number of packets pending for subscriber
+INLINE uint8_t rx_ring_pending(const rx_ring_t *self, uint8_t i)
+{
+  return (uint8_t) (self->head - self->sub[i].tail);
+}
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // RX_RING_H
+
+/*** end of "rx_ring.h" file ***/
+
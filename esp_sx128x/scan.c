@@ -0,0 +1,140 @@
+/*
+ * Spectrum energy scanner: instantaneous RSSI statistic per channel
+ * File: "scan.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include <stdio.h>  // snprintf()
+#include "sx128x.h" // sx128x_freq2code()
+#include "scan.h"
+//-----------------------------------------------------------------------------
+// CSV header
+const char scan_csv_head[] = "ch,freq_khz,min_dbm,avg_dbm,max_dbm,busy_pct";
+//-----------------------------------------------------------------------------
+// init scanner (default plan and threshold)
+void scan_init(scan_t *self)
+{
+  self->fmin     = 0;
+  self->step     = 0;
+  self->channels = 0;
+  self->thr      = SCAN_THRESHOLD;
+  self->time     = 0;
+  self->t0       = 0;
+  scan_plan(self, SCAN_FREQ_MIN, SCAN_FREQ_MAX, SCAN_STEP);
+  scan_reset(self);
+}
+//-----------------------------------------------------------------------------
+// reset statistic of all channels
+void scan_reset(scan_t *self)
+{
+  memset((void*) self->ch, 0, sizeof(self->ch));
+  self->sweeps = 0;
+  self->ready  = 0;
+}
+//-----------------------------------------------------------------------------
+// set channel plan and precompute PLL codes (statistic reset if plan changed)
+// (return number of channels)
+uint16_t scan_plan(scan_t *self, uint32_t fmin, uint32_t fmax, uint32_t step)
+{
+  uint32_t n;
+  uint16_t i;
+
+  if (step == 0) step = SCAN_STEP;
+  n = fmax > fmin ? (fmax - fmin) / step + 1 : 1;
+  if (n > SCAN_CHANNELS) n = SCAN_CHANNELS;
+
+  if (self->channels == n && self->fmin == fmin && self->step == step)
+    return self->channels; // same plan
+
+  self->fmin     = fmin;
+  self->step     = step;
+  self->channels = (uint16_t) n;
+
+  // divisions here => only one SPI write on each channel switch
+  for (i = 0; i < self->channels; i++)
+    self->code[i] = sx128x_freq2code(scan_freq(self, i) * 1000);
+
+  scan_reset(self);
+  return self->channels;
+}
+//-----------------------------------------------------------------------------
+// mark sweep start (t = TIME_FUNC())
+void scan_begin(scan_t *self, unsigned long t)
+{
+  self->t0 = t;
+}
+//-----------------------------------------------------------------------------
+// mark sweep finish (t = TIME_FUNC())
+void scan_end(scan_t *self, unsigned long t)
+{
+  self->time = (uint32_t) (((uint64_t) (uint32_t) (t - self->t0) * 1000) /
+                           TIME_FACTOR);
+  self->sweeps++;
+  self->ready = 1;
+}
+//-----------------------------------------------------------------------------
+// account one RSSI sample of channel (rssi = -dBm*2)
+void scan_add(scan_t *self, uint16_t ch, uint8_t rssi)
+{
+  scan_ch_t *c;
+  if (ch >= self->channels) return;
+  c = &self->ch[ch];
+
+  if (c->n == 0 || rssi < c->rssi_min) c->rssi_min = rssi;
+  if (c->n == 0 || rssi > c->rssi_max) c->rssi_max = rssi;
+  c->rssi_sum += rssi;
+  c->n++;
+  if (rssi <= self->thr) c->busy++;
+}
+//-----------------------------------------------------------------------------
+// channel frequency [kHz]
+uint32_t scan_freq(const scan_t *self, uint16_t ch)
+{
+  return self->fmin + (uint32_t) ch * self->step;
+}
+//-----------------------------------------------------------------------------
+// cleanest channel (lowest mean RSSI, -1 if no samples)
+int16_t scan_best(const scan_t *self)
+{
+  int16_t best = -1;
+  uint32_t best_sum = 0;
+  uint16_t i;
+
+  for (i = 0; i < self->channels; i++)
+  {
+    const scan_ch_t *c = &self->ch[i];
+    if (c->n == 0) continue;
+
+    // greater mean of -dBm*2 => lower power (compare sum/n by cross products)
+    if (best < 0 ||
+        (uint64_t) c->rssi_sum * self->ch[best].n >
+        (uint64_t) best_sum * c->n)
+    {
+      best     = (int16_t) i;
+      best_sum = c->rssi_sum;
+    }
+  }
+  return best;
+}
+//-----------------------------------------------------------------------------
+// format CSV row of channel (one line without EOL)
+int scan_csv(const scan_t *self, uint16_t ch, char *buf, size_t size)
+{
+  const scan_ch_t *c = &self->ch[ch];
+  uint32_t avg  = c->n ? // [0.1 dB]
+    (uint32_t) (((uint64_t) c->rssi_sum * 5 + c->n / 2) / c->n) : 0;
+  uint32_t busy = c->n ? // [0.1%]
+    (uint32_t) (((uint64_t) c->busy * 1000 + c->n / 2) / c->n) : 0;
+
+  return snprintf(buf, size,
+    "%u,%lu,-%u.%u,-%lu.%lu,-%u.%u,%lu.%lu",
+    (unsigned) ch, (unsigned long) scan_freq(self, ch),
+    (unsigned) (c->rssi_max >> 1), (unsigned) (c->rssi_max & 1) * 5,
+    (unsigned long) (avg / 10), (unsigned long) (avg % 10),
+    (unsigned) (c->rssi_min >> 1), (unsigned) (c->rssi_min & 1) * 5,
+    (unsigned long) (busy / 10), (unsigned long) (busy % 10));
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "scan.c" file ***/
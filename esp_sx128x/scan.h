@@ -0,0 +1,89 @@
+/*
+ * Spectrum energy scanner: instantaneous RSSI statistic per channel
+ * File: "scan.h"
+ */
+
+#pragma once
+#ifndef SCAN_H
+#define SCAN_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+//-----------------------------------------------------------------------------
+// channel plan by default (2400...2500 MHz, 1 MHz step)
+#define SCAN_FREQ_MIN 2400000 // minimal frequency [kHz]
+#define SCAN_FREQ_MAX 2500000 // maximal frequency [kHz]
+#define SCAN_STEP        1000 // channel step [kHz]
+#define SCAN_DWELL          1 // dwell time on each channel [ms]
+#define SCAN_SAMPLES        8 // RSSI samples on each channel
+#define SCAN_THRESHOLD    180 // "busy" threshold = -90 dBm (-dBm*2)
+
+#ifndef SCAN_CHANNELS
+#  define SCAN_CHANNELS 101 // maximal number of channels in plan
+#endif
+//-----------------------------------------------------------------------------
+// occupancy of one channel (RSSI = -rssi/2 [dBm])
+typedef struct scan_ch_ {
+  uint8_t  rssi_min; // strongest sample
+  uint8_t  rssi_max; // weakest sample
+  uint32_t rssi_sum; // sum of samples
+  uint32_t n;        // number of samples
+  uint32_t busy;     // samples stronger than threshold
+} scan_ch_t;
+//-----------------------------------------------------------------------------
+// spectrum scanner
+typedef struct scan_ {
+  uint32_t fmin;                  // first channel frequency [kHz]
+  uint32_t step;                  // channel step [kHz]
+  uint16_t channels;              // number of channels in plan
+  uint32_t code[SCAN_CHANNELS];   // precomputed PLL codes of channels
+  scan_ch_t ch[SCAN_CHANNELS];    // statistic of channels
+  uint8_t  thr;                   // "busy" threshold (-dBm*2)
+  uint32_t sweeps;                // finished sweeps
+  uint32_t time;                  // duration of last sweep [us]
+  unsigned long t0;               // start time of current sweep
+  uint8_t  ready;                 // 1 - sweep finished and not reported yet
+} scan_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init scanner (default plan and threshold)
+void scan_init(scan_t *self);
+//-----------------------------------------------------------------------------
+// reset statistic of all channels
+void scan_reset(scan_t *self);
+//-----------------------------------------------------------------------------
+// set channel plan and precompute PLL codes (statistic reset if plan changed)
+// (return number of channels)
+uint16_t scan_plan(scan_t *self, uint32_t fmin, uint32_t fmax, uint32_t step);
+//-----------------------------------------------------------------------------
+// mark sweep start/finish (t = TIME_FUNC())
+void scan_begin(scan_t *self, unsigned long t);
+void scan_end(scan_t *self, unsigned long t);
+//-----------------------------------------------------------------------------
+// account one RSSI sample of channel (rssi = -dBm*2)
+void scan_add(scan_t *self, uint16_t ch, uint8_t rssi);
+//-----------------------------------------------------------------------------
+// channel frequency [kHz]
+uint32_t scan_freq(const scan_t *self, uint16_t ch);
+//-----------------------------------------------------------------------------
+// cleanest channel (lowest mean RSSI, -1 if no samples)
+int16_t scan_best(const scan_t *self);
+//-----------------------------------------------------------------------------
+// CSV header "ch,freq_khz,min_dbm,avg_dbm,max_dbm,busy_pct"
+extern const char scan_csv_head[];
+//-----------------------------------------------------------------------------
+// format CSV row of channel (one line without EOL)
+int scan_csv(const scan_t *self, uint16_t ch, char *buf, size_t size);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // SCAN_H
+
+/*** end of "scan.h" file ***/
@@ -0,0 +1,209 @@
+/*
+ * Link statistics: counters per mode, RSSI/SNR/FEI/dT histograms, PER
+ * File: "stats.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "stats.h"
+#include "sx128x_def.h"
+//-----------------------------------------------------------------------------
+// init histogram
+void stats_hist_init(stats_hist_t *h, int32_t min, int32_t step)
+{
+  h->min  = min;
+  h->step = step > 0 ? step : 1;
+  stats_hist_clear(h);
+}
+//-----------------------------------------------------------------------------
+// clear histogram (keep range)
+void stats_hist_clear(stats_hist_t *h)
+{
+  h->cnt   = 0;
+  h->under = 0;
+  h->over  = 0;
+  h->vmin  = 0;
+  h->vmax  = 0;
+  h->sum   = 0;
+  memset((void*) h->bin, 0, sizeof(h->bin));
+}
+//-----------------------------------------------------------------------------
+// add value to histogram
+void stats_hist_add(stats_hist_t *h, int32_t v)
+{
+  if (h->cnt == 0 || v < h->vmin) h->vmin = v;
+  if (h->cnt == 0 || v > h->vmax) h->vmax = v;
+  h->cnt++;
+  h->sum += v;
+
+  if (v < h->min)
+    h->under++;
+  else
+  {
+    uint32_t i = ((uint32_t) (v - h->min)) / (uint32_t) h->step;
+    if (i >= STATS_BINS)
+      h->over++;
+    else
+      h->bin[i]++;
+  }
+}
+//-----------------------------------------------------------------------------
+// mean value of histogram rounded to nearest (0 if empty)
+int32_t stats_hist_mean(const stats_hist_t *h)
+{
+  int64_t half = (int64_t) (h->cnt / 2);
+  if (h->cnt == 0) return 0;
+  return (int32_t) ((h->sum + (h->sum < 0 ? -half : half)) / (int64_t) h->cnt);
+}
+//-----------------------------------------------------------------------------
+// percentile (0...100) of histogram (middle of bin; 0 if empty)
+int32_t stats_hist_percentile(const stats_hist_t *h, uint8_t p)
+{
+  uint32_t rank, acc;
+  int i;
+
+  if (h->cnt == 0) return 0;
+  if (p > 100) p = 100;
+
+  // rank of value (1...cnt)
+  rank = (uint32_t) (((uint64_t) h->cnt * p + 99) / 100);
+  if (rank == 0) rank = 1;
+
+  acc = h->under;
+  if (rank <= acc) return h->vmin;
+
+  for (i = 0; i < STATS_BINS; i++)
+  {
+    acc += h->bin[i];
+    if (rank <= acc)
+    {
+      int32_t v = h->min + h->step * i + h->step / 2;
+      if (v < h->vmin) v = h->vmin;
+      if (v > h->vmax) v = h->vmax;
+      return v;
+    }
+  }
+
+  return h->vmax; // overflow
+}
+//-----------------------------------------------------------------------------
+// init statistics (sequence counter off)
+void stats_init(stats_t *self)
+{
+  self->seq_offset = -1;
+  stats_reset(self);
+}
+//-----------------------------------------------------------------------------
+// reset all counters and histograms (keep sequence counter offset)
+void stats_reset(stats_t *self)
+{
+  memset((void*) self->cnt, 0, sizeof(self->cnt));
+  stats_hist_init(&self->rssi, STATS_RSSI_MIN, STATS_RSSI_STEP);
+  stats_hist_init(&self->snr,  STATS_SNR_MIN,  STATS_SNR_STEP);
+  stats_hist_init(&self->fei,  STATS_FEI_MIN,  STATS_FEI_STEP);
+  stats_hist_init(&self->dt,   STATS_DT_MIN,   STATS_DT_STEP);
+  self->t_valid   = 0;
+  self->seq_valid = 0;
+}
+//-----------------------------------------------------------------------------
+// account IRQ flags (call from IRQ handler)
+void stats_irq(stats_t *self, uint8_t mode, uint16_t irq)
+{
+  stats_cnt_t *cnt;
+  if (mode >= STATS_MODES) return;
+  cnt = &self->cnt[mode];
+
+  if (irq & SX128X_IRQ_TX_DONE)          cnt->tx++;
+  if (irq & SX128X_IRQ_RX_DONE)          cnt->rx++;
+  if (irq & SX128X_IRQ_CRC_ERROR)        cnt->crc_err++;
+  if (irq & SX128X_IRQ_HEADER_ERROR)     cnt->hdr_err++;
+  if (irq & SX128X_IRQ_SYNC_WORD_ERROR)  cnt->sync_err++;
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT)    cnt->timeout++;
+  if (irq & SX128X_IRQ_MASTER_TIMEOUT)   cnt->timeout++;
+}
+//-----------------------------------------------------------------------------
+// account ranging result
+void stats_ranging(stats_t *self, uint8_t mode)
+{
+  if (mode < STATS_MODES) self->cnt[mode].ranging++;
+}
+//-----------------------------------------------------------------------------
+// account received packet (RX ring subscriber, context = stats_t*)
+uint8_t stats_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  stats_t *self = (stats_t*) context;
+  const sx128x_rx_t *rx = &pkt->rx;
+  stats_cnt_t *cnt;
+
+  if (pkt->mode >= STATS_MODES || !rx->crc_ok) return 1;
+  cnt = &self->cnt[pkt->mode];
+  cnt->rx_ok++;
+
+  // signal quality (SNR without rounding: no bias of mean/percentiles)
+  stats_hist_add(&self->rssi, -((int32_t) (rx->rssi >> 1)));
+  if (rx->lora)
+  {
+    stats_hist_add(&self->snr, (int32_t) rx->snr); // [dB/4]
+    stats_hist_add(&self->fei, rx->fei);
+  }
+
+  // inter-arrival time
+  if (self->t_valid)
+    stats_hist_add(&self->dt,
+                   (int32_t) ((uint32_t) (pkt->t - self->t) / (TIME_FACTOR)));
+  self->t = pkt->t;
+  self->t_valid = 1;
+
+  // sequence gaps
+  if (self->seq_offset >= 0 && pkt->size >= self->seq_offset + 2)
+  {
+    uint16_t seq = ((uint16_t) pkt->data[self->seq_offset]) |
+                   ((uint16_t) pkt->data[self->seq_offset + 1] << 8);
+    uint16_t d    = (uint16_t) (seq - self->seq_last); // ahead
+    uint16_t back = (uint16_t) (self->seq_last - seq); // behind
+
+    if (!self->seq_valid || (d >= 0x8000 && back >= STATS_HISTORY))
+    { // first packet or far in the past (transmitter restarted)
+      self->seq_last = seq;
+      self->seq_seen = 1;
+      cnt->seq++;
+    }
+    else if (d == 0)
+      cnt->dup++; // same as last
+    else if (d < 0x8000)
+    { // new packet (d-1 lost before it)
+      cnt->lost += d - 1;
+      cnt->seq++;
+      self->seq_seen = d >= STATS_HISTORY ? 1 : (self->seq_seen << d) | 1;
+      self->seq_last = seq;
+    }
+    else if (self->seq_seen & ((uint64_t) 1 << back))
+      cnt->dup++; // already received
+    else
+    { // late packet (was counted as lost)
+      self->seq_seen |= (uint64_t) 1 << back;
+      if (cnt->lost) cnt->lost--;
+      cnt->reorder++;
+      cnt->seq++;
+    }
+    self->seq_valid = 1;
+  }
+
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// Packet Error Rate [0.1%] by sequence gaps of mode (-1 if unknown)
+int16_t stats_per(const stats_t *self, uint8_t mode)
+{
+  const stats_cnt_t *cnt;
+  uint32_t all;
+  if (mode >= STATS_MODES) return -1;
+  cnt = &self->cnt[mode];
+
+  all = cnt->seq + cnt->lost;
+  if (all == 0) return -1;
+  return (int16_t) (((uint64_t) cnt->lost * 1000 + all / 2) / all);
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "stats.c" file ***/
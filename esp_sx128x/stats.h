@@ -0,0 +1,120 @@
+/*
+ * Link statistics: counters per mode, RSSI/SNR/FEI/dT histograms, PER
+ * File: "stats.h"
+ */
+
+#pragma once
+#ifndef STATS_H
+#define STATS_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+#define STATS_MODES 5 // GFSK, LoRa, Ranging, FLRC, BLE
+
+#ifndef STATS_BINS
+#  define STATS_BINS 32 // number of histogram bins
+#endif
+
+// histograms ranges (min, step)
+#define STATS_RSSI_MIN  -128 // [dBm]
+#define STATS_RSSI_STEP    4 // [dB]
+#define STATS_SNR_MIN    -80 // [dB/4] (-20 dB)
+#define STATS_SNR_STEP     4 // [dB/4] (1 dB)
+#define STATS_FEI_MIN -32000 // [Hz]
+#define STATS_FEI_STEP  2000 // [Hz]
+#define STATS_DT_MIN       0 // [ms]
+#define STATS_DT_STEP     10 // [ms]
+
+#define STATS_HISTORY 64 // sequence bitmap depth (duplicate/reorder check)
+//-----------------------------------------------------------------------------
+// fixed memory linear histogram
+typedef struct stats_hist_ {
+  int32_t  min;   // low edge of first bin
+  int32_t  step;  // bin width
+  uint32_t cnt;   // number of values
+  uint32_t under; // values less than min
+  uint32_t over;  // values more than last bin
+  int32_t  vmin;  // minimal value
+  int32_t  vmax;  // maximal value
+  int64_t  sum;   // sum of values (for mean)
+  uint32_t bin[STATS_BINS];
+} stats_hist_t;
+//-----------------------------------------------------------------------------
+// counters of one mode (packet type)
+typedef struct stats_cnt_ {
+  uint32_t tx;       // TxDone
+  uint32_t rx;       // RxDone (all)
+  uint32_t rx_ok;    // received with CRC ok
+  uint32_t crc_err;  // CRC errors
+  uint32_t hdr_err;  // LoRa header errors
+  uint32_t sync_err; // sync word errors
+  uint32_t timeout;  // RX/TX and ranging master timeouts
+  uint32_t ranging;  // ranging results
+  uint32_t seq;      // received unique packets with sequence counter
+  uint32_t lost;     // lost packets (sequence gaps without late packets)
+  uint32_t dup;      // duplicated packets
+  uint32_t reorder;  // reordered (late) packets
+} stats_cnt_t;
+//-----------------------------------------------------------------------------
+// link statistics
+typedef struct stats_ {
+  stats_cnt_t  cnt[STATS_MODES]; // counters per mode
+  stats_hist_t rssi;   // RSSI [dBm]
+  stats_hist_t snr;    // SNR [dB/4] (LoRa/Ranging)
+  stats_hist_t fei;    // FEI [Hz] (LoRa/Ranging)
+  stats_hist_t dt;     // inter-arrival time [ms]
+  unsigned long t;     // last packet time (TIME_FUNC())
+  uint8_t  t_valid;    // 1 - `t` is valid
+  uint8_t  seq_valid;  // 1 - `seq_last` is valid
+  uint16_t seq_last;   // last (maximal) sequence counter
+  uint64_t seq_seen;   // bitmap of received seq_last, seq_last-1,...
+  int16_t  seq_offset; // offset of 16-bit LE counter in payload (-1 - off)
+} stats_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init histogram
+void stats_hist_init(stats_hist_t *h, int32_t min, int32_t step);
+//-----------------------------------------------------------------------------
+// clear histogram (keep range)
+void stats_hist_clear(stats_hist_t *h);
+//-----------------------------------------------------------------------------
+// add value to histogram
+void stats_hist_add(stats_hist_t *h, int32_t v);
+//-----------------------------------------------------------------------------
+// mean value of histogram rounded to nearest (0 if empty)
+int32_t stats_hist_mean(const stats_hist_t *h);
+//-----------------------------------------------------------------------------
+// percentile (0...100) of histogram (middle of bin; 0 if empty)
+int32_t stats_hist_percentile(const stats_hist_t *h, uint8_t p);
+//-----------------------------------------------------------------------------
+// init statistics (sequence counter off)
+void stats_init(stats_t *self);
+//-----------------------------------------------------------------------------
+// reset all counters and histograms (keep sequence counter offset)
+void stats_reset(stats_t *self);
+//-----------------------------------------------------------------------------
+// account IRQ flags (call from IRQ handler)
+void stats_irq(stats_t *self, uint8_t mode, uint16_t irq);
+//-----------------------------------------------------------------------------
+// account ranging result
+void stats_ranging(stats_t *self, uint8_t mode);
+//-----------------------------------------------------------------------------
+// account received packet (RX ring subscriber, context = stats_t*)
+uint8_t stats_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+// Packet Error Rate [0.1%] by sequence gaps of mode (-1 if unknown)
+int16_t stats_per(const stats_t *self, uint8_t mode);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // STATS_H
+
+/*** end of "stats.h" file ***/
@@ -7,7 +7,6 @@
 #include <stdio.h>  // NULL
 #include <string.h> // memset(), memcpy()
 #include <stdlib.h> // abs()
-#include <limits.h> // INT_MAX, INT_MIN
 #include "sx128x.h" // `sx128x_t` class
 #include "crc8.h"   // CRC8 function
 //-----------------------------------------------------------------------------
@@ -67,6 +66,7 @@ const sx128x_pars_t sx128x_pars_default = {
   3,          // bits check mode: 0...3 {8, 16, 24, 32 bits}
   13315,      // Ranging calibration value (24 bit), by reset 0x005FD2
   0,          // Advanced Ranging activate (1-on, 0-off)
+  SX128X_CALIB_TABLE, // calibration by BW (406, 812, 1625 kHz) and SF (5...10)
 #endif
 
 #ifdef SX128X_USE_FLRC
@@ -115,36 +115,103 @@ const sx128x_pars_t sx128x_pars_default = {
   0,          // auto TX delay: 0 - off, real delay = 33 + time us
 #endif
 };
+#ifdef SX128X_USE_TRACE
 //-----------------------------------------------------------------------------
-// SPI exchange wrapper (+check BUSY with timeout)
-static int8_t sx128x_spi(sx128x_t *self, int nbytes)
+// init SPI transaction trace ring (off by default)
+void sx128x_trace_init(sx128x_trace_t *trace, uint32_t (*time_us)(void))
 {
-  // wait BUSY down
-  if (self->busy_wait(SX128X_TIMEOUT, self->dev_context)) return SX128X_ERR_BUSY;
+  trace->time_us = time_us;
+  trace->on      = 0;
+  sx128x_trace_clear(trace);
+}
+//-----------------------------------------------------------------------------
+// clear SPI transaction trace ring
+void sx128x_trace_clear(sx128x_trace_t *trace)
+{
+  trace->head = 0;
+  trace->cnt  = 0;
+}
+//-----------------------------------------------------------------------------
+// get trace time [us] (0 if tracer is off)
+static inline uint32_t sx128x_trace_time(const sx128x_t *self)
+{
+  return self->trace && self->trace->on ? self->trace->time_us() : 0;
+}
+//-----------------------------------------------------------------------------
+// save SPI transaction to trace ring
+static void sx128x_trace_put(sx128x_t *self, const uint8_t *tx, uint16_t len,
+                             uint32_t t0, uint32_t t1, int8_t err)
+{
+  sx128x_trace_t *trace = self->trace;
+  sx128x_trace_rec_t *rec;
+  uint32_t t2;
 
-  // SPI echange (rxbuf, txbuf)
-  if (!self->spi_exchange(self->rxbuf, self->txbuf, nbytes,
-                          self->dev_context)) return SX128X_ERR_SPI;
+  if (!trace || !trace->on) return;
+  t2 = trace->time_us();
+  if (err == SX128X_ERR_BUSY) t1 = t2; // no transfer
 
-  self->status = self->rxbuf[0]; // save last status
-  return SX128X_ERR_NONE;
+  rec = &trace->rec[trace->head];
+  rec->t      = t0;
+  rec->busy   = (uint16_t) SX128X_MIN(t1 - t0, 0xFFFFu);
+  rec->xfer   = (uint16_t) SX128X_MIN(t2 - t1, 0xFFFFu);
+  rec->len    = len;
+  rec->opcode = tx[0];
+  rec->err    = err;
+
+  if (++trace->head >= SX128X_TRACE_SIZE) trace->head = 0;
+  trace->cnt++;
 }
+#endif // SX128X_USE_TRACE
 //-----------------------------------------------------------------------------
-// SPI exchange wrapper - send pktpars[]
-static int8_t sx128x_spi_pktpars(sx128x_t *self)
+// SPI exchange with BUSY wait (+trace)
+static int8_t sx128x_spi_tx(sx128x_t *self, const uint8_t *tx, uint16_t len)
 {
+#ifdef SX128X_USE_TRACE
+  uint32_t t0 = sx128x_trace_time(self), t1;
+#endif
+
   // wait BUSY down
-  if (self->busy_wait(SX128X_TIMEOUT, self->dev_context)) return SX128X_ERR_BUSY;
+  if (self->busy_wait(SX128X_TIMEOUT, self->dev_context))
+  {
+#ifdef SX128X_USE_TRACE
+    sx128x_trace_put(self, tx, len, t0, t0, SX128X_ERR_BUSY);
+#endif
+    return SX128X_ERR_BUSY;
+  }
 
-  // SPI exchange (rxbuf, pktpars)
-  if (!self->spi_exchange(self->rxbuf, self->pktpars,
-                          SX128X_PKT_PARS_BUF_SIZE,
-                          self->dev_context)) return SX128X_ERR_SPI;
+#ifdef SX128X_USE_TRACE
+  t1 = sx128x_trace_time(self);
+#endif
+
+  // SPI echange (rxbuf, tx)
+  if (!self->spi_exchange(self->rxbuf, tx, len, self->dev_context))
+  {
+#ifdef SX128X_USE_TRACE
+    sx128x_trace_put(self, tx, len, t0, t1, SX128X_ERR_SPI);
+#endif
+    return SX128X_ERR_SPI;
+  }
+
+#ifdef SX128X_USE_TRACE
+  sx128x_trace_put(self, tx, len, t0, t1, SX128X_ERR_NONE);
+#endif
 
   self->status = self->rxbuf[0]; // save last status
   return SX128X_ERR_NONE;
 }
 //-----------------------------------------------------------------------------
+// SPI exchange wrapper (+check BUSY with timeout)
+static int8_t sx128x_spi(sx128x_t *self, int nbytes)
+{
+  return sx128x_spi_tx(self, self->txbuf, nbytes);
+}
+//-----------------------------------------------------------------------------
+// SPI exchange wrapper - send pktpars[]
+static int8_t sx128x_spi_pktpars(sx128x_t *self)
+{
+  return sx128x_spi_tx(self, self->pktpars, SX128X_PKT_PARS_BUF_SIZE);
+}
+//-----------------------------------------------------------------------------
 // run command without any params (write 1 byte of opcode)
 static int8_t sx128x_cmd(sx128x_t *self, uint8_t opcode)
 {
@@ -240,6 +307,18 @@ int8_t sx128x_buf_read(sx128x_t *self,
   }
   return SX128X_ERR_NONE;
 }
+#ifdef SX128X_USE_RANGING
+//-----------------------------------------------------------------------------
+// cache registers modified by sx128x_advanced_ranging_read()
+static int8_t sx128x_advanced_ranging_cache(sx128x_t *self)
+{
+  int8_t retv = sx128x_reg_read(self, SX128X_REG_RANGING_ADDR_MUX,
+                                &self->ar_mux, 1);
+  if (retv != SX128X_ERR_NONE) return retv;
+  return sx128x_reg_read(self, SX128X_REG_FREEZE_RANGING_RESULT,
+                         &self->ar_freeze, 1);
+}
+#endif // SX128X_USE_RANGING
 //-----------------------------------------------------------------------------
 // init SX128x radio module
 int8_t sx128x_init(
@@ -265,6 +344,9 @@ int8_t sx128x_init(
   self->busy_wait    = busy_wait;
   self->spi_exchange = spi_exchange;
   self->dev_context  = dev_context;
+#ifdef SX128X_USE_TRACE
+  self->trace        = NULL;
+#endif
   self->sleep        = 0;
   self->status       = 0;
 
@@ -405,15 +487,17 @@ int8_t sx128x_set_pars(
       sx128x_ranging_slave_address(self, pars->slave_address, pars->slave_mode);
       if (retv != SX128X_ERR_NONE) return retv;
 
-      // set ranging callibration register value (24 bit)
-      retv = sx128x_ranging_set_calibration(self, pars->calibration);
-      if (retv != SX128X_ERR_NONE) return retv;
+      // note: ranging calibration register (by BW/SF table) is set
+      //       by sx128x_mod_lora() above
 
       if (pars->advanced_ranging)
       { // set Advanced Ranging (by writing 0x01 to opcode 0x9A)
         retv = sx128x_cmd_write(self, SX128X_CMD_SET_ADVANCED_RANGING, 0x01);
         if (retv != SX128X_ERR_NONE) return retv;
         self->pars->advanced_ranging = 1;
+
+        retv = sx128x_advanced_ranging_cache(self);
+        if (retv != SX128X_ERR_NONE) return retv;
       }
       else
       { // deactivate Advanced Ranging mode: write 0x00 to opcode 0x9A
@@ -833,7 +917,7 @@ int8_t sx128x_save_context(sx128x_t *self)
 //-----------------------------------------------------------------------------
 // convert RF frequency from Hz to code (code = freq * 2**10 / (5**6 * 13))
 // note: rf_step = 56 MHz / 2**18 = 13 * 5**6 / 2**10 = 198.3642578125 Hz
-static uint32_t sx128x_freq2code(uint32_t freq)
+uint32_t sx128x_freq2code(uint32_t freq)
 {
   uint32_t code = (freq / (13UL * 15625UL)) << 11UL;
   freq       = (freq % (13UL * 15625UL)) << 11UL;
@@ -843,7 +927,7 @@ static uint32_t sx128x_freq2code(uint32_t freq)
 //-----------------------------------------------------------------------------
 // convert RF frequency code to Hz (freq = code * 13 * 5**6 / 2**10)
 // note: rf_step = 56 MHz / 2**18 = 13 * 5**6 / 2**10 = 198.3642578125 Hz
-static uint32_t sx128x_code2freq(uint32_t code)
+uint32_t sx128x_code2freq(uint32_t code)
 { // code = 0...21651921
   uint32_t cl = (code >>  0) & 0x3FFF; // 0...16383
   uint32_t ch = (code >> 14) & 0x7FF;  // 0...1321
@@ -856,7 +940,12 @@ static uint32_t sx128x_code2freq(uint32_t code)
 // set RF frequency [Hz]
 int8_t sx128x_set_frequency(sx128x_t *self, uint32_t freq)
 {
-  uint32_t code    = sx128x_freq2code(freq);
+  return sx128x_set_frequency_code(self, sx128x_freq2code(freq));
+}
+//-----------------------------------------------------------------------------
+// set RF frequency by precomputed PLL code (fast channel switch)
+int8_t sx128x_set_frequency_code(sx128x_t *self, uint32_t code)
+{
   self->pars->freq = sx128x_code2freq(code);
 
   SX128X_DBG("set RF frequency to %uHz (code=%u)",
@@ -1369,6 +1458,16 @@ int8_t sx128x_mod_lora(
   self->txbuf[2] = bw_param;
   self->txbuf[3] = cr;
 
+#ifdef SX128X_USE_RANGING
+  if (ranging)
+  { // calibration depends on BW/SF (AN1200.29 Table 1)
+    int8_t retv = sx128x_spi(self, 4);
+    if (retv != SX128X_ERR_NONE) return retv;
+    return sx128x_ranging_set_calibration(self,
+                                          sx128x_ranging_calib_value(self->pars));
+  }
+#endif
+
   return sx128x_spi(self, 4);
 }
 //-----------------------------------------------------------------------------
@@ -1536,6 +1635,20 @@ int8_t sx128x_rssi_lora(
 //-----------------------------------------------------------------------------
 #endif // SX128X_USE_LORA || SX128X_USE_RANGING
 //-----------------------------------------------------------------------------
+// LoRa/Ranging BW [kHz] to exact BW [Hz] (203/406/812 kHz are
+// 203.125/406.25/812.5 kHz)
+INLINE uint32_t sx128x_lora_bw_hz(uint16_t bw)
+{
+  switch (bw)
+  {
+    case  203: return  203125;
+    case  406: return  406250;
+    case  812: return  812500;
+    case    0: return 1625000;
+    default:   return (uint32_t) bw * 1000;
+  }
+}
+//-----------------------------------------------------------------------------
 #ifdef SX128X_USE_RANGING
 //-----------------------------------------------------------------------------
 // set Ranging role (0x01-Master, 0x00-Slave)
@@ -1565,6 +1678,29 @@ int8_t sx128x_ranging_master_address(sx128x_t *self, uint32_t address)
   return sx128x_reg_write(self, SX128X_REG_RANGING_REQ_ADDR3, buf, 4);
 }
 //-----------------------------------------------------------------------------
+// update Ranging master request address by writing changed bytes only
+// (chip register is supposed to hold pars->master_address)
+int8_t sx128x_ranging_master_address_update(sx128x_t *self, uint32_t address)
+{
+  uint8_t buf[4], i;
+  uint32_t diff = address ^ self->pars->master_address;
+
+  if (diff == 0) return SX128X_ERR_NONE; // no SPI exchange
+
+  self->pars->master_address = address;
+
+  buf[0] = (address >> 24) & 0xFF; // byte 3
+  buf[1] = (address >> 16) & 0xFF; // byte 2
+  buf[2] = (address >>  8) & 0xFF; // byte 1
+  buf[3] = (address      ) & 0xFF; // byte 0
+
+  // first changed byte (from byte 3), registers are consecutive
+  for (i = 0; i < 3 && (diff >> (24 - 8 * i)) == 0; i++);
+
+  return sx128x_reg_write(self, SX128X_REG_RANGING_REQ_ADDR3 + i,
+                          buf + i, 4 - i);
+}
+//-----------------------------------------------------------------------------
 // set Ranging slave respond address and bits check mode
 int8_t sx128x_ranging_slave_address(
   sx128x_t *self,
@@ -1633,18 +1769,50 @@ int8_t sx128x_ranging_get_calibration(sx128x_t *self, uint32_t *callibration)
   return SX128X_ERR_NONE;
 }
 //-----------------------------------------------------------------------------
+// get pointer to calibration table cell by BW [kHz] and SF
+// (BW/SF are limited as by sx128x_mod_lora() in Ranging mode)
+uint16_t *sx128x_ranging_calib_cell(sx128x_pars_t *pars, uint16_t bw, uint8_t sf)
+{
+  uint8_t b = bw <= 600 ? 0 : bw <= 1200 ? 1 : 2;
+  sf = SX128X_LIMIT(sf, SX128X_CALIB_SF_MIN,
+                        SX128X_CALIB_SF_MIN + SX128X_CALIB_SFS - 1);
+  return &pars->calib[b][sf - SX128X_CALIB_SF_MIN];
+}
+//-----------------------------------------------------------------------------
+// calibration value for current BW/SF: table cell or `calibration` if 0
+uint32_t sx128x_ranging_calib_value(sx128x_pars_t *pars)
+{
+  uint16_t calib = *sx128x_ranging_calib_cell(pars, pars->bw, pars->sf);
+  return calib ? (uint32_t) calib : pars->calibration;
+}
+//-----------------------------------------------------------------------------
+// convert raw 24-bit Ranging result to distance [cm] by BW [kHz]
+// (exact with rounding to nearest: d[m] = raw * 150 / (2^12 * BW[MHz]),
+// BW 203/406/812 kHz are 203.125/406.25/812.5 kHz)
+int32_t sx128x_ranging_distance(uint32_t result, uint16_t bw)
+{ // |raw| <= 2^23 => |raw * 1.5e10| < 2^57, 2^12 * BW[Hz] < 2^33
+  int64_t raw = (int64_t) (result & 0xFFFFFF), num, den;
+  uint32_t hz; // BW [Hz]
+
+  if (raw & 0x800000) raw -= 0x1000000; // 24 bit signed
+
+  hz = sx128x_lora_bw_hz(bw);
+  num = raw * 15000000000LL; // 150 m * 100 cm * 1e6 Hz
+  den = (int64_t) hz << 12;
+  return (int32_t) ((num < 0 ? num - den / 2 : num + den / 2) / den);
+}
+//-----------------------------------------------------------------------------
 // get Ranging results
 int8_t sx128x_ranging_result(
   sx128x_t *self,
   uint8_t  *filter,   // result type (0-off, 1-on, 2-as-is) - modified
   uint32_t *result,   // raw result
-  int32_t *distance, // distance [dm]
+  int32_t  *distance, // distance [cm]
   uint8_t  *rssi)     // RSSI of last exchange
 {
   uint8_t buf[3], reg;
   int8_t retv;
   uint32_t bw = (uint32_t) self->pars->bw;
-  int32_t result_signed;
 
   if (bw < 400) bw = 406; // kHz
 
@@ -1689,21 +1857,8 @@ int8_t sx128x_ranging_result(
   retv = sx128x_standby(self, SX128X_STANDBY_RC);
   if (retv != SX128X_ERR_NONE) return retv;
 
-  // 24 bit signed -> 32 bit signed
-  result_signed = (int32_t) *result;
-  if (result_signed & 0x00800000) result_signed |= 0xFF000000;
-
   // Table 14-63: Ranging Result Type Selection (page 139)
-#if 0 // double - is bad idea
-  *distance = (int) (((double) result_signed) * 150. /
-                     ((double) (1<<12) * bw * 1e-3) * 10.); // dm
-#else // It's work! (only 32-bit integer arithmetic)
-  // note: (1625 << 10) / 8000 = 208
-  //        150 * 10 / 4 = 375
-  if      (result_signed > INT_MAX / 375) result_signed = INT_MAX / 375 - 1;
-  else if (result_signed < INT_MIN / 375) result_signed = INT_MAX / 375 + 1;
-  *distance = (((result_signed * 375) / 208) * (1625 / (int) bw)) / 8; // dm
-#endif
+  *distance = sx128x_ranging_distance(*result, (uint16_t) bw); // cm
 
   if (*filter >= 2)
   { // read ranging result MUX
@@ -1717,9 +1872,9 @@ int8_t sx128x_ranging_result(
   retv = sx128x_reg_read(self, SX128X_REG_RANGING_RSSI, rssi, 1);
   if (retv != SX128X_ERR_NONE) return retv;
 
-  SX128X_DBG("get Ranging result: Raw=0x%08X Signed=%i Distance=%idm "
+  SX128X_DBG("get Ranging result: Raw=0x%08X Distance=%icm "
              "Filter=%u RSSI=-%idBm/2",
-             (unsigned) *result, (int) result_signed, (int) *distance,
+             (unsigned) *result, (int) *distance,
              (unsigned) *filter, (int) *rssi);
 
   return SX128X_ERR_NONE;
@@ -1741,6 +1896,10 @@ int8_t sx128x_set_advanced_ranging(sx128x_t *self, uint8_t on)
     // [save activated state]
     self->pars->advanced_ranging = 1;
 
+    // [cache registers modified by sx128x_advanced_ranging_read()]
+    retv = sx128x_advanced_ranging_cache(self);
+    if (retv != SX128X_ERR_NONE) return retv;
+
     // 3. enable the AdvancedRangingDone interrupt
     retv = sx128x_irq_dio_mask(
              self,
@@ -1845,6 +2004,53 @@ int8_t sx128x_advanced_ranging_address(sx128x_t *self, uint32_t *address)
   return SX128X_ERR_NONE;
 }
 //-----------------------------------------------------------------------------
+// get Advanced Ranging exchange by batched register access (6 SPI
+// transactions, chip is left in STDBY_XOSC - restart RX after it):
+// received address, raw 24-bit result and RSSI
+int8_t sx128x_advanced_ranging_read(
+  sx128x_t *self,
+  uint32_t *address, // received address
+  uint32_t *result,  // raw result
+  uint8_t  *rssi)    // RSSI of exchange
+{ // 0x95F..0x964 are contiguous: address bytes 1:0, result and RSSI are
+  // read by one transaction, MUX and freeze registers are cached
+  uint8_t buf[6], reg;
+  int8_t retv;
+
+  *address = *result = 0;
+  *rssi = 0;
+
+  // 1. freeze result in STDBY_XOSC (like sx128x_ranging_result())
+  retv = sx128x_standby(self, SX128X_STANDBY_XOSC);
+  if (retv != SX128X_ERR_NONE) return retv;
+  reg = self->ar_freeze | (1 << 1);
+  retv = sx128x_reg_write(self, SX128X_REG_FREEZE_RANGING_RESULT, &reg, 1);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  // 2. address bytes 1:0 + result + RSSI
+  reg = self->ar_mux & 0xFC;
+  retv = sx128x_reg_write(self, SX128X_REG_RANGING_ADDR_MUX, &reg, 1);
+  if (retv != SX128X_ERR_NONE) return retv;
+  retv = sx128x_reg_read(self, SX128X_REG_RANGING_ADDR_HI, buf, 6);
+  if (retv != SX128X_ERR_NONE) return retv;
+  *address = ((uint32_t) buf[0] << 8) | (uint32_t) buf[1];
+  *result  = ((uint32_t) buf[2] << 16) | ((uint32_t) buf[3] << 8) |
+              (uint32_t) buf[4];
+  *rssi    = buf[5];
+
+  // 3. address bytes 3:2
+  reg = (self->ar_mux & 0xFC) | 0x01;
+  retv = sx128x_reg_write(self, SX128X_REG_RANGING_ADDR_MUX, &reg, 1);
+  if (retv != SX128X_ERR_NONE) return retv;
+  retv = sx128x_reg_read(self, SX128X_REG_RANGING_ADDR_HI, buf, 2);
+  if (retv != SX128X_ERR_NONE) return retv;
+  *address |= ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16);
+
+  SX128X_DBG("get Advanced Ranging: Address=0x%08X Raw=0x%06X RSSI=-%idBm/2",
+             (unsigned) *address, (unsigned) *result, (int) *rssi);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
 #endif // SX128X_USE_RANGING
 //-----------------------------------------------------------------------------
 #ifdef SX128X_USE_FLRC
@@ -2410,6 +2616,68 @@ int8_t sx128x_send(
   return sx128x_tx(self, timeout, timeout_base);
 }
 //-----------------------------------------------------------------------------
+// time on air of packet by current options [us] (help function)
+// (LoRa/Ranging: SX1280 datasheet, chapter 7.4 "LoRa Time-on-Air";
+// FLRC/GFSK/BLE: sum of preamble, sync word, header, payload and CRC bits)
+uint32_t sx128x_time_on_air(const sx128x_t *self, uint8_t payload_size)
+{
+  const sx128x_pars_t *pars = self->pars;
+  uint32_t bits = 0, rate = 1; // FLRC/GFSK/BLE: bits and bitrate [kbit/s]
+
+#if defined(SX128X_USE_LORA) || defined(SX128X_USE_RANGING)
+  if (pars->mode == SX128X_PACKET_TYPE_LORA ||
+      pars->mode == SX128X_PACKET_TYPE_RANGING)
+  {
+    uint32_t hz = sx128x_lora_bw_hz(pars->bw);
+    uint8_t sf  = pars->sf, cr = pars->cr;
+    int32_t pl  = 8 * ((int32_t) payload_size + (pars->crc == 2 ? 1 : 0)) +
+                  (pars->crc == 1 ? 16 : 0) - 4 * sf + (pars->fixed ? 0 : 20);
+    int32_t den = 4 * (sf > 10 ? sf - 2 : sf);
+    uint64_t nsym4; // symbols * 4 (preamble + 6.25 or 4.25 + 8 + payload)
+
+    if (cr > 4) cr = (cr == 7) ? 4 : cr - 4; // long interleaving ~ same rate
+    if (sf > 6) pl += 8;
+    if (pl < 0) pl = 0;
+    nsym4 = 4 * (uint64_t) pars->preamble + (sf > 6 ? 17 : 25) + 32 +
+            4 * (uint64_t) ((pl + den - 1) / den) * (cr + 4);
+    return (uint32_t) (((nsym4 << sf) * 250000 + hz / 2) / hz);
+  }
+#endif
+
+#ifdef SX128X_USE_FLRC
+  if (pars->mode == SX128X_PACKET_TYPE_FLRC)
+  { // preamble, 21 bits, sync word, coded header/payload/CRC/tail
+    uint32_t body = (pars->fixed ? 0 : 16) + 8 * (uint32_t) payload_size +
+                    (pars->flrc_crc ? 8 * (pars->flrc_crc + 1) : 0) + 6;
+    if      (pars->flrc_cr == 2) body = (body * 4 + 2) / 3; // CR=3/4
+    else if (pars->flrc_cr == 3) body = body * 2;           // CR=1/2
+    bits = pars->flrc_preamble + 21 + (pars->flrc_sw_on ? 32 : 0) + body;
+    rate = pars->flrc_br;
+  }
+#endif
+
+#ifdef SX128X_USE_GFSK
+  if (pars->mode == SX128X_PACKET_TYPE_GFSK)
+  {
+    bits = pars->gfsk_preamble + 8 * (uint32_t) pars->gfsk_sw_len +
+           (pars->fixed ? 0 : 8) + 8 * (uint32_t) payload_size +
+           8 * (uint32_t) pars->gfsk_crc;
+    rate = pars->gfsk_br;
+  }
+#endif
+
+#ifdef SX128X_USE_BLE
+  if (pars->mode == SX128X_PACKET_TYPE_BLE)
+  { // 1 Mbit/s: preamble, access address, header, payload, CRC
+    bits = 8 + 32 + 16 + 8 * (uint32_t) payload_size +
+           (pars->ble_crc ? 24 : 0);
+    rate = 1000;
+  }
+#endif
+
+  return (bits * 1000 + rate / 2) / (rate ? rate : 1);
+}
+//-----------------------------------------------------------------------------
 // go to RX mode; wait callback by interrupt (help function)
 // Note: timeout = 0x0000 (SX128X_RX_TIMEOUT_SINGLE) - timeout disable (RX Single mode)
 //       timeout = 0xFFFF (SX128X_RX_TIMEOUT_CONTINUOUS) - RX Continuous mode
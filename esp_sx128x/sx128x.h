@@ -29,6 +29,11 @@
 //#define SX128X_DEBUG_IRQ   // debug verbose IRQ print
 //#define SX128X_DEBUG_EXTRA // extra debug verbose print
 //-----------------------------------------------------------------------------
+//#define SX128X_USE_TRACE   // use SPI transaction tracer
+#ifndef SX128X_TRACE_SIZE
+#  define SX128X_TRACE_SIZE 128 // trace ring size (records)
+#endif
+//-----------------------------------------------------------------------------
 // BUSY down timeout for SPI exchange (FIXME: why 10ms?)
 #ifndef SX128X_TIMEOUT
 #  define SX128X_TIMEOUT 10 // ms
@@ -70,6 +75,21 @@
 #define SX128X_FIFO_TX_BASE_ADDR 0x00
 #define SX128X_FIFO_RX_BASE_ADDR 0x80
 //-----------------------------------------------------------------------------
+#ifdef SX128X_USE_RANGING
+// ranging calibration table size: BW {406, 812, 1625 kHz} x SF {5...10}
+#define SX128X_CALIB_BWS    3
+#define SX128X_CALIB_SFS    6
+#define SX128X_CALIB_SF_MIN 5
+
+// Semtech AN1200.29 Table 1: Measured Calibration Values
+// (look doc/sx1280/SX1280-Calibration_Table.png)
+#define SX128X_CALIB_TABLE {                              \
+  /* SF5    SF6    SF7    SF8    SF9   SF10 */            \
+  { 10299, 10271, 10244, 10242, 10230, 10246 }, /*  406 */ \
+  { 11486, 11474, 11453, 11426, 11417, 11401 }, /*  812 */ \
+  { 13308, 13493, 13528, 13515, 13430, 13376 }  /* 1625 */ }
+#endif // SX128X_USE_RANGING
+//-----------------------------------------------------------------------------
 #ifdef SX128X_USE_EXTRA
 extern const char * const sx128x_status_mode_string[8];
 extern const char * const sx128x_status_cmd_string[8];
@@ -128,6 +148,8 @@ typedef struct sx128x_pars_ {
   uint8_t  slave_mode;       // bits check mode: 0...3 {8, 16, 24, 32 bits}
   uint32_t calibration;      // Ranging calibration value (24 bit), by reset 0x005FD2
   uint8_t  advanced_ranging; // Advanced Ranging activate (1-on, 0-off)
+  uint16_t calib[SX128X_CALIB_BWS][SX128X_CALIB_SFS]; // calibration by BW/SF
+                             // (applied in Ranging mode, 0 - use `calibration`)
 #endif
 
 #ifdef SX128X_USE_FLRC
@@ -212,6 +234,27 @@ typedef struct sx128x_rx_ {
   };
 } sx128x_rx_t;
 //-----------------------------------------------------------------------------
+#ifdef SX128X_USE_TRACE
+// SPI transaction trace record
+typedef struct sx128x_trace_rec_ {
+  uint32_t t;      // start time [us]
+  uint16_t busy;   // BUSY wait duration [us]
+  uint16_t xfer;   // SPI transfer duration [us]
+  uint16_t len;    // number of bytes
+  uint8_t  opcode; // command opcode (first byte)
+  int8_t   err;    // SX128X_ERR_NONE, SX128X_ERR_BUSY or SX128X_ERR_SPI
+} sx128x_trace_rec_t;
+//-----------------------------------------------------------------------------
+// SPI transaction trace ring
+typedef struct sx128x_trace_ {
+  uint32_t (*time_us)(void); // time function [us]
+  uint8_t  on;               // 1-on, 0-off
+  uint16_t head;             // next record index
+  uint32_t cnt;              // total records counter
+  sx128x_trace_rec_t rec[SX128X_TRACE_SIZE];
+} sx128x_trace_t;
+#endif // SX128X_USE_TRACE
+//-----------------------------------------------------------------------------
 // SX128x class pivate data
 typedef struct sx128x_ sx128x_t;
 struct sx128x_ {
@@ -219,6 +262,8 @@ struct sx128x_ {
   uint8_t sleep;            // 0 - stadby mode, 1 - sleep mode
   uint8_t status;           // last status
   uint8_t advanced_ranging; // Advanced Rangig 0-off/1-on
+  uint8_t ar_mux;           // cached address MUX register (Advanced Ranging)
+  uint8_t ar_freeze;        // cached freeze register (Advanced Ranging)
 
   uint8_t (*busy_wait)(     // BYSY=0 wait function with timeout (return BUSY state)
     uint32_t timeout,       // wait BUSY down timeout [ms]
@@ -232,6 +277,10 @@ struct sx128x_ {
 
   void *dev_context; // optional device context or NULL
 
+#ifdef SX128X_USE_TRACE
+  sx128x_trace_t *trace; // SPI transaction tracer or NULL
+#endif
+
   uint8_t txbuf[SX128X_SPI_BUF_SIZE];
   uint8_t rxbuf[SX128X_SPI_BUF_SIZE];
   uint8_t pktpars[SX128X_PKT_PARS_BUF_SIZE];
@@ -298,6 +347,36 @@ int8_t sx128x_sleep(sx128x_t *self, uint8_t config);
 // get Sleep state (return: 0 - stadby mode, 1 - sleep mode)
 INLINE uint8_t sx128x_get_sleep(const sx128x_t *self) { return self->sleep; }
 //-----------------------------------------------------------------------------
+#ifdef SX128X_USE_TRACE
+// init SPI transaction trace ring (off by default)
+void sx128x_trace_init(sx128x_trace_t *trace, uint32_t (*time_us)(void));
+//-----------------------------------------------------------------------------
+// clear SPI transaction trace ring
+void sx128x_trace_clear(sx128x_trace_t *trace);
+//-----------------------------------------------------------------------------
+// attach SPI transaction tracer (or NULL to detach)
+INLINE void sx128x_set_trace(sx128x_t *self, sx128x_trace_t *trace)
+{
+  self->trace = trace;
+}
+//-----------------------------------------------------------------------------
+// number of records in SPI transaction trace ring
+INLINE uint16_t sx128x_trace_num(const sx128x_trace_t *trace)
+{
+  return trace->cnt < SX128X_TRACE_SIZE ? (uint16_t) trace->cnt :
+                                          SX128X_TRACE_SIZE;
+}
+//-----------------------------------------------------------------------------
+// get trace record by index (0 - oldest)
+INLINE const sx128x_trace_rec_t *sx128x_trace_get(const sx128x_trace_t *trace,
+                                                  uint16_t i)
+{
+  uint16_t n = sx128x_trace_num(trace);
+  return &trace->rec[(trace->head + SX128X_TRACE_SIZE - n + i) %
+                     SX128X_TRACE_SIZE];
+}
+#endif // SX128X_USE_TRACE
+//-----------------------------------------------------------------------------
 // set Standby mode from Sleep mode (no wait BUSY down)
 // config = SX128X_STANDBY_RC (0x00) or SX128X_STANDBY_XOSC (0x01)
 int8_t sx128x_wakeup(sx128x_t *self, uint8_t config);
@@ -413,9 +492,18 @@ int8_t sx128x_tx_preamble(sx128x_t *self);
 // set save context
 int8_t sx128x_save_context(sx128x_t *self);
 //-----------------------------------------------------------------------------
+// convert RF frequency from Hz to PLL code (rf_step = 198.3642578125 Hz)
+uint32_t sx128x_freq2code(uint32_t freq);
+//-----------------------------------------------------------------------------
+// convert RF frequency PLL code to Hz
+uint32_t sx128x_code2freq(uint32_t code);
+//-----------------------------------------------------------------------------
 // set RF frequency [Hz]
 int8_t sx128x_set_frequency(sx128x_t *self, uint32_t freq);
 //-----------------------------------------------------------------------------
+// set RF frequency by precomputed PLL code (fast channel switch)
+int8_t sx128x_set_frequency_code(sx128x_t *self, uint32_t code);
+//-----------------------------------------------------------------------------
 // get RF frequency [Hz]
 INLINE uint32_t sx128x_get_frequency(sx128x_t *self) { return self->pars->freq; }
 //-----------------------------------------------------------------------------
@@ -580,6 +668,9 @@ int8_t sx128x_ranging_role(sx128x_t *self, uint8_t role);
 // set Ranging master request address
 int8_t sx128x_ranging_master_address(sx128x_t *self, uint32_t address);
 //-----------------------------------------------------------------------------
+// update Ranging master request address by writing changed bytes only
+int8_t sx128x_ranging_master_address_update(sx128x_t *self, uint32_t address);
+//-----------------------------------------------------------------------------
 // set Ranging slave respond address and bits check mode
 int8_t sx128x_ranging_slave_address(
   sx128x_t *self,
@@ -592,12 +683,24 @@ int8_t sx128x_ranging_set_calibration(sx128x_t *self, uint32_t callibration);
 // get ranging callibration register value (24 bit)
 int8_t sx128x_ranging_get_calibration(sx128x_t *self, uint32_t *callibration);
 //-----------------------------------------------------------------------------
+// get pointer to calibration table cell by BW [kHz] and SF
+// (BW/SF are limited as by sx128x_mod_lora() in Ranging mode)
+uint16_t *sx128x_ranging_calib_cell(sx128x_pars_t *pars, uint16_t bw, uint8_t sf);
+//-----------------------------------------------------------------------------
+// calibration value for current BW/SF: table cell or `calibration` if 0
+uint32_t sx128x_ranging_calib_value(sx128x_pars_t *pars);
+//-----------------------------------------------------------------------------
+// convert raw 24-bit Ranging result to distance [cm] by BW [kHz]
+// (exact with rounding to nearest: d[m] = raw * 150 / (2^12 * BW[MHz]),
+// BW 203/406/812 kHz are 203.125/406.25/812.5 kHz)
+int32_t sx128x_ranging_distance(uint32_t result, uint16_t bw);
+//-----------------------------------------------------------------------------
 // get Ranging results
 int8_t sx128x_ranging_result(
   sx128x_t *self,
   uint8_t  *filter,   // result type (0-off, 1-on, 2-as-is) - modified
   uint32_t *result,   // raw result
-  int32_t  *distance, // distance [dm]
+  int32_t  *distance, // distance [cm]
   uint8_t  *rssi);    // RSSI of last exchange
 //-----------------------------------------------------------------------------
 // on/off Advanced Ranging (0-off, 1-on)
@@ -610,6 +713,15 @@ INLINE uint8_t sx128x_get_advanced_ranging(const sx128x_t *self)
 // get Advanced Ranging Address Received
 int8_t sx128x_advanced_ranging_address(sx128x_t *self, uint32_t *address);
 //-----------------------------------------------------------------------------
+// get Advanced Ranging exchange by batched register access (6 SPI
+// transactions, chip is left in STDBY_XOSC - restart RX after it):
+// received address, raw 24-bit result and RSSI
+int8_t sx128x_advanced_ranging_read(
+  sx128x_t *self,
+  uint32_t *address, // received address
+  uint32_t *result,  // raw result
+  uint8_t  *rssi);   // RSSI of exchange
+//-----------------------------------------------------------------------------
 #endif // SX128X_USE_RANGING
 //-----------------------------------------------------------------------------
 #if defined(SX128X_USE_FLRC) || defined(SX128X_USE_GFSK)
@@ -770,6 +882,9 @@ int8_t sx128x_send(
   uint16_t timeout,       // TX timeout (SX128X_TX_TIMEOUT_SINGLE - disable)
   uint8_t  timeout_base); // TX timeout base (15.625us, 62.5us, 1ms, 4ms)
 //-----------------------------------------------------------------------------
+// time on air of packet by current options [us] (help function)
+uint32_t sx128x_time_on_air(const sx128x_t *self, uint8_t payload_size);
+//-----------------------------------------------------------------------------
 // go to RX mode; wait callback by interrupt (help function)
 // Note: timeout = 0x0000 (SX128X_RX_TIMEOUT_SINGLE) - timeout disable (RX Single mode)
 //       timeout = 0xFFFF (SX128X_RX_TIMEOUT_CONTINUOUS) - RX Continuous mode
@@ -385,6 +385,9 @@
 #define SX128X_REG_RANGING_RESULT_MUX     0x924 // Ranging result configuration
 #define SX128X_REG_SF_ADDITIONAL_CONF     0x925 // SF range selection in LoRa mode
 
+#define SX128X_REG_RANGING_ADDR_MUX       0x927 // Advanced Ranging: address bytes selection
+                                                // (bits 1:0, 0 - bytes 1:0, 1 - bytes 3:2)
+
 #define SX128X_REG_RANGING_CALIB_BYTE2    0x92B // The ranging calibration value
 #define SX128X_REG_RANGING_CALIB_BYTE1    0x92C //
 #define SX128X_REG_RANGING_CALIB_BYTE0    0x92D //
@@ -403,6 +406,9 @@
 #define SX128X_REG_LORA_FEI_BYTE1         0x955 // Note: LoRa FEi is reliable only for positive SNR
 #define SX128X_REG_LORA_FEI_BYTE0         0x956 //
 
+#define SX128X_REG_RANGING_ADDR_HI        0x95F // Advanced Ranging: received address
+#define SX128X_REG_RANGING_ADDR_LO        0x960 // (byte pair by SX128X_REG_RANGING_ADDR_MUX)
+
 #define SX128X_REG_RANGING_RESULT_BYTE2   0x961 // The result of the last ranging exchange
 #define SX128X_REG_RANGING_RESULT_BYTE1   0x962 //
 #define SX128X_REG_RANGING_RESULT_BYTE0   0x963 //
@@ -7,12 +7,20 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include "sx128x_hw_arduino.h"
+#include "tstamp.h"
 #include "print.h"
 //-----------------------------------------------------------------------------
 // global variable(s)
 volatile char     sx128x_hw_irq_flag  = 0; // interrupt flag by DIO1
 volatile unsigned sx128x_hw_irq_cnt   = 0; // interrupt counter
 volatile unsigned long sx128x_hw_irq_time = 0; // time of last interrupt [ms or us]
+volatile uint64_t sx128x_hw_irq_raw = 0; // raw timestamp of last interrupt
+//-----------------------------------------------------------------------------
+// TIME_FUNC() by tstamp_us() needs 64-bit division => ISR saves raw counter
+// only and time of interrupt is converted in main loop
+#if defined(USE_TSTAMP) && (TIME_FACTOR == 1000)
+#  define SX128X_HW_IRQ_TIME_RAW
+#endif
 //-----------------------------------------------------------------------------
 #ifdef USE_DIO1_INTERRUPT
 //-----------------------------------------------------------------------------
@@ -24,7 +32,10 @@ ICACHE_RAM_ATTR
 #endif
 sx128x_hw_isr()
 {
-  sx128x_hw_irq_time = TIME_FUNC(); // ms or us
+  sx128x_hw_irq_raw  = tstamp_raw(); // first (ISR entry jitter only)
+#ifndef SX128X_HW_IRQ_TIME_RAW
+  sx128x_hw_irq_time = TIME_FUNC();  // ms or us
+#endif
   sx128x_hw_irq_cnt++;
   sx128x_hw_irq_flag = 1;
 }
@@ -38,7 +49,10 @@ void sx128x_hw_check_dio1()
   char state = digitalRead(SX128X_DIO1_PIN);
   if (state == 1 && old_state == 0)
   { // IRQ DIO1 rise
+    sx128x_hw_irq_raw  = tstamp_raw();
+#ifndef SX128X_HW_IRQ_TIME_RAW
     sx128x_hw_irq_time = TIME_FUNC();
+#endif
     sx128x_hw_irq_cnt++;
     sx128x_hw_irq_flag = 1;
   }
@@ -47,6 +61,28 @@ void sx128x_hw_check_dio1()
 //-----------------------------------------------------------------------------
 #endif // USE_DIO1_INTERRUPT
 //-----------------------------------------------------------------------------
+// time of last interrupt: `ns` - timestamp [ns] (look "tstamp.h"),
+// `t` - TIME_FUNC() [ms or us] (call from main loop)
+void sx128x_hw_irq_get(uint64_t *ns, unsigned long *t)
+{
+  unsigned cnt;
+  uint64_t raw;
+  unsigned long time;
+
+  do
+  { // 64-bit read is not atomic on 32-bit core => retry if ISR came between
+    cnt  = sx128x_hw_irq_cnt;
+    raw  = sx128x_hw_irq_raw;
+    time = sx128x_hw_irq_time;
+  } while (cnt != sx128x_hw_irq_cnt);
+
+  *ns = tstamp_ns_raw(raw);
+#ifdef SX128X_HW_IRQ_TIME_RAW
+  time = (unsigned long) (*ns / 1000); // as tstamp_us()
+#endif
+  *t = time;
+}
+//-----------------------------------------------------------------------------
 // init SPI/GPIO
 void sx128x_hw_begin()
 {
@@ -172,6 +208,12 @@ uint8_t sx128x_hw_exchange(
   return 1; // 1-success, 0-error
 }
 //----------------------------------------------------------------------------
+// time function for SPI transaction tracer [us]
+uint32_t sx128x_hw_time_us(void)
+{
+  return (uint32_t) micros();
+}
+//----------------------------------------------------------------------------
 
 /*** end of "sx128x_hw_arduino.c" file ***/
 
@@ -20,7 +20,8 @@
 extern volatile char     sx128x_hw_irq_state; // GPIO IRQ state (DIO1)
 extern volatile char     sx128x_hw_irq_flag;  // interrupt flag by DIO1
 extern volatile unsigned sx128x_hw_irq_cnt;   // interrupt counter
-extern volatile unsigned long sx128x_hw_irq_time; // time of last interrupt [ms or us]
+extern volatile unsigned long sx128x_hw_irq_time; // time of last interrupt [ms or us] (look sx128x_hw_irq_get())
+extern volatile uint64_t sx128x_hw_irq_raw; // raw timestamp of last interrupt (look "tstamp.h")
 //-----------------------------------------------------------------------------
 #ifdef __cplusplus
 extern "C"
@@ -32,6 +33,10 @@ extern "C"
 void sx128x_hw_check_dio1();
 #endif // !USE_DIO1_INTERRUPT
 //-----------------------------------------------------------------------------
+// time of last interrupt: `ns` - timestamp [ns] (look "tstamp.h"),
+// `t` - TIME_FUNC() [ms or us] (call from main loop)
+void sx128x_hw_irq_get(uint64_t *ns, unsigned long *t);
+//-----------------------------------------------------------------------------
 // init SPI/GPIO
 void sx128x_hw_begin();
 //-----------------------------------------------------------------------------
@@ -61,6 +66,9 @@ uint8_t sx128x_hw_exchange(
   uint16_t len,          // number of bytes
   void *context);        // optional device context or NULL
 //-----------------------------------------------------------------------------
+// time function for SPI transaction tracer [us]
+uint32_t sx128x_hw_time_us(void);
+//-----------------------------------------------------------------------------
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -7,6 +7,10 @@
 #include "sx128x_hw_arduino.h"
 #include "global.h"
 #include "print.h"
+#include "capture.h"
+//-----------------------------------------------------------------------------
+// TIME_FUNC() units to microseconds
+#define LAT_US(dt) ((uint32_t) (dt) * (1000 / TIME_FACTOR))
 //-----------------------------------------------------------------------------
 // check interrupt from SX128x
 void sx128x_irq()
@@ -15,11 +19,16 @@ void sx128x_irq()
   uint16_t irq;
   uint8_t recv = 0;
   uint8_t ranging = 0;
-  uint8_t buf[255];
-  uint8_t verbose = Opt.verbose || !Fsm.run();
+  uint64_t ns;     // time of interrupt [ns]
+  unsigned long t; // time of interrupt [TIME_FUNC() units]
+  uint8_t verbose = (Opt.verbose || !Fsm.run()) && !ArLog.on;
 
   if (!sx128x_hw_irq_flag) return;
   sx128x_hw_irq_flag = 0;
+  sx128x_hw_irq_get(&ns, &t);
+
+  // ISR -> handler delay
+  lat_add(&Latency.irq, LAT_US(TIME_FUNC() - t));
 
   mrl_clear(&Mrl);
 
@@ -33,12 +42,15 @@ void sx128x_irq()
     if (retv != SX128X_ERR_NONE) { mrl_refresh(&Mrl); return; } // error
   }
 
+  // account IRQ flags in link statistics
+  stats_irq(&Stats, sx128x_get_mode(&Radio), irq);
+
   if (verbose)
   {
     print_str("DIO1 interrupt: cnt=");
     print_uint(sx128x_hw_irq_cnt);
     print_str(" time=");
-    print_uint(sx128x_hw_irq_time);
+    print_uint(t);
     print_str(" irq=[");
     if (irq & SX128X_IRQ_TX_DONE              ) print_str(" TxDone");
     if (irq & SX128X_IRQ_RX_DONE              ) print_str(" RxDone");
@@ -68,15 +80,21 @@ void sx128x_irq()
 
   if (irq & SX128X_IRQ_TX_DONE)
   { // TX done
-    unsigned long dt = Fsm.tx_done_dt(sx128x_hw_irq_time);
+    unsigned long dt = Fsm.tx_done_dt(t);
     if (verbose) print_uval("TxDone: dt=", dt);
+    lat_add(&Latency.tx, LAT_US(dt));
+    tstamp_link_tx(&Tstamp, sx128x_get_mode(&Radio), ns,
+                   ns - (uint64_t) LAT_US(dt) * 1000,
+                   sx128x_time_on_air(&Radio, Fsm.tx_size()));
     Fsm.tx_done();
   }
 
   if (irq & SX128X_IRQ_RX_DONE)
   { // RX done
-    unsigned long dt = Fsm.rx_done_dt(sx128x_hw_irq_time);
+    unsigned long dt = Fsm.rx_done_dt(t);
     if (verbose) print_uval("RxDone: dT=", dt);
+    if (Fsm.mode() == AFSM_RQ && Fsm.run())
+      lat_add(&Latency.rtt, LAT_US(t - Fsm.tx_start_time()));
     recv = 1;
   }
 
@@ -108,17 +126,19 @@ void sx128x_irq()
   if (irq & SX128X_IRQ_SLAVE_RESPONSE_DONE)
   { // slave request done
     Led.off();
+    Fsm.ranging_done(); // hop to next channel (frequency diversity)
   }
 
   if (irq & SX128X_IRQ_SLAVE_REQUEST_DISCARD)
-  { // slave request discard
-    sx128x_rx(&Radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_15_625US);
+  { // slave request discard (keep channel and RX window)
+    Fsm.ranging_listen();
     Led.off();
   }
 
   if (irq & SX128X_IRQ_CAD_DONE)
-  { // CAD done
+  { // CAD done (mesh relay: send if channel is free)
     //if (verbose) print_str("CadDone\r\n");
+    Fsm.cad_done((irq & SX128X_IRQ_CAD_DETECTED) ? 1 : 0);
   }
 
   if (irq & SX128X_IRQ_CAD_DETECTED)
@@ -135,109 +155,87 @@ void sx128x_irq()
   }
 
   if (recv)
-  { // receive packet (RxDone)
-    sx128x_rx_t rx;
-    uint8_t payload_size;
+  { // receive packet (RxDone) to RX ring (zero copy)
+    rx_pkt_t *pkt = rx_ring_alloc(&RxRing);
+    pkt->t    = t;
+    pkt->mode = sx128x_get_mode(&Radio);
+    pkt->ts   = tstamp_link_rx(&Tstamp, pkt->mode, ns);
 
     // get RX data and RX status from chip (help mega function)
     retv = sx128x_get_recv(
-             &Radio,          // pointer to `sx128x_t` object
+             &Radio,            // pointer to `sx128x_t` object
              // input:
-             irq,             // IRQ status from sx128x_get_irq()
-             sizeof(buf),     // RX data buffer size
+             irq,               // IRQ status from sx128x_get_irq()
+             sizeof(pkt->data), // RX data buffer size
              // output:
-             &rx,             // RX status
-             buf,             // buffer for RX payload data
-             &payload_size);  // real RX payload data size
-    if (retv == SX128X_ERR_NONE && (rx.crc_ok || Opt.verbose > 1))
+             &pkt->rx,          // RX status
+             pkt->data,         // buffer for RX payload data
+             &pkt->size);       // real RX payload data size
+    if (retv == SX128X_ERR_NONE)
     {
-      int i;
-      if (rx.lora)
-      { // LoRa/Ranging
-        print_str("recv: LoRa/Ranging CRC_ok="); print_uint(rx.crc_ok);
-
-        if (rx.hdr.fixed)
-        { // Implicit header
-          print_str(" HdrType=Implicit\r\n");
-        }
-        else
-        { // Explicit header
-          print_str(" HdrType=Explicit (CR="); print_int((int) rx.hdr.cr);
-          print_str(" CRC="); print_str(rx.hdr.crc ? "on" : "off");
-          print_str(")\r\n");
-        }
-        print_str("recv:");
-        print_str(" RSSI=");      print_rssi(rx.rssi);      print_str("dB");
-        print_str(" RSSI_inst="); print_rssi(rx.rssi_inst); print_str("dB");
-        print_str(" SNR=");       print_snr(rx.snr);        print_str("dB");
-        print_str(" FEI=");       print_fei(rx.fei);        print_str("kHz");
+      // responder saves ping request header (echoed by stamper of reply)
+      if (Ping.on && Fsm.mode() == AFSM_RP)
+      {
+        if (pkt->rx.crc_ok) ping_request(&Ping, pkt->data, pkt->size);
+        else                Ping.req_size = 0;
       }
-      else
-      { // GFSK/FLRC/BLE
-        print_str("recv: GFSK/FLRC/BLE CRC_ok="); print_uint(rx.crc_ok);
-        print_str(" RSSI="); print_rssi(rx.rssi);  print_str("dBm");
-        print_str(" sync_addrs=0b"); print_bin((int) rx.sync_addrs, 3);
 
-#if 1 // more compact
-        if (rx.pkt_status & (1 << 0)) print_str(" PktSent=1");
-        if (rx.pkt_status & (5 << 5)) print_str(" rxNoAck=1");
-
-        if (rx.pkt_errors & (1 << 0)) print_str(" pktCtrlBusy=1");
-        if (rx.pkt_errors & (1 << 1)) print_str(" pktRecv=1"    );
-        if (rx.pkt_errors & (1 << 2)) print_str(" hdrRecv=1"    );
-        if (rx.pkt_errors & (1 << 3)) print_str(" AbortErr=1"   );
-        if (rx.pkt_errors & (1 << 4)) print_str(" crcErr=1"     );
-        if (rx.pkt_errors & (1 << 5)) print_str(" LenErr=1"     );
-        if (rx.pkt_errors & (1 << 5)) print_str(" SyncErr=1"    );
-
-#else
-        print_str(" PktSent="); print_int((int) (rx.pkt_status >> 0) & 0x1);
-        print_str(" rxNoAck="); print_int((int) (rx.pkt_status >> 5) & 0x1);
-
-        print_str(" pktCtrlBusy="); print_int((int) (rx.pkt_errors >> 0) & 0x1);
-        print_str(" pktRecv="    ); print_int((int) (rx.pkt_errors >> 1) & 0x1);
-        print_str(" hdrRecv="    ); print_int((int) (rx.pkt_errors >> 2) & 0x1);
-        print_str(" AbortErr="   ); print_int((int) (rx.pkt_errors >> 3) & 0x1);
-        print_str(" crcErr="     ); print_int((int) (rx.pkt_errors >> 4) & 0x1);
-        print_str(" LenErr="     ); print_int((int) (rx.pkt_errors >> 5) & 0x1);
-        print_str(" SyncErr="    ); print_int((int) (rx.pkt_errors >> 6) & 0x1);
-#endif
-      }
-      print_uval("\r\nsize=", payload_size);
+      // hop follower synchronizes by header (stamped to reply by stamper)
+      if (Hop.on && (Fsm.mode() == AFSM_RP || Fsm.mode() == AFSM_RX))
+        Hop.reply = pkt->rx.crc_ok &&
+                    hop_sync(&Hop, pkt->data, pkt->size, pkt->t, Opt.fsm.t);
 
-      print_str("data:");
-      for (i = 0; i < payload_size; i++)
-      {
-        print_str(" 0x");
-        print_hex(buf[i], 2);
-      }
-      print_eol();
+      rx_ring_push(&RxRing); // subscribers get packet in rx_ring_yield()
     }
 
     Fsm.rx_done();
+
+    if (Fsm.mode() == AFSM_RP) // responder turnaround
+      lat_add(&Latency.turn, LAT_US(Fsm.tx_start_time() - t));
   }
 
-  if (ranging)
+  if (ranging && ArLog.on)
+  { // passive capture: batched read to log, binary stream from main loop
+    uint32_t address; // received request address
+    uint32_t result;  // raw result
+    uint8_t  rssi;    // RSSI of exchange
+
+    retv = sx128x_advanced_ranging_read(&Radio, &address, &result, &rssi);
+    if (retv == SX128X_ERR_NONE)
+    {
+      stats_ranging(&Stats, sx128x_get_mode(&Radio));
+      arlog_push(&ArLog, t, address, result, rssi);
+    }
+
+    Fsm.ranging_done(); // restart RX
+  }
+  else if (ranging)
   { // get Ranging results
     uint8_t  filter = 0; // FIXME: why? !!!
     uint32_t result;     // raw result
-    int32_t  distance;   // distance [dm]
+    int32_t  distance;   // distance [cm]
     uint8_t  rssi;       // RSSI of last exchange
 
     retv = sx128x_ranging_result(
              &Radio,
              &filter,   // result type (0-off, 1-on, 2-as-is)
              &result,   // raw result
-             &distance, // distance [dm]
+             &distance, // distance [cm]
              &rssi);    // RSSI of last exchange
     if (retv == SX128X_ERR_NONE)
     {
+      stats_ranging(&Stats, sx128x_get_mode(&Radio));
+      range_add(&Range, result, distance, rssi); // ignored out of session
+    }
+
+    if (retv == SX128X_ERR_NONE && (!Range.active || Opt.verbose >= 3))
+    { // single shot or verbose session
       print_str("ranging result: filter=");
       print_uint(filter);
       print_str(" raw=0x");
       print_hex(result, 8);
       print_str(" distance=");
-      print_distance(distance);
+      print_distance_cm(distance);
       print_str("m RSSI=");
       print_rssi(rssi);
       print_str("dBm\r\n");
@@ -249,6 +247,82 @@ void sx128x_irq()
   mrl_refresh(&Mrl);
 }
 //-----------------------------------------------------------------------------
+// print received packet (RX ring console subscriber)
+uint8_t sx128x_irq_print_cb(const rx_pkt_t *pkt, void *context)
+{
+  const sx128x_rx_t *rx = &pkt->rx;
+  int i;
+
+  if (!rx->crc_ok && Opt.verbose <= 1) return 1; // skip bad packet
+  if (capture_enabled()) return 1; // binary capture instead of text
+
+  mrl_clear(&Mrl);
+
+  if (rx->lora)
+  { // LoRa/Ranging
+    print_str("recv: LoRa/Ranging CRC_ok="); print_uint(rx->crc_ok);
+
+    if (rx->hdr.fixed)
+    { // Implicit header
+      print_str(" HdrType=Implicit\r\n");
+    }
+    else
+    { // Explicit header
+      print_str(" HdrType=Explicit (CR="); print_int((int) rx->hdr.cr);
+      print_str(" CRC="); print_str(rx->hdr.crc ? "on" : "off");
+      print_str(")\r\n");
+    }
+    print_str("recv:");
+    print_str(" RSSI=");      print_rssi(rx->rssi);      print_str("dB");
+    print_str(" RSSI_inst="); print_rssi(rx->rssi_inst); print_str("dB");
+    print_str(" SNR=");       print_snr(rx->snr);        print_str("dB");
+    print_str(" FEI=");       print_fei(rx->fei);        print_str("kHz");
+  }
+  else
+  { // GFSK/FLRC/BLE
+    print_str("recv: GFSK/FLRC/BLE CRC_ok="); print_uint(rx->crc_ok);
+    print_str(" RSSI="); print_rssi(rx->rssi);  print_str("dBm");
+    print_str(" sync_addrs=0b"); print_bin((int) rx->sync_addrs, 3);
+
+#if 1 // more compact
+    if (rx->pkt_status & (1 << 0)) print_str(" PktSent=1");
+    if (rx->pkt_status & (5 << 5)) print_str(" rxNoAck=1");
+
+    if (rx->pkt_errors & (1 << 0)) print_str(" pktCtrlBusy=1");
+    if (rx->pkt_errors & (1 << 1)) print_str(" pktRecv=1"    );
+    if (rx->pkt_errors & (1 << 2)) print_str(" hdrRecv=1"    );
+    if (rx->pkt_errors & (1 << 3)) print_str(" AbortErr=1"   );
+    if (rx->pkt_errors & (1 << 4)) print_str(" crcErr=1"     );
+    if (rx->pkt_errors & (1 << 5)) print_str(" LenErr=1"     );
+    if (rx->pkt_errors & (1 << 5)) print_str(" SyncErr=1"    );
+
+#else
+    print_str(" PktSent="); print_int((int) (rx->pkt_status >> 0) & 0x1);
+    print_str(" rxNoAck="); print_int((int) (rx->pkt_status >> 5) & 0x1);
+
+    print_str(" pktCtrlBusy="); print_int((int) (rx->pkt_errors >> 0) & 0x1);
+    print_str(" pktRecv="    ); print_int((int) (rx->pkt_errors >> 1) & 0x1);
+    print_str(" hdrRecv="    ); print_int((int) (rx->pkt_errors >> 2) & 0x1);
+    print_str(" AbortErr="   ); print_int((int) (rx->pkt_errors >> 3) & 0x1);
+    print_str(" crcErr="     ); print_int((int) (rx->pkt_errors >> 4) & 0x1);
+    print_str(" LenErr="     ); print_int((int) (rx->pkt_errors >> 5) & 0x1);
+    print_str(" SyncErr="    ); print_int((int) (rx->pkt_errors >> 6) & 0x1);
+#endif
+  }
+  print_uval("\r\nsize=", pkt->size);
+
+  print_str("data:");
+  for (i = 0; i < pkt->size; i++)
+  {
+    print_str(" 0x");
+    print_hex(pkt->data[i], 2);
+  }
+  print_eol();
+
+  mrl_refresh(&Mrl);
+  return 1;
+}
+//-----------------------------------------------------------------------------
 
 /*** end of "sx128x_irq.cpp" file ***/
 
@@ -6,6 +6,8 @@
 #ifndef SX128X_IRQ_H
 #define SX128X_IRQ_H
 //-----------------------------------------------------------------------------
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
 #ifdef __cplusplus
 extern "C"
 {
@@ -14,6 +16,9 @@ extern "C"
 // check interrupt from SX128x
 void sx128x_irq();
 //-----------------------------------------------------------------------------
+// print received packet (RX ring console subscriber)
+uint8_t sx128x_irq_print_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,268 @@
+/*
+ * TDMA slot scheduler: coordinator beacons, clock discipline of members by
+ * beacon RxDone time (offset and drift), guard times by measured error
+ * File: "tdma.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "tdma.h"
+//-----------------------------------------------------------------------------
+static void tdma_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)  v;
+  p[1] = (uint8_t) (v >> 8);
+  p[2] = (uint8_t) (v >> 16);
+  p[3] = (uint8_t) (v >> 24);
+}
+//-----------------------------------------------------------------------------
+static uint32_t tdma_get32(const uint8_t *p)
+{
+  return ((uint32_t) p[0]      ) | ((uint32_t) p[1] <<  8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+static uint32_t tdma_abs(int32_t x)
+{
+  return x < 0 ? (uint32_t) 0 - (uint32_t) x : (uint32_t) x;
+}
+//-----------------------------------------------------------------------------
+// account error [us] (last, maximal and EWMA of absolute value)
+static void tdma_error(tdma_t *self, int32_t e)
+{
+  uint32_t a = tdma_abs(e);
+  if (a > 0xFFFFF) a = 0xFFFFF;
+  self->err = e;
+  if (a > self->err_max) self->err_max = a;
+  self->jit = (self->jit * 7 + a * 16) / 8;
+}
+//-----------------------------------------------------------------------------
+// local time of coordinator time `c` [us]
+static uint32_t tdma_local(const tdma_t *self, uint32_t c)
+{
+  uint32_t t = c - (uint32_t) self->offset; // without drift
+  return c - (uint32_t) tdma_offset(self, t);
+}
+//-----------------------------------------------------------------------------
+// member: guard time of own slot from coordinator time `c` [us]
+// (error grows with frames from last beacon by residual drift)
+static uint16_t tdma_guard(const tdma_t *self, uint32_t c)
+{
+  uint32_t frame = tdma_frame_us(self);
+  uint32_t age = (c - self->frame_t + frame - 1) / frame; // [frames]
+  uint64_t g = self->guard_min + (uint64_t) (self->jit >> 3) * (age ? age : 1);
+  return g > 0xFFFF ? 0xFFFF : (uint16_t) g;
+}
+//-----------------------------------------------------------------------------
+// member: schedule first own slot not started at local time `t`
+static void tdma_arm(tdma_t *self, uint32_t t)
+{
+  uint32_t frame = tdma_frame_us(self);
+  uint32_t c = t + (uint32_t) tdma_offset(self, t); // coordinator time now
+
+  self->next_c = self->frame_t + (uint32_t) self->slot * self->slot_us;
+  while ((int32_t) (self->next_c - c) < 0) self->next_c += frame;
+
+  self->guard = tdma_guard(self, self->next_c);
+  self->next  = tdma_local(self, self->next_c + self->guard);
+  self->armed = 1;
+}
+//-----------------------------------------------------------------------------
+// init scheduler (coordinator, default frame and discipline)
+void tdma_init(tdma_t *self)
+{
+  memset((void*) self, 0, sizeof(tdma_t));
+  self->slots     = TDMA_SLOTS;
+  self->slot_us   = TDMA_SLOT_US;
+  self->guard_min = TDMA_GUARD_MIN;
+  self->rx_delay  = TDMA_RX_DELAY;
+}
+//-----------------------------------------------------------------------------
+// reset synchronization, schedule and statistic
+void tdma_reset(tdma_t *self)
+{
+  tdma_t opt = *self;
+  memset((void*) self, 0, sizeof(tdma_t));
+  self->active    = opt.active;
+  self->slot      = opt.slot;
+  self->slots     = opt.slots;
+  self->slot_us   = opt.slot_us;
+  self->guard_min = opt.guard_min;
+  self->rx_delay  = opt.rx_delay;
+  self->toa       = opt.toa;
+}
+//-----------------------------------------------------------------------------
+// frame length [us]
+uint32_t tdma_frame_us(const tdma_t *self)
+{
+  return (uint32_t) self->slots * self->slot_us;
+}
+//-----------------------------------------------------------------------------
+// coordinator - local time at local time `t` [us] (by offset and drift)
+int32_t tdma_offset(const tdma_t *self, uint32_t t)
+{
+  if (self->slot == 0) return 0; // coordinator clock is reference
+  return self->offset +
+         (int32_t) ((int64_t) self->drift * (int32_t) (t - self->t_sync) /
+                    1000000000);
+}
+//-----------------------------------------------------------------------------
+// start (FSM mode TD): `t` - local time [us], `toa` - time on air [us]
+// (coordinator sends first beacon now, member waits beacons)
+void tdma_begin(tdma_t *self, uint32_t t, uint32_t toa)
+{
+  self->active  = 1;
+  self->toa     = toa;
+  self->sync    = 0;
+  self->armed   = 0;
+  self->frame_t = t;
+}
+//-----------------------------------------------------------------------------
+// own TX must start at local time `t` [us] (call from main loop when radio
+// is in RX): return 1 once per own slot
+uint8_t tdma_due(tdma_t *self, uint32_t t)
+{
+  uint32_t frame = tdma_frame_us(self);
+
+  if (!self->active || frame == 0) return 0;
+
+  if (self->slot == 0)
+  { // coordinator: beacon at frame start by own clock
+    if (!self->armed)
+    {
+      self->next  = t;
+      self->armed = 1;
+    }
+    if ((int32_t) (t - self->next) < 0) return 0;
+    do self->next += frame; while ((int32_t) (t - self->next) >= 0);
+    return 1;
+  }
+
+  if (!self->sync) return 0;
+  if (t - self->t_sync > (uint32_t) TDMA_LOST * frame)
+  { // no beacons => stop TX until next acquisition
+    self->sync  = 0;
+    self->armed = 0;
+    self->lost++;
+    return 0;
+  }
+  if (self->sync < TDMA_ACQ) return 0;
+
+  if (!self->armed) tdma_arm(self, t);
+  if ((int32_t) (t - self->next) < 0) return 0;
+  self->armed = 0; // next slot is armed by next call
+
+  if (t - self->next > self->guard_min ||
+      self->toa + 2 * (uint32_t) self->guard > self->slot_us)
+  { // late start or packet with guards does not fit to slot
+    self->late++;
+    return 0;
+  }
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// write TDMA header to payload tail before own TX at local time `t` [us]
+// (return 0 if payload is too small)
+uint8_t tdma_stamp(tdma_t *self, uint8_t *data, uint8_t size, uint32_t t)
+{
+  uint8_t *p;
+
+  if (size < TDMA_HDR_SIZE) return 0;
+  p = data + size - TDMA_HDR_SIZE;
+
+  p[0] = TDMA_MAGIC;
+  p[1] = self->slot;
+  tdma_put32(p + 2, t + (uint32_t) tdma_offset(self, t));
+  p[6] = self->slots;
+  tdma_put32(p + 7, self->slot_us);
+
+  if (self->slot == 0)
+  { // beacon: frame start
+    self->frame_t = t;
+    self->beacons++;
+  }
+  self->sent++;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// received packet with RxDone at local time `t` [us]: member disciplines
+// clock by beacon, coordinator measures clock error of member
+// (return 1 if packet has TDMA header)
+uint8_t tdma_recv(tdma_t *self, const uint8_t *data, uint8_t size,
+                  uint32_t t)
+{
+  const uint8_t *p;
+  uint32_t c, slot_us;
+  uint8_t slots;
+  int32_t o;
+
+  if (!self->active || size < TDMA_HDR_SIZE) return 0;
+  p = data + size - TDMA_HDR_SIZE;
+  if (p[0] != TDMA_MAGIC) return 0;
+
+  // coordinator time of RxDone: TX start + time on air + residual delay
+  c = tdma_get32(p + 2) + self->toa + (uint32_t) (int32_t) self->rx_delay;
+
+  if (self->slot == 0)
+  { // coordinator: clock error of member
+    if (p[1] != 0)
+    {
+      self->rx++;
+      tdma_error(self, (int32_t) (c - t));
+    }
+    return 1;
+  }
+
+  slots   = p[6];
+  slot_us = tdma_get32(p + 7);
+  if (p[1] != 0 || slots < 2 || slot_us == 0)
+    return 1; // other member or bad beacon
+
+  self->beacons++;
+  o = (int32_t) (c - t);
+
+  if (self->sync)
+  { // predict offset by drift, correct offset and drift by error
+    uint32_t dt = t - self->t_sync;
+    int32_t pred = tdma_offset(self, t), e = o - pred;
+
+    if (dt == 0 || dt > (uint32_t) TDMA_LOST * slots * slot_us ||
+        tdma_abs(e) > slot_us / 2)
+      self->sync = 0; // time jump (coordinator restart) => acquisition
+    else
+    {
+      self->drift += (int32_t) ((int64_t) e * 1000000000 / dt / TDMA_KI);
+      self->offset = pred + e / TDMA_KP;
+      tdma_error(self, e);
+      if (self->sync < 255) self->sync++;
+    }
+  }
+
+  if (!self->sync)
+  { // acquisition: offset by one beacon, drift is unknown
+    self->offset = o;
+    self->drift  = 0;
+    self->jit    = 0;
+    self->sync   = 1;
+    self->resync++;
+  }
+
+  self->t_sync  = t;
+  self->frame_t = tdma_get32(p + 2);
+  self->slots   = slots;
+  self->slot_us = slot_us;
+  self->armed   = 0; // reschedule by new estimate
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// RX ring subscriber (context = tdma_t*)
+uint8_t tdma_rx_cb(const rx_pkt_t *pkt, void *context)
+{
+  tdma_t *self = (tdma_t*) context;
+  if (pkt->rx.crc_ok) // end of packet on air (compensated RxDone)
+    tdma_recv(self, pkt->data, pkt->size, (uint32_t) (pkt->ts / 1000));
+  return 1;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "tdma.c" file ***/
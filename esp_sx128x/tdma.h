@@ -0,0 +1,119 @@
+/*
+ * TDMA slot scheduler: coordinator beacons, clock discipline of members by
+ * beacon RxDone time (offset and drift), guard times by measured error
+ * File: "tdma.h"
+ */
+
+#pragma once
+#ifndef TDMA_H
+#define TDMA_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "config.h"
+#include "rx_ring.h"
+//-----------------------------------------------------------------------------
+// TDMA header at the END of payload (little endian):
+//   [0]     - TDMA_MAGIC
+//   [1]     - slot of sender (0 - coordinator beacon)
+//   [2..5]  - TX start time by coordinator clock [us] (member: estimate)
+//   [6]     - slots in frame (beacon slot included)
+//   [7..10] - slot length [us]
+#define TDMA_MAGIC    0xD5
+#define TDMA_HDR_SIZE 11
+
+// frame by default (coordinator)
+#define TDMA_SLOTS        8 // slots in frame (slot 0 - beacon)
+#define TDMA_SLOT_US  20000 // slot length [us]
+
+// clock discipline by default (member)
+#define TDMA_GUARD_MIN  100 // minimal guard time (TX start jitter) [us]
+#define TDMA_RX_DELAY     0 // RxDone delay not compensated by timestamps [us]
+#define TDMA_ACQ          3 // beacons before first TX (drift is measured)
+#define TDMA_LOST         8 // frames without beacon before sync loss
+#define TDMA_KP           2 // offset correction = error / TDMA_KP
+#define TDMA_KI           4 // drift correction = error / time / TDMA_KI
+//-----------------------------------------------------------------------------
+// TDMA scheduler
+typedef struct tdma_ {
+  uint8_t  active;    // 1 - FSM mode TD is running
+
+  // options
+  uint8_t  slot;      // own slot (0 - coordinator)
+  uint8_t  slots;     // slots in frame (coordinator, member: by beacon)
+  uint32_t slot_us;   // slot length [us] (coordinator, member: by beacon)
+  uint16_t guard_min; // minimal guard time [us]
+  int16_t  rx_delay;  // RxDone delay not compensated by timestamps [us]
+  uint32_t toa;       // time on air of packets [us] (set by FSM)
+
+  // schedule
+  uint32_t frame_t;   // coordinator time of last beacon TX start [us]
+  uint32_t next_c;    // coordinator time of next own slot start [us]
+  uint32_t next;      // local time of next own TX start [us]
+  uint8_t  armed;     // 1 - `next` is valid
+  uint16_t guard;     // guard time of next own TX [us]
+
+  // clock discipline (member)
+  uint8_t  sync;      // beacons after acquisition (0 - no sync)
+  int32_t  offset;    // coordinator - local time at `t_sync` [us]
+  uint32_t t_sync;    // local time of last beacon RxDone [us]
+  int32_t  drift;     // coordinator clock rate - local clock rate [ppb]
+
+  // error: beacon prediction (member) or clock of members (coordinator)
+  int32_t  err;       // last error [us]
+  uint32_t err_max;   // maximal |error| [us]
+  uint32_t jit;       // EWMA of |error| * 16 [us]
+
+  // statistic
+  uint32_t beacons;   // beacons sent (coordinator) or received (member)
+  uint32_t sent;      // own slot transmissions
+  uint32_t rx;        // member packets received (coordinator)
+  uint32_t late;      // own slots skipped (late start or guard > slot)
+  uint32_t resync;    // member synchronizations
+  uint32_t lost;      // member sync losses
+} tdma_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init scheduler (coordinator, default frame and discipline)
+void tdma_init(tdma_t *self);
+//-----------------------------------------------------------------------------
+// reset synchronization, schedule and statistic
+void tdma_reset(tdma_t *self);
+//-----------------------------------------------------------------------------
+// frame length [us]
+uint32_t tdma_frame_us(const tdma_t *self);
+//-----------------------------------------------------------------------------
+// coordinator - local time at local time `t` [us] (by offset and drift)
+int32_t tdma_offset(const tdma_t *self, uint32_t t);
+//-----------------------------------------------------------------------------
+// start (FSM mode TD): `t` - local time [us], `toa` - time on air [us]
+// (coordinator sends first beacon now, member waits beacons)
+void tdma_begin(tdma_t *self, uint32_t t, uint32_t toa);
+//-----------------------------------------------------------------------------
+// own TX must start at local time `t` [us] (call from main loop when radio
+// is in RX): return 1 once per own slot
+uint8_t tdma_due(tdma_t *self, uint32_t t);
+//-----------------------------------------------------------------------------
+// write TDMA header to payload tail before own TX at local time `t` [us]
+// (return 0 if payload is too small)
+uint8_t tdma_stamp(tdma_t *self, uint8_t *data, uint8_t size, uint32_t t);
+//-----------------------------------------------------------------------------
+// received packet with RxDone at local time `t` [us]: member disciplines
+// clock by beacon, coordinator measures clock error of member
+// (return 1 if packet has TDMA header)
+uint8_t tdma_recv(tdma_t *self, const uint8_t *data, uint8_t size,
+                  uint32_t t);
+//-----------------------------------------------------------------------------
+// RX ring subscriber (context = tdma_t*)
+uint8_t tdma_rx_cb(const rx_pkt_t *pkt, void *context);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // TDMA_H
+
+/*** end of "tdma.h" file ***/
@@ -0,0 +1,224 @@
+/*
+ * 64-bit monotonic timestamps by pluggable clock source (ESP32 hardware
+ * timer, micros() or host clock) and TxDone/RxDone delay compensation
+ * File: "tstamp.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset()
+#include "config.h" // ARDUINO_ESP32, USE_VCLOCK
+#include "tstamp.h"
+#if defined(USE_VCLOCK)
+#  include "vclock.h"
+#elif defined(__linux__)
+#  include <time.h> // clock_gettime()
+#else
+#  include <Arduino.h> // micros()
+#endif
+//-----------------------------------------------------------------------------
+// reference point: raw counter and extended counter at last poll
+typedef struct tstamp_ref_ {
+  uint64_t raw; // raw counter of source
+  uint64_t ext; // ticks from source start (no wrap)
+} tstamp_ref_t;
+//-----------------------------------------------------------------------------
+// default clock source
+#if defined(USE_VCLOCK)
+static uint64_t tstamp_src_default(void) { return vclock_now(); }
+#  define TSTAMP_SRC_HZ   1000000
+#  define TSTAMP_SRC_BITS 64
+#  define TSTAMP_SRC_NAME "vclock"
+#elif defined(__linux__)
+static uint64_t tstamp_src_default(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+#  define TSTAMP_SRC_HZ   1000000000
+#  define TSTAMP_SRC_BITS 64
+#  define TSTAMP_SRC_NAME "monotonic"
+#else
+static uint64_t TSTAMP_IRAM tstamp_src_default(void) { return micros(); }
+#  define TSTAMP_SRC_HZ   1000000
+#  define TSTAMP_SRC_BITS 32
+#  define TSTAMP_SRC_NAME "micros"
+#endif
+//-----------------------------------------------------------------------------
+static tstamp_src_t TsSrc   = tstamp_src_default;
+static uint32_t     TsHz    = TSTAMP_SRC_HZ;
+static uint8_t      TsBits  = TSTAMP_SRC_BITS;
+static const char  *TsName  = TSTAMP_SRC_NAME;
+static uint64_t     TsBase  = 0; // time of source start [ns]
+
+// ticks to time by multiply-shift: ns = ticks * TsMul >> TsShift (exact,
+// TsMul = 0 - 1e9 * 2^32 is not multiple of `TsHz`, use division)
+static uint32_t     TsMul   = 1000000000 / TSTAMP_SRC_HZ;
+static uint8_t      TsShift = 0;
+
+// double buffered reference (main loop writes one, ISR reads other)
+static tstamp_ref_t     TsRef[2];
+static volatile uint8_t TsIdx = 0;
+//-----------------------------------------------------------------------------
+// ticks of source to time [ns] (without 64 bit overflow)
+static uint64_t TSTAMP_IRAM tstamp_ticks_ns(uint64_t ext)
+{
+  if (TsMul)
+  { // two 32x32 multiplications (ISR friendly, no 64 bit division)
+    uint64_t hi = (uint64_t) (uint32_t) (ext >> 32) * TsMul;
+    uint64_t lo = (uint64_t) (uint32_t)  ext        * TsMul;
+    return TsBase + (hi << (32 - TsShift)) + (lo >> TsShift);
+  }
+  return TsBase + (ext / TsHz) * 1000000000 +
+         (ext % TsHz) * 1000000000 / TsHz;
+}
+//-----------------------------------------------------------------------------
+// exact multiply-shift for `hz`: minimal shift with 1e9 * 2^shift / hz
+// integer and 32 bit (return 0 if there is no one)
+static uint32_t tstamp_mul(uint32_t hz, uint8_t *shift)
+{
+  uint8_t s;
+  for (s = 0; s <= 32; s++)
+  {
+    uint64_t n = 1000000000ull << s;
+    if (n % hz == 0)
+    {
+      *shift = s;
+      return n / hz <= 0xFFFFFFFFull ? (uint32_t) (n / hz) : 0;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// extend raw counter by reference (signed difference in half wrap)
+static uint64_t TSTAMP_IRAM tstamp_extend(uint64_t raw)
+{
+  const tstamp_ref_t *ref = &TsRef[TsIdx];
+  uint64_t d = raw - ref->raw;
+
+  if (TsBits < 64)
+  { // sign extend difference from `TsBits`
+    uint64_t m = ((uint64_t) 1 << TsBits) - 1;
+    d &= m;
+    if (d > (m >> 1)) d -= m + 1;
+  }
+  return ref->ext + d;
+}
+//-----------------------------------------------------------------------------
+// set clock source (`hz` - counter frequency, `bits` - counter width);
+// time continues monotonic from previous source (call from setup())
+void tstamp_source(tstamp_src_t src, uint32_t hz, uint8_t bits,
+                   const char *name)
+{
+  uint64_t now = tstamp_ns();
+  uint8_t i = !TsIdx, shift = 0;
+  uint32_t mul;
+
+  if (hz == 0 || bits == 0 || bits > 64) return;
+  mul = tstamp_mul(hz, &shift);
+
+  // new source starts from current time
+  TsRef[i].raw = src();
+  TsRef[i].ext = 0;
+  TsSrc   = src;
+  TsHz    = hz;
+  TsMul   = mul;
+  TsShift = shift;
+  TsBits  = bits;
+  TsName  = name;
+  TsBase  = now;
+  TsIdx   = i;
+}
+//-----------------------------------------------------------------------------
+// clock source name
+const char *tstamp_name(void)
+{
+  return TsName;
+}
+//-----------------------------------------------------------------------------
+// clock source frequency [Hz]
+uint32_t tstamp_hz(void)
+{
+  return TsHz;
+}
+//-----------------------------------------------------------------------------
+// extend raw counter (call from main loop at least once per half wrap
+// of source counter, ~35 minutes for micros())
+void tstamp_poll(void)
+{
+  uint64_t raw = TsSrc();
+  uint8_t i = !TsIdx;
+  TsRef[i].ext = tstamp_extend(raw);
+  TsRef[i].raw = raw;
+  TsIdx = i;
+}
+//-----------------------------------------------------------------------------
+// read raw counter of clock source (ISR safe)
+uint64_t TSTAMP_IRAM tstamp_raw(void)
+{
+  return TsSrc();
+}
+//-----------------------------------------------------------------------------
+// raw counter (not older/newer than half wrap from last poll) to time [ns]
+// (ISR safe)
+uint64_t TSTAMP_IRAM tstamp_ns_raw(uint64_t raw)
+{
+  return tstamp_ticks_ns(tstamp_extend(raw));
+}
+//-----------------------------------------------------------------------------
+// current time [ns] (64 bit, monotonic, ISR safe)
+uint64_t TSTAMP_IRAM tstamp_ns(void)
+{
+  return tstamp_ticks_ns(tstamp_extend(TsSrc()));
+}
+//-----------------------------------------------------------------------------
+// current time [us] (64 bit, monotonic, ISR safe)
+uint64_t TSTAMP_IRAM tstamp_us(void)
+{
+  return tstamp_ns() / 1000;
+}
+//-----------------------------------------------------------------------------
+// init radio events (default compensation)
+void tstamp_link_init(tstamp_link_t *self)
+{
+  uint8_t i;
+  memset((void*) self, 0, sizeof(tstamp_link_t));
+  for (i = 0; i < TSTAMP_MODEMS; i++)
+  {
+    self->delay[i].tx = TSTAMP_TX_DELAY;
+    self->delay[i].rx = TSTAMP_RX_DELAY;
+  }
+}
+//-----------------------------------------------------------------------------
+// TxDone at `ns` of packet type `mode` started by SetTx() at `start` [ns]
+// with time on air `toa` [us]: return end of packet on air [ns]
+uint64_t tstamp_link_tx(tstamp_link_t *self, uint8_t mode, uint64_t ns,
+                        uint64_t start, uint32_t toa)
+{
+  if (mode >= TSTAMP_MODEMS) mode = 0;
+  self->tx      = ns - (uint64_t) (int64_t) self->delay[mode].tx;
+  self->tx_mode = mode;
+
+  if (start && toa && ns > start)
+  { // overhead of TX start
+    int64_t o = (int64_t) (ns - start) - (int64_t) toa * 1000;
+    if      (o >  0x7FFFFFF) o =  0x7FFFFFF;
+    else if (o < -0x7FFFFFF) o = -0x7FFFFFF;
+    self->ovh[mode] = (int32_t) o;
+    if (self->ovh_cnt[mode]++ == 0) self->ovh_avg[mode] = (int32_t) o * 8;
+    else self->ovh_avg[mode] += (int32_t) o - self->ovh_avg[mode] / 8;
+  }
+  return self->tx;
+}
+//-----------------------------------------------------------------------------
+// RxDone at `ns` of packet type `mode`: return end of packet on air [ns]
+uint64_t tstamp_link_rx(tstamp_link_t *self, uint8_t mode, uint64_t ns)
+{
+  if (mode >= TSTAMP_MODEMS) mode = 0;
+  self->rx      = ns - (uint64_t) (int64_t) self->delay[mode].rx;
+  self->rx_mode = mode;
+  return self->rx;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "tstamp.c" file ***/
@@ -0,0 +1,102 @@
+/*
+ * 64-bit monotonic timestamps by pluggable clock source (ESP32 hardware
+ * timer, micros() or host clock) and TxDone/RxDone delay compensation
+ * File: "tstamp.h"
+ */
+
+#pragma once
+#ifndef TSTAMP_H
+#define TSTAMP_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+//-----------------------------------------------------------------------------
+#define TSTAMP_MODEMS 5 // packet types: 0-GFSK, 1-LoRa, 2-Ranging, 3-FLRC, 4-BLE
+
+// TxDone/RxDone IRQ after end of packet on air by default [ns]
+// (DIO1 edge + ISR entry, 0 - not calibrated: timestamps are not
+// compensated until set by "ts delay" command)
+#define TSTAMP_TX_DELAY 0
+#define TSTAMP_RX_DELAY 0
+//-----------------------------------------------------------------------------
+// function in IRAM (may be called from ISR)
+#if defined(ARDUINO_ESP32)
+#  include "esp_attr.h"
+#  define TSTAMP_IRAM IRAM_ATTR
+#else
+#  define TSTAMP_IRAM
+#endif
+//-----------------------------------------------------------------------------
+// clock source: raw counter (`bits` wide, wrap to 0)
+typedef uint64_t (*tstamp_src_t)(void);
+//-----------------------------------------------------------------------------
+// TxDone/RxDone compensation of one modem [ns]
+typedef struct tstamp_delay_ {
+  int32_t tx; // TxDone IRQ after end of packet on air
+  int32_t rx; // RxDone IRQ after end of packet on air
+} tstamp_delay_t;
+//-----------------------------------------------------------------------------
+// radio events by compensated timestamps
+typedef struct tstamp_link_ {
+  tstamp_delay_t delay[TSTAMP_MODEMS]; // compensation [ns]
+
+  uint64_t tx;       // last TxDone: end of packet on air [ns]
+  uint64_t rx;       // last RxDone: end of packet on air [ns]
+  uint8_t  tx_mode;  // packet type of last TxDone
+  uint8_t  rx_mode;  // packet type of last RxDone
+
+  // TX start overhead: SetTx() -> TxDone minus time on air (ramp, IRQ)
+  // (statistic for "ts delay" calibration, TDMA slots don't use it)
+  int32_t  ovh[TSTAMP_MODEMS];     // last [ns]
+  int32_t  ovh_avg[TSTAMP_MODEMS]; // EWMA * 8 [ns]
+  uint32_t ovh_cnt[TSTAMP_MODEMS]; // number of TxDone
+} tstamp_link_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// set clock source (`hz` - counter frequency, `bits` - counter width);
+// time continues monotonic from previous source
+void tstamp_source(tstamp_src_t src, uint32_t hz, uint8_t bits,
+                   const char *name);
+//-----------------------------------------------------------------------------
+// clock source name and frequency [Hz]
+const char *tstamp_name(void);
+uint32_t tstamp_hz(void);
+//-----------------------------------------------------------------------------
+// extend raw counter (call from main loop at least once per half wrap
+// of source counter, ~35 minutes for micros())
+void tstamp_poll(void);
+//-----------------------------------------------------------------------------
+// read raw counter of clock source (ISR safe)
+uint64_t tstamp_raw(void);
+//-----------------------------------------------------------------------------
+// raw counter (not older/newer than half wrap from last poll) to time [ns]
+// (ISR safe)
+uint64_t tstamp_ns_raw(uint64_t raw);
+//-----------------------------------------------------------------------------
+// current time [ns] (64 bit, monotonic, ISR safe)
+uint64_t tstamp_ns(void);
+//-----------------------------------------------------------------------------
+// current time [us] (64 bit, monotonic, ISR safe)
+uint64_t tstamp_us(void);
+//-----------------------------------------------------------------------------
+// init radio events (default compensation)
+void tstamp_link_init(tstamp_link_t *self);
+//-----------------------------------------------------------------------------
+// TxDone at `ns` of packet type `mode` started by SetTx() at `start` [ns]
+// with time on air `toa` [us]: return end of packet on air [ns]
+uint64_t tstamp_link_tx(tstamp_link_t *self, uint8_t mode, uint64_t ns,
+                        uint64_t start, uint32_t toa);
+//-----------------------------------------------------------------------------
+// RxDone at `ns` of packet type `mode`: return end of packet on air [ns]
+uint64_t tstamp_link_rx(tstamp_link_t *self, uint8_t mode, uint64_t ns);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // TSTAMP_H
+
+/*** end of "tstamp.h" file ***/
@@ -0,0 +1,44 @@
+/*
+ * Timestamp clock source by ESP32 hardware timer (64-bit timer group counter)
+ * File: "tstamp_timer.cpp"
+ */
+
+//-----------------------------------------------------------------------------
+#include <Arduino.h>
+#include "config.h" // TSTAMP_TIMER_NUM, TSTAMP_TIMER_HZ
+#include "tstamp.h"
+#include "tstamp_timer.h"
+//-----------------------------------------------------------------------------
+#ifndef ESP_ARDUINO_VERSION_MAJOR
+#  define ESP_ARDUINO_VERSION_MAJOR 2
+#endif
+//-----------------------------------------------------------------------------
+static hw_timer_t *TsTimer = NULL;
+//-----------------------------------------------------------------------------
+// raw counter (free running up counter, no alarm and no interrupt)
+static uint64_t IRAM_ATTR tstamp_timer_read(void)
+{
+  return timerRead(TsTimer);
+}
+//-----------------------------------------------------------------------------
+// start hardware timer TSTAMP_TIMER_NUM at TSTAMP_TIMER_HZ and set it as
+// clock source of timestamps (look "tstamp.h"), return 0 on success
+int8_t tstamp_timer_begin(void)
+{
+  if (TsTimer == NULL)
+  {
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+    TsTimer = timerBegin(TSTAMP_TIMER_HZ);
+#else
+    TsTimer = timerBegin(TSTAMP_TIMER_NUM, APB_CLK_FREQ / TSTAMP_TIMER_HZ, true);
+#endif
+    if (TsTimer == NULL) return -1;
+    timerStart(TsTimer);
+  }
+
+  tstamp_source(tstamp_timer_read, TSTAMP_TIMER_HZ, 64, "timer");
+  return 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "tstamp_timer.cpp" file ***/
@@ -0,0 +1,27 @@
+/*
+ * Timestamp clock source by ESP32 hardware timer (64-bit timer group counter)
+ * File: "tstamp_timer.h"
+ */
+
+#pragma once
+#ifndef TSTAMP_TIMER_H
+#define TSTAMP_TIMER_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// start hardware timer TSTAMP_TIMER_NUM at TSTAMP_TIMER_HZ and set it as
+// clock source of timestamps (look "tstamp.h"), return 0 on success
+int8_t tstamp_timer_begin(void);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // TSTAMP_TIMER_H
+
+/*** end of "tstamp_timer.h" file ***/
@@ -0,0 +1,126 @@
+/*
+ * Virtual (simulated) clock for host build of FSM (USE_VCLOCK)
+ * File: "vclock.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <stddef.h> // NULL
+#include "vclock.h"
+//-----------------------------------------------------------------------------
+// one-shot alarm
+typedef struct vclock_alarm_ {
+  uint64_t    t;       // fire time [us]
+  vclock_cb_t cb;      // callback or NULL (free)
+  void       *context; // callback context
+} vclock_alarm_t;
+//-----------------------------------------------------------------------------
+static uint64_t vclock_t = 0; // current time [us]
+static vclock_alarm_t vclock_alarms[VCLOCK_ALARMS];
+static int vclock_top = 0; // highest used alarm index + 1 (scan limit)
+//-----------------------------------------------------------------------------
+// lower scan limit after alarms are freed
+static void vclock_shrink(void)
+{
+  while (vclock_top > 0 && vclock_alarms[vclock_top - 1].cb == NULL)
+    vclock_top--;
+}
+//-----------------------------------------------------------------------------
+// set current time [us] and cancel all alarms
+void vclock_reset(uint64_t us)
+{
+  int i;
+  vclock_t = us;
+  for (i = 0; i < VCLOCK_ALARMS; i++) vclock_alarms[i].cb = NULL;
+  vclock_top = 0;
+}
+//-----------------------------------------------------------------------------
+// get current time [us] (64 bit, no wrap)
+uint64_t vclock_now(void)
+{
+  return vclock_t;
+}
+//-----------------------------------------------------------------------------
+// micros() replacement (wrap after ~71 minutes as on hardware)
+unsigned long vclock_us(void)
+{
+  return (unsigned long) (uint32_t) vclock_t;
+}
+//-----------------------------------------------------------------------------
+// millis() replacement
+unsigned long vclock_ms(void)
+{
+  return (unsigned long) (uint32_t) (vclock_t / 1000);
+}
+//-----------------------------------------------------------------------------
+// set alarm after `us` from now (return alarm index or -1 if no room)
+int vclock_alarm(uint32_t us, vclock_cb_t cb, void *context)
+{
+  int i;
+  for (i = 0; i < VCLOCK_ALARMS; i++)
+  {
+    vclock_alarm_t *a = &vclock_alarms[i];
+    if (a->cb == NULL)
+    {
+      a->t       = vclock_t + us;
+      a->cb      = cb;
+      a->context = context;
+      if (vclock_top <= i) vclock_top = i + 1;
+      return i;
+    }
+  }
+  return -1;
+}
+//-----------------------------------------------------------------------------
+// cancel alarm by index
+void vclock_cancel(int alarm)
+{
+  if (alarm >= 0 && alarm < VCLOCK_ALARMS)
+  {
+    vclock_alarms[alarm].cb = NULL;
+    vclock_shrink();
+  }
+}
+//-----------------------------------------------------------------------------
+// advance time to the nearest alarm but not more than `max_us`
+// and fire due alarms (return number of fired alarms)
+int vclock_step(uint32_t max_us)
+{
+  uint64_t t = vclock_t + max_us;
+  int i, cnt = 0;
+
+  for (i = 0; i < vclock_top; i++)
+    if (vclock_alarms[i].cb != NULL && vclock_alarms[i].t < t)
+      t = vclock_alarms[i].t;
+
+  if (t > vclock_t) vclock_t = t;
+
+  for (i = 0; i < vclock_top; i++) // callback may raise `vclock_top`
+  {
+    vclock_alarm_t *a = &vclock_alarms[i];
+    if (a->cb != NULL && a->t <= vclock_t)
+    {
+      vclock_cb_t cb = a->cb;
+      a->cb = NULL; // free before call (callback may set new alarm)
+      cb(a->context);
+      cnt++;
+    }
+  }
+  vclock_shrink();
+
+  return cnt;
+}
+//-----------------------------------------------------------------------------
+// advance time by `us` (fire all alarms on the way)
+void vclock_advance(uint64_t us)
+{
+  uint64_t end = vclock_t + us;
+  while (vclock_t < end)
+  {
+    uint64_t rest = end - vclock_t;
+    vclock_step(rest > 0xFFFFFFFFul ? 0xFFFFFFFFul : (uint32_t) rest);
+  }
+  vclock_step(0); // alarms at the end
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "vclock.c" file ***/
@@ -0,0 +1,55 @@
+/*
+ * Virtual (simulated) clock for host build of FSM (USE_VCLOCK)
+ * File: "vclock.h"
+ */
+
+#pragma once
+#ifndef VCLOCK_H
+#define VCLOCK_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+//-----------------------------------------------------------------------------
+#ifndef VCLOCK_ALARMS
+#  define VCLOCK_ALARMS 8 // maximal number of pending alarms
+#endif
+//-----------------------------------------------------------------------------
+// alarm callback (simulated IRQ, radio event and so on)
+typedef void (*vclock_cb_t)(void *context);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// set current time [us] and cancel all alarms
+void vclock_reset(uint64_t us);
+//-----------------------------------------------------------------------------
+// get current time [us] (64 bit, no wrap)
+uint64_t vclock_now(void);
+//-----------------------------------------------------------------------------
+// micros() replacement (wrap after ~71 minutes as on hardware)
+unsigned long vclock_us(void);
+//-----------------------------------------------------------------------------
+// millis() replacement
+unsigned long vclock_ms(void);
+//-----------------------------------------------------------------------------
+// set alarm after `us` from now (return alarm index or -1 if no room)
+int vclock_alarm(uint32_t us, vclock_cb_t cb, void *context);
+//-----------------------------------------------------------------------------
+// cancel alarm by index
+void vclock_cancel(int alarm);
+//-----------------------------------------------------------------------------
+// advance time to the nearest alarm but not more than `max_us`
+// and fire due alarms (return number of fired alarms)
+int vclock_step(uint32_t max_us);
+//-----------------------------------------------------------------------------
+// advance time by `us` (fire all alarms on the way)
+void vclock_advance(uint64_t us);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // VCLOCK_H
+
+/*** end of "vclock.h" file ***/
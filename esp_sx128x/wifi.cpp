@@ -10,6 +10,7 @@
 //-----------------------------------------------------------------------------
 #include "config.h"
 #include "wifi.h"
+#include "print.h"
 //-----------------------------------------------------------------------------
 static const char *wifi_ssid   = "";
 static const char *wifi_passwd = "";
@@ -29,6 +30,7 @@ bool wifi_reconnect()
   unsigned cnt = 0;
   unsigned timeout = WIFI_TIMEOUT * 2;
 
+  print_flush(); // deferred log and capture frame before direct output
   Serial.print("Trying Wi-Fi connection to ESSID: \"");
   Serial.print(wifi_ssid);
   Serial.print("\" in ");
@@ -79,6 +81,7 @@ long wifi_rssi()
 void wifi_status_print()
 {
   bool connected = WiFi.isConnected();
+  print_flush(); // deferred log and capture frame before direct output
   Serial.print("Wi-Fi is ");
   Serial.println(connected ? "connected" : "disconnected");
 
@@ -27,8 +27,13 @@ int main()
   int scale = (150 * 1000000 / 4096); // 36621.09375
   int d4 = rs * scale / ((int) rint(fbw * 1e3) / 100);
 
-  printf("rs=%i d1=%.3fm d2=%idm d3=%im d4=%icm\n",
-          rs, d1, d2, d3, d4);
+  // exact (sx128x_ranging_distance()): 64-bit, BW in Hz, rounding
+  long long num = (long long) rs * 15000000000LL; // 150 m * 100 cm * 1e6 Hz
+  long long den = (long long) rint(fbw * 1e3) << 12;
+  int d5 = (int) ((num < 0 ? num - den / 2 : num + den / 2) / den);
+
+  printf("rs=%i d1=%.3fm d2=%idm d3=%im d4=%icm d5=%icm\n",
+          rs, d1, d2, d3, d4, d5);
   
   return 0;
 }
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# Convert Advanced Ranging passive capture log of esp_sx128x
+# ("arlog 1" CLI command in FSM mode AR) to CSV
+#
+# Usage:
+#   stty -F /dev/ttyUSB0 115200 raw -echo
+#   ./arlog2csv.py /dev/ttyUSB0 arlog.csv [BW_kHz]
+#   ./arlog2csv.py arlog.bin arlog.csv [BW_kHz]
+#
+# Frame format look in "esp_sx128x/arlog.h"
+#
+
+import sys
+import struct
+
+SYNC = b'\xA5\x5A'
+TYPE = 0x80  # ARLOG_TYPE
+BATCH = 16   # ARLOG_BATCH
+HEAD = 4     # ARLOG_HEAD
+REC = 12     # ARLOG_REC
+
+def crc8(data):
+    crc = 0xFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x31) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+def frames(stream):
+    # yield log records from byte stream (skip console text, packet
+    # capture frames and broken frames)
+    buf = b''
+    while True:
+        chunk = stream.read(1024)
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                buf = buf[-1:]
+                break
+            buf = buf[i:]
+            if len(buf) < 6:
+                break
+            size = buf[2] | (buf[3] << 8)
+            n = buf[5]
+            if buf[4] != TYPE or n < 1 or n > BATCH or size != HEAD + n * REC:
+                buf = buf[1:] # false sync or other stream
+                continue
+            if len(buf) < size + 5:
+                break
+            if crc8(buf[2:size + 4]) != buf[size + 4]:
+                buf = buf[1:] # CRC error
+                continue
+            yield buf[4:size + 4]
+            buf = buf[size + 5:]
+
+def distance(raw, bw):
+    # raw 24-bit two's complement result => distance [m]
+    if raw & 0x800000:
+        raw -= 1 << 24
+    return raw * 150.0 / (4096.0 * bw / 1000.0)
+
+def main():
+    if len(sys.argv) < 3:
+        print('Usage: %s INPUT(tty|file) OUTPUT.csv [BW_kHz]' % sys.argv[0])
+        return 1
+    bw = int(sys.argv[3]) if len(sys.argv) > 3 else 1625
+
+    cnt, drops = 0, 0
+    with open(sys.argv[1], 'rb', buffering=0) as fi, open(sys.argv[2], 'w') as fo:
+        fo.write('t_us,addr,raw,distance_m,rssi_dbm\n')
+        try:
+            for rec in frames(fi):
+                n, drops = rec[1], struct.unpack_from('<H', rec, 2)[0]
+                for i in range(n):
+                    t, addr, r0, r1, r2, rssi = struct.unpack_from(
+                        '<IIBBBB', rec, HEAD + i * REC)
+                    raw = r0 | (r1 << 8) | (r2 << 16)
+                    fo.write('%u,0x%08X,0x%06X,%.2f,%.1f\n' %
+                             (t, addr, raw, distance(raw, bw), -rssi / 2.0))
+                    cnt += 1
+                fo.flush()
+        except KeyboardInterrupt:
+            pass
+    print('%d exchanges, %d dropped' % (cnt, drops))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# Convert binary capture stream of esp_sx128x ("cap 1" CLI command)
+# to pcapng file (LINKTYPE_USER0 = 147) for Wireshark
+#
+# Usage:
+#   stty -F /dev/ttyUSB0 115200 raw -echo
+#   ./cap2pcapng.py /dev/ttyUSB0 sx128x.pcapng
+#   ./cap2pcapng.py capture.bin sx128x.pcapng
+#
+# Frame format look in "esp_sx128x/capture.h"
+#
+
+import sys
+import time
+import struct
+
+SYNC = b'\xA5\x5A'
+LINKTYPE_USER0 = 147
+HEAD = 19 # record header size (without payload)
+VERSION = 1 # capture record version (other streams are skipped)
+
+def crc8(data):
+    crc = 0xFF
+    for b in data:
+        crc ^= b
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x31) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+def block(btype, body):
+    body += b'\0' * (-len(body) % 4) # pad to 32 bits
+    size = len(body) + 12
+    return struct.pack('<II', btype, size) + body + struct.pack('<I', size)
+
+def shb():
+    # Section Header Block
+    return block(0x0A0D0D0A, struct.pack('<IHHq', 0x1A2B3C4D, 1, 0, -1))
+
+def idb():
+    # Interface Description Block (if_tsresol = 6 => microseconds)
+    opts = struct.pack('<HHB3x', 9, 1, 6) + struct.pack('<HH', 0, 0)
+    return block(0x00000001, struct.pack('<HHI', LINKTYPE_USER0, 0, 65535) + opts)
+
+def epb(ts, data):
+    # Enhanced Packet Block
+    hdr = struct.pack('<IIIII', 0, ts >> 32, ts & 0xFFFFFFFF, len(data), len(data))
+    return block(0x00000006, hdr + data)
+
+def frames(stream):
+    # yield records from byte stream (skip console text and broken frames)
+    buf = b''
+    while True:
+        chunk = stream.read(1024)
+        if not chunk:
+            return
+        buf += chunk
+        while True:
+            i = buf.find(SYNC)
+            if i < 0:
+                buf = buf[-1:]
+                break
+            buf = buf[i:]
+            if len(buf) < 4:
+                break
+            size = buf[2] | (buf[3] << 8)
+            if size < HEAD or size > HEAD + 255:
+                buf = buf[1:] # false sync
+                continue
+            if len(buf) < size + 5:
+                break
+            if crc8(buf[2:size + 4]) != buf[size + 4]:
+                buf = buf[1:] # CRC error
+                continue
+            yield buf[4:size + 4]
+            buf = buf[size + 5:]
+
+def main():
+    if len(sys.argv) < 3:
+        print('Usage: %s INPUT(tty|file) OUTPUT.pcapng [--device-time]' % sys.argv[0])
+        return 1
+    device_time = '--device-time' in sys.argv[3:]
+
+    t_prev, t_high, t_base = None, 0, None
+    cnt = 0
+    with open(sys.argv[1], 'rb', buffering=0) as fi, open(sys.argv[2], 'wb') as fo:
+        fo.write(shb() + idb())
+        try:
+            for rec in frames(fi):
+                if rec[0] != VERSION:
+                    continue # not packet (e.g. "arlog" frame)
+                t = struct.unpack_from('<I', rec, 1)[0]
+                if t_prev is not None and t < t_prev:
+                    t_high += 1 << 32 # unwrap 32-bit microseconds
+                t_prev = t
+                ts = t_high + t
+                if not device_time:
+                    if t_base is None:
+                        t_base = int(time.time() * 1e6) - ts
+                    ts += t_base
+                fo.write(epb(ts, rec))
+                fo.flush()
+                cnt += 1
+        except KeyboardInterrupt:
+            pass
+    print('%d packets' % cnt)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
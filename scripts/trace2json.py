@@ -0,0 +1,80 @@
+#!/usr/bin/env python3
+#
+# Convert esp_sx128x SPI trace dump ("trace dump" CLI command output)
+# to Chrome trace JSON (open in chrome://tracing or ui.perfetto.dev)
+#
+# Usage:
+#   ./trace2json.py dump.txt trace.json
+#   ./trace2json.py - trace.json < dump.txt
+#
+# Input lines look like:
+#   trace: t=123456 op=0x8A len=2 busy=3 xfer=12 err=0
+#
+
+import os
+import re
+import sys
+import json
+
+LINE = re.compile(r'trace: t=(\d+) op=0x([0-9A-Fa-f]+) len=(\d+) '
+                  r'busy=(\d+) xfer=(\d+) err=(-?\d+)')
+
+DEF = re.compile(r'#define\s+SX128X_CMD_(\w+)\s+0x([0-9A-Fa-f]+)')
+
+def opcode_names():
+    # get opcode names from driver header (if found)
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                        '..', 'esp_sx128x', 'sx128x_def.h')
+    names = {}
+    try:
+        with open(path) as f:
+            for line in f:
+                m = DEF.search(line)
+                if m:
+                    names.setdefault(int(m.group(2), 16), m.group(1))
+    except OSError:
+        pass
+    return names
+
+def main():
+    if len(sys.argv) < 3:
+        print('Usage: %s DUMP.txt|- TRACE.json' % sys.argv[0])
+        return 1
+
+    names = opcode_names()
+    fi = sys.stdin if sys.argv[1] == '-' else open(sys.argv[1])
+    events = []
+    t_high, t_prev = 0, None
+    for line in fi:
+        m = LINE.search(line)
+        if not m:
+            continue
+        t, op, size, busy, xfer, err = m.groups()
+        t, op, busy, xfer = int(t), int(op, 16), int(busy), int(xfer)
+        if t_prev is not None and t < t_prev:
+            t_high += 1 << 32 # unwrap 32-bit microseconds
+        t_prev = t
+        t += t_high
+
+        name = names.get(op, '0x%02X' % op)
+        args = {'opcode': '0x%02X' % op, 'len': int(size), 'err': int(err)}
+        if busy:
+            events.append({'name': 'BUSY', 'cat': 'busy', 'ph': 'X',
+                           'ts': t, 'dur': busy, 'pid': 1, 'tid': 1,
+                           'args': args})
+        events.append({'name': name, 'cat': 'spi', 'ph': 'X',
+                       'ts': t + busy, 'dur': max(xfer, 1), 'pid': 1, 'tid': 2,
+                       'args': args})
+
+    events.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': 1,
+                   'args': {'name': 'BUSY wait'}})
+    events.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': 2,
+                   'args': {'name': 'SPI transfer'}})
+
+    with open(sys.argv[2], 'w') as fo:
+        json.dump({'traceEvents': events}, fo)
+    print('%d records' % (len(events) - 2))
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
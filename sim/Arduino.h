@@ -0,0 +1,42 @@
+/*
+ * Minimal Arduino API for host simulator and tests
+ * File: "Arduino.h"
+ */
+
+#pragma once
+#ifndef ARDUINO_H
+#define ARDUINO_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+//-----------------------------------------------------------------------------
+#define LOW         0
+#define HIGH        1
+#define INPUT       0
+#define OUTPUT      1
+#define LED_BUILTIN 2
+//-----------------------------------------------------------------------------
+// time by virtual clock (look "vclock.h")
+unsigned long millis();
+unsigned long micros();
+//-----------------------------------------------------------------------------
+// GPIO (do nothing)
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int val);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+// serial port (defined by test program that uses it, look "log_test.cpp")
+class HardwareSerial {
+public:
+  int    availableForWrite();
+  size_t write(const uint8_t *buf, size_t size);
+  size_t print(const char *str);
+  size_t print(char c);
+  void   flush();
+};
+extern HardwareSerial Serial;
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // ARDUINO_H
+
+/*** end of "Arduino.h" file ***/
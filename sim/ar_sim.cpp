@@ -0,0 +1,382 @@
+/*
+ * Advanced Ranging passive capture simulator (host build, virtual time)
+ * File: "ar_sim.cpp"
+ *
+ * K ranging masters (AFsm RM, own request addresses, staggered periods)
+ * around passive listener (AFsm AR) on emulated chips. Listener reads each
+ * AdvancedRangingDone by batched register access to "arlog.c" ring, main
+ * loop packs records to frames drained by modeled UART. Frames are checked
+ * (CRC, unpack) and captured exchanges are compared with ground truth:
+ * requests sent by every master, addresses, distances and counters
+ * (events = captured + dropped + pending). With --legacy listener reads
+ * exchange as before (address + ranging result) to compare SPI cost.
+ * Exit code 1 if capture is inconsistent.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), fprintf()
+#include <stdlib.h> // strtol(), strtod()
+#include <string.h> // strcmp(), memset()
+#include <math.h>   // sqrt(), fabs()
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "arlog.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build simulator with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define ASIM_STEP_US   20 // main loop step (IRQ polling resolution) [us]
+#define ASIM_MASTERS   16 // maximal number of masters
+#define ASIM_UART_FIFO 128 // UART TX FIFO (max credit of idle line) [bytes]
+//-----------------------------------------------------------------------------
+// simulation options
+typedef struct asim_opt_ {
+  uint32_t time;   // simulation time [s]
+  uint8_t  k;      // number of masters
+  uint32_t period; // master exchange period [ms]
+  uint8_t  sf;     // LoRa SF (5...10)
+  uint32_t bw;     // LoRa BW [kHz]
+  double   dist;   // distance of first master [m]
+  uint32_t baud;   // UART baud rate (0 - unlimited)
+  uint8_t  legacy; // 1 - read exchange by old functions
+  uint32_t seed;   // random seed
+} asim_opt_t;
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM)
+typedef struct asim_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  ABlink        led;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  uint32_t      errors; // FSM action errors
+} asim_node_t;
+//-----------------------------------------------------------------------------
+// capture statistic of one master
+typedef struct asim_stat_ {
+  uint32_t addr;      // request address
+  double   d;         // true distance [m]
+  uint32_t n;         // captured exchanges
+  double   sum, sum2; // distance error [m]
+} asim_stat_t;
+//-----------------------------------------------------------------------------
+static chan_t       Chan;  // RF channel (big, static)
+static arlog_t      Log;   // listener capture log
+static asim_node_t *Cur;   // node in FSM callback context
+static asim_stat_t  Stat[ASIM_MASTERS];
+static uint32_t     Spi;   // listener SPI transactions
+static uint32_t     SpiRead, Reads; // SPI transactions to read exchanges
+static uint32_t     Captured, Foreign, Broken, Order, DropsRx;
+static double       LatSum, LatMax; // event => host latency [ms]
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+// request address of master `i` (all bytes differ => byte order check)
+static uint32_t asim_addr(int i)
+{
+  return 0xA55A0000u | ((uint32_t) (i + 1) << 8) | (uint32_t) (0xF0 - i);
+}
+//-----------------------------------------------------------------------------
+// counting SPI exchange of listener
+static uint8_t asim_spi(uint8_t *rx_buf, const uint8_t *tx_buf, uint16_t len,
+                        void *context)
+{
+  Spi++;
+  return emu_spi_exchange(rx_buf, tx_buf, len, context);
+}
+//-----------------------------------------------------------------------------
+// FSM event callback
+static void asim_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  if (err != SX128X_ERR_NONE) Cur->errors++;
+}
+//-----------------------------------------------------------------------------
+// master DIO1 handler (no slaves => every exchange is lost)
+static void asim_master_irq(asim_node_t *n)
+{
+  uint16_t irq;
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+  if (irq & (SX128X_IRQ_MASTER_TIMEOUT | SX128X_IRQ_RX_TX_TIMEOUT))
+    n->fsm.rxtx_timeout();
+}
+//-----------------------------------------------------------------------------
+// listener DIO1 handler (AR part of sx128x_irq() with "arlog 1")
+static void asim_listener_irq(asim_node_t *n, const asim_opt_t *opt)
+{
+  uint32_t address, result, s0;
+  uint8_t  rssi;
+  uint16_t irq;
+  int8_t   retv;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+  if (!(irq & SX128X_IRQ_ADVANCED_RANGING_DONE)) return;
+
+  s0 = Spi;
+  if (opt->legacy)
+  { // old path: address (8 transactions) + ranging result
+    uint8_t filter = 0;
+    int32_t cm;
+    retv = sx128x_advanced_ranging_address(&n->radio, &address);
+    if (retv == SX128X_ERR_NONE)
+      retv = sx128x_ranging_result(&n->radio, &filter, &result, &cm, &rssi);
+  }
+  else
+    retv = sx128x_advanced_ranging_read(&n->radio, &address, &result, &rssi);
+  SpiRead += Spi - s0;
+  Reads++;
+
+  if (retv == SX128X_ERR_NONE)
+    arlog_push(&Log, vclock_us(), address, result, rssi);
+  n->fsm.ranging_done(); // restart RX
+}
+//-----------------------------------------------------------------------------
+// host side: check frame and account captured exchanges
+static void asim_host(const uint8_t *frame, uint16_t size, double bw_mhz)
+{
+  static uint32_t t_prev = 0;
+  arlog_rec_t rec[ARLOG_BATCH];
+  uint16_t drops;
+  uint8_t n, i;
+  int k;
+
+  n = arlog_unpack(frame, size, rec, &drops);
+  if (n == 0) { Broken++; return; }
+  DropsRx = drops;
+
+  for (i = 0; i < n; i++)
+  {
+    const arlog_rec_t *r = &rec[i];
+    int32_t raw = (int32_t) r->raw;
+    double lat = (vclock_us() - r->t) * 1e-3;
+
+    if (raw & 0x800000) raw -= 1 << 24;
+    if (r->t < t_prev) Order++;
+    t_prev = r->t;
+    LatSum += lat;
+    if (lat > LatMax) LatMax = lat;
+    Captured++;
+
+    for (k = 0; k < ASIM_MASTERS && Stat[k].addr != r->addr; k++);
+    if (k >= ASIM_MASTERS || Stat[k].d == 0.) { Foreign++; continue; }
+
+    double e = raw * 150. / (4096. * bw_mhz) - Stat[k].d;
+    Stat[k].n++;
+    Stat[k].sum  += e;
+    Stat[k].sum2 += e * e;
+  }
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - listener, 1...k - masters)
+static int asim_node_init(asim_node_t *n, int id, const asim_opt_t *opt)
+{
+  double a = id ? 2. * M_PI * (id - 1) / opt->k : 0.;
+  double d = id ? opt->dist * (1. + 0.5 * (id - 1)) : 0.;
+  int8_t retv;
+
+  emu_init(&n->emu, &Chan, id, d * cos(a), d * sin(a));
+  chan_add(&Chan, &n->emu);
+
+  n->pars      = sx128x_pars_default;
+  n->pars.mode = SX128X_RANGING;
+  n->pars.sf   = opt->sf;
+  n->pars.bw   = opt->bw;
+  n->pars.role = id ? 0x01 : 0x00;
+  if (id)
+  {
+    n->pars.master_address = asim_addr(id - 1);
+    Stat[id - 1].addr = n->pars.master_address;
+    Stat[id - 1].d    = d;
+  }
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, id ? emu_spi_exchange : asim_spi,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = id ? AFSM_RM : AFSM_AR;
+  n->fsm_pars.t    = opt->period + (id ? 7 * (id - 1) : 0); // staggered
+  n->fsm_pars.wut  = 1;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data_size  = 4;
+  n->tx_timeout = 0;
+  n->errors     = 0;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, asim_callback);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// simulate masters, listener and UART drain
+static int asim_run(const asim_opt_t *opt)
+{
+  static asim_node_t node[ASIM_MASTERS + 1];
+  static uint8_t frame[ARLOG_FRAME_MAX];
+  uint64_t end = (uint64_t) opt->time * 1000000ull;
+  double credit = 0., rate = opt->baud / 10e6; // [bytes/us]
+  uint16_t len = 0; // frame in UART (0 - idle)
+  int i;
+
+  vclock_reset(0);
+  chan_pars_t cp = chan_pars_default;
+  cp.seed = opt->seed;
+  chan_init(&Chan, &cp);
+
+  for (i = 0; i <= opt->k; i++)
+  {
+    if (asim_node_init(&node[i], i, opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail (node %i)\n", i);
+      return -1;
+    }
+  }
+
+  // listener first, masters start with 3 ms steps
+  arlog_init(&Log);
+  Log.on = 1;
+  Cur = &node[0];
+  node[0].fsm.start();
+
+  while (vclock_now() < end)
+  {
+    for (i = 1; i <= opt->k; i++)
+      if (!node[i].fsm.run() && vclock_ms() >= (uint32_t) (3 * i))
+      {
+        Cur = &node[i];
+        node[i].fsm.start();
+      }
+
+    for (i = 0; i <= opt->k; i++)
+    {
+      asim_node_t *n = Cur = &node[i];
+      n->fsm.yield(TIME_FUNC());
+      if (!emu_dio1(&n->emu)) continue;
+      if (i) asim_master_irq(n);
+      else   asim_listener_irq(n, opt);
+    }
+
+    // main loop: UART drain (capture_yield()) and packing of log
+    if (len)
+    {
+      credit += rate * ASIM_STEP_US;
+      if (opt->baud == 0 || credit >= len)
+      {
+        asim_host(frame, len, opt->bw * 1e-3);
+        credit -= len;
+        len = 0;
+      }
+    }
+    else if (credit < ASIM_UART_FIFO)
+      credit += rate * ASIM_STEP_US;
+    if (!len && arlog_count(&Log))
+      len = arlog_pack(&Log, frame);
+
+    vclock_step(ASIM_STEP_US);
+  }
+  if (len) asim_host(frame, len, opt->bw * 1e-3); // flush
+
+  for (i = 0; i <= opt->k; i++)
+    if (node[i].errors) printf("# FSM errors: node=%i n=%u\n", i,
+                               (unsigned) node[i].errors);
+
+  printf("# master  addr        dist[m]  requests  captured  bias[m]  rms[m]\n");
+  for (i = 0; i < opt->k; i++)
+  {
+    const asim_stat_t *s = &Stat[i];
+    printf("%-7i 0x%08X %8.1f %9u %9u %8.2f %7.2f\n", i + 1,
+           (unsigned) s->addr, s->d, (unsigned) node[i + 1].emu.tx_cnt,
+           (unsigned) s->n, s->n ? s->sum / s->n : 0.,
+           s->n ? sqrt(s->sum2 / s->n) : 0.);
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void asim_usage()
+{
+  printf(
+    "Usage: ar_sim [options]\n"
+    "  -t SEC           simulation time [s] (default 10)\n"
+    "  -k N             number of masters 1...16 (default 4)\n"
+    "  -p MS            master exchange period [ms] (default 20)\n"
+    "  -s SF            LoRa SF 5...10 (default 6)\n"
+    "  -b KHZ           LoRa BW 406, 812, 1625 kHz (default 1625)\n"
+    "  -a M             distance of first master [m] (default 50)\n"
+    "  -u BAUD          UART baud rate, 0 - unlimited (default 115200)\n"
+    "  --legacy 0|1     read exchange by old functions (default 0)\n"
+    "  --seed N         random seed (default 1)\n");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  asim_opt_t opt = { 10, 4, 20, 6, 1625, 50., 115200, 0, 1 };
+  uint32_t sent = 0, pending;
+  int i, bad;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { asim_usage(); return 0; }
+    if (v == NULL) { asim_usage(); return 1; }
+    i++;
+
+    if      (!strcmp(a, "-t")) opt.time   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-k")) opt.k      = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-p")) opt.period = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-s")) opt.sf     = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-b")) opt.bw     = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-a")) opt.dist   = strtod(v, NULL);
+    else if (!strcmp(a, "-u")) opt.baud   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "--legacy")) opt.legacy = (uint8_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "--seed"))   opt.seed   = (uint32_t) strtoul(v, NULL, 10);
+    else { asim_usage(); return 1; }
+  }
+
+  if (opt.time == 0 || opt.period == 0 || opt.k < 1 || opt.k > ASIM_MASTERS ||
+      opt.dist <= 0.)
+  { asim_usage(); return 1; }
+
+  printf("# Advanced Ranging capture SF%u BW%ukHz masters=%u period=%ums "
+         "time=%us baud=%u legacy=%u seed=%u\n", opt.sf, opt.bw, opt.k,
+         opt.period, opt.time, opt.baud, opt.legacy, opt.seed);
+  if (asim_run(&opt) != 0) return 1;
+
+  for (i = 0; i < opt.k; i++) sent += Stat[i].n;
+  pending = arlog_count(&Log);
+  printf("# events=%lu captured=%lu drops=%lu pending=%lu peak=%u "
+         "frames=%lu broken=%lu\n", (unsigned long) Log.events,
+         (unsigned long) Captured, (unsigned long) Log.drops,
+         (unsigned long) pending, (unsigned) Log.peak,
+         (unsigned long) Log.frames, (unsigned long) Broken);
+  printf("# foreign=%lu order=%lu latency: mean=%.2fms max=%.2fms\n",
+         (unsigned long) Foreign, (unsigned long) Order,
+         Captured ? LatSum / Captured : 0., LatMax);
+  printf("# SPI per event: read=%.1f total=%.1f\n",
+         Reads ? (double) SpiRead / Reads : 0.,
+         Reads ? (double) Spi / Reads : 0.);
+
+  bad = Captured + pending != Log.events || Captured != sent || Foreign ||
+        Broken || Order || DropsRx > Log.drops;
+  if (bad) printf("# FAIL: inconsistent capture\n");
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "ar_sim.cpp" file ***/
@@ -0,0 +1,224 @@
+/*
+ * Binary capture stream test, mixed with console output (host build)
+ * File: "cap_test.cpp"
+ *
+ * Received packets go by "rx_ring.c" to "capture.cpp" subscriber while
+ * "print.cpp" deferred log prints from main loop (drop mode), from CLI
+ * (wait mode, dumps bigger than log ring => blocking print calls) and by
+ * print_flush(); fake UART has small FIFO (frames are sent by parts).
+ * Output is parsed like
+ * scripts/cap2pcapng.py (sync, length, CRC8): every packet must come as
+ * one valid frame with the same record, in order, and text between frames
+ * must be exactly the printed text with drop marks (no text inside frame,
+ * no broken frame). Exit code 1 if any check fails.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), snprintf()
+#include <stdlib.h> // rand(), srand(), atoi()
+#include <string.h> // memset(), strlen()
+#include <string>
+#include <vector>
+#include "config.h"
+#include "print.h"
+#include "capture.h"
+#include "rx_ring.h"
+#include "crc8.h"
+#include "Arduino.h"
+//-----------------------------------------------------------------------------
+#define CT_FIFO  64    // UART TX FIFO [bytes] (less than frame)
+#define CT_LOOPS 20000 // main loop iterations (100 us)
+//-----------------------------------------------------------------------------
+// fake UART: FIFO drained 1 byte/us by virtual time
+static struct {
+  std::string out;   // all written bytes
+  int         room;  // free FIFO space [bytes]
+  uint32_t    us;    // virtual time [us]
+} Sink;
+
+HardwareSerial Serial;
+//-----------------------------------------------------------------------------
+static void ct_advance(uint32_t us)
+{
+  Sink.us   += us;
+  Sink.room += (int) us;
+  if (Sink.room > CT_FIFO) Sink.room = CT_FIFO;
+}
+//-----------------------------------------------------------------------------
+int HardwareSerial::availableForWrite()
+{
+  ct_advance(rand() % 16); // polling takes time
+  return Sink.room;
+}
+//-----------------------------------------------------------------------------
+size_t HardwareSerial::write(const uint8_t *buf, size_t size)
+{
+  if ((int) size > Sink.room) size = (size_t) Sink.room;
+  Sink.out.append((const char*) buf, size);
+  Sink.room -= (int) size;
+  return size;
+}
+//-----------------------------------------------------------------------------
+size_t HardwareSerial::print(const char *str) { return write((const uint8_t*) str, strlen(str)); }
+size_t HardwareSerial::print(char c) { return write((const uint8_t*) &c, 1); }
+void HardwareSerial::flush() {}
+//-----------------------------------------------------------------------------
+unsigned long millis() { return Sink.us / 1000; }
+unsigned long micros() { return Sink.us; }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+static rx_ring_t                 Ring;
+static std::vector<std::string>  Rec;  // expected records
+static std::string               Text; // expected console text
+static uint32_t                  Lost; // dropped lines (drop mode)
+//-----------------------------------------------------------------------------
+static void ct_print(const char *s)
+{
+  if (print_str(s)) Text += s;
+  else              Lost++;
+}
+//-----------------------------------------------------------------------------
+// receive random packet (like sx128x_irq())
+static void ct_recv(uint32_t n)
+{
+  rx_pkt_t *pkt = rx_ring_alloc(&Ring);
+  uint8_t frame[CAPTURE_FRAME_MAX];
+  uint16_t len;
+  int i;
+
+  memset((void*) &pkt->rx, 0, sizeof(pkt->rx));
+  pkt->t           = Sink.us;
+  pkt->mode        = (uint8_t) (n % 5);
+  pkt->size        = (uint8_t) (rand() % 256);
+  pkt->rx.crc_ok   = (uint8_t) (rand() & 1);
+  pkt->rx.rssi     = (uint8_t) rand();
+  pkt->rx.lora     = pkt->mode == 1 || pkt->mode == 2;
+  if (pkt->rx.lora)
+  {
+    pkt->rx.snr = (int8_t) rand();
+    pkt->rx.fei = rand() - RAND_MAX / 2;
+  }
+  for (i = 0; i < pkt->size; i++)
+    pkt->data[i] = (uint8_t) (i & 1 ? 0xA5 : 0x5A); // sync inside payload
+  pkt->data[0] = (uint8_t) n;
+
+  len = capture_pack(pkt, frame);
+  Rec.push_back(std::string((const char*) frame + 4, len - 5));
+  rx_ring_push(&Ring);
+}
+//-----------------------------------------------------------------------------
+int main()
+{
+  uint32_t frames = 0, crc_err = 0, order = 0, dropped = 0, n;
+  unsigned bad = 0;
+  std::string text;
+  size_t pos = 0;
+
+  srand(1);
+  rx_ring_init(&Ring);
+  rx_ring_subscribe(&Ring, capture_cb, NULL, "capture");
+  capture_enable(1);
+  print_log_wait(0);
+
+  for (n = 0; n < CT_LOOPS; n++)
+  {
+    char line[80];
+
+    if (rand() % 5 == 0) ct_recv(n);
+
+    // console log of main loop (drop mode, but sink is fast enough)
+    if (rand() % 4 == 0)
+    {
+      snprintf(line, sizeof(line), "loop %u\r\n", (unsigned) n);
+      ct_print(line);
+    }
+
+    if (n % 1000 == 500)
+    { // CLI command: blocking dump bigger than log ring
+      int i;
+      print_log_wait(1);
+      for (i = 0; i < 200; i++)
+      {
+        snprintf(line, sizeof(line), "dump %u line %03i 0123456789abcdef"
+                 "0123456789abcdef\r\n", (unsigned) n, i);
+        ct_print(line);
+        if (i % 50 == 0) ct_recv(n); // RX during dump
+        rx_ring_yield(&Ring);
+      }
+      print_log_wait(0);
+    }
+
+    if (n % 3000 == 1500)
+    { // setup()-like output with flush
+      ct_print("flush\r\n");
+      print_flush();
+    }
+
+    // main loop (like loop() in sketch)
+    ct_advance(100);
+    rx_ring_yield(&Ring);
+    capture_yield();
+    print_yield();
+  }
+  while (rx_ring_pending(&Ring, 0))
+  {
+    rx_ring_yield(&Ring);
+    capture_flush();
+  }
+  print_log_wait(1);
+  print_flush();
+
+  // parse stream like cap2pcapng.py: frames and text between frames
+  while (pos < Sink.out.size())
+  {
+    const uint8_t *p = (const uint8_t*) Sink.out.data() + pos;
+    size_t rest = Sink.out.size() - pos;
+    if (rest >= 5 && p[0] == CAPTURE_SYNC0 && p[1] == CAPTURE_SYNC1)
+    {
+      uint16_t len = p[2] | ((uint16_t) p[3] << 8);
+      if (len >= CAPTURE_HEAD && len <= CAPTURE_HEAD + 255 &&
+          rest >= (size_t) len + 5)
+      {
+        if (crc8(p + 2, len + 2) == p[len + 4])
+        {
+          std::string r((const char*) p + 4, len);
+          if (frames >= Rec.size() || r != Rec[frames]) order++;
+          frames++;
+          pos += len + 5;
+          continue;
+        }
+        crc_err++;
+      }
+    }
+    text += (char) *p; // console text (or garbage of broken frame)
+    pos++;
+  }
+
+  // cut drop marks of deferred log
+  while ((pos = text.find("\r\n<log: ")) != std::string::npos)
+  {
+    size_t end = text.find(">\r\n", pos);
+    if (end == std::string::npos) break;
+    dropped += (uint32_t) atoi(text.c_str() + pos + 8);
+    text.erase(pos, end + 3 - pos);
+  }
+
+  if (frames != Rec.size() || capture_frames() != Rec.size() || Ring.drops)
+    bad++;
+  if (crc_err || order) bad++;
+  if (text != Text || dropped != Lost) bad++;
+
+  printf("# FIFO=%u loops=%u\n", (unsigned) CT_FIFO, (unsigned) CT_LOOPS);
+  printf("# packets frames drops crc_err order   text/printed lost   stream   bad\n");
+  printf("%9u %6u %5u %7u %5u %7u/%-7u %4u %8u %5u\n",
+         (unsigned) Rec.size(), (unsigned) frames, (unsigned) Ring.drops,
+         (unsigned) crc_err, (unsigned) order, (unsigned) text.size(),
+         (unsigned) Text.size(), (unsigned) dropped, (unsigned) Sink.out.size(),
+         bad);
+  if (bad) printf("# FAIL: %u checks\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "cap_test.cpp" file ***/
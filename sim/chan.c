@@ -0,0 +1,388 @@
+/*
+ * RF channel model for host simulator: path loss, SNR, collisions, capture
+ * File: "chan.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset(), memcpy()
+#include <math.h>   // log10(), pow(), sqrt()
+#include "chan.h"
+#include "sx128x_def.h"
+#include "vclock.h"
+//-----------------------------------------------------------------------------
+// default channel parameters
+const chan_pars_t chan_pars_default = {
+  40.0, // pl0: path loss at 1 m [dB]
+  2.7,  // n: path loss exponent (indoor/urban)
+  4.0,  // sigma: shadowing [dB]
+  6.0,  // nf: noise figure [dB]
+  6.0,  // capture: capture threshold [dB]
+  1,    // seed
+  0.0   // fsel: frequency selective multipath off
+};
+//-----------------------------------------------------------------------------
+// 32-bit integer hash (lowbias32)
+static uint32_t chan_hash(uint32_t x)
+{
+  x ^= x >> 16; x *= 0x7FEB352Du;
+  x ^= x >> 15; x *= 0x846CA68Bu;
+  x ^= x >> 16;
+  return x;
+}
+//-----------------------------------------------------------------------------
+// standard normal value of link a<->b (Box-Muller by hash)
+static double chan_link_normal(uint32_t seed, int a, int b)
+{
+  uint32_t h;
+  double u1, u2;
+  if (a > b) { int t = a; a = b; b = t; }
+  h  = chan_hash(seed ^ chan_hash((uint32_t) a * 65537u + (uint32_t) b));
+  u1 = ((double) h + 1.0) / 4294967297.0;
+  u2 = (double) chan_hash(h) / 4294967296.0;
+  return sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+//-----------------------------------------------------------------------------
+static uint8_t chan_is_lora(uint8_t type)
+{
+  return type == SX128X_PACKET_TYPE_LORA || type == SX128X_PACKET_TYPE_RANGING;
+}
+//-----------------------------------------------------------------------------
+// init channel
+void chan_init(chan_t *self, const chan_pars_t *pars)
+{
+  memset((void*) self, 0, sizeof(chan_t));
+  self->pars = pars ? *pars : chan_pars_default;
+}
+//-----------------------------------------------------------------------------
+// add node (return index or -1)
+int chan_add(chan_t *self, sx1280_emu_t *emu)
+{
+  if (self->nodes >= CHAN_NODES) return -1;
+  self->node[self->nodes] = emu;
+  return self->nodes++;
+}
+//-----------------------------------------------------------------------------
+// add external interferer (return index or -1)
+int chan_jam(chan_t *self, uint32_t freq, uint32_t bw, double power,
+             double duty)
+{
+  chan_jam_t *jam;
+  if (self->jams >= CHAN_JAMMERS) return -1;
+  jam = &self->jam[self->jams];
+  jam->freq  = freq;
+  jam->bw    = bw;
+  jam->power = power;
+  jam->duty  = duty;
+  return self->jams++;
+}
+//-----------------------------------------------------------------------------
+// path loss between nodes [dB] (with shadowing, symmetric)
+double chan_path_loss(const chan_t *self, int a, int b)
+{
+  const sx1280_emu_t *na = self->node[a], *nb = self->node[b];
+  double dx = na->x - nb->x, dy = na->y - nb->y;
+  double d  = sqrt(dx * dx + dy * dy);
+  if (d < 1.0) d = 1.0;
+  return self->pars.pl0 + 10.0 * self->pars.n * log10(d) +
+         self->pars.sigma * chan_link_normal(self->pars.seed, a, b);
+}
+//-----------------------------------------------------------------------------
+// thermal noise power in bandwidth [dBm]
+double chan_noise(const chan_t *self, uint32_t bw)
+{
+  return -174.0 + 10.0 * log10((double) bw) + self->pars.nf;
+}
+//-----------------------------------------------------------------------------
+// required SNR of modem [dB] (sensitivity = noise + required SNR)
+double chan_snr_min(uint8_t type, uint8_t sf)
+{
+  if (chan_is_lora(type))
+    return -2.5 * (sf - 4); // SF5: -2.5 dB ... SF12: -20 dB
+  if (type == SX128X_PACKET_TYPE_FLRC)
+    return 4.0;
+  return 9.0; // GFSK/BLE
+}
+//-----------------------------------------------------------------------------
+// transmission overlaps receiver channel
+static uint8_t chan_overlap(const chan_tx_t *tx, const sx1280_emu_t *r)
+{
+  uint32_t df = tx->freq > r->freq ? tx->freq - r->freq : r->freq - tx->freq;
+  uint32_t bw = emu_bw(r);
+  return df < (tx->bw + bw) / 2;
+}
+//-----------------------------------------------------------------------------
+// receiver can demodulate transmission (same channel and modem)
+static uint8_t chan_match(const chan_tx_t *tx, const sx1280_emu_t *r)
+{
+  uint32_t df = tx->freq > r->freq ? tx->freq - r->freq : r->freq - tx->freq;
+  return chan_is_lora(tx->type) == chan_is_lora(r->pkt_type) &&
+         (chan_is_lora(tx->type) || tx->type == r->pkt_type) &&
+         tx->sf == emu_sf(r) && tx->bw == emu_bw(r) &&
+         df < tx->bw / 4;
+}
+//-----------------------------------------------------------------------------
+// received power of transmission at node `r` [dBm]
+static double chan_rx_power(const chan_t *self, const chan_tx_t *tx, int r)
+{
+  return tx->power - chan_path_loss(self, tx->node, r);
+}
+//-----------------------------------------------------------------------------
+// interference power at node `r` during transmission `tx` [mW]
+static double chan_interference(const chan_t *self, const chan_tx_t *tx, int r)
+{
+  const sx1280_emu_t *emu = self->node[r];
+  double sum = 0.;
+  int i;
+
+  for (i = 0; i < CHAN_TX_RING; i++)
+  {
+    const chan_tx_t *it = &self->tx[i];
+    double p;
+    if (it->id == 0 || it == tx || it->node == r) continue;
+    if (it->t0 >= tx->t1 || it->t1 <= tx->t0) continue;
+    if (!chan_overlap(it, emu)) continue;
+
+    p = chan_rx_power(self, it, r);
+    if (chan_is_lora(it->type) && chan_is_lora(tx->type) && it->sf != tx->sf)
+      p -= CHAN_SF_REJECT; // quasi-orthogonal SF
+    sum += pow(10.0, p / 10.0);
+  }
+
+  return sum;
+}
+//-----------------------------------------------------------------------------
+// power of external interferers at receiver during [t0, t1) [mW]
+static double chan_jam_power(const chan_t *self, const sx1280_emu_t *r,
+                             uint64_t t0, uint64_t t1)
+{
+  double sum = 0.;
+  int j;
+
+  for (j = 0; j < self->jams; j++)
+  {
+    const chan_jam_t *jam = &self->jam[j];
+    uint32_t df = jam->freq > r->freq ? jam->freq - r->freq : r->freq - jam->freq;
+    uint64_t s;
+
+    if (df >= (jam->bw + emu_bw(r)) / 2) continue; // out of band
+
+    for (s = t0 / CHAN_JAM_SLOT; s * CHAN_JAM_SLOT < t1; s++)
+    { // any burst during interval
+      uint32_t h = chan_hash(self->pars.seed ^
+                             chan_hash((uint32_t) j * 7919u ^ (uint32_t) s));
+      if ((double) h < jam->duty * 4294967296.0)
+      {
+        sum += pow(10.0, jam->power / 10.0);
+        break;
+      }
+    }
+  }
+
+  return sum;
+}
+//-----------------------------------------------------------------------------
+// end of transmission (vclock alarm)
+static void chan_tx_end_cb(void *context)
+{
+  chan_tx_t *tx = (chan_tx_t*) context;
+  chan_t *self  = (chan_t*) tx->chan;
+  int slot = (int) (tx - self->tx);
+  int r;
+
+  emu_tx_done(self->node[tx->node]);
+
+  for (r = 0; r < self->nodes; r++)
+  {
+    sx1280_emu_t *emu = self->node[r];
+    double s, n, i, sinr;
+    uint8_t ok;
+
+    if (emu->lock != slot) continue;
+
+    s = chan_rx_power(self, tx, r);
+    n = chan_noise(self, tx->bw);
+    i = chan_interference(self, tx, r) +
+        chan_jam_power(self, emu, tx->t0, tx->t1);
+    sinr = s - 10.0 * log10(pow(10.0, n / 10.0) + i);
+
+    ok = sinr >= chan_snr_min(tx->type, tx->sf) &&
+         (i == 0. || s - 10.0 * log10(i) >= self->pars.capture);
+
+    if (ok) self->stat.ok++;
+    else    self->stat.collision++;
+
+    emu->rx_from = tx->node;
+    emu_rx_done(emu, tx->data, tx->size, ok, s, sinr);
+  }
+}
+//-----------------------------------------------------------------------------
+// start transmission by node (call from emulator by SetTx)
+void chan_tx_start(chan_t *self, sx1280_emu_t *emu)
+{
+  int slot = (int) (self->head++ % CHAN_TX_RING);
+  chan_tx_t *tx = &self->tx[slot];
+  uint32_t toa;
+  int r;
+
+  tx->chan  = self;
+  tx->id    = ++self->serial;
+  tx->node  = emu->id;
+  tx->freq  = emu->freq;
+  tx->bw    = emu_bw(emu);
+  tx->type  = emu->pkt_type;
+  tx->sf    = emu_sf(emu);
+  tx->power = emu->power;
+  tx->size  = emu_tx_size(emu);
+  memcpy((void*) tx->data, (const void*) &emu->buf[emu->tx_base], tx->size);
+
+  toa    = emu_toa(emu, tx->size);
+  tx->t0 = vclock_now();
+  tx->t1 = tx->t0 + toa;
+  tx->tp = tx->t0 + emu_preamble(emu);
+
+  self->stat.tx++;
+  emu->tx_cnt++;
+  emu->tx_us += toa;
+
+  // receivers lock to preamble at start of packet
+  for (r = 0; r < self->nodes; r++)
+  {
+    sx1280_emu_t *rx = self->node[r];
+    double snr;
+
+    if (r == emu->id || rx->mode != EMU_MODE_RX || rx->cad ||
+        !chan_match(tx, rx))
+      continue; // not a listener
+
+    snr = chan_rx_power(self, tx, r) - chan_noise(self, tx->bw);
+    if (snr < chan_snr_min(tx->type, tx->sf))
+    {
+      self->stat.weak++;
+      continue;
+    }
+
+    if (rx->lock >= 0)
+    { // busy by other packet
+      self->stat.missed++;
+      continue;
+    }
+
+    rx->lock = slot;
+    self->stat.locked++;
+  }
+
+  vclock_alarm(toa, chan_tx_end_cb, tx);
+}
+//-----------------------------------------------------------------------------
+// receiver started (call from emulator by SetRx): lock to packet on air
+void chan_rx_start(chan_t *self, sx1280_emu_t *emu)
+{
+  uint64_t now = vclock_now();
+  double best = 0.;
+  int i, slot = -1;
+
+  for (i = 0; i < CHAN_TX_RING; i++)
+  {
+    const chan_tx_t *tx = &self->tx[i];
+    double snr;
+
+    if (tx->id == 0 || tx->node == emu->id || now < tx->t0 || now >= tx->tp ||
+        !chan_match(tx, emu))
+      continue; // preamble is not on air
+
+    snr = chan_rx_power(self, tx, emu->id) - chan_noise(self, tx->bw);
+    if (snr < chan_snr_min(tx->type, tx->sf)) continue;
+
+    if (slot < 0 || snr > best)
+    { // strongest one
+      best = snr;
+      slot = i;
+    }
+  }
+
+  if (slot >= 0)
+  {
+    emu->lock = slot;
+    self->stat.locked++;
+  }
+}
+//-----------------------------------------------------------------------------
+// measured ranging distance between nodes [m]: true distance with Gaussian
+// error by SNR and bandwidth and rare multipath excess path
+double chan_range(chan_t *self, int a, int b, uint32_t freq, double snr,
+                  uint32_t bw)
+{
+  const sx1280_emu_t *p = self->node[a], *q = self->node[b];
+  double d = hypot(p->x - q->x, p->y - q->y);
+  double sigma = CHAN_RANGE_SIGMA * 1625000.0 / (bw ? bw : 1625000);
+  uint32_t h = chan_hash(self->pars.seed ^ chan_hash(++self->ranges));
+  double u1 = ((double) h + 1.0) / 4294967297.0;
+  double u2 = (double) (h = chan_hash(h)) / 4294967296.0;
+  double u3 = (double) (h = chan_hash(h)) / 4294967296.0;
+
+  if (snr < CHAN_RANGE_SNR)
+    sigma *= pow(10.0, (CHAN_RANGE_SNR - snr) / 20.0);
+
+  d += sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+
+  if (u3 < CHAN_RANGE_MP) // reflected path only (late)
+    d += CHAN_RANGE_MP_MAX * (double) chan_hash(h) / 4294967296.0;
+
+  if (self->pars.fsel > 0.)
+  { // direct path is faded at this frequency (same for link in both ways)
+    h = chan_hash(self->pars.seed ^ chan_hash(freq / CHAN_RANGE_FS_BIN) ^
+                  chan_hash((uint32_t) (a < b ? a : b) * 65537u +
+                            (uint32_t) (a < b ? b : a)));
+    if ((double) h / 4294967296.0 < self->pars.fsel)
+      d += CHAN_RANGE_FS_MAX * (double) chan_hash(h) / 4294967296.0;
+  }
+
+  return d;
+}
+//-----------------------------------------------------------------------------
+// LoRa channel activity at receiver in [t0, t1) [us]: same SF/BW
+// transmission on air over sensitivity (CAD result)
+uint8_t chan_cad(const chan_t *self, const sx1280_emu_t *emu, uint64_t t0,
+                 uint64_t t1)
+{
+  int i;
+
+  if (!chan_is_lora(emu->pkt_type)) return 0;
+
+  for (i = 0; i < CHAN_TX_RING; i++)
+  {
+    const chan_tx_t *tx = &self->tx[i];
+    if (tx->id == 0 || tx->node == emu->id || tx->t0 >= t1 || tx->t1 <= t0 ||
+        !chan_match(tx, emu))
+      continue;
+    if (chan_rx_power(self, tx, emu->id) - chan_noise(self, tx->bw) >=
+        chan_snr_min(tx->type, tx->sf))
+      return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// instantaneous RSSI at receiver (noise + transmissions on air) [-dBm*2]
+uint8_t chan_rssi_inst(const chan_t *self, const sx1280_emu_t *emu)
+{
+  uint64_t now = vclock_now();
+  double sum = pow(10.0, chan_noise(self, emu_bw(emu)) / 10.0) + // [mW]
+               chan_jam_power(self, emu, now, now + 1);
+  double p;
+  int i;
+
+  for (i = 0; i < CHAN_TX_RING; i++)
+  {
+    const chan_tx_t *tx = &self->tx[i];
+    if (tx->id == 0 || tx->node == emu->id || now < tx->t0 || now >= tx->t1 ||
+        !chan_overlap(tx, emu))
+      continue;
+    sum += pow(10.0, chan_rx_power(self, tx, emu->id) / 10.0);
+  }
+
+  p = -2.0 * 10.0 * log10(sum);
+  return (uint8_t) (p < 0. ? 0. : p > 255. ? 255. : p + 0.5);
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "chan.c" file ***/
@@ -0,0 +1,148 @@
+/*
+ * RF channel model for host simulator: path loss, SNR, collisions, capture
+ * File: "chan.h"
+ */
+
+#pragma once
+#ifndef CHAN_H
+#define CHAN_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+#include "sx1280_emu.h"
+//-----------------------------------------------------------------------------
+#ifndef CHAN_NODES
+#  define CHAN_NODES 256 // maximal number of nodes
+#endif
+
+#ifndef CHAN_TX_RING
+#  define CHAN_TX_RING 512 // transmissions history (for overlap check)
+#endif
+
+#ifndef CHAN_JAMMERS
+#  define CHAN_JAMMERS 8 // maximal number of external interferers
+#endif
+
+#define CHAN_SF_REJECT 16.0 // LoRa inter-SF rejection [dB]
+#define CHAN_JAM_SLOT   500 // interferer burst slot [us]
+
+#define CHAN_RANGE_SIGMA  1.0 // ranging error RMS at 1.6 MHz and high SNR [m]
+#define CHAN_RANGE_SNR   10.0 // ranging error grows below this SNR [dB]
+#define CHAN_RANGE_MP    0.05 // probability of multipath (late) result
+#define CHAN_RANGE_MP_MAX 30.0 // maximal multipath excess path [m]
+#define CHAN_RANGE_FS_BIN 1000000 // frequency selective multipath bin [Hz]
+#define CHAN_RANGE_FS_MAX 10.0 // maximal frequency selective excess path [m]
+//-----------------------------------------------------------------------------
+// channel parameters
+typedef struct chan_pars_ {
+  double   pl0;     // path loss at 1 m [dB] (40 dB at 2.44 GHz)
+  double   n;       // path loss exponent (2 - free space)
+  double   sigma;   // log-normal shadowing per link [dB]
+  double   nf;      // receiver noise figure [dB]
+  double   capture; // capture threshold (signal/interference) [dB]
+  uint32_t seed;    // random seed of shadowing
+  double   fsel;    // probability of frequency selective multipath excess
+                    // per link and frequency bin (persistent, 0 - off)
+} chan_pars_t;
+//-----------------------------------------------------------------------------
+// one transmission
+typedef struct chan_tx_ {
+  struct chan_ *chan; // owner channel
+  uint32_t id;        // serial number (0 - free)
+  int      node;      // transmitter index
+  uint64_t t0, t1;    // start/end time [us]
+  uint64_t tp;        // end of preamble (last time to lock) [us]
+  uint32_t freq;      // RF frequency [Hz]
+  uint32_t bw;        // bandwidth [Hz]
+  uint8_t  type;      // packet type
+  uint8_t  sf;        // LoRa SF (0 - GFSK/FLRC)
+  int8_t   power;     // TX power [dBm]
+  uint8_t  size;      // payload size
+  uint8_t  data[256]; // payload
+} chan_tx_t;
+//-----------------------------------------------------------------------------
+// external interferer (like Wi-Fi AP): random bursts with duty cycle
+typedef struct chan_jam_ {
+  uint32_t freq;  // center frequency [Hz]
+  uint32_t bw;    // bandwidth [Hz]
+  double   power; // power at all receivers [dBm]
+  double   duty;  // probability of burst in slot (0...1)
+} chan_jam_t;
+//-----------------------------------------------------------------------------
+// channel statistic
+typedef struct chan_stat_ {
+  uint32_t tx;        // transmissions
+  uint32_t locked;    // receptions started (preamble detected)
+  uint32_t ok;        // received without errors
+  uint32_t collision; // lost by interference
+  uint32_t weak;      // lost by noise (under sensitivity)
+  uint32_t missed;    // receiver busy (TX, sleep or other packet)
+} chan_stat_t;
+//-----------------------------------------------------------------------------
+// channel (medium)
+typedef struct chan_ {
+  chan_pars_t   pars;
+  sx1280_emu_t *node[CHAN_NODES];
+  int           nodes;
+  uint32_t      serial;           // last transmission serial number
+  chan_tx_t     tx[CHAN_TX_RING]; // transmissions ring
+  uint32_t      head;             // next slot in ring
+  chan_stat_t   stat;
+  chan_jam_t    jam[CHAN_JAMMERS]; // external interferers
+  int           jams;
+  uint32_t      ranges;            // ranging exchanges (noise sequence)
+} chan_t;
+//-----------------------------------------------------------------------------
+// default channel parameters
+extern const chan_pars_t chan_pars_default;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init channel
+void chan_init(chan_t *self, const chan_pars_t *pars);
+//-----------------------------------------------------------------------------
+// add node (return index or -1)
+int chan_add(chan_t *self, sx1280_emu_t *emu);
+//-----------------------------------------------------------------------------
+// add external interferer (return index or -1)
+int chan_jam(chan_t *self, uint32_t freq, uint32_t bw, double power,
+             double duty);
+//-----------------------------------------------------------------------------
+// path loss between nodes [dB] (with shadowing, symmetric)
+double chan_path_loss(const chan_t *self, int a, int b);
+//-----------------------------------------------------------------------------
+// thermal noise power in bandwidth [dBm]
+double chan_noise(const chan_t *self, uint32_t bw);
+//-----------------------------------------------------------------------------
+// required SNR of modem [dB] (sensitivity = noise + required SNR)
+double chan_snr_min(uint8_t type, uint8_t sf);
+//-----------------------------------------------------------------------------
+// start transmission by node (call from emulator by SetTx)
+void chan_tx_start(chan_t *self, sx1280_emu_t *emu);
+//-----------------------------------------------------------------------------
+// receiver started (call from emulator by SetRx): lock to packet on air
+void chan_rx_start(chan_t *self, sx1280_emu_t *emu);
+//-----------------------------------------------------------------------------
+// measured ranging distance between nodes [m]: true distance with Gaussian
+// error by SNR and bandwidth, rare multipath excess path and persistent
+// frequency selective excess path of link at `freq` [Hz]
+double chan_range(chan_t *self, int a, int b, uint32_t freq, double snr,
+                  uint32_t bw);
+//-----------------------------------------------------------------------------
+// LoRa channel activity at receiver in [t0, t1) [us]: same SF/BW
+// transmission on air over sensitivity (CAD result)
+uint8_t chan_cad(const chan_t *self, const sx1280_emu_t *emu, uint64_t t0,
+                 uint64_t t1);
+//-----------------------------------------------------------------------------
+// instantaneous RSSI at receiver (noise + transmissions on air) [-dBm*2]
+uint8_t chan_rssi_inst(const chan_t *self, const sx1280_emu_t *emu);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // CHAN_H
+
+/*** end of "chan.h" file ***/
@@ -0,0 +1,94 @@
+/*
+ * Ranging distance conversion test (host build)
+ * File: "dist_test.cpp"
+ *
+ * sx128x_ranging_distance() against datasheet formula
+ * d[m] = raw * 150 / (2^12 * BW[MHz]) in long double for every 24-bit raw
+ * result and all LoRa BWs: result must be the nearest centimetre (ties
+ * within rounding error of reference are not counted). Old 32-bit formula
+ * of sx128x_ranging_result() (dm) is shown for comparison: maximal error
+ * out of its clamp region and number of results with error over 1 m.
+ * Exit code 1 if any result is wrong.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf()
+#include <math.h>   // fabsl(), llroundl()
+#include <time.h>   // clock()
+#include <limits.h> // INT_MAX, INT_MIN
+#include "sx128x.h"
+//-----------------------------------------------------------------------------
+#define DTEST_TIE 1e-6L // reference fraction this close to 0.5 is tie [cm]
+//-----------------------------------------------------------------------------
+// old conversion of sx128x_ranging_result() [dm]
+static int32_t dtest_old(uint32_t result, uint32_t bw)
+{
+  int32_t result_signed = (int32_t) result;
+  if (bw < 400) bw = 406;
+  if (result_signed & 0x00800000) result_signed |= 0xFF000000;
+  if      (result_signed > INT_MAX / 375) result_signed = INT_MAX / 375 - 1;
+  else if (result_signed < INT_MIN / 375) result_signed = INT_MAX / 375 + 1;
+  return (((result_signed * 375) / 208) * (1625 / (int) bw)) / 8;
+}
+//-----------------------------------------------------------------------------
+int main()
+{
+  static const uint16_t bws[] = { 203, 406, 812, 1625 };     // [kHz]
+  static const long double mhz[] = { 0.203125L, 0.40625L, 0.8125L, 1.625L };
+  unsigned i, bad = 0;
+
+  printf("# BW[kHz]  results    wrong   ties  max_err[cm]  old_err[cm]  "
+         "old>1m  ns/call\n");
+  for (i = 0; i < sizeof(bws) / sizeof(bws[0]); i++)
+  {
+    uint32_t raw, wrong = 0, ties = 0, old_bad = 0;
+    long double max_err = 0.L, old_err = 0.L;
+    volatile int32_t sink = 0;
+    clock_t t0;
+    double ns;
+
+    for (raw = 0; raw < 0x1000000; raw++)
+    {
+      int32_t r = (int32_t) raw - ((raw & 0x800000) ? 0x1000000 : 0);
+      long double ref = (long double) r * 150.L / (4096.L * mhz[i]) * 100.L;
+      long double frac = fabsl(ref - truncl(ref));
+      int32_t cm = sx128x_ranging_distance(raw, bws[i]);
+      long double e = fabsl((long double) cm - ref);
+
+      if (e > max_err) max_err = e;
+      if (fabsl(frac - 0.5L) < DTEST_TIE)
+      { // exact tie: both neighbours are correct
+        ties++;
+        if (e > 0.5L + DTEST_TIE) wrong++;
+      }
+      else if ((long long) cm != llroundl(ref))
+        wrong++;
+
+      if (bws[i] >= 400)
+      { // old formula (Ranging BW only): error without clamp region
+        e = fabsl((long double) dtest_old(raw, bws[i]) * 10.L - ref);
+        if (e > 100.L) old_bad++;
+        if (e > old_err && r <= INT_MAX / 375 && r >= INT_MIN / 375)
+          old_err = e;
+      }
+    }
+
+    t0 = clock();
+    for (raw = 0; raw < 0x1000000; raw++)
+      sink += sx128x_ranging_distance(raw, bws[i]);
+    ns = (double) (clock() - t0) / CLOCKS_PER_SEC * 1e9 / 0x1000000;
+
+    printf("%7u  %8u  %7u  %6u  %11.4Lf  ", (unsigned) bws[i], 0x1000000u,
+           (unsigned) wrong, (unsigned) ties, max_err);
+    if (bws[i] >= 400) printf("%11.1Lf  %6u", old_err, (unsigned) old_bad);
+    else               printf("%11s  %6s", "-", "-");
+    printf("  %7.2f\n", ns);
+    bad += wrong;
+  }
+
+  if (bad) printf("# FAIL: %u wrong results\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "dist_test.cpp" file ***/
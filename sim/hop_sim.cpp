@@ -0,0 +1,342 @@
+/*
+ * Two-node frequency hopping simulator (host build, virtual time)
+ * File: "hop_sim.cpp"
+ *
+ * Requester (AFsm RQ, hop leader) and responder (AFsm RP, hop follower)
+ * exchange packets under Wi-Fi like interferers; compare fixed channel,
+ * blind hopping and adaptive hopping with the same "hop.c" engine as sketch.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), fprintf()
+#include <stdlib.h> // strtol(), strtod()
+#include <string.h> // strcmp(), memset()
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "hop.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build simulator with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define HSIM_STEP_US 1000 // main loop step (FSM timers resolution) [us]
+#define HSIM_JAMS    CHAN_JAMMERS
+//-----------------------------------------------------------------------------
+typedef enum {
+  HSIM_FIXED = 0, // fixed channel (no hopping)
+  HSIM_HOP,       // blind hopping (adaptation off)
+  HSIM_AFH,       // adaptive hopping
+  HSIM_RUNS
+} hsim_run_t;
+
+static const char * const hsim_run_name[HSIM_RUNS] = { "fixed", "hop", "afh" };
+//-----------------------------------------------------------------------------
+// simulation options
+typedef struct hsim_opt_ {
+  uint32_t time;             // simulation time [s]
+  uint32_t period;           // exchange period [ms]
+  uint32_t freq;             // fixed channel frequency [kHz]
+  uint32_t jam[HSIM_JAMS];   // interferer center frequencies [kHz]
+  int      jams;             // number of interferers
+  double   duty;             // interferer duty cycle (0...1)
+  double   power;            // interferer power at receivers [dBm]
+  double   dist;             // distance between nodes [m]
+  uint32_t seed;             // random seed
+} hsim_opt_t;
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM + hopping)
+typedef struct hsim_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  ABlink        led;
+  hop_t         hop;
+  uint8_t       hop_rx;     // follower receiver is running
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  uint32_t      sent;       // requests (leader)
+  uint32_t      replies;    // good replies (leader)
+  uint32_t      errors;     // FSM action errors
+} hsim_node_t;
+//-----------------------------------------------------------------------------
+static chan_t       Chan; // RF channel (big, static)
+static hsim_node_t *Cur;  // node in FSM callback context
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+// tune radio to current hop channel (as hop_tune() in sketch)
+static int8_t hsim_tune(hsim_node_t *n, uint8_t rx)
+{
+  int8_t retv = SX128X_ERR_NONE;
+  if (rx) retv = sx128x_standby(&n->radio, SX128X_STANDBY_XOSC);
+  if (retv == SX128X_ERR_NONE)
+    retv = sx128x_set_frequency_code(&n->radio, n->hop.code[n->hop.ch]);
+  if (retv == SX128X_ERR_NONE && rx)
+    retv = sx128x_rx(&n->radio, SX128X_RX_TIMEOUT_CONTINUOUS,
+                     SX128X_TIME_BASE_1MS);
+  return retv;
+}
+//-----------------------------------------------------------------------------
+// FSM event callback (hopping part of fsm_callback() in sketch)
+static void hsim_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  hsim_node_t *n = Cur;
+  uint8_t mode = n->fsm.mode();
+
+  if (n->hop.on)
+  {
+    if (ev == AFSM_EV_PERIOD && mode == AFSM_RQ)
+    { // leader: next channel before send
+      hop_next(&n->hop, 1);
+      if (err == SX128X_ERR_NONE) err = hsim_tune(n, 0);
+    }
+    else if (mode == AFSM_RP)
+    { // follower
+      if (ev == AFSM_EV_WAKEUP)
+      {
+        n->hop_rx = 1;
+        if (err == SX128X_ERR_NONE) err = hsim_tune(n, 1);
+      }
+      else if (ev == AFSM_EV_TX_DONE && n->hop.follow)
+      {
+        hop_follow(&n->hop);
+        if (err == SX128X_ERR_NONE) err = hsim_tune(n, 1);
+      }
+    }
+  }
+
+  if (ev == AFSM_EV_PERIOD && mode == AFSM_RQ) n->sent++;
+  if (err != SX128X_ERR_NONE) n->errors++;
+}
+//-----------------------------------------------------------------------------
+// FSM TX stamper (hopping part of fsm_stamp() in sketch)
+static void hsim_stamp(uint8_t *frame, uint8_t size, unsigned long t)
+{
+  hsim_node_t *n = Cur;
+  if (n->hop.on && (n->fsm.mode() == AFSM_RQ || n->hop.reply))
+    hop_stamp(&n->hop, frame, size); // leader hop or follower reply
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (like sx128x_irq())
+static void hsim_irq(hsim_node_t *n)
+{
+  unsigned long t = TIME_FUNC();
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_TX_DONE)
+    n->fsm.tx_done();
+
+  if (irq & SX128X_IRQ_RX_DONE)
+  {
+    rx_pkt_t pkt;
+    memset((void*) &pkt, 0, sizeof(pkt));
+    pkt.t    = t;
+    pkt.mode = sx128x_get_mode(&n->radio);
+    n->hop.reply = 0; // no hop header in reply without sync
+
+    if (sx128x_get_recv(&n->radio, irq, sizeof(pkt.data), &pkt.rx,
+                        pkt.data, &pkt.size) == SX128X_ERR_NONE &&
+        pkt.rx.crc_ok)
+    {
+      if (n->fsm.mode() == AFSM_RP)
+      { // follower: sync (reply is stamped by stamper)
+        if (n->hop.on)
+          n->hop.reply = hop_sync(&n->hop, pkt.data, pkt.size, t,
+                                  n->fsm_pars.t);
+      }
+      else
+      { // leader: reply
+        n->replies++;
+        hop_rx_cb(&pkt, (void*) &n->hop);
+      }
+    }
+    n->fsm.rx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT)
+    n->fsm.rxtx_timeout();
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - responder, 1 - requester)
+static int hsim_node_init(hsim_node_t *n, int id, hsim_run_t run,
+                          const hsim_opt_t *opt)
+{
+  int8_t retv;
+
+  emu_init(&n->emu, &Chan, id, id ? opt->dist : 0., 0.);
+  chan_add(&Chan, &n->emu);
+
+  n->pars              = sx128x_pars_default;
+  n->pars.mode         = SX128X_LORA;
+  n->pars.freq         = opt->freq * 1000;
+  n->pars.fixed        = 1;
+  n->pars.payload_size = 16;
+  n->pars.sf           = 7;
+  n->pars.bw           = 812;
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = id ? AFSM_RQ : AFSM_RP;
+  n->fsm_pars.t    = opt->period;
+  n->fsm_pars.wut  = 1;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data_size  = 16;
+  n->tx_timeout = 0;
+  n->sent       = 0;
+  n->replies    = 0;
+  n->errors     = 0;
+  n->hop_rx     = 0;
+
+  hop_init(&n->hop);
+  n->hop.on    = run != HSIM_FIXED;
+  n->hop.adapt = run == HSIM_AFH;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, hsim_callback);
+  n->fsm.stamper(hsim_stamp);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// run one simulation, print result line
+static int hsim_run(hsim_run_t run, const hsim_opt_t *opt)
+{
+  static hsim_node_t node[2];
+  uint64_t end = (uint64_t) opt->time * 1000000ull;
+  hsim_node_t *rq = &node[1], *rp = &node[0];
+  int i;
+
+  vclock_reset(0);
+  chan_pars_t cp = chan_pars_default;
+  cp.seed = opt->seed;
+  chan_init(&Chan, &cp);
+  for (i = 0; i < opt->jams; i++) // Wi-Fi like: 20 MHz
+    chan_jam(&Chan, opt->jam[i] * 1000, 20000000, opt->power, opt->duty);
+
+  for (i = 0; i < 2; i++)
+  {
+    if (hsim_node_init(&node[i], i, run, opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail (node %i)\n", i);
+      return -1;
+    }
+  }
+
+  // responder starts first, requester after half period
+  Cur = rp;
+  rp->fsm.start();
+
+  while (vclock_now() < end)
+  {
+    if (rq->sent == 0 && vclock_ms() >= opt->period / 2 && !rq->fsm.run())
+    {
+      Cur = rq;
+      rq->fsm.start();
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+      hsim_node_t *n = Cur = &node[i];
+      unsigned long t = TIME_FUNC();
+      n->fsm.yield(t);
+      if (n->hop_rx && hop_yield(&n->hop, t, n->fsm_pars.t))
+        hsim_tune(n, 1);
+      if (emu_dio1(&n->emu)) hsim_irq(n);
+    }
+    vclock_step(HSIM_STEP_US);
+  }
+
+  printf("%-6s %7u %7u %6.2f %4u/%-3u %6u %6u %5u %5u %4u\n",
+         hsim_run_name[run], rq->sent, rq->replies,
+         rq->sent ? 100. * rq->replies / rq->sent : 0.,
+         (unsigned) rq->hop.ngood, (unsigned) rq->hop.n,
+         rq->hop.banned, rq->hop.restored, rp->hop.resync, rp->hop.lost,
+         rq->errors + rp->errors);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void hsim_usage()
+{
+  printf(
+    "Usage: hop_sim [options]\n"
+    "  -t SEC           simulation time [s] (default 120)\n"
+    "  -p MS            exchange period [ms] (default 50)\n"
+    "  -f KHZ           fixed channel frequency [kHz] (default 2437000)\n"
+    "  -j F1,F2,...     Wi-Fi interferers [kHz] (default 2412000,2437000,2462000)\n"
+    "  -d DUTY          interferer duty cycle 0...1 (default 0.5)\n"
+    "  -P DBM           interferer power at receivers [dBm] (default -60)\n"
+    "  -a M             distance between nodes [m] (default 30)\n"
+    "  --seed N         random seed (default 1)\n");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  hsim_opt_t opt = {
+    120, 50, 2437000,                   // time, period, freq
+    { 2412000, 2437000, 2462000 }, 3,   // jam[], jams
+    0.5, -60., 30., 1 };                // duty, power, dist, seed
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { hsim_usage(); return 0; }
+    if (v == NULL) { hsim_usage(); return 1; }
+    i++;
+
+    if (!strcmp(a, "-j"))
+    {
+      char *p = (char*) v;
+      for (opt.jams = 0; opt.jams < HSIM_JAMS && *p; )
+      {
+        long f = strtol(p, &p, 10);
+        if (f > 0) opt.jam[opt.jams++] = (uint32_t) f;
+        if (*p == ',') p++; else break;
+      }
+    }
+    else if (!strcmp(a, "-t")) opt.time   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-p")) opt.period = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-f")) opt.freq   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-d")) opt.duty   = strtod(v, NULL);
+    else if (!strcmp(a, "-P")) opt.power  = strtod(v, NULL);
+    else if (!strcmp(a, "-a")) opt.dist   = strtod(v, NULL);
+    else if (!strcmp(a, "--seed")) opt.seed = (uint32_t) strtoul(v, NULL, 10);
+    else { hsim_usage(); return 1; }
+  }
+
+  if (opt.time == 0 || opt.period == 0) { hsim_usage(); return 1; }
+
+  printf("# LoRa SF7 BW812kHz period=%ums time=%us fixed=%ukHz Wi-Fi=%i "
+         "duty=%.2f power=%.0fdBm dist=%.0fm seed=%u\n",
+         opt.period, opt.time, opt.freq, opt.jams, opt.duty, opt.power,
+         opt.dist, opt.seed);
+  printf("# run      sent replies  ok%%   used    banned restor resync  lost  err\n");
+
+  for (i = 0; i < HSIM_RUNS; i++)
+    if (hsim_run((hsim_run_t) i, &opt) != 0) return 1;
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "hop_sim.cpp" file ***/
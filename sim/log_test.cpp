@@ -0,0 +1,291 @@
+/*
+ * Deferred console log test with slow sink (host build)
+ * File: "log_test.cpp"
+ *
+ * "print.cpp" (PRINT_LOG) with fake UART: TX FIFO of 128 bytes drained at
+ * 115200 baud. Realtime phase (drop mode, like main loop): every 1 ms loop
+ * prints some event lines by parts with bursts much bigger than log ring;
+ * print calls must never touch UART (never wait), print_yield() must write
+ * not more than FIFO room, every line on output must be whole and in
+ * order, lines out + dropped lines = lines printed. CLI phase (wait mode):
+ * dump bigger than log ring must come out exact, waiting time is bounded
+ * by sink rate. Stall phase (wait mode, sink takes nothing): print calls
+ * and print_flush() must fall back to drop mode by timeout. Worst-case
+ * latency of print calls and print_yield() by wall clock is printed.
+ * Exit code 1 if any check fails.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), snprintf(), sscanf()
+#include <stdlib.h> // rand(), srand()
+#include <string.h> // memcmp(), strncmp()
+#include <time.h>   // clock_gettime()
+#include <string>
+#include "config.h" // PRINT_LOG, PRINT_LOG_SIZE
+#include "print.h"
+#include "Arduino.h"
+//-----------------------------------------------------------------------------
+#define LT_FIFO  128    // UART TX FIFO [bytes]
+#define LT_RATE  11520  // sink rate [bytes/s] (115200 baud)
+#define LT_LOOPS 20000  // main loop iterations (1 ms)
+//-----------------------------------------------------------------------------
+// fake UART: FIFO drained by virtual time
+static struct {
+  std::string out;    // all written bytes
+  double      room;   // free FIFO space [bytes]
+  uint64_t    us;     // virtual time [us]
+  uint8_t     wait;   // 1 - availableForWrite() is called in wait loop
+  uint8_t     stall;  // 1 - sink takes nothing (no USB host)
+  uint32_t    calls;  // availableForWrite()/write() calls
+  uint32_t    write_max; // maximal bytes by one print_yield()
+} Sink;
+
+HardwareSerial Serial;
+//-----------------------------------------------------------------------------
+static void lt_advance(uint32_t us)
+{
+  Sink.us   += us;
+  Sink.room += (double) LT_RATE * us / 1e6;
+  if (Sink.room > LT_FIFO) Sink.room = LT_FIFO;
+}
+//-----------------------------------------------------------------------------
+int HardwareSerial::availableForWrite()
+{
+  Sink.calls++;
+  if (Sink.wait) lt_advance(100); // CLI waits room: time goes
+  return Sink.stall ? 0 : (int) Sink.room;
+}
+//-----------------------------------------------------------------------------
+size_t HardwareSerial::write(const uint8_t *buf, size_t size)
+{
+  Sink.calls++;
+  if ((double) size > Sink.room) size = (size_t) Sink.room; // FIFO is full
+  Sink.out.append((const char*) buf, size);
+  Sink.room -= size;
+  return size;
+}
+//-----------------------------------------------------------------------------
+size_t HardwareSerial::print(const char *str) { return write((const uint8_t*) str, strlen(str)); }
+size_t HardwareSerial::print(char c) { return write((const uint8_t*) &c, 1); }
+void HardwareSerial::flush() {}
+//-----------------------------------------------------------------------------
+unsigned long millis() { return (unsigned long) (Sink.us / 1000); }
+unsigned long micros() { return (unsigned long) Sink.us; }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+static uint64_t lt_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+//-----------------------------------------------------------------------------
+// realtime phase: return number of failed checks
+static unsigned lt_realtime()
+{
+  uint32_t printed = 0, lines = 0, marks = 0, dropped = 0, drops, seq = 0;
+  uint64_t print_max = 0, yield_max = 0;
+  unsigned bad = 0, i, calls;
+  uint16_t used, peak;
+  size_t pos = 0;
+
+  print_log_wait(0);
+  Sink.out.clear();
+  Sink.room = LT_FIFO;
+
+  for (i = 0; i < LT_LOOPS; i++)
+  {
+    unsigned n = (i % 2000 == 1999) ? 200 : // burst (~9 KB > log ring)
+                 (rand() % 8 == 0);         // ~6 bytes/ms (half of sink)
+    uint64_t t0 = lt_ns(), t1, t2;
+    uint32_t wr0;
+
+    calls = Sink.calls;
+    while (n--)
+    { // line by parts (whole or dropped)
+      print_str("evt ");
+      print_uint_ex(printed++, 6);
+      print_str(" rssi=-");
+      print_uint(rand() % 120);
+      print_str(" snr=");
+      print_int(rand() % 40 - 20);
+      print_eol();
+    }
+    t1 = lt_ns();
+    if (Sink.calls != calls) bad++; // print touched UART
+
+    wr0 = (uint32_t) Sink.out.size();
+    print_yield();
+    t2 = lt_ns();
+    if (Sink.out.size() - wr0 > Sink.write_max)
+      Sink.write_max = (uint32_t) (Sink.out.size() - wr0);
+
+    if (t1 - t0 > print_max) print_max = t1 - t0;
+    if (t2 - t1 > yield_max) yield_max = t2 - t1;
+    lt_advance(1000);
+  }
+  print_log_stat(&drops, &used, &peak);
+
+  // drain (CLI mode)
+  Sink.wait = 1;
+  print_flush();
+  Sink.wait = 0;
+
+  // parse output: whole lines in order and drop marks
+  while (pos < Sink.out.size())
+  {
+    size_t eol = Sink.out.find("\r\n", pos);
+    std::string l;
+    unsigned s, r, d;
+    int q;
+    if (eol == std::string::npos) { bad++; break; } // broken tail
+    l = Sink.out.substr(pos, eol - pos);
+    pos = eol + 2;
+    if (l.empty()) continue; // before mark
+    if (sscanf(l.c_str(), "<log: %u dropped>", &d) == 1)
+    {
+      dropped += d;
+      marks++;
+    }
+    else if (sscanf(l.c_str(), "evt %6u rssi=-%u snr=%d", &s, &r, &q) == 3 &&
+             (lines == 0 || s >= seq) && s < printed)
+    {
+      seq = s + 1;
+      lines++;
+    }
+    else
+      bad++; // broken line
+  }
+  if (lines + dropped != printed || dropped != drops || !marks) bad++;
+  if (Sink.write_max > LT_FIFO) bad++;
+
+  printf("realtime %7u %7u %7u %5u %5u %10.1f %10.1f %5u\n",
+         (unsigned) printed, (unsigned) lines, (unsigned) dropped,
+         (unsigned) peak, (unsigned) Sink.write_max,
+         print_max / 1000., yield_max / 1000., bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// CLI phase (wait mode): return number of failed checks
+static unsigned lt_cli()
+{
+  std::string exp;
+  uint64_t us0, ns0, wait_us, limit_us;
+  uint32_t drops0, drops, size;
+  uint16_t used, peak;
+  unsigned bad = 0, i;
+  char buf[32];
+
+  print_log_stat(&drops0, &used, &peak);
+  print_log_wait(1);
+  Sink.out.clear();
+  Sink.room = LT_FIFO;
+  Sink.wait = 1;
+  us0 = Sink.us;
+  ns0 = lt_ns();
+
+  for (i = 0; i < 1000; i++)
+  { // text and number records
+    print_str("reg 0x");
+    print_hex(i * 2654435761u, 8);
+    print_str(" = ");
+    print_int((long) i - 500);
+    print_str(" bits ");
+    print_bin(i, 12);
+    print_eol();
+    snprintf(buf, sizeof(buf), "reg 0x%08X = %d bits ",
+             (unsigned) (i * 2654435761u), (int) i - 500);
+    exp += buf;
+    for (int b = 11; b >= 0; b--) exp += (char) ('0' + ((i >> b) & 1));
+    exp += "\r\n";
+  }
+  print_flush();
+  wait_us = Sink.us - us0;
+  Sink.wait = 0;
+  print_log_stat(&drops, &used, &peak);
+  print_log_wait(0);
+
+  // waiting time: dump without log ring at sink rate (+ one poll step)
+  size = (uint32_t) exp.size();
+  limit_us = (uint64_t) size * 1000000 / LT_RATE + 1000;
+  if (Sink.out != exp || drops != drops0 || used || wait_us > limit_us) bad++;
+
+  printf("cli      %7u %7u %7u %5u %5u %10.1f %10.1f %5u\n",
+         (unsigned) size, (unsigned) Sink.out.size(),
+         (unsigned) (drops - drops0), (unsigned) peak, (unsigned) LT_FIFO,
+         (lt_ns() - ns0) / 1000., wait_us / 1000., bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// stalled sink in wait mode (no USB host): print and print_flush() must
+// fall back to drop mode by timeout, output must restart with sink
+static unsigned lt_stall()
+{
+  uint64_t us0;
+  uint32_t drops0, drops;
+  uint16_t used, peak;
+  unsigned bad = 0, i, wait_ms;
+
+  print_log_stat(&drops0, &used, &peak);
+  print_log_wait(1);
+  Sink.out.clear();
+  Sink.room  = LT_FIFO;
+  Sink.wait  = 1;
+  Sink.stall = 1;
+  us0 = Sink.us;
+
+  for (i = 0; i < 1000; i++)
+  { // like setup() output without host
+    print_str("boot line ");
+    print_uint(i);
+    print_eol();
+  }
+  print_flush();
+  wait_ms = (unsigned) ((Sink.us - us0) / 1000);
+  print_log_stat(&drops, &used, &peak);
+
+  // bounded waiting (one timeout), lines dropped, nothing written
+  if (wait_ms > 2 * PRINT_LOG_TIMEOUT || drops == drops0 || Sink.out.size())
+    bad++;
+
+  // host is back: log and drop mark come out
+  Sink.stall = 0;
+  print_flush();
+  print_str("host\r\n");
+  print_flush();
+  Sink.wait = 0;
+  print_log_wait(0);
+  if (Sink.out.find("dropped>") == std::string::npos ||
+      Sink.out.find("host\r\n") == std::string::npos)
+    bad++;
+
+  printf("stall    %7u %7u %7u %5u %5u %10.1f %10u %5u\n",
+         1000u, (unsigned) Sink.out.size(), (unsigned) (drops - drops0),
+         (unsigned) peak, (unsigned) LT_FIFO, (Sink.us - us0) / 1000.,
+         wait_ms, bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+int main()
+{
+  unsigned bad = 0;
+
+  srand(1);
+  printf("# PRINT_LOG_SIZE=%u FIFO=%u rate=%uB/s loops=%u\n",
+         (unsigned) PRINT_LOG_SIZE, (unsigned) LT_FIFO, (unsigned) LT_RATE,
+         (unsigned) LT_LOOPS);
+  printf("# realtime: printed/out lines, print/yield worst-case latency [us]\n");
+  printf("# cli: dump/out bytes, total [us] and waiting time [ms]\n");
+  printf("# stall: lines/out bytes without sink, total and waiting time [ms]\n");
+  printf("# phase     print     out    drop  peak  write   print/cli  yield/wait   bad\n");
+  bad += lt_realtime();
+  bad += lt_cli();
+  bad += lt_stall();
+
+  if (bad) printf("# FAIL: %u checks\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "log_test.cpp" file ***/
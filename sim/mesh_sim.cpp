@@ -0,0 +1,457 @@
+/*
+ * Multi-node mesh flooding simulator (host build, virtual time)
+ * File: "mesh_sim.cpp"
+ *
+ * N nodes (AFsm MS, the same "mesh.c" relay as sketch) at random positions
+ * with constant density (average number of neighbors), so network diameter
+ * grows with N. Every node floods own packet every period; relays check
+ * channel by LoRa CAD after random delay. Delivery ratio is counted against
+ * nodes reachable by links over sensitivity (multi-hop), airtime is sum of
+ * all transmissions. Pure flooding is compared with counter suppression
+ * (relay is canceled after K copies heard). Every node learns neighbors
+ * by "nbr.c" table (mean table size and ETX are printed).
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), fprintf()
+#include <stdlib.h> // strtol(), strtod()
+#include <string.h> // strcmp(), memset()
+#include <math.h>   // pow(), sqrt()
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "mesh.h"
+#include "nbr.h"
+#include "lat.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build simulator with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define MSIM_NMAX  16   // maximal number of N in list
+#define MSIM_SEQ   256  // sequence numbers in TX time table (power of 2)
+#define MSIM_DRAIN 3    // time after last own packet [s]
+//-----------------------------------------------------------------------------
+typedef enum {
+  MSIM_FLOOD = 0, // every node relays every new packet once
+  MSIM_SUPP,      // relay is canceled after K copies heard
+  MSIM_RUNS
+} msim_run_t;
+
+static const char * const msim_run_name[MSIM_RUNS] = { "flood", "supp" };
+//-----------------------------------------------------------------------------
+// simulation options
+typedef struct msim_opt_ {
+  int      n[MSIM_NMAX]; // number of nodes
+  int      nn;           // size of n[] list
+  uint32_t time;         // simulation time [s]
+  uint32_t period;       // own packet period of node [ms]
+  uint8_t  sf;           // LoRa SF
+  uint16_t bw;           // LoRa BW [kHz]
+  uint8_t  size;         // payload size [bytes]
+  double   nbr;          // average number of neighbors
+  uint8_t  ttl;          // TTL of own packets
+  uint32_t delay;        // random relay delay window [us]
+  uint8_t  supp;         // copies heard to cancel relay (MSIM_SUPP run)
+  uint32_t step;         // main loop step [us]
+  uint32_t seed;         // random seed
+} msim_opt_t;
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM + relay)
+typedef struct msim_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  ABlink        led;
+  mesh_t        mesh;
+  nbr_t         nbr;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  unsigned long start_ms;   // FSM start time [ms]
+  uint8_t       started;
+  uint32_t      reach;      // reachable nodes (without itself)
+  uint32_t      errors;     // FSM action errors
+} msim_node_t;
+//-----------------------------------------------------------------------------
+// result of run
+typedef struct msim_res_ {
+  uint64_t   hops; // sum of hops of new packets
+  lat_hist_t lat;  // own TX start -> new packet RxDone on other node [us]
+} msim_res_t;
+//-----------------------------------------------------------------------------
+static chan_t       Chan;    // RF channel (big, static)
+static msim_node_t *Node;    // nodes of run
+static msim_node_t *Cur;     // node in FSM callback context
+static msim_res_t   Res;     // result of run
+static uint32_t     Rnd = 1; // xorshift32 state
+
+// own TX start time by origin and sequence number
+static uint64_t Sent[256][MSIM_SEQ];
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+// uniform random value 0...1
+static double msim_rand()
+{
+  Rnd ^= Rnd << 13; Rnd ^= Rnd >> 17; Rnd ^= Rnd << 5;
+  return (double) Rnd / 4294967296.0;
+}
+//-----------------------------------------------------------------------------
+// link a <-> b over sensitivity (mean power, shadowing of link)
+static uint8_t msim_link(int a, int b)
+{
+  const sx1280_emu_t *e = &Node[a].emu;
+  uint32_t bw = emu_bw(e);
+  double snr = Node[a].pars.power - chan_path_loss(&Chan, a, b) -
+               chan_noise(&Chan, bw);
+  return snr >= chan_snr_min(e->pkt_type, emu_sf(e));
+}
+//-----------------------------------------------------------------------------
+// number of nodes reachable from every node by multi-hop links (BFS)
+static void msim_reach(int num)
+{
+  int *queue = new int[num];
+  uint8_t *seen = new uint8_t[num];
+  int i, j;
+
+  for (i = 0; i < num; i++)
+  {
+    int head = 0, tail = 0;
+    memset((void*) seen, 0, num);
+    seen[i] = 1;
+    queue[tail++] = i;
+    while (head < tail)
+    {
+      int a = queue[head++];
+      for (j = 0; j < num; j++)
+        if (!seen[j] && msim_link(a, j))
+        {
+          seen[j] = 1;
+          queue[tail++] = j;
+        }
+    }
+    Node[i].reach = (uint32_t) (tail - 1);
+  }
+
+  delete[] seen;
+  delete[] queue;
+}
+//-----------------------------------------------------------------------------
+// FSM event callback: own TX start time
+static void msim_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  msim_node_t *n = Cur;
+  const mesh_t *m = &n->mesh;
+
+  if (err != SX128X_ERR_NONE) n->errors++;
+
+  if (ev == AFSM_EV_CAD && err == SX128X_ERR_NONE &&
+      m->state == MESH_TX && m->cur == MESH_OWN)
+    Sent[m->addr & 0xFF][m->seq & (MSIM_SEQ - 1)] = vclock_now();
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (like sx128x_irq()), t - local time
+static void msim_irq(msim_node_t *n, uint32_t t)
+{
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_TX_DONE)
+    n->fsm.tx_done();
+
+  if (irq & SX128X_IRQ_RX_DONE)
+  {
+    sx128x_rx_t rx;
+    uint8_t data[255], size = 0;
+
+    if (sx128x_get_recv(&n->radio, irq, sizeof(data), &rx, data, &size) ==
+        SX128X_ERR_NONE && rx.crc_ok)
+    {
+      uint32_t cnt = n->mesh.rx;
+      rx_pkt_t pkt;
+      pkt.ts   = vclock_now() * 1000; // [ns]
+      pkt.rx   = rx;
+      pkt.size = size;
+      memcpy((void*) pkt.data, (const void*) data, size);
+      nbr_rx_cb(&pkt, &n->nbr); // like RX ring subscriber
+      mesh_recv(&n->mesh, data, size, t); // like RX ring subscriber
+      if (n->mesh.rx != cnt)
+      { // new packet: hops and latency from origin
+        uint64_t t0 = Sent[n->mesh.last_origin & 0xFF]
+                          [n->mesh.last_seq & (MSIM_SEQ - 1)];
+        Res.hops += n->mesh.last_hops + 1;
+        if (t0) lat_add(&Res.lat, (uint32_t) (vclock_now() - t0));
+      }
+    }
+    n->fsm.rx_done();
+  }
+
+  if (irq & SX128X_IRQ_CAD_DONE)
+    n->fsm.cad_done((irq & SX128X_IRQ_CAD_DETECTED) ? 1 : 0);
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT)
+    n->fsm.rxtx_timeout();
+
+  if ((irq & SX128X_IRQ_HEADER_ERROR) || (irq & SX128X_IRQ_CRC_ERROR))
+  { // see Errata 16.2 (as in sx128x_irq())
+    sx128x_rx(&n->radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_15_625US);
+  }
+}
+//-----------------------------------------------------------------------------
+// init node `id` at random position in square area with side `side` [m]
+static int msim_node_init(msim_node_t *n, int id, double side, msim_run_t run,
+                          const msim_opt_t *opt)
+{
+  int8_t retv;
+
+  emu_init(&n->emu, &Chan, id, (msim_rand() - 0.5) * side,
+                               (msim_rand() - 0.5) * side);
+  chan_add(&Chan, &n->emu);
+
+  n->pars              = sx128x_pars_default;
+  n->pars.mode         = SX128X_LORA;
+  n->pars.fixed        = 1;
+  n->pars.payload_size = opt->size;
+  n->pars.sf           = opt->sf;
+  n->pars.bw           = opt->bw;
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = AFSM_MS;
+  n->fsm_pars.t    = opt->period;
+  n->fsm_pars.wut  = 1;
+  n->start_ms      = (unsigned long) (100 * msim_rand());
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data[0]    = (uint8_t) id;
+  n->data_size  = opt->size;
+  n->tx_timeout = 0;
+  n->started    = 0;
+  n->errors     = 0;
+
+  mesh_init(&n->mesh);
+  n->mesh.addr  = (uint16_t) id;
+  n->mesh.ttl   = opt->ttl;
+  n->mesh.delay = opt->delay;
+  n->mesh.supp  = run == MSIM_SUPP ? opt->supp : 0;
+  mesh_reset(&n->mesh);
+  nbr_init(&n->nbr);
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, msim_callback);
+  n->fsm.relay(&n->mesh);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// run one simulation with `num` nodes, print result line
+static int msim_run(int num, msim_run_t run, double range,
+                    const msim_opt_t *opt)
+{
+  msim_node_t *node = Node = new msim_node_t[num];
+  uint64_t end = (uint64_t) opt->time * 1000000ull;
+  uint64_t air = 0, exp = 0;
+  uint32_t sent = 0, ok = 0, errors = 0, relayed = 0, busy = 0, drop = 0;
+  uint32_t supp = 0, full = 0, reach = 0, nbrs = 0, links = 0;
+  uint64_t etx = 0;
+  double side = sqrt(num * M_PI * range * range / opt->nbr), dr, load;
+  int i, j;
+
+  vclock_reset(0);
+  chan_pars_t cp = chan_pars_default;
+  cp.seed = opt->seed;
+  chan_init(&Chan, &cp);
+  memset((void*) &Res, 0, sizeof(Res));
+  memset((void*) Sent, 0, sizeof(Sent));
+  lat_clear(&Res.lat);
+  Rnd = opt->seed ? opt->seed : 1;
+
+  for (i = 0; i < num; i++)
+  {
+    if (msim_node_init(&node[i], i, side, run, opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail (node %i)\n", i);
+      delete[] node;
+      return -1;
+    }
+  }
+  msim_reach(num);
+
+  while (vclock_now() < end + MSIM_DRAIN * 1000000ull)
+  {
+    uint8_t stop = vclock_now() >= end; // no own packets, relays finish
+    for (i = 0; i < num; i++)
+    {
+      msim_node_t *n = Cur = &node[i];
+      uint32_t t = vclock_us();
+      if (!n->started && vclock_ms() >= n->start_ms)
+      {
+        n->fsm.start();
+        n->started = 1;
+      }
+      if (stop) n->mesh.period = 0;
+      n->fsm.yield(t);
+      if (emu_dio1(&n->emu)) msim_irq(n, t);
+    }
+    vclock_step(opt->step);
+  }
+
+  for (i = 0; i < num; i++)
+  {
+    const mesh_t *m = &node[i].mesh;
+    sent    += m->sent;
+    ok      += m->rx;
+    relayed += m->relayed;
+    busy    += m->busy;
+    drop    += m->drop;
+    supp    += m->supp_cnt;
+    full    += m->full;
+    air     += m->air;
+    errors  += node[i].errors;
+    reach   += node[i].reach;
+    exp     += (uint64_t) m->sent * node[i].reach;
+    nbrs    += node[i].nbr.num;
+    for (j = 0; j < NBR_SIZE; j++)
+    {
+      const nbr_ent_t *e = &node[i].nbr.ent[j];
+      if (e->used && nbr_etx(e) != NBR_ETX_MAX)
+      {
+        etx += nbr_etx(e);
+        links++;
+      }
+    }
+  }
+
+  dr   = exp ? 100. * ok / exp : 0.;
+  load = (double) air / end;
+
+  printf("%4i %-5s %5.1f %5.1f %6u %8u %6.2f %6.2f %5.3f %6u %5u %5u %5u "
+         "%6u %5u %5u %4.1f %4.2f\n",
+         num, msim_run_name[run], 100. * reach / ((double) num * (num - 1)),
+         ok ? (double) Res.hops / ok : 0., sent, ok, dr,
+         sent ? (double) (sent + relayed) / sent : 0., load, busy, drop,
+         supp, full, Chan.stat.collision,
+         lat_percentile(&Res.lat, 500) / 1000,
+         lat_percentile(&Res.lat, 990) / 1000, (double) nbrs / num,
+         links ? etx / (100. * links) : 0.);
+  printf("%s", errors ? "# FSM errors\n" : "");
+
+  delete[] node;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void msim_usage()
+{
+  printf(
+    "Usage: mesh_sim [options]\n"
+    "  -n N1,N2,...     number of nodes (default 4,8,16,32,64)\n"
+    "  -t SEC           simulation time [s] (default 60)\n"
+    "  -p MS            own packet period of node [ms] (default 10000)\n"
+    "  -s SF            LoRa spreading factor 5...12 (default 7)\n"
+    "  -b BW            LoRa bandwidth 203|406|812|1625 kHz (default 812)\n"
+    "  -l SIZE          payload size 8...255 bytes (default 16)\n"
+    "  -d NBR           average number of neighbors (default 6)\n"
+    "  -r TTL           TTL of own packets (default 8)\n"
+    "  -D US            random relay delay window [us] (default 20000)\n"
+    "  -k K             copies heard to cancel relay in `supp` run (default 2)\n"
+    "  --step US        main loop step [us] (default 50)\n"
+    "  --seed N         random seed (default 1)\n");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  msim_opt_t opt = {
+    { 4, 8, 16, 32, 64 }, 5, // n[], nn
+    60, 10000,               // time, period
+    7, 812, 16,              // sf, bw, size
+    6., 8, MESH_DELAY, 2,    // nbr, ttl, delay, supp
+    50, 1 };                 // step, seed
+  double range;
+  uint32_t toa;
+  int i, j;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { msim_usage(); return 0; }
+    if (v == NULL) { msim_usage(); return 1; }
+    i++;
+
+    if (!strcmp(a, "-n"))
+    {
+      char *p = (char*) v;
+      for (opt.nn = 0; opt.nn < MSIM_NMAX && *p; )
+      {
+        long n = strtol(p, &p, 10);
+        if (n >= 2 && n <= CHAN_NODES) opt.n[opt.nn++] = (int) n;
+        if (*p == ',') p++; else break;
+      }
+    }
+    else if (!strcmp(a, "-t")) opt.time   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-p")) opt.period = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-s")) opt.sf     = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-b")) opt.bw     = (uint16_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-l")) opt.size   = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-d")) opt.nbr    = strtod(v, NULL);
+    else if (!strcmp(a, "-r")) opt.ttl    = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-D")) opt.delay  = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-k")) opt.supp   = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "--step")) opt.step = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "--seed")) opt.seed = (uint32_t) strtoul(v, NULL, 10);
+    else { msim_usage(); return 1; }
+  }
+
+  if (opt.size < MESH_HDR_SIZE + 1) opt.size = MESH_HDR_SIZE + 1;
+  if (opt.nn == 0 || opt.time == 0 || opt.step == 0 || opt.period == 0 ||
+      opt.nbr <= 0.) { msim_usage(); return 1; }
+
+  { // time on air by driver and mean link range (no shadowing)
+    static msim_node_t n;
+    double snr;
+    vclock_reset(0);
+    chan_init(&Chan, &chan_pars_default);
+    if (msim_node_init(&n, 0, 1., MSIM_FLOOD, &opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail\n");
+      return 1;
+    }
+    toa = sx128x_time_on_air(&n.radio, opt.size);
+    snr = n.pars.power - chan_noise(&Chan, emu_bw(&n.emu)) -
+          chan_snr_min(n.emu.pkt_type, emu_sf(&n.emu));
+    range = pow(10., (snr - chan_pars_default.pl0) /
+                     (10. * chan_pars_default.n));
+  }
+
+  printf("# LoRa SF=%u BW=%ukHz size=%u toa=%uus range=%.0fm nbr=%.1f "
+         "period=%ums ttl=%u delay=%uus K=%u step=%uus time=%us seed=%u\n",
+         opt.sf, opt.bw, opt.size, toa, range, opt.nbr, opt.period, opt.ttl,
+         opt.delay, opt.supp, opt.step, opt.time, opt.seed);
+  printf("#  N run   reach  hops   sent       ok    DR%%  tx/pkt  load   "
+         "busy  drop  supp  full collis  l50   l99  nbr  etx\n");
+
+  for (i = 0; i < opt.nn; i++)
+    for (j = 0; j < MSIM_RUNS; j++)
+      if (msim_run(opt.n[i], (msim_run_t) j, range, &opt) != 0) return 1;
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "mesh_sim.cpp" file ***/
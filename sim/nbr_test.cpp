@@ -0,0 +1,267 @@
+/*
+ * Neighbor table test (host build)
+ * File: "nbr_test.cpp"
+ *
+ * "nbr.c" against plain reference list: random packets of many addresses
+ * (table overflow, eviction of the oldest seen, expire by timeout with
+ * backward shift of probe chains), every known address must be found and
+ * every dropped one must not. ACK history of random loss must give
+ * received/lost counters and ETX by window. Lookup time is measured.
+ * Exit code 1 if any check fails.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf()
+#include <stdlib.h> // rand(), srand()
+#include <string.h> // memset()
+#include <time.h>   // clock_gettime()
+#include "config.h"
+#include "nbr.h"
+//-----------------------------------------------------------------------------
+#define NT_ADDRS 200 // addresses in test (more than table)
+//-----------------------------------------------------------------------------
+// reference neighbor
+typedef struct nt_ref_ {
+  uint8_t  used;
+  uint16_t seq;
+  uint32_t seen;
+} nt_ref_t;
+
+static nt_ref_t Ref[NT_ADDRS];
+static uint16_t Addr[NT_ADDRS]; // random addresses (collisions of hash)
+static nbr_t    Nbr;
+//-----------------------------------------------------------------------------
+// check table against reference: return number of failed checks
+static unsigned nt_check()
+{
+  unsigned bad = 0, num = 0;
+  int i;
+
+  for (i = 0; i < NT_ADDRS; i++)
+  {
+    const nbr_ent_t *e = nbr_find(&Nbr, Addr[i]);
+    if (Ref[i].used)
+    {
+      num++;
+      if (!e || e->seq != Ref[i].seq || e->seen != Ref[i].seen) bad++;
+    }
+    else if (e) bad++;
+  }
+  if (num != Nbr.num || num > NBR_MAX) bad++;
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// drop reference entries like nbr_expire()
+static void nt_expire(uint32_t t)
+{
+  int i;
+  for (i = 0; i < NT_ADDRS; i++)
+    if (Ref[i].used && t - Ref[i].seen >= Nbr.timeout) Ref[i].used = 0;
+}
+//-----------------------------------------------------------------------------
+// random table operations: return number of failed checks
+static unsigned nt_table(unsigned steps)
+{
+  sx128x_rx_t rx;
+  unsigned bad = 0, k;
+  uint32_t t = 0xFFFF0000; // near wrap
+  int i;
+
+  memset((void*) &rx, 0, sizeof(rx));
+  memset((void*) Ref, 0, sizeof(Ref));
+  for (i = 0; i < NT_ADDRS; i++)
+  { // unique random addresses
+    int j;
+    do {
+      Addr[i] = (uint16_t) rand();
+      for (j = 0; j < i && Addr[j] != Addr[i]; j++);
+    } while (j < i);
+  }
+
+  nbr_init(&Nbr);
+  Nbr.timeout = 5000;
+
+  for (k = 0; k < steps; k++)
+  {
+    int a = rand() % (k & 0x400 ? NT_ADDRS : NBR_MAX / 2); // phases
+    t += 1 + (uint32_t) (rand() % 50);
+
+    if (rand() % 1000 == 0)
+    { // explicit expire
+      nt_expire(t);
+      nbr_expire(&Nbr, t);
+    }
+    else
+    {
+      if (!Ref[a].used)
+      { // new neighbor: expire or evict the oldest seen
+        int n = 0, old = -1;
+        for (i = 0; i < NT_ADDRS; i++) n += Ref[i].used;
+        if (n >= NBR_MAX)
+        {
+          nt_expire(t);
+          for (i = 0, n = 0; i < NT_ADDRS; i++) n += Ref[i].used;
+        }
+        if (n >= NBR_MAX)
+        {
+          for (i = 0; i < NT_ADDRS; i++)
+            if (Ref[i].used &&
+                (old < 0 || (int32_t) (Ref[i].seen - Ref[old].seen) < 0))
+              old = i;
+          Ref[old].used = 0;
+        }
+        Ref[a].used = 1;
+      }
+      Ref[a].seq++;
+      Ref[a].seen = t;
+      rx.rssi = (uint8_t) (rand() % 200);
+      nbr_update(&Nbr, Addr[a], Ref[a].seq, &rx, t);
+    }
+    bad += nt_check();
+  }
+
+  printf("table    %6u %4u %7lu %7lu %7lu %5u\n", steps, (unsigned) Nbr.num,
+         (unsigned long) Nbr.added, (unsigned long) Nbr.evict,
+         (unsigned long) Nbr.expired, bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// ACK history by sequence gaps and ACKs: return number of failed checks
+static unsigned nt_etx(unsigned loss) // loss [%]
+{
+  sx128x_rx_t rx;
+  const nbr_ent_t *e;
+  uint32_t rx_cnt = 1, lost = 0, win = 0, acks = 0, etx, exp;
+  uint8_t hist[NBR_HIST];
+  uint16_t seq = 100;
+  unsigned bad = 0, i, k, n = 0;
+
+  memset((void*) &rx, 0, sizeof(rx));
+  rx.lora = 1;
+  rx.rssi = 170; // -85 dBm
+  rx.snr  = 28;  // +7 dB
+  nbr_init(&Nbr);
+  e = nbr_update(&Nbr, 7, seq, &rx, 0);
+  hist[n++ % NBR_HIST] = 1;
+
+  for (k = 0; k < 10000; k++)
+  {
+    uint8_t ok = (unsigned) (rand() % 100) >= loss;
+    seq++;
+    if (ok)
+    {
+      if (rand() & 1) nbr_update(&Nbr, 7, seq, &rx, k);
+      else            { nbr_ack(&Nbr, 7, 1); seq--; } // unicast ACK
+      rx_cnt++;
+    }
+    else if (rand() & 1)
+    {
+      nbr_ack(&Nbr, 7, 0); // no ACK
+      seq--;
+      lost++;
+    }
+    else
+    { // sequence gap: known with next packet
+      seq++;
+      nbr_update(&Nbr, 7, seq, &rx, k);
+      hist[n++ % NBR_HIST] = 0;
+      rx_cnt++;
+      lost++;
+      ok = 1;
+    }
+    hist[n++ % NBR_HIST] = ok;
+  }
+
+  for (i = 0; i < NBR_HIST; i++) acks += hist[i];
+  win = n < NBR_HIST ? n : NBR_HIST;
+  exp = acks ? (100 * win * win + acks * acks / 2) / (acks * acks) : NBR_ETX_MAX;
+  etx = nbr_etx(e);
+
+  if (e->rx != rx_cnt || e->lost != lost || e->acks != acks ||
+      e->hist_n != win || etx != (exp < NBR_ETX_MAX ? exp : NBR_ETX_MAX))
+    bad++;
+  if (e->rssi != -85 * 16 || e->snr != 7 * 16) bad++;
+
+  printf("etx      %5u%% %6lu %6lu %4u/%u %4u.%02u %5u\n", loss,
+         (unsigned long) e->rx, (unsigned long) e->lost, (unsigned) e->acks,
+         (unsigned) e->hist_n, etx / 100, etx % 100, bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// long sequence gap: link must be bad (not perfect by one packet) and
+// recover with new packets; return number of failed checks
+static unsigned nt_gap(uint16_t gap)
+{
+  sx128x_rx_t rx;
+  const nbr_ent_t *e;
+  uint16_t seq = 0xFFF0, etx_gap, etx_back;
+  unsigned bad = 0, k;
+
+  memset((void*) &rx, 0, sizeof(rx));
+  nbr_init(&Nbr);
+  for (k = 0; k < NBR_HIST; k++)
+    e = nbr_update(&Nbr, 9, seq++, &rx, k); // perfect link
+  if (nbr_etx(e) != 100) bad++;
+
+  seq += gap; // lost packets
+  e = nbr_update(&Nbr, 9, seq++, &rx, k);
+  etx_gap = nbr_etx(e);
+  if (gap >= NBR_GAP_MAX ? etx_gap != NBR_ETX_MAX :
+      e->acks != NBR_HIST - gap)
+    bad++;
+  if (e->lost != gap) bad++;
+
+  for (k = 1; k < NBR_HIST; k++)
+    e = nbr_update(&Nbr, 9, seq++, &rx, k);
+  etx_back = nbr_etx(e);
+  if (etx_back != 100) bad++;
+
+  printf("gap      %5u %6lu %6lu %4u.%02u %4u.%02u %5u\n", (unsigned) gap,
+         (unsigned long) e->rx, (unsigned long) e->lost,
+         etx_gap / 100, etx_gap % 100, etx_back / 100, etx_back % 100, bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+int main()
+{
+  struct timespec t0, t1;
+  unsigned bad = 0, found = 0;
+  uint64_t ns;
+  int i, k;
+
+  srand(1);
+
+  printf("# NBR_SIZE=%u NBR_MAX=%u NBR_HIST=%u\n",
+         (unsigned) NBR_SIZE, (unsigned) NBR_MAX, (unsigned) NBR_HIST);
+  printf("# test    steps  num   added   evict expired   bad\n");
+  bad += nt_table(200000);
+
+  // lookup time of full table (known and unknown addresses)
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (k = 0; k < 100000; k++)
+    for (i = 0; i < NT_ADDRS; i++)
+      found += nbr_find(&Nbr, Addr[i]) != NULL;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  ns = (uint64_t) (t1.tv_sec - t0.tv_sec) * 1000000000 +
+       (t1.tv_nsec - t0.tv_nsec);
+  printf("# lookup %.1f ns/call (found %u%%)\n",
+         (double) ns / (100000. * NT_ADDRS),
+         (unsigned) (found / (1000 * NT_ADDRS)));
+
+  printf("# test     loss     rx   lost  acks/n     etx   bad\n");
+  bad += nt_etx(0);
+  bad += nt_etx(10);
+  bad += nt_etx(30);
+  bad += nt_etx(60);
+
+  printf("# test      gap     rx   lost  etx_gap etx_back   bad\n");
+  bad += nt_gap(5);
+  bad += nt_gap(NBR_GAP_MAX);
+  bad += nt_gap(1000);
+
+  if (bad) printf("# FAIL: %u checks\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "nbr_test.cpp" file ***/
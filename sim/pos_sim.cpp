@@ -0,0 +1,440 @@
+/*
+ * Multi-anchor positioning simulator (host build, virtual time)
+ * File: "pos_sim.cpp"
+ *
+ * Schedule: ranging master (AFsm RM with "range.c" session and "pos.c"
+ * anchor cycle) and K anchors (AFsm RS) on emulated chips around it,
+ * prints positions per second, position error and residuals (--div:
+ * sessions with frequency diversity, parked anchors ignore requests to
+ * other anchors).
+ * Solver (-g N): N random synthetic 2D/3D anchor geometries with Gaussian
+ * distance noise through pos_solve() only (no chips).
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), fprintf()
+#include <stdlib.h> // strtol(), strtod()
+#include <string.h> // strcmp(), memset()
+#include <math.h>   // sqrt(), cos(), sin(), log()
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "range.h"
+#include "pos.h"
+#include "rdiv.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build simulator with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define PSIM_STEP_US 20          // main loop step (IRQ polling resolution) [us]
+#define PSIM_ADDR    0xDEADBE00u // anchor address base (+ anchor number)
+//-----------------------------------------------------------------------------
+// simulation options
+typedef struct psim_opt_ {
+  uint32_t time;   // simulation time [s]
+  uint32_t period; // cycle period [ms]
+  uint8_t  count;  // exchanges in session (per anchor)
+  uint8_t  sf;     // LoRa SF (5...10)
+  uint32_t bw;     // LoRa BW [kHz]
+  uint8_t  k;      // anchors
+  double   r;      // anchors circle radius [m]
+  double   x, y;   // tag position [m]
+  uint32_t g;      // synthetic geometries (solver test), 0 - schedule
+  uint8_t  dim;    // solver dimension {2|3}
+  double   e;      // synthetic distance noise RMS [m]
+  uint8_t  div;    // diversity channels (0 - off)
+  double   fsel;   // frequency selective multipath probability
+  uint32_t seed;   // random seed
+} psim_opt_t;
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM)
+typedef struct psim_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  rdiv_t        div;
+  ABlink        led;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  uint32_t      errors; // FSM action errors
+} psim_node_t;
+//-----------------------------------------------------------------------------
+// error statistic [m]
+typedef struct psim_err_ {
+  uint32_t n;
+  double   sum, sum2, max;
+} psim_err_t;
+//-----------------------------------------------------------------------------
+static chan_t       Chan;  // RF channel (big, static)
+static range_t      Range; // ranging session of master
+static pos_list_t   List;  // anchors
+static pos_t        Pos;   // anchor cycle of master
+static psim_node_t *Cur;   // node in FSM callback context
+static uint64_t     Rnd;   // solver test random state
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+static void psim_err_add(psim_err_t *s, double e)
+{
+  s->n++;
+  s->sum  += e;
+  s->sum2 += e * e;
+  if (fabs(e) > s->max) s->max = fabs(e);
+}
+//-----------------------------------------------------------------------------
+static double psim_rms(const psim_err_t *s)
+{
+  return s->n ? sqrt(s->sum2 / s->n) : 0.;
+}
+//-----------------------------------------------------------------------------
+// uniform random [0, 1) (xorshift64*)
+static double psim_rand()
+{
+  Rnd ^= Rnd >> 12;
+  Rnd ^= Rnd << 25;
+  Rnd ^= Rnd >> 27;
+  return (double) ((Rnd * 2685821657736338717ull) >> 11) / 9007199254740992.;
+}
+//-----------------------------------------------------------------------------
+// Gaussian random N(0, 1) (Box-Muller)
+static double psim_gauss()
+{
+  double u = psim_rand(), v = psim_rand();
+  return sqrt(-2. * log(u + 1e-300)) * cos(2. * M_PI * v);
+}
+//-----------------------------------------------------------------------------
+// FSM event callback
+static void psim_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  if (err != SX128X_ERR_NONE) Cur->errors++;
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (ranging part of sx128x_irq())
+static void psim_irq(psim_node_t *n)
+{
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_MASTER_RESULT_VALID)
+  {
+    uint8_t  filter = 0, rssi;
+    uint32_t raw;
+    int32_t  cm;
+    if (sx128x_ranging_result(&n->radio, &filter, &raw, &cm, &rssi) ==
+        SX128X_ERR_NONE)
+      range_add(&Range, raw, cm, rssi);
+    n->fsm.ranging_done();
+  }
+
+  if (irq & SX128X_IRQ_MASTER_TIMEOUT)
+    n->fsm.rxtx_timeout();
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT) // anchor RX window
+    n->fsm.rxtx_timeout();
+
+  if (irq & SX128X_IRQ_SLAVE_RESPONSE_DONE)
+    n->fsm.ranging_done();
+
+  if (irq & SX128X_IRQ_SLAVE_REQUEST_DISCARD)
+    n->fsm.ranging_listen();
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - master, 1...K - anchors) at (x, y) [m]
+static int psim_node_init(psim_node_t *n, int id, double x, double y,
+                          const psim_opt_t *opt)
+{
+  int8_t retv;
+
+  emu_init(&n->emu, &Chan, id, x, y);
+  chan_add(&Chan, &n->emu);
+
+  n->pars      = sx128x_pars_default;
+  n->pars.mode = SX128X_RANGING;
+  n->pars.sf   = opt->sf;
+  n->pars.bw   = opt->bw;
+  n->pars.role = id ? 0x00 : 0x01;
+  if (id) n->pars.slave_address = PSIM_ADDR + id;
+  else
+  { // master is calibrated (look "range_sim --cal")
+    int i, j;
+    for (i = 0; i < SX128X_CALIB_BWS; i++)
+      for (j = 0; j < SX128X_CALIB_SFS; j++)
+        n->pars.calib[i][j] += EMU_RNG_CAL_DESIGN;
+  }
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = id ? AFSM_RS : AFSM_RM;
+  n->fsm_pars.t    = opt->period;
+  n->fsm_pars.wut  = 1;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data_size  = 4;
+  n->tx_timeout = 0;
+  n->errors     = 0;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, psim_callback);
+  if (id == 0)
+  {
+    n->fsm.ranger(&Range);
+    n->fsm.anchors(&Pos);
+  }
+
+  rdiv_init(&n->div);
+  if (opt->div)
+  {
+    rdiv_plan(&n->div, RDIV_FREQ_MIN,
+              RDIV_FREQ_MIN + (uint32_t) (opt->div - 1) * RDIV_STEP, RDIV_STEP);
+    n->div.on = 1;
+    n->fsm.diversity(&n->div);
+  }
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// simulate anchor cycles on emulated chips
+static int psim_run(const psim_opt_t *opt)
+{
+  static psim_node_t node[1 + POS_ANCHORS];
+  uint64_t end = (uint64_t) opt->time * 1000000ull;
+  psim_node_t *rm = &node[0];
+  psim_err_t err = { 0, 0., 0., 0. }, res = { 0, 0., 0., 0. };
+  uint32_t rate = 0, errors = 0;
+  int i;
+
+  vclock_reset(0);
+  chan_pars_t cp = chan_pars_default;
+  cp.seed = opt->seed;
+  cp.fsel = opt->fsel;
+  chan_init(&Chan, &cp);
+
+  // anchors evenly on circle, tag inside
+  pos_list_default(&List);
+  List.on = 1;
+  List.n  = opt->k;
+  for (i = 0; i <= opt->k; i++)
+  {
+    double a = 2. * M_PI * (i - 1) / opt->k;
+    double x = i ? opt->r * cos(a) : opt->x;
+    double y = i ? opt->r * sin(a) : opt->y;
+    if (i)
+    {
+      pos_anchor_t *p = &List.a[i - 1];
+      p->addr = PSIM_ADDR + i;
+      p->x    = (int32_t) floor(x * 10. + 0.5);
+      p->y    = (int32_t) floor(y * 10. + 0.5);
+      p->z    = 0;
+    }
+    if (psim_node_init(&node[i], i, x, y, opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail (node %i)\n", i);
+      return -1;
+    }
+  }
+  pos_init(&Pos, &List);
+
+  // anchors listen first, master starts after 1 ms
+  for (i = 1; i <= opt->k; i++)
+  {
+    Cur = &node[i];
+    node[i].fsm.start();
+  }
+
+  while (vclock_now() < end)
+  {
+    if (vclock_ms() >= 1 && !rm->fsm.run() && Pos.fixes + Pos.fails == 0)
+    {
+      Cur = rm;
+      rm->fsm.start();
+    }
+
+    for (i = 0; i <= opt->k; i++)
+    {
+      psim_node_t *n = Cur = &node[i];
+      n->fsm.yield(TIME_FUNC());
+      if (emu_dio1(&n->emu)) psim_irq(n);
+    }
+
+    if (Pos.ready)
+    {
+      Pos.ready = 0;
+      rate += Pos.rate;
+      if (Pos.err == POS_ERR_NONE)
+      {
+        psim_err_add(&err, hypot(Pos.fix.x / 10. - opt->x,
+                                 Pos.fix.y / 10. - opt->y));
+        psim_err_add(&res, Pos.fix.rms / 10.);
+      }
+    }
+    vclock_step(PSIM_STEP_US);
+  }
+
+  for (i = 0; i <= opt->k; i++) errors += node[i].errors;
+  if (errors) printf("# FSM errors: %u\n", errors);
+
+  printf("# cycles=%lu fixes=%lu fails=%lu positions=%.2f/s "
+         "cycle=%lu/s\n",
+         (unsigned long) (Pos.fixes + Pos.fails), (unsigned long) Pos.fixes,
+         (unsigned long) Pos.fails, Pos.fixes / (double) opt->time,
+         (unsigned long) (Pos.fixes + Pos.fails ?
+                          rate / (Pos.fixes + Pos.fails) : 0));
+  printf("# error[m]: mean=%.2f rms=%.2f max=%.2f residual rms=%.2f\n",
+         err.n ? err.sum / err.n : 0., psim_rms(&err), err.max,
+         psim_rms(&res));
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// solver test on random geometries (anchors and tag in box)
+static int psim_solver(const psim_opt_t *opt)
+{
+  const double box = 2. * opt->r;
+  psim_err_t err = { 0, 0., 0., 0. }, res = { 0, 0., 0., 0. };
+  uint32_t i, fails = 0, iters = 0;
+  uint8_t j;
+
+  Rnd = opt->seed * 0x9E3779B97F4A7C15ull + 1;
+
+  for (i = 0; i < opt->g; i++)
+  {
+    double p[3], e;
+    int32_t d[POS_ANCHORS];
+    pos_fix_t fix;
+
+    pos_list_default(&List);
+    List.dim = opt->dim;
+    List.n   = opt->k;
+    for (j = 0; j < 3; j++) p[j] = psim_rand() * box;
+    if (opt->dim == 2) p[2] = 0.;
+
+    for (j = 0; j < opt->k; j++)
+    {
+      pos_anchor_t *a = &List.a[j];
+      double q[3], r;
+      q[0] = psim_rand() * box;
+      q[1] = psim_rand() * box;
+      q[2] = opt->dim == 3 ? psim_rand() * box : 0.;
+      a->x = (int32_t) floor(q[0] * 10. + 0.5);
+      a->y = (int32_t) floor(q[1] * 10. + 0.5);
+      a->z = (int32_t) floor(q[2] * 10. + 0.5);
+      r = sqrt((p[0] - a->x / 10.) * (p[0] - a->x / 10.) +
+               (p[1] - a->y / 10.) * (p[1] - a->y / 10.) +
+               (p[2] - a->z / 10.) * (p[2] - a->z / 10.));
+      d[j] = (int32_t) floor((r + opt->e * psim_gauss()) * 10. + 0.5);
+    }
+
+    if (pos_solve(&List, d, 0xFFFF, &fix, 0) != POS_ERR_NONE)
+    {
+      fails++;
+      continue;
+    }
+    e = sqrt((fix.x / 10. - p[0]) * (fix.x / 10. - p[0]) +
+             (fix.y / 10. - p[1]) * (fix.y / 10. - p[1]) +
+             (fix.z / 10. - p[2]) * (fix.z / 10. - p[2]));
+    psim_err_add(&err, e);
+    psim_err_add(&res, fix.rms / 10.);
+    iters += fix.iter;
+  }
+
+  printf("# geometries=%lu fails=%lu iter=%.2f\n", (unsigned long) opt->g,
+         (unsigned long) fails, err.n ? iters / (double) err.n : 0.);
+  printf("# error[m]: mean=%.2f rms=%.2f max=%.2f residual rms=%.2f\n",
+         err.n ? err.sum / err.n : 0., psim_rms(&err), err.max,
+         psim_rms(&res));
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void psim_usage()
+{
+  printf(
+    "Usage: pos_sim [options]\n"
+    "  -t SEC           simulation time [s] (default 60)\n"
+    "  -p MS            cycle period [ms] (default 200)\n"
+    "  -n N             exchanges per anchor 1...64 (default 4)\n"
+    "  -s SF            LoRa SF 5...10 (default 6)\n"
+    "  -b KHZ           LoRa BW 406, 812, 1625 kHz (default 1625)\n"
+    "  -k K             anchors 3...%u (default 4)\n"
+    "  -R M             anchors circle radius / half box [m] (default 50)\n"
+    "  -x M -y M        tag position [m] (default 10 -15)\n"
+    "  -g N             solver test on N random geometries (no chips)\n"
+    "  -d DIM           solver test dimension 2 or 3 (default 2)\n"
+    "  -e M             solver test distance noise RMS [m] (default 0.3)\n"
+    "  --div N          frequency diversity: N channels of 10 MHz (default 0)\n"
+    "  --fsel P         frequency selective multipath probability (default 0)\n"
+    "  --seed N         random seed (default 1)\n", POS_ANCHORS);
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  psim_opt_t opt = { 60, 200, 4, 6, 1625, 4, 50., 10., -15., 0, 2, 0.3,
+                     0, 0., 1 };
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { psim_usage(); return 0; }
+    if (v == NULL) { psim_usage(); return 1; }
+    i++;
+
+    if      (!strcmp(a, "-t")) opt.time   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-p")) opt.period = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-n")) opt.count  = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-s")) opt.sf     = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-b")) opt.bw     = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-k")) opt.k      = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-R")) opt.r      = strtod(v, NULL);
+    else if (!strcmp(a, "-x")) opt.x      = strtod(v, NULL);
+    else if (!strcmp(a, "-y")) opt.y      = strtod(v, NULL);
+    else if (!strcmp(a, "-g")) opt.g      = (uint32_t) strtoul(v, NULL, 10);
+    else if (!strcmp(a, "-d")) opt.dim    = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-e")) opt.e      = strtod(v, NULL);
+    else if (!strcmp(a, "--div"))  opt.div  = (uint8_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "--fsel")) opt.fsel = strtod(v, NULL);
+    else if (!strcmp(a, "--seed")) opt.seed = (uint32_t) strtoul(v, NULL, 10);
+    else { psim_usage(); return 1; }
+  }
+
+  if (opt.time == 0 || opt.period == 0 || opt.count < 1 ||
+      opt.count > RANGE_SAMPLES || opt.k < 3 || opt.k > POS_ANCHORS ||
+      (opt.dim != 2 && opt.dim != 3) || opt.div > RDIV_CHANNELS)
+  { psim_usage(); return 1; }
+
+  if (opt.g)
+  {
+    printf("# Solver %uD K=%u geometries=%lu box=%.0fm noise=%.2fm seed=%u\n",
+           opt.dim, opt.k, (unsigned long) opt.g, 2. * opt.r, opt.e,
+           opt.seed);
+    return psim_solver(&opt) != 0;
+  }
+
+  range_init(&Range);
+  Range.count = opt.count;
+
+  printf("# Positioning SF%u BW%ukHz K=%u R=%.0fm N=%u period=%ums time=%us "
+         "tag=(%.1f,%.1f)m div=%u fsel=%.2f seed=%u\n", opt.sf, opt.bw, opt.k,
+         opt.r, opt.count, opt.period, opt.time, opt.x, opt.y, opt.div,
+         opt.fsel, opt.seed);
+  return psim_run(&opt) != 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "pos_sim.cpp" file ***/
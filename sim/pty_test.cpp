@@ -0,0 +1,448 @@
+/*
+ * Capture stream end-to-end over pseudo terminal (host build)
+ * File: "pty_test.cpp"
+ *
+ * Emulated chips (AFsm TX node with random payload size and RX node)
+ * receive packets by RX ring to "capture.cpp" subscriber; binary frames
+ * mixed with deferred console log of "print.cpp" go to master of pty,
+ * scripts/cap2pcapng.py reads slave of pty (like USB-CDC tty) and writes
+ * pcapng file. Output is parsed as pcapng (SHB, IDB with LINKTYPE_USER0
+ * and microsecond resolution, EPB): every received packet must come as
+ * one EPB with the same record, in order, and timestamp must be RxDone
+ * time over 32-bit wrap (--device-time). Exit code 1 if any check fails.
+ *
+ * Usage: pty_test [cap2pcapng.py [python3]]
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>     // printf(), snprintf(), fopen()
+#include <stdlib.h>    // rand(), srand()
+#include <string.h>    // memset(), memcpy()
+#include <unistd.h>    // fork(), execlp(), write(), usleep()
+#include <fcntl.h>     // open()
+#include <signal.h>    // kill()
+#include <poll.h>      // poll()
+#include <termios.h>   // cfmakeraw(), tcsetattr()
+#include <pty.h>       // openpty()
+#include <sys/ioctl.h> // ioctl(FIONREAD)
+#include <sys/wait.h>  // waitpid()
+#include <string>
+#include <vector>
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+#include "rx_ring.h"
+#include "capture.h"
+#include "print.h"
+#include "Arduino.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build test with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define PT_STEP_US  100   // main loop step [us]
+#define PT_PERIOD   20    // TX period [ms]
+#define PT_TIME     20    // run time [s]
+#define PT_ROOM     256   // UART/USB-CDC TX room [bytes]
+#define PT_TIMEOUT  10000 // converter timeout [ms]
+#define PT_T0       (0x100000000ull - 5000000ull) // 5 s before wrap [us]
+#define PT_LINKTYPE 147   // LINKTYPE_USER0
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM)
+typedef struct pt_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  ABlink        led;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+} pt_node_t;
+//-----------------------------------------------------------------------------
+// expected capture record
+typedef struct pt_rec_ {
+  std::string rec; // record (without sync, length and CRC)
+  uint64_t    us;  // RxDone time (64 bit) [us]
+} pt_rec_t;
+//-----------------------------------------------------------------------------
+static chan_t                Chan;
+static pt_node_t             Node[2]; // TX, RX
+static pt_node_t            *Cur;     // node in FSM callback context
+static rx_ring_t             Ring;
+static std::vector<pt_rec_t> Rec;     // expected records
+static int                   Master = -1; // master of pty
+static uint32_t              Bytes;   // written to pty [bytes]
+static pid_t                 Pid = -1;    // converter process
+static int                   Status = -1; // converter exit status
+
+HardwareSerial Serial;
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock and serial port by master of pty
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+
+int HardwareSerial::availableForWrite() { return PT_ROOM; }
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size)
+{ // write while converter reads other end (discard if it is gone)
+  struct pollfd pfd;
+  size_t n = 0;
+  int ms = 0;
+
+  pfd.fd     = Master;
+  pfd.events = POLLOUT;
+  while (n < size && Status == -1)
+  {
+    ssize_t r;
+    if (poll(&pfd, 1, 10) <= 0)
+    {
+      if (waitpid(Pid, &Status, WNOHANG) != Pid && (ms += 10) < PT_TIMEOUT)
+        continue;
+      if (Status == -1) Status = 0x7F00; // stalled => failed
+      break;
+    }
+    r = ::write(Master, buf + n, size - n);
+    if (r <= 0) break;
+    n += (size_t) r;
+    ms = 0;
+  }
+  Bytes += (uint32_t) n;
+  return size;
+}
+
+size_t HardwareSerial::print(const char *str) { return write((const uint8_t*) str, strlen(str)); }
+size_t HardwareSerial::print(char c) { return write((const uint8_t*) &c, 1); }
+void HardwareSerial::flush() {}
+//-----------------------------------------------------------------------------
+// FSM event callback: random payload for next packet
+static void pt_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  pt_node_t *n = Cur;
+  int i;
+
+  if (ev == AFSM_EV_PERIOD && n->fsm.mode() == AFSM_TX)
+  { // packet will be sent after wakeup (sync bytes inside payload)
+    n->data_size = (uint8_t) (1 + rand() % 200);
+    for (i = 0; i < n->data_size; i++)
+      n->data[i] = (uint8_t) (rand() % 3 ? rand() : (i & 1 ? 0x5A : 0xA5));
+  }
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (like sx128x_irq()): received packet to RX ring
+static void pt_irq(pt_node_t *n)
+{
+  unsigned long t = TIME_FUNC();
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_TX_DONE)
+  {
+    n->fsm.tx_done_dt(t);
+    n->fsm.tx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_DONE)
+  {
+    rx_pkt_t *pkt = rx_ring_alloc(&Ring);
+    n->fsm.rx_done_dt(t);
+    pkt->t    = t;
+    pkt->ts   = 0;
+    pkt->mode = sx128x_get_mode(&n->radio);
+    if (sx128x_get_recv(&n->radio, irq, sizeof(pkt->data), &pkt->rx,
+                        pkt->data, &pkt->size) == SX128X_ERR_NONE)
+    {
+      uint8_t frame[CAPTURE_FRAME_MAX];
+      uint16_t len = capture_pack(pkt, frame);
+      pt_rec_t r;
+      r.rec = std::string((const char*) frame + 4, len - 5);
+      r.us  = vclock_now();
+      Rec.push_back(r);
+      rx_ring_push(&Ring);
+    }
+    n->fsm.rx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT)
+    n->fsm.rxtx_timeout();
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - TX, 1 - RX)
+static int pt_node_init(pt_node_t *n, int id)
+{
+  int8_t retv;
+
+  emu_init(&n->emu, &Chan, id, id ? 10. : 0., 0.);
+  chan_add(&Chan, &n->emu);
+
+  n->pars              = sx128x_pars_default;
+  n->pars.mode         = SX128X_LORA;
+  n->pars.fixed        = 0; // variable size (explicit header)
+  n->pars.payload_size = 255;
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = id ? AFSM_RX : AFSM_TX;
+  n->fsm_pars.t    = PT_PERIOD;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data_size  = 16;
+  n->tx_timeout = 0;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, pt_callback);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// start converter on slave of pty (return pid or -1)
+static pid_t pt_convert(const char *python, const char *script,
+                        const char *tty, const char *out)
+{
+  pid_t pid = fork();
+  if (pid == 0)
+  { // child: console output of converter is not needed
+    int fd = open("/dev/null", O_WRONLY);
+    if (fd >= 0) dup2(fd, 1);
+    close(Master);
+    execlp(python, python, script, tty, out, "--device-time", (char*) NULL);
+    perror(python);
+    _exit(127);
+  }
+  return pid;
+}
+//-----------------------------------------------------------------------------
+static uint32_t pt_u32(const std::string &s, size_t pos)
+{
+  const uint8_t *p = (const uint8_t*) s.data() + pos;
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+// read file
+static std::string pt_read(const char *name)
+{
+  std::string s;
+  char buf[4096];
+  size_t n;
+  FILE *f = fopen(name, "rb");
+  if (!f) return s;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+  fclose(f);
+  return s;
+}
+//-----------------------------------------------------------------------------
+// count EPB in pcapng file (stops at incomplete block)
+static uint32_t pt_count(const std::string &s)
+{
+  uint32_t cnt = 0;
+  size_t pos = 0;
+  while (pos + 12 <= s.size())
+  {
+    uint32_t type = pt_u32(s, pos), size = pt_u32(s, pos + 4);
+    if (size < 12 || pos + size > s.size()) break;
+    if (type == 6) cnt++;
+    pos += size;
+  }
+  return cnt;
+}
+//-----------------------------------------------------------------------------
+// check pcapng file against expected records: return number of failed
+// checks, count EPB, wrong records and timestamps
+static unsigned pt_check(const std::string &s, uint32_t *epb,
+                         uint32_t *wrong, uint32_t *ts_err)
+{
+  unsigned bad = 0;
+  uint64_t base = 0;
+  size_t pos = 0;
+  uint8_t shb = 0, idb = 0;
+
+  *epb = *wrong = *ts_err = 0;
+  if (Rec.size())
+    base = Rec[0].us - (uint32_t) Rec[0].us; // converter unwraps from 0
+
+  while (pos + 12 <= s.size())
+  {
+    uint32_t type = pt_u32(s, pos), size = pt_u32(s, pos + 4);
+    if (size < 12 || size % 4 || pos + size > s.size() ||
+        pt_u32(s, pos + size - 4) != size)
+    {
+      bad++; // broken block
+      break;
+    }
+
+    if (type == 0x0A0D0D0A)
+    { // Section Header Block
+      if (pos != 0 || pt_u32(s, pos + 8) != 0x1A2B3C4D) bad++;
+      shb++;
+    }
+    else if (type == 1)
+    { // Interface Description Block: LINKTYPE_USER0, if_tsresol = 6
+      if (!shb || (pt_u32(s, pos + 8) & 0xFFFF) != PT_LINKTYPE ||
+          (pt_u32(s, pos + 16) & 0xFFFF) != 9 ||
+          (uint8_t) s[pos + 20] != 6)
+        bad++;
+      idb++;
+    }
+    else if (type == 6)
+    { // Enhanced Packet Block: record and RxDone time [us]
+      uint64_t ts = ((uint64_t) pt_u32(s, pos + 12) << 32) |
+                    pt_u32(s, pos + 16);
+      uint32_t len = pt_u32(s, pos + 20);
+      if (!idb || pt_u32(s, pos + 8) != 0 || pt_u32(s, pos + 24) != len ||
+          28 + len + 4 > size)
+        bad++;
+      else if (*epb >= Rec.size() || s.compare(pos + 28, len, Rec[*epb].rec))
+        (*wrong)++;
+      else if (ts != Rec[*epb].us - base)
+        (*ts_err)++;
+      (*epb)++;
+    }
+    pos += size;
+  }
+
+  if (shb != 1 || idb != 1 || pos != s.size()) bad++;
+  if (*epb != Rec.size() || *wrong || *ts_err) bad++;
+  return bad;
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  const char *script = argc > 1 ? argv[1] : "../scripts/cap2pcapng.py";
+  const char *python = argc > 2 ? argv[2] : "python3";
+  uint64_t end = PT_T0 + (uint64_t) PT_TIME * 1000000ull;
+  uint32_t epb = 0, wrong = 0, ts_err = 0, wraps = 0, lines = 0, ms;
+  unsigned long t_prev;
+  unsigned bad = 0;
+  char tty[64], out[64];
+  struct termios tio;
+  int slave, i, avail;
+  std::string s;
+
+  // pty in raw mode (binary stream like USB-CDC)
+  if (openpty(&Master, &slave, tty, NULL, NULL) < 0)
+  {
+    perror("openpty");
+    return 1;
+  }
+  tcgetattr(slave, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(slave, TCSANOW, &tio);
+
+  snprintf(out, sizeof(out), "/tmp/pty_test_%d.pcapng", (int) getpid());
+  Pid = pt_convert(python, script, tty, out);
+  if (Pid < 0)
+  {
+    perror("fork");
+    return 1;
+  }
+
+  srand(1);
+  vclock_reset(PT_T0);
+  chan_init(&Chan, &chan_pars_default);
+  rx_ring_init(&Ring);
+  rx_ring_subscribe(&Ring, capture_cb, NULL, "capture");
+  capture_enable(1);
+  print_log_wait(0);
+
+  for (i = 0; i < 2; i++)
+    if (pt_node_init(&Node[i], i) != SX128X_ERR_NONE)
+    {
+      printf("# FAIL: sx128x_init() node %i\n", i);
+      kill(Pid, SIGKILL);
+      return 1;
+    }
+
+  Node[1].fsm.start(); // RX
+  Node[0].fsm.start(); // TX
+  t_prev = TIME_FUNC();
+
+  while (vclock_now() < end)
+  {
+    unsigned long t = TIME_FUNC();
+    if (t < t_prev) wraps++;
+    t_prev = t;
+
+    for (i = 0; i < 2; i++)
+    {
+      pt_node_t *n = Cur = &Node[i];
+      n->fsm.yield(TIME_FUNC());
+      if (emu_dio1(&n->emu)) pt_irq(n);
+    }
+
+    // main loop (like loop() in sketch): console log between frames
+    if (rand() % 50 == 0)
+    {
+      print_str("loop t=");
+      print_uint(t);
+      print_str(" rx=");
+      print_uint((unsigned long) Rec.size());
+      print_eol();
+      lines++;
+    }
+    rx_ring_yield(&Ring);
+    capture_yield();
+    print_yield();
+    vclock_step(PT_STEP_US);
+  }
+  while (rx_ring_pending(&Ring, 0))
+  {
+    rx_ring_yield(&Ring);
+    capture_flush();
+  }
+  print_log_wait(1);
+  print_flush();
+
+  // wait converter: all bytes read from tty and all packets written
+  for (ms = 0; ms < PT_TIMEOUT && Status == -1; ms += 10)
+  {
+    if (ioctl(slave, FIONREAD, &avail) == 0 && avail == 0 &&
+        pt_count(pt_read(out)) >= Rec.size())
+      break;
+    if (waitpid(Pid, &Status, WNOHANG) == Pid) break; // converter failed
+    usleep(10000);
+  }
+
+  // stop converter (Ctrl+C)
+  if (Status == -1 || Status == 0x7F00)
+  {
+    kill(Pid, SIGINT);
+    waitpid(Pid, Status == -1 ? &Status : NULL, 0);
+  }
+  if (!WIFEXITED(Status) || WEXITSTATUS(Status) != 0) bad++;
+
+  s = pt_read(out);
+  bad += pt_check(s, &epb, &wrong, &ts_err);
+  if (wraps != 1 || ms >= PT_TIMEOUT || Ring.drops) bad++;
+
+  printf("# period=%ums time=%us t0=0x%llX (5 s before wrap) room=%u\n",
+         (unsigned) PT_PERIOD, (unsigned) PT_TIME,
+         (unsigned long long) PT_T0, (unsigned) PT_ROOM);
+  printf("# packets   epb  wrong  ts_err  lines   stream  pcapng  wraps  exit   bad\n");
+  printf("%9u %5u %6u %7u %6u %8u %7u %6u %5d %5u\n",
+         (unsigned) Rec.size(), (unsigned) epb, (unsigned) wrong,
+         (unsigned) ts_err, (unsigned) lines, (unsigned) Bytes,
+         (unsigned) s.size(), (unsigned) wraps,
+         WIFEXITED(Status) ? WEXITSTATUS(Status) : -1, bad);
+
+  unlink(out);
+  close(slave);
+  close(Master);
+  if (bad) printf("# FAIL: %u checks\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "pty_test.cpp" file ***/
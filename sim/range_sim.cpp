@@ -0,0 +1,436 @@
+/*
+ * Multi-sample ranging simulator and replay tool (host build, virtual time)
+ * File: "range_sim.cpp"
+ *
+ * Ranging master (AFsm RM with "range.c" session) and slave (AFsm RS) on
+ * emulated chips at given distance: exchanges per second and accuracy of
+ * raw samples, median, trimmed mean and Kalman filter. Sample sets may be
+ * saved (-o) and replayed (-r) through the same filters. With --cal the
+ * first sessions run the calibration routine at known distance (as
+ * "range cal" command does) and statistic is accounted after it. With
+ * --div both nodes hop through diversity channels per exchange and
+ * "channels" row is median of per-channel medians (use with --fsel to
+ * model frequency selective multipath).
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), fprintf(), fopen()
+#include <stdlib.h> // strtol(), strtod()
+#include <string.h> // strcmp(), memset()
+#include <math.h>   // sqrt(), fabs()
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "range.h"
+#include "rdiv.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build simulator with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define RSIM_STEP_US 20 // main loop step (IRQ polling resolution) [us]
+//-----------------------------------------------------------------------------
+// filters to compare
+typedef enum {
+  RSIM_RAW = 0, // every sample
+  RSIM_MEDIAN,  // session median
+  RSIM_TRIMMED, // session trimmed mean
+  RSIM_KALMAN,  // Kalman filter at session end
+  RSIM_CHANNELS,// median of per-channel medians
+  RSIM_FILTERS
+} rsim_filter_t;
+
+static const char * const rsim_filter_name[RSIM_FILTERS] = {
+  "raw", "median", "trimmed", "kalman", "channels" };
+//-----------------------------------------------------------------------------
+// simulation options
+typedef struct rsim_opt_ {
+  uint32_t time;   // simulation time [s]
+  uint32_t period; // session period [ms]
+  uint8_t  count;  // exchanges in session
+  uint8_t  sf;     // LoRa SF (5...10)
+  uint32_t bw;     // LoRa BW [kHz]
+  double   dist;   // distance between nodes [m]
+  double   cal;    // calibrate at known distance [m] (0 - no)
+  uint8_t  div;    // diversity channels (0 - off)
+  double   fsel;   // frequency selective multipath probability
+  uint32_t seed;   // random seed
+  const char *out; // save samples to CSV file or NULL
+  const char *in;  // replay samples from CSV file or NULL
+} rsim_opt_t;
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM)
+typedef struct rsim_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  rdiv_t        div;
+  ABlink        led;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  uint32_t      errors; // FSM action errors
+} rsim_node_t;
+//-----------------------------------------------------------------------------
+// error statistic of one filter [cm]
+typedef struct rsim_err_ {
+  uint32_t n;
+  double   sum, sum2, max;
+} rsim_err_t;
+//-----------------------------------------------------------------------------
+static chan_t       Chan;  // RF channel (big, static)
+static range_t      Range; // ranging session of master
+static range_cal_t  Cal;   // calibration routine of master
+static rsim_node_t *Cur;   // node in FSM callback context
+static rsim_err_t   Err[RSIM_FILTERS];
+static FILE        *Out;   // samples CSV or NULL
+static uint32_t     Lost, Rate;
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+static void rsim_err_add(rsim_filter_t f, double e)
+{
+  rsim_err_t *s = &Err[f];
+  s->n++;
+  s->sum  += e;
+  s->sum2 += e * e;
+  if (fabs(e) > s->max) s->max = fabs(e);
+}
+//-----------------------------------------------------------------------------
+// account finished session against true distance [cm]
+static void rsim_session(double d)
+{
+  uint8_t i;
+  Range.ready = 0;
+  Lost += Range.lost;
+  Rate += Range.rate;
+  for (i = 0; i < Range.n; i++)
+    rsim_err_add(RSIM_RAW, Range.s[i].d - d);
+  if (Range.samples == 0) return;
+  rsim_err_add(RSIM_MEDIAN,  Range.median  - d);
+  rsim_err_add(RSIM_TRIMMED, Range.trimmed - d);
+  rsim_err_add(RSIM_KALMAN,  Range.kalman  - d);
+  rsim_err_add(RSIM_CHANNELS,
+               (Range.chans > 1 ? Range.chmed : Range.median) - d);
+}
+//-----------------------------------------------------------------------------
+// calibration step by finished session (table cell of master pars is
+// applied by next wakeup)
+static void rsim_cal(sx128x_pars_t *pars)
+{
+  uint8_t step = Cal.step;
+  uint32_t c = range_cal_step(&Cal, Range.median);
+  Range.ready = 0;
+  Lost += Range.lost;
+  Rate += Range.rate;
+  *sx128x_ranging_calib_cell(pars, pars->bw, pars->sf) = (uint16_t) c;
+  range_kf_reset(&Range);
+  printf("# cal step=%u median=%.1fm next=%lu\n", (unsigned) step,
+         Range.median / 100., (unsigned long) c);
+  if (Cal.step == RANGE_CAL_DONE)
+    printf("# cal done: calib=%ld err=%.1fm\n", (long) Cal.c, Cal.err / 100.);
+  else if (Cal.step == RANGE_CAL_FAIL)
+    printf("# cal fail: no slope\n");
+}
+//-----------------------------------------------------------------------------
+// FSM event callback
+static void rsim_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  if (err != SX128X_ERR_NONE) Cur->errors++;
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (ranging part of sx128x_irq(), master and slave)
+static void rsim_irq(rsim_node_t *n, double d)
+{
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_MASTER_RESULT_VALID)
+  {
+    uint8_t  filter = 0, rssi;
+    uint32_t raw;
+    int32_t  cm;
+    if (sx128x_ranging_result(&n->radio, &filter, &raw, &cm, &rssi) ==
+        SX128X_ERR_NONE)
+    {
+      if (Out != NULL && Range.active)
+        fprintf(Out, "%lu,%.0f,%ld,%u,%u\n", (unsigned long) Range.sessions,
+                d, (long) cm, (unsigned) rssi, (unsigned) Range.ch);
+      range_add(&Range, raw, cm, rssi);
+    }
+    n->fsm.ranging_done();
+  }
+
+  if (irq & SX128X_IRQ_MASTER_TIMEOUT)
+    n->fsm.rxtx_timeout();
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT) // slave RX window
+    n->fsm.rxtx_timeout();
+
+  if (irq & SX128X_IRQ_SLAVE_RESPONSE_DONE)
+    n->fsm.ranging_done();
+
+  if (irq & SX128X_IRQ_SLAVE_REQUEST_DISCARD)
+    n->fsm.ranging_listen();
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - slave, 1 - master)
+static int rsim_node_init(rsim_node_t *n, int id, const rsim_opt_t *opt)
+{
+  int8_t retv;
+
+  emu_init(&n->emu, &Chan, id, id ? opt->dist : 0., 0.);
+  chan_add(&Chan, &n->emu);
+
+  n->pars      = sx128x_pars_default;
+  n->pars.mode = SX128X_RANGING;
+  n->pars.sf   = opt->sf;
+  n->pars.bw   = opt->bw;
+  n->pars.role = id ? 0x01 : 0x00;
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = id ? AFSM_RM : AFSM_RS;
+  n->fsm_pars.t    = opt->period;
+  n->fsm_pars.wut  = 1;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data_size  = 4;
+  n->tx_timeout = 0;
+  n->errors     = 0;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, rsim_callback);
+  if (id) n->fsm.ranger(&Range);
+
+  rdiv_init(&n->div);
+  if (opt->div)
+  {
+    rdiv_plan(&n->div, RDIV_FREQ_MIN,
+              RDIV_FREQ_MIN + (uint32_t) (opt->div - 1) * RDIV_STEP, RDIV_STEP);
+    n->div.on = 1;
+    n->fsm.diversity(&n->div);
+  }
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// simulate sessions on emulated chips
+static int rsim_run(const rsim_opt_t *opt)
+{
+  static rsim_node_t node[2];
+  uint64_t end = (uint64_t) opt->time * 1000000ull;
+  rsim_node_t *rm = &node[1], *rs = &node[0];
+  double d = opt->dist * 100.; // [cm]
+  int i;
+
+  vclock_reset(0);
+  chan_pars_t cp = chan_pars_default;
+  cp.seed = opt->seed;
+  cp.fsel = opt->fsel;
+  chan_init(&Chan, &cp);
+
+  for (i = 0; i < 2; i++)
+  {
+    if (rsim_node_init(&node[i], i, opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail (node %i)\n", i);
+      return -1;
+    }
+  }
+
+  if (opt->cal > 0.)
+    range_cal_begin(&Cal, (int32_t) (opt->cal * 100. + 0.5),
+                    sx128x_ranging_calib_value(&node[1].pars));
+
+  // slave listens first, master starts after 1 ms
+  Cur = rs;
+  rs->fsm.start();
+
+  while (vclock_now() < end)
+  {
+    if (vclock_ms() >= 1 && !rm->fsm.run() && Range.sessions == 0)
+    {
+      Cur = rm;
+      rm->fsm.start();
+    }
+
+    for (i = 0; i < 2; i++)
+    {
+      rsim_node_t *n = Cur = &node[i];
+      n->fsm.yield(TIME_FUNC());
+      if (emu_dio1(&n->emu)) rsim_irq(n, d);
+    }
+    if (Range.ready && Cal.step > RANGE_CAL_OFF && Cal.step < RANGE_CAL_DONE)
+      rsim_cal(&rm->pars);
+    if (Range.ready) rsim_session(d);
+    vclock_step(RSIM_STEP_US);
+  }
+
+  if (rm->errors + rs->errors)
+    printf("# FSM errors: %u\n", rm->errors + rs->errors);
+  if (opt->div)
+    printf("# diversity: channels=%u master hops=%lu slave hops=%lu "
+           "parks=%lu\n", (unsigned) rm->div.n, (unsigned long) rm->div.hops,
+           (unsigned long) rs->div.hops, (unsigned long) rs->div.parks);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// replay CSV samples "session,true_cm,d_cm[,rssi[,ch]]" by sessions
+static int rsim_replay(const rsim_opt_t *opt)
+{
+  FILE *f = fopen(opt->in, "r");
+  char line[128];
+  long ses = -1;
+  double d = 0.;
+
+  if (f == NULL)
+  {
+    fprintf(stderr, "error: can't open '%s'\n", opt->in);
+    return -1;
+  }
+
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    char *p = line;
+    long s, cm;
+    double t;
+    unsigned rssi, ch;
+
+    if (*p == '#' || *p == '\n' || *p == '\r') continue;
+    s    = strtol(p, &p, 10); if (*p == ',') p++;
+    t    = strtod(p, &p);     if (*p == ',') p++;
+    cm   = strtol(p, &p, 10); if (*p == ',') p++;
+    rssi = (unsigned) strtoul(p, &p, 10); if (*p == ',') p++;
+    ch   = (unsigned) strtoul(p, &p, 10);
+
+    if (s != ses)
+    { // next session
+      if (ses >= 0)
+      {
+        Range.tries = Range.n; // no timeouts in file
+        range_end(&Range, 0);
+        rsim_session(d);
+      }
+      range_begin(&Range, 0);
+      ses = s;
+      d   = t;
+    }
+    Range.ch = (uint8_t) ch;
+    range_add(&Range, 0, (int32_t) cm, (uint8_t) rssi);
+  }
+  if (ses >= 0)
+  {
+    Range.tries = Range.n;
+    range_end(&Range, 0);
+    rsim_session(d);
+  }
+
+  fclose(f);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void rsim_usage()
+{
+  printf(
+    "Usage: range_sim [options]\n"
+    "  -t SEC           simulation time [s] (default 60)\n"
+    "  -p MS            session period [ms] (default 200)\n"
+    "  -n N             exchanges in session 2...64 (default 16)\n"
+    "  -s SF            LoRa SF 5...10 (default 6)\n"
+    "  -b KHZ           LoRa BW 406, 812, 1625 kHz (default 1625)\n"
+    "  -a M             distance between nodes [m] (default 100)\n"
+    "  -o FILE          save samples to CSV (session,true_cm,d_cm,rssi,ch)\n"
+    "  -r FILE          replay samples from CSV (no simulation)\n"
+    "  --cal M          calibrate at known distance [m] before statistic\n"
+    "  --div N          frequency diversity: N channels of 10 MHz (default 0)\n"
+    "  --fsel P         frequency selective multipath probability (default 0)\n"
+    "  --seed N         random seed (default 1)\n");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  rsim_opt_t opt = { 60, 200, 16, 6, 1625, 100., 0., 0, 0., 1, NULL, NULL };
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { rsim_usage(); return 0; }
+    if (v == NULL) { rsim_usage(); return 1; }
+    i++;
+
+    if      (!strcmp(a, "-t")) opt.time   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-p")) opt.period = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-n")) opt.count  = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-s")) opt.sf     = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-b")) opt.bw     = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-a")) opt.dist   = strtod(v, NULL);
+    else if (!strcmp(a, "-o")) opt.out    = v;
+    else if (!strcmp(a, "-r")) opt.in     = v;
+    else if (!strcmp(a, "--cal"))  opt.cal  = strtod(v, NULL);
+    else if (!strcmp(a, "--div"))  opt.div  = (uint8_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "--fsel")) opt.fsel = strtod(v, NULL);
+    else if (!strcmp(a, "--seed")) opt.seed = (uint32_t) strtoul(v, NULL, 10);
+    else { rsim_usage(); return 1; }
+  }
+
+  if (opt.time == 0 || opt.period == 0 || opt.count < 2 ||
+      opt.count > RANGE_SAMPLES || opt.div > RDIV_CHANNELS)
+  { rsim_usage(); return 1; }
+
+  range_init(&Range);
+  Range.count = opt.count;
+
+  if (opt.in != NULL)
+  {
+    printf("# replay '%s'\n", opt.in);
+    if (rsim_replay(&opt) != 0) return 1;
+  }
+  else
+  {
+    if (opt.out != NULL && (Out = fopen(opt.out, "w")) == NULL)
+    {
+      fprintf(stderr, "error: can't create '%s'\n", opt.out);
+      return 1;
+    }
+    printf("# Ranging SF%u BW%ukHz N=%u period=%ums time=%us dist=%.1fm "
+           "div=%u fsel=%.2f seed=%u\n", opt.sf, opt.bw, opt.count,
+           opt.period, opt.time, opt.dist, opt.div, opt.fsel, opt.seed);
+    if (rsim_run(&opt) != 0) return 1;
+    if (Out != NULL) fclose(Out);
+  }
+
+  printf("# sessions=%lu lost=%lu rate=%lu/s\n",
+         (unsigned long) Range.sessions, (unsigned long) Lost,
+         (unsigned long) (Range.sessions ? Rate / Range.sessions : 0));
+  printf("# filter      n  bias[m]   rms[m]   max[m]\n");
+  for (i = 0; i < RSIM_FILTERS; i++)
+  {
+    const rsim_err_t *s = &Err[i];
+    double m = s->n ? s->sum / s->n : 0.;
+    printf("%-8s %6u %8.2f %8.2f %8.2f\n", rsim_filter_name[i], s->n,
+           m / 100., s->n ? sqrt(s->sum2 / s->n) / 100. : 0., s->max / 100.);
+  }
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "range_sim.cpp" file ***/
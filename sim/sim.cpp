@@ -0,0 +1,354 @@
+/*
+ * Multi-node SX1280 network simulator (host build, virtual time)
+ * File: "sim.cpp"
+ *
+ * N-1 periodic transmitters (AFsm TX mode) and one sink (AFsm RX mode)
+ * share one RF channel; real driver and FSM code run on emulated chips.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), fprintf()
+#include <stdlib.h> // strtol(), strtod()
+#include <string.h> // strcmp(), memset()
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "lat.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build simulator with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define SIM_STEP_US 1000 // main loop step (FSM timers resolution) [us]
+#define SIM_HDR     10   // packet header: id(2) + seq(4) + time(4) [bytes]
+#define SIM_NMAX    16   // maximal number of N in list
+//-----------------------------------------------------------------------------
+// simulation options
+typedef struct sim_opt_ {
+  int      n[SIM_NMAX]; // number of nodes (with sink)
+  int      nn;          // size of n[] list
+  uint32_t time;        // simulation time [s]
+  uint32_t period;      // TX period [ms]
+  uint8_t  mode;        // SX128X_LORA, SX128X_FLRC, SX128X_GFSK
+  uint8_t  sf;          // LoRa SF
+  uint16_t bw;          // LoRa BW [kHz]
+  uint8_t  size;        // payload size [bytes]
+  int8_t   power;       // TX power [dBm]
+  double   area;        // area side [m]
+  uint32_t seed;        // random seed
+} sim_opt_t;
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM)
+typedef struct sim_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  ABlink        led;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  unsigned long start_ms;   // FSM start time [ms]
+  uint8_t       started;
+  uint32_t      seq;        // next sequence number
+  uint32_t      sent;       // TxDone counter
+  uint32_t      errors;     // FSM action errors
+} sim_node_t;
+//-----------------------------------------------------------------------------
+// sink statistic
+typedef struct sim_res_ {
+  uint32_t   ok;     // received packets
+  uint32_t   bad;    // CRC errors
+  uint64_t   bytes;  // received payload [bytes]
+  lat_hist_t lat;    // period start -> RxDone latency [us]
+} sim_res_t;
+//-----------------------------------------------------------------------------
+static chan_t      Chan;     // RF channel (big, static)
+static sim_node_t *Cur;      // node in FSM callback context
+static sim_res_t   Res;      // sink statistic
+static uint32_t    Rnd = 1;  // xorshift32 state
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+// uniform random value 0...1
+static double sim_rand()
+{
+  Rnd ^= Rnd << 13; Rnd ^= Rnd >> 17; Rnd ^= Rnd << 5;
+  return (double) Rnd / 4294967296.0;
+}
+//-----------------------------------------------------------------------------
+static void sim_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+//-----------------------------------------------------------------------------
+static uint32_t sim_get32(const uint8_t *p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+// FSM event callback: stamp packet by period timer, count TxDone
+static void sim_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  sim_node_t *n = Cur;
+
+  if (err != SX128X_ERR_NONE) n->errors++;
+
+  if (ev == AFSM_EV_PERIOD && n->fsm.mode() == AFSM_TX)
+  { // packet will be sent after wakeup
+    n->data[0] = n->emu.id;
+    n->data[1] = n->emu.id >> 8;
+    sim_put32(n->data + 2, n->seq++);
+    sim_put32(n->data + 6, (uint32_t) t);
+  }
+  else if (ev == AFSM_EV_TX_DONE)
+    n->sent++;
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (like sx128x_irq())
+static void sim_irq(sim_node_t *n)
+{
+  unsigned long t = TIME_FUNC();
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_TX_DONE)
+  {
+    n->fsm.tx_done_dt(t);
+    n->fsm.tx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_DONE)
+  {
+    sx128x_rx_t rx;
+    uint8_t data[255], size = 0;
+
+    n->fsm.rx_done_dt(t);
+    if (sx128x_get_recv(&n->radio, irq, sizeof(data), &rx, data, &size) ==
+        SX128X_ERR_NONE)
+    {
+      if (!rx.crc_ok)
+        Res.bad++;
+      else if (size >= SIM_HDR)
+      {
+        Res.ok++;
+        Res.bytes += size;
+        lat_add(&Res.lat, (uint32_t) t - sim_get32(data + 6));
+      }
+    }
+    n->fsm.rx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT)
+    n->fsm.rxtx_timeout();
+
+  if ((irq & SX128X_IRQ_HEADER_ERROR) || (irq & SX128X_IRQ_CRC_ERROR))
+  { // see Errata 16.2 (as in sx128x_irq())
+    sx128x_rx(&n->radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_15_625US);
+  }
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - sink in center of area)
+static int sim_node_init(sim_node_t *n, int id, const sim_opt_t *opt)
+{
+  double x = 0., y = 0.;
+  int8_t retv;
+
+  if (id)
+  {
+    x = (sim_rand() - 0.5) * opt->area;
+    y = (sim_rand() - 0.5) * opt->area;
+  }
+  emu_init(&n->emu, &Chan, id, x, y);
+  chan_add(&Chan, &n->emu);
+
+  n->pars              = sx128x_pars_default;
+  n->pars.mode         = opt->mode;
+  n->pars.power        = opt->power;
+  n->pars.fixed        = 1;
+  n->pars.payload_size = opt->size;
+  n->pars.sf           = opt->sf;
+  n->pars.bw           = opt->bw;
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  // period +/-1% jitter (crystal tolerance), random start inside period
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = id ? AFSM_TX : AFSM_RX;
+  n->fsm_pars.t    = (uint32_t) (opt->period * (0.99 + 0.02 * sim_rand()));
+  n->start_ms      = id ? (unsigned long) (opt->period * sim_rand()) : 0;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data_size  = opt->size;
+  n->tx_timeout = 0;
+  n->started    = 0;
+  n->seq        = 0;
+  n->sent       = 0;
+  n->errors     = 0;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, sim_callback);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// run one simulation with `num` nodes, print result line
+static int sim_run(int num, const sim_opt_t *opt)
+{
+  sim_node_t *node = new sim_node_t[num];
+  uint64_t end = (uint64_t) opt->time * 1000000ull;
+  uint64_t air = 0;
+  uint32_t sent = 0, errors = 0;
+  double per, load, thr;
+  int i;
+
+  vclock_reset(0);
+  chan_pars_t cp = chan_pars_default;
+  cp.seed = opt->seed;
+  chan_init(&Chan, &cp);
+  memset((void*) &Res, 0, sizeof(Res));
+  lat_clear(&Res.lat);
+  Rnd = opt->seed ? opt->seed : 1;
+
+  for (i = 0; i < num; i++)
+  {
+    if (sim_node_init(&node[i], i, opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail (node %i)\n", i);
+      delete[] node;
+      return -1;
+    }
+  }
+
+  while (vclock_now() < end)
+  {
+    for (i = 0; i < num; i++)
+    {
+      sim_node_t *n = Cur = &node[i];
+      if (!n->started && vclock_ms() >= n->start_ms)
+      {
+        n->fsm.start();
+        n->started = 1;
+      }
+      n->fsm.yield(TIME_FUNC());
+      if (emu_dio1(&n->emu)) sim_irq(n);
+    }
+    vclock_step(SIM_STEP_US);
+  }
+
+  for (i = 1; i < num; i++)
+  {
+    sent   += node[i].sent;
+    air    += node[i].emu.tx_us;
+    errors += node[i].errors;
+  }
+  errors += node[0].errors;
+
+  per  = sent ? 100. * (1. - (double) Res.ok / sent) : 0.;
+  load = (double) air / end;
+  thr  = 8. * Res.bytes / opt->time;
+
+  printf("%4i %8u %8u %6.2f %6.3f %9.0f %8u %8u %7u %7u %7u %7u %4u\n",
+         num, sent, Res.ok, per, load, thr,
+         lat_percentile(&Res.lat, 500), lat_percentile(&Res.lat, 990),
+         Chan.stat.locked, Chan.stat.collision, Chan.stat.weak,
+         Chan.stat.missed, errors);
+
+  delete[] node;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void sim_usage()
+{
+  printf(
+    "Usage: sim [options]\n"
+    "  -n N1,N2,...     number of nodes with sink (default 2,4,8,16,32)\n"
+    "  -t SEC           simulation time [s] (default 300)\n"
+    "  -p MS            TX period [ms] (default 1000)\n"
+    "  -m lora|flrc|gfsk modem (default lora)\n"
+    "  -s SF            LoRa spreading factor 5...12 (default 7)\n"
+    "  -b BW            LoRa bandwidth 203|406|812|1625 kHz (default 812)\n"
+    "  -l SIZE          payload size 10...255 bytes (default 16)\n"
+    "  -P DBM           TX power -18...13 dBm (default 10)\n"
+    "  -a M             area side [m], sink in center (default 200)\n"
+    "  --seed N         random seed (default 1)\n");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  sim_opt_t opt = {
+    { 2, 4, 8, 16, 32 }, 5, // n[], nn
+    300, 1000,              // time, period
+    SX128X_LORA, 7, 812,    // mode, sf, bw
+    16, 10, 200., 1 };      // size, power, area, seed
+  int i;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { sim_usage(); return 0; }
+    if (v == NULL) { sim_usage(); return 1; }
+    i++;
+
+    if (!strcmp(a, "-n"))
+    {
+      char *p = (char*) v;
+      for (opt.nn = 0; opt.nn < SIM_NMAX && *p; )
+      {
+        long n = strtol(p, &p, 10);
+        if (n >= 2 && n <= CHAN_NODES) opt.n[opt.nn++] = (int) n;
+        if (*p == ',') p++; else break;
+      }
+    }
+    else if (!strcmp(a, "-t")) opt.time   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-p")) opt.period = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-s")) opt.sf     = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-b")) opt.bw     = (uint16_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-l")) opt.size   = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-P")) opt.power  = (int8_t)   strtol(v, NULL, 10);
+    else if (!strcmp(a, "-a")) opt.area   = strtod(v, NULL);
+    else if (!strcmp(a, "--seed")) opt.seed = (uint32_t) strtoul(v, NULL, 10);
+    else if (!strcmp(a, "-m"))
+    {
+      if      (!strcmp(v, "lora")) opt.mode = SX128X_LORA;
+      else if (!strcmp(v, "flrc")) opt.mode = SX128X_FLRC;
+      else if (!strcmp(v, "gfsk")) opt.mode = SX128X_GFSK;
+      else { sim_usage(); return 1; }
+    }
+    else { sim_usage(); return 1; }
+  }
+
+  if (opt.size < SIM_HDR) opt.size = SIM_HDR;
+  if (opt.nn == 0 || opt.time == 0 || opt.period == 0) { sim_usage(); return 1; }
+
+  printf("# mode=%s SF=%u BW=%ukHz size=%u period=%ums time=%us area=%.0fm "
+         "power=%idBm seed=%u\n",
+         opt.mode == SX128X_LORA ? "LoRa" : opt.mode == SX128X_FLRC ? "FLRC" : "GFSK",
+         opt.sf, opt.bw, opt.size, opt.period, opt.time, opt.area,
+         opt.power, opt.seed);
+  printf("#  N     sent       ok   PER%%   load    S,bit/s  p50[us]  p99[us]"
+         "  locked  collis    weak  missed  err\n");
+
+  for (i = 0; i < opt.nn; i++)
+    if (sim_run(opt.n[i], &opt) != 0) return 1;
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "sim.cpp" file ***/
@@ -0,0 +1,226 @@
+/*
+ * Link statistics test (host build)
+ * File: "stats_test.cpp"
+ *
+ * "stats.c" against plain reference: histogram of random values (bins,
+ * under/over, min/max, mean, percentiles by sorted values within one bin),
+ * SNR of received packets in quarter dB (mean of symmetric SNR around
+ * negative value must have no bias to 0), PER by 16-bit sequence
+ * counter of payload with random loss, duplicates and reordered packets
+ * over several counter wraps (PER must be dropped/sent of generator). Exit code 1 if any check fails.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf()
+#include <stdlib.h> // rand(), srand()
+#include <string.h> // memset(), memcmp()
+#include <math.h>   // fabs(), lround()
+#include <vector>
+#include <algorithm>
+#include "config.h"
+#include "stats.h"
+//-----------------------------------------------------------------------------
+static stats_t Stats;
+//-----------------------------------------------------------------------------
+// random histogram values: return number of failed checks
+static unsigned st_hist(int32_t min, int32_t step, int32_t lo, int32_t hi)
+{
+  stats_hist_t h;
+  std::vector<int32_t> v;
+  uint32_t bin[STATS_BINS], under = 0, over = 0;
+  int64_t sum = 0;
+  unsigned bad = 0, i, p;
+
+  stats_hist_init(&h, min, step);
+  memset((void*) bin, 0, sizeof(bin));
+  for (i = 0; i < 100000; i++)
+  {
+    int32_t x = lo + (int32_t) (rand() % (hi - lo + 1));
+    stats_hist_add(&h, x);
+    v.push_back(x);
+    sum += x;
+    if      (x < min)                             under++;
+    else if ((x - min) / step >= STATS_BINS)      over++;
+    else                                          bin[(x - min) / step]++;
+  }
+  std::sort(v.begin(), v.end());
+
+  if (h.cnt != v.size() || h.under != under || h.over != over ||
+      h.vmin != v.front() || h.vmax != v.back() ||
+      memcmp((const void*) h.bin, (const void*) bin, sizeof(bin)) ||
+      stats_hist_mean(&h) != (int32_t) lround((double) sum / v.size()))
+    bad++;
+
+  for (p = 0; p <= 100; p++)
+  { // value of rank must be in returned bin (or out of range)
+    size_t r = ((size_t) v.size() * p + 99) / 100;
+    int32_t x = v[r ? r - 1 : 0], y = stats_hist_percentile(&h, (uint8_t) p);
+    if (x < min || x >= min + step * STATS_BINS)
+    {
+      if (x < min && y != h.vmin) bad++;
+      if (x >= min + step * STATS_BINS && y != h.vmax) bad++;
+    }
+    else if ((x - min) / step != (y - min) / step)
+      bad++;
+  }
+
+  printf("hist   %7d %5d %7d..%-7d %6u %6u %6u %7d %7d %7d %5u\n",
+         (int) min, (int) step, (int) lo, (int) hi, (unsigned) h.cnt,
+         (unsigned) h.under, (unsigned) h.over,
+         (int) stats_hist_mean(&h), (int) stats_hist_percentile(&h, 50),
+         (int) stats_hist_percentile(&h, 90), bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// SNR around `snr4` [dB/4] +/-2 dB: return number of failed checks
+static unsigned st_snr(int snr4)
+{
+  rx_pkt_t pkt;
+  double mean = 0;
+  unsigned bad = 0, i, n = 100000;
+  int32_t p50;
+
+  memset((void*) &pkt, 0, sizeof(pkt));
+  stats_init(&Stats);
+  pkt.mode = 1; // LoRa
+  pkt.rx.crc_ok = 1;
+  pkt.rx.lora = 1;
+
+  for (i = 0; i < n; i++)
+  {
+    int s = snr4 + rand() % 17 - 8; // symmetric
+    int64_t sum = Stats.snr.sum;
+    uint32_t cnt = Stats.snr.bin[(s - STATS_SNR_MIN) / STATS_SNR_STEP];
+
+    pkt.rx.snr  = (int8_t) s;
+    pkt.rx.rssi = (uint8_t) (rand() % 256);
+    pkt.t += 1000;
+    stats_rx_cb(&pkt, &Stats);
+    mean += s / 4.;
+
+    // quarter dB value in 1 dB bin (no truncation to 0)
+    if (Stats.snr.sum - sum != s ||
+        Stats.snr.bin[(s - STATS_SNR_MIN) / STATS_SNR_STEP] != cnt + 1)
+      bad++;
+  }
+  mean /= n;
+
+  // mean without bias, median in bin of center
+  p50 = stats_hist_percentile(&Stats.snr, 50);
+  if (fabs(stats_hist_mean(&Stats.snr) / 4. - mean) > 0.125) bad++;
+  if ((p50 - STATS_SNR_MIN) / STATS_SNR_STEP !=
+      (snr4 - STATS_SNR_MIN) / STATS_SNR_STEP)
+    bad++;
+
+  printf("snr    %6.2f %7.3f %7.2f %7.2f %5u\n", snr4 / 4., mean,
+         stats_hist_mean(&Stats.snr) / 4., p50 / 4., bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// PER by 16-bit sequence counter from `seq0`: return number of failed checks
+// (reference is ground truth of generator: dropped / sent packets)
+static unsigned st_per(uint16_t seq0, unsigned loss, unsigned dups)
+{
+  rx_pkt_t pkt;
+  uint32_t dropped = 0, dup = 0, reord = 0, sent = 0;
+  uint16_t seq = seq0;
+  unsigned bad = 0, i;
+  int16_t per, exp;
+
+  memset((void*) &pkt, 0, sizeof(pkt));
+  stats_init(&Stats);
+  Stats.seq_offset = 2;
+  pkt.mode = 3; // FLRC
+  pkt.size = 8;
+  pkt.rx.crc_ok = 1;
+
+  for (i = 0; i < 200000; i++, seq++)
+  {
+    uint8_t swap = (unsigned) (rand() % 1000) < dups && i > 0;
+
+    sent++;
+    if (i > 0 && (unsigned) (rand() % 1000) < loss)
+    {
+      dropped++;
+      continue;
+    }
+    if (swap && (unsigned) (rand() % 1000) >= loss)
+    { // reorder: next packet before this one (both delivered)
+      uint16_t s[2] = { (uint16_t) (seq + 1), seq };
+      int k;
+      for (k = 0; k < 2; k++)
+      {
+        pkt.data[2] = (uint8_t) s[k];
+        pkt.data[3] = (uint8_t) (s[k] >> 8);
+        pkt.t += 1000;
+        stats_rx_cb(&pkt, &Stats);
+      }
+      reord++;
+      seq++;
+      sent++;
+      i++;
+      continue;
+    }
+    pkt.data[2] = (uint8_t) seq;
+    pkt.data[3] = (uint8_t) (seq >> 8);
+    pkt.t += 1000;
+    stats_rx_cb(&pkt, &Stats);
+    if (swap)
+    { // duplicate
+      pkt.t += 1000;
+      stats_rx_cb(&pkt, &Stats);
+      dup++;
+    }
+  }
+
+  // last packet (gaps before it are known)
+  pkt.data[2] = (uint8_t) seq;
+  pkt.data[3] = (uint8_t) (seq >> 8);
+  stats_rx_cb(&pkt, &Stats);
+  sent++;
+
+  per = stats_per(&Stats, 3);
+  exp = (int16_t) (((uint64_t) dropped * 1000 + sent / 2) / sent);
+  if (Stats.cnt[3].seq != sent - dropped || Stats.cnt[3].lost != dropped ||
+      Stats.cnt[3].dup != dup || Stats.cnt[3].reorder != reord ||
+      per != exp || Stats.seq_last != seq)
+    bad++;
+  if (stats_per(&Stats, 1) != -1) bad++; // no packets of mode
+
+  printf("per     0x%04X %4u.%u%% %7u %6u %6u %6u %4d.%d%% %5u\n",
+         (unsigned) seq0, loss / 10, loss % 10, (unsigned) sent,
+         (unsigned) Stats.cnt[3].lost, (unsigned) Stats.cnt[3].dup,
+         (unsigned) Stats.cnt[3].reorder, per / 10, per % 10, bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+int main()
+{
+  unsigned bad = 0;
+
+  srand(1);
+  printf("# STATS_BINS=%u\n", (unsigned) STATS_BINS);
+  printf("# test       min  step  values range     cnt  under   over    mean     p50     p90   bad\n");
+  bad += st_hist(STATS_RSSI_MIN, STATS_RSSI_STEP, -140, -10);
+  bad += st_hist(STATS_SNR_MIN,  STATS_SNR_STEP,  -80,   47);
+  bad += st_hist(STATS_FEI_MIN,  STATS_FEI_STEP,  -50000, 50000);
+  bad += st_hist(STATS_DT_MIN,   STATS_DT_STEP,   0,     400);
+
+  printf("# test  snr[dB]   mean    stats    p50   bad\n");
+  bad += st_snr(-21); // -5.25 dB
+  bad += st_snr(-10); // -2.5 dB
+  bad += st_snr(0);
+  bad += st_snr(26);  // +6.5 dB
+
+  printf("# test   seq0      loss    sent   lost    dup  reord      per   bad\n");
+  bad += st_per(0,      0,   0);
+  bad += st_per(0xFF00, 10,  5);
+  bad += st_per(0x7FF0, 100, 20);
+  bad += st_per(0xFFFF, 500, 50);
+
+  if (bad) printf("# FAIL: %u checks\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "stats_test.cpp" file ***/
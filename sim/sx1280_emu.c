@@ -0,0 +1,666 @@
+/*
+ * SX1280 chip emulator on SPI command level (host simulator)
+ * File: "sx1280_emu.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h> // memset(), memcpy()
+#include <math.h>   // ceil(), floor()
+#include "sx1280_emu.h"
+#include "chan.h"
+#include "sx128x.h" // SX128X_CALIB_TABLE
+#include "vclock.h"
+//-----------------------------------------------------------------------------
+// status byte: ChipMode[7:5] + CmdStatus[4:2]
+#define EMU_STATUS(self) ((uint8_t) (((self)->mode << 5) | ((self)->stat << 2)))
+//-----------------------------------------------------------------------------
+// FLRC/GFSK bitrate and bandwidth by ModParam1
+typedef struct {
+  uint8_t  code;
+  uint32_t br; // [bit/s]
+  uint32_t bw; // [Hz]
+} emu_br_t;
+
+static const emu_br_t emu_flrc_br[] = {
+  { SX128X_FLRC_BR_1_300_BW_1_2, 1300000, 1200000 },
+  { SX128X_FLRC_BR_1_040_BW_1_2, 1040000, 1200000 },
+  { SX128X_FLRC_BR_0_650_BW_0_6,  650000,  600000 },
+  { SX128X_FLRC_BR_0_520_BW_0_6,  520000,  600000 },
+  { SX128X_FLRC_BR_0_325_BW_0_3,  325000,  300000 },
+  { SX128X_FLRC_BR_0_260_BW_0_3,  260000,  300000 },
+  { 0, 0, 0 } };
+
+static const emu_br_t emu_gfsk_br[] = {
+  { SX128X_GFSK_BLE_BR_2_000_BW_2_4, 2000000, 2400000 },
+  { SX128X_GFSK_BLE_BR_1_600_BW_2_4, 1600000, 2400000 },
+  { SX128X_GFSK_BLE_BR_1_000_BW_2_4, 1000000, 2400000 },
+  { SX128X_GFSK_BLE_BR_1_000_BW_1_2, 1000000, 1200000 },
+  { SX128X_GFSK_BLE_BR_0_800_BW_2_4,  800000, 2400000 },
+  { SX128X_GFSK_BLE_BR_0_800_BW_1_2,  800000, 1200000 },
+  { SX128X_GFSK_BLE_BR_0_500_BW_1_2,  500000, 1200000 },
+  { SX128X_GFSK_BLE_BR_0_500_BW_0_6,  500000,  600000 },
+  { SX128X_GFSK_BLE_BR_0_400_BW_1_2,  400000, 1200000 },
+  { SX128X_GFSK_BLE_BR_0_400_BW_0_6,  400000,  600000 },
+  { SX128X_GFSK_BLE_BR_0_250_BW_0_6,  250000,  600000 },
+  { SX128X_GFSK_BLE_BR_0_250_BW_0_3,  250000,  300000 },
+  { SX128X_GFSK_BLE_BR_0_125_BW_0_3,  125000,  300000 },
+  { 0, 0, 0 } };
+//-----------------------------------------------------------------------------
+static const emu_br_t *emu_br_find(const emu_br_t *table, uint8_t code)
+{
+  for (; table->code; table++)
+    if (table->code == code) return table;
+  return table - 1; // last one
+}
+//-----------------------------------------------------------------------------
+// LoRa bandwidth by ModParam2 [Hz]
+static uint32_t emu_lora_bw(uint8_t code)
+{
+  switch (code)
+  {
+    case SX128X_MOD_PARAM2_LORA_BW_1600: return 1625000;
+    case SX128X_MOD_PARAM2_LORA_BW_800:  return  812500;
+    case SX128X_MOD_PARAM2_LORA_BW_400:  return  406250;
+    default:                             return  203125;
+  }
+}
+//-----------------------------------------------------------------------------
+static uint8_t emu_is_lora(const sx1280_emu_t *self)
+{
+  return self->pkt_type == SX128X_PACKET_TYPE_LORA ||
+         self->pkt_type == SX128X_PACKET_TYPE_RANGING;
+}
+//-----------------------------------------------------------------------------
+// cancel RX/TX timeout or CAD alarm
+static void emu_cancel(sx1280_emu_t *self)
+{
+  if (self->alarm >= 0) vclock_cancel(self->alarm);
+  self->alarm = -1;
+  self->cad   = 0;
+}
+//-----------------------------------------------------------------------------
+// RX timeout alarm
+static void emu_timeout_cb(void *context)
+{
+  sx1280_emu_t *self = (sx1280_emu_t*) context;
+  self->alarm = -1;
+  if (self->mode == EMU_MODE_RX && self->lock < 0)
+  {
+    self->mode = EMU_MODE_STDBY_RC;
+    self->stat = EMU_STAT_TIMEOUT;
+    emu_set_irq(self, SX128X_IRQ_RX_TX_TIMEOUT);
+  }
+}
+//-----------------------------------------------------------------------------
+// CAD done alarm (chip returns to STDBY_RC)
+static void emu_cad_cb(void *context)
+{
+  sx1280_emu_t *self = (sx1280_emu_t*) context;
+  uint8_t busy = chan_cad(self->chan, self, self->cad_t0, vclock_now());
+  self->alarm = -1;
+  self->cad   = 0;
+  self->mode  = EMU_MODE_STDBY_RC;
+  emu_set_irq(self, SX128X_IRQ_CAD_DONE | (busy ? SX128X_IRQ_CAD_DETECTED : 0));
+}
+//-----------------------------------------------------------------------------
+// timeout [us] by SetRx/SetTx periodBase and periodBaseCount
+static uint64_t emu_period(uint8_t base, uint16_t cnt)
+{
+  static const uint32_t base_ns[4] = { 15625, 62500, 1000000, 4000000 };
+  return ((uint64_t) cnt * base_ns[base & 3]) / 1000;
+}
+//-----------------------------------------------------------------------------
+// ranging request/response address matches by check length (Slave mode)
+// or whole (Master checks response)
+static uint8_t emu_rng_match(const sx1280_emu_t *self, const uint8_t *data,
+                             uint16_t reg, uint8_t bytes)
+{
+  uint8_t i;
+  for (i = EMU_RNG_SIZE - bytes; i < EMU_RNG_SIZE; i++)
+    if (data[i] != self->reg[reg + i]) return 0;
+  return 1;
+}
+//-----------------------------------------------------------------------------
+// distance error by ranging calibration register (larger value - shorter)
+static double emu_rng_cal(const sx1280_emu_t *self, uint32_t bw)
+{
+  static const uint16_t table[SX128X_CALIB_BWS][SX128X_CALIB_SFS] =
+    SX128X_CALIB_TABLE;
+  int bi = bw <= 600000 ? 0 : bw <= 1200000 ? 1 : 2;
+  int si = emu_sf(self);
+  int32_t reg = ((int32_t) self->reg[SX128X_REG_RANGING_CALIB_BYTE2] << 16) |
+                ((int32_t) self->reg[SX128X_REG_RANGING_CALIB_BYTE1] <<  8) |
+                 (int32_t) self->reg[SX128X_REG_RANGING_CALIB_BYTE0];
+  si = si < SX128X_CALIB_SF_MIN ? 0 :
+       si >= SX128X_CALIB_SF_MIN + SX128X_CALIB_SFS ? SX128X_CALIB_SFS - 1 :
+       si - SX128X_CALIB_SF_MIN;
+  return (table[bi][si] + EMU_RNG_CAL_DESIGN - reg) * EMU_RNG_CAL_M;
+}
+//-----------------------------------------------------------------------------
+// send ranging request (master) or response (slave) with address from `reg`
+static void emu_rng_send(sx1280_emu_t *self, uint16_t reg)
+{
+  memcpy((void*) &self->buf[self->tx_base], (const void*) &self->reg[reg],
+         EMU_RNG_SIZE);
+  self->lock = -1;
+  self->mode = EMU_MODE_TX;
+  chan_tx_start(self->chan, self);
+}
+//-----------------------------------------------------------------------------
+// ranging master timeout alarm (no response)
+static void emu_rng_timeout_cb(void *context)
+{
+  sx1280_emu_t *self = (sx1280_emu_t*) context;
+  self->alarm = -1;
+  if (self->rng != EMU_RNG_WAIT) return;
+  self->rng  = EMU_RNG_IDLE;
+  self->lock = -1;
+  self->mode = EMU_MODE_STDBY_RC;
+  emu_set_irq(self, SX128X_IRQ_MASTER_TIMEOUT);
+}
+//-----------------------------------------------------------------------------
+// ranging slave turnaround alarm => send response
+static void emu_rng_turn_cb(void *context)
+{
+  sx1280_emu_t *self = (sx1280_emu_t*) context;
+  self->alarm = -1;
+  if (self->rng == EMU_RNG_RESP)
+    emu_rng_send(self, SX128X_REG_RANGING_DEV_ADDR3);
+}
+//-----------------------------------------------------------------------------
+// Advanced Ranging: received address bytes by MUX register (0x927 bits 1:0)
+static void emu_adv_mux(sx1280_emu_t *self)
+{
+  uint32_t a = self->adv_addr;
+  if (self->reg[SX128X_REG_RANGING_ADDR_MUX] & 0x03) a >>= 16;
+  self->reg[SX128X_REG_RANGING_ADDR_HI] = (uint8_t) (a >> 8);
+  self->reg[SX128X_REG_RANGING_ADDR_LO] = (uint8_t)  a;
+}
+//-----------------------------------------------------------------------------
+// ranging result and RSSI registers by distance to node `from`
+static void emu_rng_result(sx1280_emu_t *self, int from, double rssi,
+                           double snr)
+{
+  double d;
+  int32_t raw;
+  uint32_t bw = emu_bw(self);
+
+  // distance [m] = raw * 150 / (2^12 * BW[MHz]) (14.5 Ranging Result)
+  d = chan_range(self->chan, self->id, from, self->freq, snr, bw);
+  d += emu_rng_cal(self, bw);
+  raw = (int32_t) floor(d * 4096.0 * (bw * 1e-6) / 150.0 + 0.5);
+  self->reg[SX128X_REG_RANGING_RESULT_BYTE2] = (uint8_t) (raw >> 16);
+  self->reg[SX128X_REG_RANGING_RESULT_BYTE1] = (uint8_t) (raw >>  8);
+  self->reg[SX128X_REG_RANGING_RESULT_BYTE0] = (uint8_t)  raw;
+
+  rssi = -2.0 * rssi;
+  self->reg[SX128X_REG_RANGING_RSSI] =
+    (uint8_t) (rssi < 0 ? 0 : rssi > 255 ? 255 : rssi);
+}
+//-----------------------------------------------------------------------------
+// ranging packet received (master: result, slave: answer to request,
+// Advanced Ranging: address and result of any request, no answer)
+static void emu_rng_rx_done(sx1280_emu_t *self, const uint8_t *data,
+                            uint8_t size, uint8_t ok, double rssi, double snr)
+{
+  if (self->adv && !self->role)
+  { // passive listener: requests of masters only (responses are ignored)
+    const sx1280_emu_t *tx = self->chan->node[self->rx_from];
+    if (!ok || size != EMU_RNG_SIZE || !tx->role) return;
+
+    self->adv_addr = ((uint32_t) data[0] << 24) | ((uint32_t) data[1] << 16) |
+                     ((uint32_t) data[2] <<  8) |  (uint32_t) data[3];
+    emu_adv_mux(self);
+    emu_rng_result(self, self->rx_from, rssi, snr);
+    emu_set_irq(self, SX128X_IRQ_ADVANCED_RANGING_DONE);
+  }
+  else if (self->role)
+  { // master: response of requested slave => result (3.5.3 Ranging Operation)
+    if (self->rng != EMU_RNG_WAIT || !ok || size != EMU_RNG_SIZE ||
+        !emu_rng_match(self, data, SX128X_REG_RANGING_REQ_ADDR3, EMU_RNG_SIZE))
+      return; // wait for timeout
+
+    emu_cancel(self);
+    self->rng  = EMU_RNG_IDLE;
+    self->mode = EMU_MODE_STDBY_RC;
+    emu_rng_result(self, self->rx_from, rssi, snr);
+    emu_set_irq(self, SX128X_IRQ_MASTER_RESULT_VALID);
+  }
+  else if (self->rng == EMU_RNG_IDLE && ok && size == EMU_RNG_SIZE)
+  { // slave: request with own address => response after turnaround
+    uint8_t bytes = (self->reg[SX128X_REG_RANGING_ID_CHECK_LEN] >> 6) + 1;
+    if (!emu_rng_match(self, data, SX128X_REG_RANGING_DEV_ADDR3, bytes))
+    {
+      emu_set_irq(self, SX128X_IRQ_SLAVE_REQUEST_DISCARD);
+      return;
+    }
+    emu_cancel(self);
+    self->rng   = EMU_RNG_RESP;
+    self->alarm = vclock_alarm(EMU_RNG_TURN, emu_rng_turn_cb, self);
+    emu_set_irq(self, SX128X_IRQ_SLAVE_REQUEST_VALID);
+  }
+}
+//-----------------------------------------------------------------------------
+// init emulator (STDBY_RC, reset values)
+void emu_init(sx1280_emu_t *self, struct chan_ *chan, int id, double x, double y)
+{
+  memset((void*) self, 0, sizeof(sx1280_emu_t));
+  self->chan     = chan;
+  self->id       = id;
+  self->x        = x;
+  self->y        = y;
+  self->mode     = EMU_MODE_STDBY_RC;
+  self->stat     = EMU_STAT_OK;
+  self->pkt_type = SX128X_PACKET_TYPE_GFSK;
+  self->freq     = 2400000000u;
+  self->lock     = -1;
+  self->alarm    = -1;
+  self->rx_from  = -1;
+  self->cad_sym  = 1;
+  self->reg[SX128X_REG_FW_VERSION]     = 0xA9;
+  self->reg[SX128X_REG_FW_VERSION + 1] = 0xB5;
+}
+//-----------------------------------------------------------------------------
+// BUSY wait (sx128x_init() callback, always ready)
+uint8_t emu_busy_wait(uint32_t timeout, void *context)
+{
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// DIO1 line state
+uint8_t emu_dio1(const sx1280_emu_t *self)
+{
+  return (self->irq & self->dio1_mask) != 0;
+}
+//-----------------------------------------------------------------------------
+// set IRQ flags (masked by irq_mask)
+void emu_set_irq(sx1280_emu_t *self, uint16_t irq)
+{
+  self->irq |= irq & self->irq_mask;
+}
+//-----------------------------------------------------------------------------
+// receiver bandwidth by current settings [Hz]
+uint32_t emu_bw(const sx1280_emu_t *self)
+{
+  if (emu_is_lora(self))
+    return emu_lora_bw(self->mod[1]);
+  if (self->pkt_type == SX128X_PACKET_TYPE_FLRC)
+    return emu_br_find(emu_flrc_br, self->mod[0])->bw;
+  return emu_br_find(emu_gfsk_br, self->mod[0])->bw;
+}
+//-----------------------------------------------------------------------------
+// LoRa spreading factor (0 for GFSK/FLRC)
+uint8_t emu_sf(const sx1280_emu_t *self)
+{
+  return emu_is_lora(self) ? self->mod[0] >> 4 : 0;
+}
+//-----------------------------------------------------------------------------
+// payload size of packet to send
+uint8_t emu_tx_size(const sx1280_emu_t *self)
+{
+  if (self->pkt_type == SX128X_PACKET_TYPE_RANGING) return EMU_RNG_SIZE;
+  return emu_is_lora(self) ? self->pkt[2] : self->pkt[4];
+}
+//-----------------------------------------------------------------------------
+// time on air of packet with payload `size` by current settings [us]
+// (SX1280 datasheet, chapter 7.4 "LoRa Time-on-Air" and FLRC/GFSK framing)
+uint32_t emu_toa(const sx1280_emu_t *self, uint8_t size)
+{
+  double t;
+
+  if (emu_is_lora(self))
+  {
+    int sf  = self->mod[0] >> 4;
+    int cr  = self->mod[2] & 7;
+    int hdr = !(self->pkt[1] & SX128X_LORA_IMPLICIT_HEADER);
+    int crc = !!(self->pkt[3] & SX128X_LORA_CRC_ENABLE);
+    double npre = (self->pkt[0] & 0x0F) * (double) (1 << (self->pkt[0] >> 4));
+    double tsym = (double) (1 << sf) / emu_lora_bw(self->mod[1]); // [s]
+    double bits = 8.0 * size + 16.0 * crc - 4.0 * sf + 20.0 * hdr;
+    double nsym;
+
+    if (cr > 4) cr = cr == 7 ? 4 : cr - 4; // long interleaving ~ same rate
+    if (sf <= 6)
+      nsym = npre + 6.25 + 8 + ceil((bits > 0 ? bits : 0) / (4.0 * sf)) * (cr + 4);
+    else if (sf <= 10)
+      nsym = npre + 4.25 + 8 + ceil((bits + 8 > 0 ? bits + 8 : 0) / (4.0 * sf)) * (cr + 4);
+    else
+      nsym = npre + 4.25 + 8 + ceil((bits + 8 > 0 ? bits + 8 : 0) / (4.0 * (sf - 2))) * (cr + 4);
+
+    t = nsym * tsym;
+  }
+  else if (self->pkt_type == SX128X_PACKET_TYPE_FLRC)
+  {
+    const emu_br_t *br = emu_br_find(emu_flrc_br, self->mod[0]);
+    double rate = self->mod[1] == SX128X_FLRC_CR_1_2 ? 0.5 :
+                  self->mod[1] == SX128X_FLRC_CR_3_4 ? 0.75 : 1.0;
+    int pre  = ((self->pkt[0] >> 4) + 1) * 4;        // preamble [bits]
+    int sync = self->pkt[1] ? 32 : 0;                // sync word [bits]
+    int crc  = (self->pkt[5] >> 4) * 8;              // CRC [bits]
+    int body = (self->pkt[3] ? 16 : 0) + 8 * size + crc + 6; // +tail
+    t = (pre + 21 + sync + body / rate) / br->br;
+  }
+  else
+  { // GFSK/BLE
+    const emu_br_t *br = emu_br_find(emu_gfsk_br, self->mod[0]);
+    int pre  = ((self->pkt[0] >> 4) + 1) * 4;
+    int sync = (self->pkt[1] / 2 + 1) * 8;
+    int crc  = (self->pkt[5] >> 4) * 8;
+    int body = (self->pkt[3] ? 8 : 0) + 8 * size + crc;
+    t = (double) (pre + sync + body) / br->br;
+  }
+
+  return (uint32_t) (t * 1e6 + 0.5);
+}
+//-----------------------------------------------------------------------------
+// preamble (+sync word) duration by current settings [us]
+uint32_t emu_preamble(const sx1280_emu_t *self)
+{
+  double t;
+
+  if (emu_is_lora(self))
+  {
+    int sf = self->mod[0] >> 4;
+    double npre = (self->pkt[0] & 0x0F) * (double) (1 << (self->pkt[0] >> 4));
+    t = (npre + 4.25) * (double) (1 << sf) / emu_lora_bw(self->mod[1]);
+  }
+  else if (self->pkt_type == SX128X_PACKET_TYPE_FLRC)
+  {
+    int pre = ((self->pkt[0] >> 4) + 1) * 4;
+    t = (double) (pre + 21 + (self->pkt[1] ? 32 : 0)) /
+        emu_br_find(emu_flrc_br, self->mod[0])->br;
+  }
+  else
+  {
+    int pre = ((self->pkt[0] >> 4) + 1) * 4;
+    t = (double) (pre + (self->pkt[1] / 2 + 1) * 8) /
+        emu_br_find(emu_gfsk_br, self->mod[0])->br;
+  }
+
+  return (uint32_t) (t * 1e6 + 0.5);
+}
+//-----------------------------------------------------------------------------
+// packet received by channel (ok=0 => CRC error)
+void emu_rx_done(sx1280_emu_t *self, const uint8_t *data, uint8_t size,
+                 uint8_t ok, double rssi, double snr)
+{
+  self->lock = -1;
+  if (self->pkt_type == SX128X_PACKET_TYPE_RANGING)
+  { // ranging engine doesn't give packets to host
+    emu_rng_rx_done(self, data, size, ok, rssi, snr);
+    return;
+  }
+
+  memcpy((void*) &self->buf[self->rx_base], (const void*) data, size);
+  self->rx_size = size;
+  self->reg[SX128X_REG_LORA_PAYLOAD_LENGTH] = size;
+
+  rssi = -2.0 * rssi;
+  self->rx_rssi = (uint8_t) (rssi < 0 ? 0 : rssi > 255 ? 255 : rssi);
+  snr *= 4.0;
+  self->rx_snr  = (int8_t) (snr < -128 ? -128 : snr > 127 ? 127 : snr);
+
+  if (!self->rx_cont)
+  {
+    emu_cancel(self);
+    self->mode = EMU_MODE_STDBY_RC;
+  }
+  self->stat = EMU_STAT_DATA;
+
+  emu_set_irq(self, SX128X_IRQ_RX_DONE |
+                    (emu_is_lora(self) ? SX128X_IRQ_HEADER_VALID :
+                                         SX128X_IRQ_SYNC_WORD_VALID) |
+                    (ok ? 0 : SX128X_IRQ_CRC_ERROR));
+}
+//-----------------------------------------------------------------------------
+// own packet transmitted
+void emu_tx_done(sx1280_emu_t *self)
+{
+  if (self->mode != EMU_MODE_TX) return;
+
+  if (self->rng == EMU_RNG_REQ)
+  { // master: wait response of slave
+    self->rng   = EMU_RNG_WAIT;
+    self->mode  = EMU_MODE_RX;
+    self->lock  = -1;
+    self->alarm = vclock_alarm(emu_toa(self, EMU_RNG_SIZE) +
+                               EMU_RNG_TURN + EMU_RNG_MARGIN,
+                               emu_rng_timeout_cb, self);
+    return;
+  }
+
+  if (self->rng == EMU_RNG_RESP)
+  { // slave: response sent => listen again
+    self->rng  = EMU_RNG_IDLE;
+    self->mode = EMU_MODE_RX;
+    emu_set_irq(self, SX128X_IRQ_SLAVE_RESPONSE_DONE);
+    return;
+  }
+
+  self->mode = EMU_MODE_STDBY_RC;
+  self->stat = EMU_STAT_TX_DONE;
+  emu_set_irq(self, SX128X_IRQ_TX_DONE);
+}
+//-----------------------------------------------------------------------------
+// SPI exchange (sx128x_init() callback, context = sx1280_emu_t*)
+uint8_t emu_spi_exchange(uint8_t *rx_buf, const uint8_t *tx, uint16_t len,
+                         void *context)
+{
+  sx1280_emu_t *self = (sx1280_emu_t*) context;
+  uint16_t addr, i;
+
+  if (self->mode == EMU_MODE_SLEEP)
+  { // NSS falling edge => wakeup (configuration is retained by host)
+    self->mode = EMU_MODE_STDBY_RC;
+  }
+
+  memset((void*) rx_buf, 0, len);
+  rx_buf[0] = EMU_STATUS(self);
+
+  switch (tx[0])
+  {
+    case SX128X_CMD_GET_STATUS:
+      break;
+
+    case SX128X_CMD_SET_SLEEP:
+      emu_cancel(self);
+      self->lock = -1;
+      self->rng  = EMU_RNG_IDLE;
+      self->mode = EMU_MODE_SLEEP;
+      break;
+
+    case SX128X_CMD_SET_STANDBY:
+      emu_cancel(self);
+      self->lock = -1;
+      self->rng  = EMU_RNG_IDLE;
+      self->mode = (len > 1 && tx[1]) ? EMU_MODE_STDBY_XOSC : EMU_MODE_STDBY_RC;
+      self->stat = EMU_STAT_OK;
+      break;
+
+    case SX128X_CMD_SET_FS:
+      self->mode = EMU_MODE_FS;
+      break;
+
+    case SX128X_CMD_SET_PACKET_TYPE:
+      if (len > 1) self->pkt_type = tx[1];
+      break;
+
+    case SX128X_CMD_GET_PACKET_TYPE:
+      if (len > 2) rx_buf[2] = self->pkt_type;
+      break;
+
+    case SX128X_CMD_SET_RF_FREQUENCY:
+      if (len > 3)
+      {
+        uint32_t code = ((uint32_t) tx[1] << 16) | ((uint32_t) tx[2] << 8) | tx[3];
+        self->freq = (uint32_t) ((uint64_t) code * 52000000u >> 18);
+      }
+      break;
+
+    case SX128X_CMD_SET_TX_PARAMS:
+      if (len > 1) self->power = (int8_t) tx[1] - 18;
+      break;
+
+    case SX128X_CMD_SET_MODULATION_PARAMS:
+      for (i = 0; i < 3 && i + 1 < len; i++) self->mod[i] = tx[i + 1];
+      break;
+
+    case SX128X_CMD_SET_PACKET_PARAMS:
+      for (i = 0; i < 7 && i + 1 < len; i++) self->pkt[i] = tx[i + 1];
+      break;
+
+    case SX128X_CMD_SET_BUFFER_BASE_ADDRESS:
+      if (len > 2) { self->tx_base = tx[1]; self->rx_base = tx[2]; }
+      break;
+
+    case SX128X_CMD_SET_DIO_IRQ_PARAMS:
+      if (len > 4)
+      {
+        self->irq_mask  = ((uint16_t) tx[1] << 8) | tx[2];
+        self->dio1_mask = ((uint16_t) tx[3] << 8) | tx[4];
+      }
+      break;
+
+    case SX128X_CMD_GET_IRQ_STATUS:
+      if (len > 3) { rx_buf[2] = self->irq >> 8; rx_buf[3] = self->irq & 0xFF; }
+      break;
+
+    case SX128X_CMD_CLR_IRQ_STATUS:
+      if (len > 2) self->irq &= ~(((uint16_t) tx[1] << 8) | tx[2]);
+      break;
+
+    case SX128X_CMD_GET_RX_BUFFER_STATUS:
+      if (len > 3)
+      {
+        rx_buf[1] = EMU_STATUS(self);
+        rx_buf[2] = self->rx_size;
+        rx_buf[3] = self->rx_base;
+      }
+      break;
+
+    case SX128X_CMD_GET_PACKET_STATUS:
+      if (len > 6)
+      {
+        rx_buf[1] = EMU_STATUS(self);
+        if (emu_is_lora(self))
+        {
+          rx_buf[2] = self->rx_rssi;
+          rx_buf[3] = (uint8_t) self->rx_snr;
+        }
+        else
+        {
+          rx_buf[3] = self->rx_rssi;
+          rx_buf[4] = (self->irq & SX128X_IRQ_CRC_ERROR) ? 0x10 : 0x00;
+          rx_buf[6] = 0x01; // sync address 1
+        }
+      }
+      break;
+
+    case SX128X_CMD_GET_RSSI_INST:
+      if (len > 2) rx_buf[2] = self->chan != NULL ?
+                               chan_rssi_inst(self->chan, self) : self->rx_rssi;
+      break;
+
+    case SX128X_CMD_WRITE_REGISTER:
+      addr = ((uint16_t) tx[1] << 8) | tx[2];
+      for (i = 3; i < len; i++, addr++)
+        self->reg[addr % EMU_REG_SIZE] = tx[i];
+      emu_adv_mux(self);
+      break;
+
+    case SX128X_CMD_READ_REGISTER:
+      addr = ((uint16_t) tx[1] << 8) | tx[2];
+      for (i = 4; i < len; i++, addr++)
+        rx_buf[i] = self->reg[addr % EMU_REG_SIZE];
+      break;
+
+    case SX128X_CMD_WRITE_BUFFER:
+      for (i = 2; i < len; i++)
+        self->buf[(uint8_t) (tx[1] + i - 2)] = tx[i];
+      break;
+
+    case SX128X_CMD_READ_BUFFER:
+      for (i = 3; i < len; i++)
+        rx_buf[i] = self->buf[(uint8_t) (tx[1] + i - 3)];
+      break;
+
+    case SX128X_CMD_SET_TX:
+      emu_cancel(self);
+      self->lock = -1; // half duplex
+      self->mode = EMU_MODE_TX;
+      self->stat = EMU_STAT_OK;
+      if (self->pkt_type == SX128X_PACKET_TYPE_RANGING && self->role)
+      { // ranging master request
+        self->rng = EMU_RNG_REQ;
+        emu_rng_send(self, SX128X_REG_RANGING_REQ_ADDR3);
+        break;
+      }
+      self->rng = EMU_RNG_IDLE;
+      chan_tx_start(self->chan, self);
+      break;
+
+    case SX128X_CMD_SET_RANGING_ROLE:
+      if (len > 1) self->role = tx[1] ? 1 : 0;
+      break;
+
+    case SX128X_CMD_SET_ADVANCED_RANGING:
+      if (len > 1) self->adv = tx[1] ? 1 : 0;
+      break;
+
+    case SX128X_CMD_SET_TX_CONTINUOUS_WAVE:
+    case SX128X_CMD_SET_TX_CONTINUOUS_PREAMBLE:
+      emu_cancel(self);
+      self->lock = -1;
+      self->mode = EMU_MODE_TX; // no packet
+      break;
+
+    case SX128X_CMD_SET_RX:
+      emu_cancel(self);
+      self->lock = -1;
+      self->rng  = EMU_RNG_IDLE;
+      self->mode = EMU_MODE_RX;
+      self->stat = EMU_STAT_OK;
+      if (len > 3)
+      {
+        uint16_t cnt = ((uint16_t) tx[2] << 8) | tx[3];
+        self->rx_cont = (cnt == SX128X_RX_TIMEOUT_CONTINUOUS);
+        if (cnt != SX128X_RX_TIMEOUT_SINGLE && !self->rx_cont)
+          self->alarm = vclock_alarm((uint32_t) emu_period(tx[1], cnt),
+                                     emu_timeout_cb, self);
+      }
+      chan_rx_start(self->chan, self); // packet with preamble on air
+      break;
+
+    case SX128X_CMD_SET_CAD_PARAMS:
+      if (len > 1) self->cad_sym = (uint8_t) (1 << ((tx[1] >> 5) & 7));
+      break;
+
+    case SX128X_CMD_SET_CAD:
+      emu_cancel(self);
+      self->lock = -1;
+      self->rng  = EMU_RNG_IDLE;
+      self->mode = EMU_MODE_RX; // receiver is on, no packets
+      self->stat = EMU_STAT_OK;
+      if (!emu_is_lora(self))
+      { // CAD of LoRa modem only
+        self->stat = EMU_STAT_ERROR;
+        self->mode = EMU_MODE_STDBY_RC;
+        break;
+      }
+      self->cad    = 1;
+      self->cad_t0 = vclock_now();
+      self->alarm  = vclock_alarm((uint32_t) self->cad_sym *
+                                  (uint32_t) ((1000000ULL << emu_sf(self)) /
+                                              emu_bw(self)),
+                                  emu_cad_cb, self);
+      break;
+
+    default: // other commands are accepted and ignored
+      break;
+  }
+
+  return 1;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "sx1280_emu.c" file ***/
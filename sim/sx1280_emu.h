@@ -0,0 +1,147 @@
+/*
+ * SX1280 chip emulator on SPI command level (host simulator)
+ * File: "sx1280_emu.h"
+ */
+
+#pragma once
+#ifndef SX1280_EMU_H
+#define SX1280_EMU_H
+//-----------------------------------------------------------------------------
+#include <stdint.h>
+//-----------------------------------------------------------------------------
+// chip modes (status ChipMode field)
+#define EMU_MODE_SLEEP      0
+#define EMU_MODE_STDBY_RC   2
+#define EMU_MODE_STDBY_XOSC 3
+#define EMU_MODE_FS         4
+#define EMU_MODE_RX         5
+#define EMU_MODE_TX         6
+
+// command status (status CmdStatus field)
+#define EMU_STAT_OK      1 // command processed successfully
+#define EMU_STAT_DATA    2 // data available to host
+#define EMU_STAT_TIMEOUT 3 // command timeout
+#define EMU_STAT_ERROR   4 // command processing error
+#define EMU_STAT_FAIL    5 // failure to execute command
+#define EMU_STAT_TX_DONE 6 // command TX done
+
+#define EMU_REG_SIZE 0x1000 // register space
+
+// ranging exchange state (Ranging packet type)
+#define EMU_RNG_IDLE 0 // no exchange (slave listens)
+#define EMU_RNG_REQ  1 // master sends request
+#define EMU_RNG_WAIT 2 // master waits response
+#define EMU_RNG_RESP 3 // slave sends response
+
+#define EMU_RNG_SIZE      4 // ranging request/response size (address) [bytes]
+#define EMU_RNG_TURN    150 // slave turnaround delay [us]
+#define EMU_RNG_MARGIN 1000 // master timeout margin after response [us]
+
+// calibration model: true calibration of this "chip" is the nominal table
+// value + EMU_RNG_CAL_DESIGN, each unit of register error is EMU_RNG_CAL_M
+#define EMU_RNG_CAL_DESIGN  40 // offset from nominal calibration table [units]
+#define EMU_RNG_CAL_M     0.09 // distance per calibration unit [m]
+//-----------------------------------------------------------------------------
+struct chan_;
+//-----------------------------------------------------------------------------
+// one emulated SX1280 chip
+typedef struct sx1280_emu_ {
+  struct chan_ *chan; // channel (medium)
+  int   id;           // node index
+  double x, y;        // position [m]
+
+  uint8_t  mode;      // EMU_MODE_*
+  uint8_t  stat;      // EMU_STAT_*
+  uint8_t  pkt_type;  // SX128X_PACKET_TYPE_*
+  uint32_t freq;      // RF frequency [Hz]
+  int8_t   power;     // TX power [dBm]
+
+  uint8_t  mod[3];    // modulation params (SetModulationParams)
+  uint8_t  pkt[7];    // packet params (SetPacketParams)
+
+  uint16_t irq;       // IRQ status
+  uint16_t irq_mask;  // IRQ mask
+  uint16_t dio1_mask; // DIO1 mask
+
+  uint8_t  tx_base;   // TX buffer base address
+  uint8_t  rx_base;   // RX buffer base address
+  uint8_t  buf[256];  // data buffer
+  uint8_t  reg[EMU_REG_SIZE];
+
+  // last received packet
+  uint8_t  rx_size;   // payload size
+  uint8_t  rx_rssi;   // RSSI = -rx_rssi/2 [dBm]
+  int8_t   rx_snr;    // SNR = rx_snr/4 [dB]
+
+  // RX state
+  int      lock;      // index of received packet in channel or -1
+  int      alarm;     // RX/TX timeout alarm or -1
+  uint8_t  rx_cont;   // 1 - continuous RX
+  int      rx_from;   // transmitter index of last received packet
+
+  // channel activity detection (LoRa)
+  uint8_t  cad;       // 1 - CAD in progress (SetCad)
+  uint8_t  cad_sym;   // CAD symbols (SetCadParams)
+  uint64_t cad_t0;    // CAD start [us]
+
+  // ranging
+  uint8_t  role;      // 1 - master, 0 - slave (SetRangingRole)
+  uint8_t  rng;       // EMU_RNG_*
+  uint8_t  adv;       // 1 - Advanced Ranging (SetAdvancedRanging)
+  uint32_t adv_addr;  // Advanced Ranging: last received request address
+
+  // counters
+  uint32_t tx_cnt;    // transmitted packets
+  uint64_t tx_us;     // time on air [us]
+} sx1280_emu_t;
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+extern "C"
+{
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+// init emulator (STDBY_RC, reset values)
+void emu_init(sx1280_emu_t *self, struct chan_ *chan, int id, double x, double y);
+//-----------------------------------------------------------------------------
+// SPI exchange (sx128x_init() callback, context = sx1280_emu_t*)
+uint8_t emu_spi_exchange(uint8_t *rx_buf, const uint8_t *tx_buf, uint16_t len,
+                         void *context);
+//-----------------------------------------------------------------------------
+// BUSY wait (sx128x_init() callback, always ready)
+uint8_t emu_busy_wait(uint32_t timeout, void *context);
+//-----------------------------------------------------------------------------
+// DIO1 line state
+uint8_t emu_dio1(const sx1280_emu_t *self);
+//-----------------------------------------------------------------------------
+// set IRQ flags (masked by irq_mask)
+void emu_set_irq(sx1280_emu_t *self, uint16_t irq);
+//-----------------------------------------------------------------------------
+// time on air of packet with payload `size` by current settings [us]
+uint32_t emu_toa(const sx1280_emu_t *self, uint8_t size);
+//-----------------------------------------------------------------------------
+// preamble (+sync word) duration by current settings [us]
+uint32_t emu_preamble(const sx1280_emu_t *self);
+//-----------------------------------------------------------------------------
+// receiver bandwidth by current settings [Hz]
+uint32_t emu_bw(const sx1280_emu_t *self);
+//-----------------------------------------------------------------------------
+// LoRa spreading factor (0 for GFSK/FLRC)
+uint8_t emu_sf(const sx1280_emu_t *self);
+//-----------------------------------------------------------------------------
+// payload size of packet to send
+uint8_t emu_tx_size(const sx1280_emu_t *self);
+//-----------------------------------------------------------------------------
+// packet received by channel (ok=0 => CRC error)
+void emu_rx_done(sx1280_emu_t *self, const uint8_t *data, uint8_t size,
+                 uint8_t ok, double rssi, double snr);
+//-----------------------------------------------------------------------------
+// own packet transmitted
+void emu_tx_done(sx1280_emu_t *self);
+//-----------------------------------------------------------------------------
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+//-----------------------------------------------------------------------------
+#endif // SX1280_EMU_H
+
+/*** end of "sx1280_emu.h" file ***/
@@ -0,0 +1,416 @@
+/*
+ * Multi-node TDMA simulator (host build, virtual time)
+ * File: "tdma_sim.cpp"
+ *
+ * Coordinator (AFsm TD, slot 0, sink) and N-1 members (AFsm TD, slot i)
+ * with own drifting clocks share one RF channel; members discipline clock
+ * by beacons with the same "tdma.c" scheduler as sketch. Same offered load
+ * by ALOHA (AFsm TX, random phase, one packet per frame) is compared.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf(), fprintf()
+#include <stdlib.h> // strtol(), strtod()
+#include <string.h> // strcmp(), memset()
+#include "config.h" // TIME_FUNC(), USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "tdma.h"
+#include "lat.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build simulator with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define TSIM_NMAX 16 // maximal number of N in list
+//-----------------------------------------------------------------------------
+typedef enum {
+  TSIM_ALOHA = 0, // periodic TX with random phase (AFsm TX)
+  TSIM_TDMA,      // slots by disciplined clock (AFsm TD)
+  TSIM_RUNS
+} tsim_run_t;
+
+static const char * const tsim_run_name[TSIM_RUNS] = { "aloha", "tdma" };
+//-----------------------------------------------------------------------------
+// simulation options
+typedef struct tsim_opt_ {
+  int      n[TSIM_NMAX]; // number of nodes (with coordinator)
+  int      nn;           // size of n[] list
+  uint32_t time;         // simulation time [s]
+  uint8_t  sf;           // LoRa SF
+  uint16_t bw;           // LoRa BW [kHz]
+  uint8_t  size;         // payload size [bytes]
+  uint32_t slot;         // slot length [us] (0 - by time on air)
+  uint16_t guard;        // minimal guard time [us]
+  double   ppm;          // maximal clock error of node [ppm]
+  double   loss;         // probability of beacon loss on member
+  uint32_t jit;          // RxDone timestamp jitter (IRQ latency) [us]
+  uint32_t step;         // main loop step [us]
+  double   area;         // area side [m]
+  uint32_t seed;         // random seed
+} tsim_opt_t;
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM + scheduler + own clock)
+typedef struct tsim_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  ABlink        led;
+  tdma_t        tdma;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  uint32_t      phase;      // local clock at virtual time 0 [us]
+  int64_t       ppb;        // local clock error [ppb]
+  unsigned long start_ms;   // FSM start time [ms]
+  uint8_t       started;
+  uint32_t      sent;       // TxDone counter
+  uint32_t      errors;     // FSM action errors
+} tsim_node_t;
+//-----------------------------------------------------------------------------
+// result of run
+typedef struct tsim_res_ {
+  uint32_t   ok;   // member packets received by coordinator
+  uint32_t   viol; // member packets out of own slot (by true time)
+  lat_hist_t err;  // |member clock - coordinator clock| at TX start [us]
+} tsim_res_t;
+//-----------------------------------------------------------------------------
+static chan_t       Chan;    // RF channel (big, static)
+static tsim_node_t *Cur;     // node in FSM callback context
+static tsim_node_t *Coord;   // coordinator (node 0)
+static tsim_res_t   Res;     // result of run
+static uint32_t     Rnd = 1; // xorshift32 state
+static double       Loss;    // probability of beacon loss on member
+static uint32_t     Jit;     // RxDone timestamp jitter [us]
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+// uniform random value 0...1
+static double tsim_rand()
+{
+  Rnd ^= Rnd << 13; Rnd ^= Rnd >> 17; Rnd ^= Rnd << 5;
+  return (double) Rnd / 4294967296.0;
+}
+//-----------------------------------------------------------------------------
+static uint32_t tsim_get32(const uint8_t *p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+// local clock of node [us] (TIME_FUNC() of node)
+static uint32_t tsim_local(const tsim_node_t *n)
+{
+  int64_t now = (int64_t) vclock_now();
+  return (uint32_t) (n->phase + now + now * n->ppb / 1000000000);
+}
+//-----------------------------------------------------------------------------
+// member slot TX started: true clock error and slot boundaries check
+static void tsim_slot_check(const tsim_node_t *n)
+{
+  const tdma_t *c = &Coord->tdma;
+  const uint8_t *p = n->fsm.last_frame() + n->data_size - TDMA_HDR_SIZE;
+  uint32_t s = tsim_local(Coord); // true coordinator time of TX start
+  int32_t e = (int32_t) (s - tsim_get32(p + 2));
+  uint32_t pos = (s - c->frame_t) % tdma_frame_us(c);
+  uint32_t beg = (uint32_t) n->tdma.slot * c->slot_us;
+
+  lat_add(&Res.err, (uint32_t) (e < 0 ? -e : e));
+  if (pos < beg || pos + n->tdma.toa > beg + c->slot_us) Res.viol++;
+}
+//-----------------------------------------------------------------------------
+// FSM event callback: payload id, slot check, count TxDone
+static void tsim_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  tsim_node_t *n = Cur;
+
+  if (err != SX128X_ERR_NONE) n->errors++;
+
+  if (ev == AFSM_EV_TICK && n->fsm.mode() == AFSM_TD && n != Coord &&
+      err == SX128X_ERR_NONE)
+    tsim_slot_check(n);
+  else if (ev == AFSM_EV_TX_DONE)
+    n->sent++;
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (like sx128x_irq()), t - local time
+static void tsim_irq(tsim_node_t *n, uint32_t t)
+{
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_TX_DONE)
+    n->fsm.tx_done();
+
+  if (irq & SX128X_IRQ_RX_DONE)
+  {
+    sx128x_rx_t rx;
+    uint8_t data[255], size = 0;
+
+    t += (uint32_t) (tsim_rand() * Jit); // ISR latency
+
+    if (sx128x_get_recv(&n->radio, irq, sizeof(data), &rx, data, &size) ==
+        SX128X_ERR_NONE && rx.crc_ok)
+    {
+      if (n == Coord)
+        Res.ok++; // member packet to sink
+      if (n->fsm.mode() == AFSM_TD && (n == Coord || tsim_rand() >= Loss))
+        tdma_recv(&n->tdma, data, size, t);
+    }
+    n->fsm.rx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT)
+    n->fsm.rxtx_timeout();
+
+  if ((irq & SX128X_IRQ_HEADER_ERROR) || (irq & SX128X_IRQ_CRC_ERROR))
+  { // see Errata 16.2 (as in sx128x_irq())
+    sx128x_rx(&n->radio, SX128X_RX_TIMEOUT_CONTINUOUS, SX128X_TIME_BASE_15_625US);
+  }
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - coordinator/sink in center of area)
+static int tsim_node_init(tsim_node_t *n, int id, int num, tsim_run_t run,
+                          uint32_t slot, const tsim_opt_t *opt)
+{
+  double x = 0., y = 0.;
+  int8_t retv;
+
+  if (id)
+  {
+    x = (tsim_rand() - 0.5) * opt->area;
+    y = (tsim_rand() - 0.5) * opt->area;
+  }
+  emu_init(&n->emu, &Chan, id, x, y);
+  chan_add(&Chan, &n->emu);
+
+  n->pars              = sx128x_pars_default;
+  n->pars.mode         = SX128X_LORA;
+  n->pars.fixed        = 1;
+  n->pars.payload_size = opt->size;
+  n->pars.sf           = opt->sf;
+  n->pars.bw           = opt->bw;
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  // own crystal: random phase and error +/-ppm
+  n->phase = (uint32_t) (tsim_rand() * 4294967296.0);
+  n->ppb   = (int64_t) ((2. * tsim_rand() - 1.) * opt->ppm * 1000.);
+
+  // ALOHA: period of TDMA frame, random start inside period
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = run == TSIM_TDMA ? AFSM_TD : id ? AFSM_TX : AFSM_RX;
+  n->fsm_pars.t    = (uint32_t) (((uint64_t) slot * num + 500) / 1000);
+  n->fsm_pars.wut  = 1;
+  n->start_ms      = id ? (unsigned long) (n->fsm_pars.t * tsim_rand()) : 0;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data[0]    = (uint8_t) id;
+  n->data_size  = opt->size;
+  n->tx_timeout = 0;
+  n->started    = 0;
+  n->sent       = 0;
+  n->errors     = 0;
+
+  tdma_init(&n->tdma);
+  n->tdma.slot      = (uint8_t) id;
+  n->tdma.slots     = (uint8_t) num;
+  n->tdma.slot_us   = slot;
+  n->tdma.guard_min = opt->guard;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, tsim_callback);
+  n->fsm.scheduler(&n->tdma);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+// run one simulation with `num` nodes, print result line
+static int tsim_run(int num, tsim_run_t run, uint32_t slot,
+                    const tsim_opt_t *opt)
+{
+  tsim_node_t *node = new tsim_node_t[num];
+  uint64_t end = (uint64_t) opt->time * 1000000ull;
+  uint64_t air = 0;
+  uint32_t sent = 0, errors = 0, late = 0, lost = 0, resync = 0, guard = 0;
+  double per, load;
+  int i;
+
+  vclock_reset(0);
+  chan_pars_t cp = chan_pars_default;
+  cp.seed = opt->seed;
+  chan_init(&Chan, &cp);
+  memset((void*) &Res, 0, sizeof(Res));
+  lat_clear(&Res.err);
+  Rnd  = opt->seed ? opt->seed : 1;
+  Loss = opt->loss;
+  Jit  = opt->jit;
+
+  for (i = 0; i < num; i++)
+  {
+    if (tsim_node_init(&node[i], i, num, run, slot, opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail (node %i)\n", i);
+      delete[] node;
+      return -1;
+    }
+  }
+  Coord = &node[0];
+
+  while (vclock_now() < end)
+  {
+    for (i = 0; i < num; i++)
+    {
+      tsim_node_t *n = Cur = &node[i];
+      uint32_t t = tsim_local(n);
+      if (!n->started && vclock_ms() >= n->start_ms)
+      {
+        n->fsm.start();
+        n->started = 1;
+      }
+      n->fsm.yield(t);
+      if (emu_dio1(&n->emu)) tsim_irq(n, t);
+    }
+    vclock_step(opt->step);
+  }
+
+  for (i = 1; i < num; i++)
+  {
+    const tdma_t *m = &node[i].tdma;
+    sent   += node[i].sent;
+    air    += node[i].emu.tx_us;
+    errors += node[i].errors;
+    late   += m->late;
+    lost   += m->lost;
+    resync += m->resync;
+    guard  += m->guard;
+  }
+  errors += node[0].errors;
+
+  per  = sent ? 100. * (1. - (double) Res.ok / sent) : 0.;
+  load = (double) air / end;
+
+  printf("%4i %-5s %7u %7u %6.2f %5.3f %6u", num, tsim_run_name[run], sent,
+         Res.ok, per, load, Chan.stat.collision);
+  if (run == TSIM_TDMA)
+    printf(" %5u %4u %6u %5u %5u %5u %5u %5u\n", late, lost, resync,
+           guard / (num - 1), lat_percentile(&Res.err, 500),
+           lat_percentile(&Res.err, 990), Res.err.max, Res.viol);
+  else
+    printf(" %5s %4s %6s %5s %5s %5s %5s %5s\n",
+           "-", "-", "-", "-", "-", "-", "-", "-");
+  printf("%s", errors ? "# FSM errors\n" : "");
+
+  delete[] node;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+static void tsim_usage()
+{
+  printf(
+    "Usage: tdma_sim [options]\n"
+    "  -n N1,N2,...     number of nodes with coordinator (default 2,4,8,16,32)\n"
+    "  -t SEC           simulation time [s] (default 20)\n"
+    "  -s SF            LoRa spreading factor 5...12 (default 7)\n"
+    "  -b BW            LoRa bandwidth 203|406|812|1625 kHz (default 812)\n"
+    "  -l SIZE          payload size 13...255 bytes (default 16)\n"
+    "  -S US            slot length [us] (default 0 - time on air + 4 guards)\n"
+    "  -g US            minimal guard time [us] (default 100)\n"
+    "  -D PPM           maximal clock error of node [ppm] (default 20)\n"
+    "  -L P             probability of beacon loss on member (default 0)\n"
+    "  -j US            RxDone timestamp jitter (ISR latency) [us] (default 10)\n"
+    "  --step US        main loop step [us] (default 50)\n"
+    "  -a M             area side [m], coordinator in center (default 200)\n"
+    "  --seed N         random seed (default 1)\n");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+  tsim_opt_t opt = {
+    { 2, 4, 8, 16, 32 }, 5, // n[], nn
+    20, 7, 812, 16,         // time, sf, bw, size
+    0, TDMA_GUARD_MIN,      // slot, guard
+    20., 0., 10, 50,        // ppm, loss, jit, step
+    200., 1 };              // area, seed
+  uint32_t slot, toa;
+  int i, j;
+
+  for (i = 1; i < argc; i++)
+  {
+    const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+
+    if (!strcmp(a, "-h") || !strcmp(a, "--help")) { tsim_usage(); return 0; }
+    if (v == NULL) { tsim_usage(); return 1; }
+    i++;
+
+    if (!strcmp(a, "-n"))
+    {
+      char *p = (char*) v;
+      for (opt.nn = 0; opt.nn < TSIM_NMAX && *p; )
+      {
+        long n = strtol(p, &p, 10);
+        if (n >= 2 && n <= CHAN_NODES && n <= 255) opt.n[opt.nn++] = (int) n;
+        if (*p == ',') p++; else break;
+      }
+    }
+    else if (!strcmp(a, "-t")) opt.time  = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-s")) opt.sf    = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-b")) opt.bw    = (uint16_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-l")) opt.size  = (uint8_t)  strtol(v, NULL, 10);
+    else if (!strcmp(a, "-S")) opt.slot  = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-g")) opt.guard = (uint16_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-D")) opt.ppm   = strtod(v, NULL);
+    else if (!strcmp(a, "-L")) opt.loss  = strtod(v, NULL);
+    else if (!strcmp(a, "-j")) opt.jit   = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "-a")) opt.area  = strtod(v, NULL);
+    else if (!strcmp(a, "--step")) opt.step = (uint32_t) strtol(v, NULL, 10);
+    else if (!strcmp(a, "--seed")) opt.seed = (uint32_t) strtoul(v, NULL, 10);
+    else { tsim_usage(); return 1; }
+  }
+
+  if (opt.size < TDMA_HDR_SIZE + 2) opt.size = TDMA_HDR_SIZE + 2;
+  if (opt.nn == 0 || opt.time == 0 || opt.step == 0) { tsim_usage(); return 1; }
+
+  { // time on air by driver (same formula as FSM uses)
+    static tsim_node_t n;
+    vclock_reset(0);
+    chan_init(&Chan, &chan_pars_default);
+    if (tsim_node_init(&n, 0, 2, TSIM_TDMA, 1, &opt) != SX128X_ERR_NONE)
+    {
+      fprintf(stderr, "error: sx128x_init() fail\n");
+      return 1;
+    }
+    toa = sx128x_time_on_air(&n.radio, opt.size);
+  }
+  slot = opt.slot ? opt.slot : (toa + 4 * opt.guard + 99) / 100 * 100;
+
+  printf("# LoRa SF=%u BW=%ukHz size=%u toa=%uus slot=%uus guard=%uus "
+         "clock=+/-%.0fppm loss=%.2f jit=%uus step=%uus time=%us seed=%u\n",
+         opt.sf, opt.bw, opt.size, toa, slot, opt.guard, opt.ppm, opt.loss,
+         opt.jit, opt.step, opt.time, opt.seed);
+  printf("#  N run      sent      ok   PER%%  load collis  late lost resync "
+         "guard  e50   e99  emax  viol\n");
+
+  for (i = 0; i < opt.nn; i++)
+    for (j = 0; j < TSIM_RUNS; j++)
+      if (tsim_run(opt.n[i], (tsim_run_t) j, slot, &opt) != 0) return 1;
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "tdma_sim.cpp" file ***/
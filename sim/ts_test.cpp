@@ -0,0 +1,155 @@
+/*
+ * Timestamp subsystem test (host build, pluggable clock source)
+ * File: "ts_test.cpp"
+ *
+ * "tstamp.c" with fake counters: 16-bit 32768 Hz (RTC like), 32-bit 1 MHz
+ * (micros() near wrap), 24-bit and 64-bit (near wrap) 40 MHz timers, 32-bit
+ * 26 MHz (no exact multiply-shift, division), then back to virtual clock.
+ * Counters
+ * advance by random steps (less than half wrap between polls) over many
+ * wraps; time must be exact (ticks * 1e9 / Hz from source start), strictly
+ * monotonic, continuous after source switch, and raw values captured
+ * before/after poll (ISR) must convert to the same time. Conversion time
+ * of raw counter is measured. Exit code 1 if any check fails.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf()
+#include <stdlib.h> // rand(), srand()
+#include <time.h>   // clock_gettime()
+#include "config.h" // USE_VCLOCK
+#include "vclock.h"
+#include "tstamp.h"
+//-----------------------------------------------------------------------------
+static uint64_t Ticks; // fake counter (without wrap)
+static uint8_t  Bits;  // fake counter width
+//-----------------------------------------------------------------------------
+static uint64_t tt_src(void)
+{
+  return Bits < 64 ? Ticks & (((uint64_t) 1 << Bits) - 1) : Ticks;
+}
+//-----------------------------------------------------------------------------
+// random 64 bit in [0, n)
+static uint64_t tt_rand(uint64_t n)
+{
+  uint64_t r = ((uint64_t) rand() << 42) ^ ((uint64_t) rand() << 21) ^
+               (uint64_t) rand();
+  return n ? r % n : 0;
+}
+//-----------------------------------------------------------------------------
+// run fake counter: return number of failed checks
+static unsigned tt_run(const char *name, uint8_t bits, uint32_t hz,
+                       uint64_t start, unsigned steps)
+{
+  uint64_t half = bits < 64 ? (uint64_t) 1 << (bits - 1) : (uint64_t) 1 << 40;
+  uint64_t t0, ticks0, prev, err_max = 0;
+  unsigned i, bad = 0, wraps;
+
+  Ticks = start;
+  Bits  = bits;
+  t0 = tstamp_ns();
+  tstamp_source(tt_src, hz, bits, name);
+  ticks0 = Ticks;
+  prev = tstamp_ns();
+  if (prev < t0) bad++; // time goes back on source switch
+
+  for (i = 0; i < steps; i++)
+  {
+    uint64_t back = tt_rand(half / 2), fwd = tt_rand(half / 2) + 1;
+    uint64_t raw_old = tt_src() - (back <= Ticks - ticks0 ? back : 0);
+    uint64_t t_old, t_new, now, exp, e;
+
+    // ISR captures raw before poll, converts after poll
+    t_old = tstamp_ns_raw(raw_old);
+    Ticks += fwd;
+    tstamp_poll();
+    if (tstamp_ns_raw(raw_old) != t_old) bad++;
+
+    // ISR captures raw after poll (newer than reference)
+    Ticks += fwd / 2;
+    t_new = tstamp_ns_raw(tt_src());
+    now   = tstamp_ns();
+    if (t_new != now) bad++;
+
+    // exact time from source start
+    exp = t0 + ((Ticks - ticks0) / hz) * 1000000000 +
+          ((Ticks - ticks0) % hz) * 1000000000 / hz;
+    e = now > exp ? now - exp : exp - now;
+    if (e > err_max) err_max = e;
+    if (e) bad++;
+
+    if (now <= prev) bad++; // not strictly monotonic
+    prev = now;
+  }
+
+  wraps = bits < 64 ? (unsigned) ((Ticks >> bits) - (start >> bits)) : 0;
+  printf("%-8s %4u %10lu %8u %8u %10llu %6u\n", name, (unsigned) bits,
+         (unsigned long) hz, steps, wraps, (unsigned long long) err_max, bad);
+  return bad;
+}
+//-----------------------------------------------------------------------------
+// conversion time of raw counter of 64-bit source `hz` [ns/call]
+static double tt_speed(uint32_t hz)
+{
+  struct timespec t0, t1;
+  uint64_t sum = 0, i, n = 10000000;
+
+  Bits = 64;
+  tstamp_source(tt_src, hz, 64, "speed");
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (i = 0; i < n; i++) sum += tstamp_ns_raw(Ticks + i * 977);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  if (sum == 0) printf("#\n"); // don't optimize out
+  return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / n;
+}
+//-----------------------------------------------------------------------------
+int main()
+{
+  unsigned bad = 0;
+  uint64_t t;
+
+  srand(1);
+
+  // default source of host build: virtual clock
+  vclock_reset(0x123456789ULL);
+  if (tstamp_us() != vclock_now() || (uint32_t) tstamp_us() != vclock_us())
+    bad++;
+  printf("# default clock=%s %luHz now=%lluus vclock=%lluus\n",
+         tstamp_name(), (unsigned long) tstamp_hz(),
+         (unsigned long long) tstamp_us(), (unsigned long long) vclock_now());
+
+  printf("# source  bits         Hz    steps    wraps  err[ns]    bad\n");
+  bad += tt_run("rtc",    16,    32768, 0xFF00,                 100000);
+  bad += tt_run("micros", 32,  1000000, 0xFFFFFFF0,             100000);
+  bad += tt_run("timer",  24, 40000000, 0x123456,               100000);
+  bad += tt_run("timer",  64, 40000000, 0xFFFFFFFFFFF00000ULL,  100000);
+  bad += tt_run("xtal",   32, 26000000, 0xFFFF0000,             100000);
+
+  printf("# convert: 40MHz %.1f ns/call (multiply-shift), "
+         "26MHz %.1f ns/call (division)\n", tt_speed(40000000),
+         tt_speed(26000000));
+
+  // back to virtual clock: time continues
+  t = tstamp_ns();
+  tstamp_source(vclock_now, 1000000, 64, "vclock");
+  vclock_advance(1000);
+  if (tstamp_ns() != t + 1000000) bad++;
+
+  // compensation of TxDone/RxDone delays
+  {
+    tstamp_link_t link;
+    tstamp_link_init(&link);
+    link.delay[1].tx = 1500;
+    link.delay[1].rx = 4250;
+    if (tstamp_link_tx(&link, 1, 1000000, 900000, 80) != 998500) bad++;
+    if (link.ovh[1] != 20000 || link.ovh_avg[1] != 160000) bad++;
+    if (tstamp_link_rx(&link, 1, 2000000) != 1995750) bad++;
+    if (tstamp_link_rx(&link, 9, 2000000) != 2000000) bad++; // bad mode
+  }
+
+  if (bad) printf("# FAIL: %u checks\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "ts_test.cpp" file ***/
@@ -0,0 +1,254 @@
+/*
+ * AFsm periodic TX over TIME_FUNC() wrap (host build, virtual time)
+ * File: "wrap_test.cpp"
+ *
+ * One transmitter (AFsm TX mode) and one receiver (AFsm RX mode) on
+ * emulated chips run 24 hours of virtual time from 5 s before 32-bit
+ * micros() wrap (TIME_FUNC() wraps every ~71.6 minutes, ~20 times per
+ * run). Every TxDone interval must be period +/- loop step (no missed or
+ * extra period at wrap), total drift must be less than one step, every
+ * packet must be received with bounded latency by 32-bit time stamps,
+ * no FSM errors and no dropped events. Exit code 1 if any check fails.
+ */
+
+//-----------------------------------------------------------------------------
+#include <stdio.h>  // printf()
+#include <string.h> // memset()
+#include "config.h" // TIME_FUNC(), TIME_FACTOR, USE_VCLOCK
+#include "vclock.h"
+#include "afsm.h"
+#include "lat.h"
+#include "sx128x.h"
+#include "sx1280_emu.h"
+#include "chan.h"
+//-----------------------------------------------------------------------------
+#ifndef USE_VCLOCK
+#  error "build test with -DUSE_VCLOCK"
+#endif
+//-----------------------------------------------------------------------------
+#define WT_STEP_US 1000          // main loop step [us]
+#define WT_PERIOD  1000          // TX period [ms]
+#define WT_HOURS   24            // run time [h]
+#define WT_T0      (0x100000000ull - 5000000ull) // 5 s before wrap [us]
+//-----------------------------------------------------------------------------
+// one node (emulated chip + driver + FSM)
+typedef struct wt_node_ {
+  sx1280_emu_t  emu;
+  sx128x_t      radio;
+  sx128x_pars_t pars;
+  afsm_pars_t   fsm_pars;
+  AFsm          fsm;
+  ABlink        led;
+  uint8_t       data[256];
+  uint8_t       data_size;
+  uint32_t      tx_timeout;
+  uint32_t      errors; // FSM action errors
+} wt_node_t;
+//-----------------------------------------------------------------------------
+static chan_t     Chan;
+static wt_node_t  Node[2]; // TX, RX
+static wt_node_t *Cur;     // node in FSM callback context
+
+static struct {
+  uint32_t   sent;      // TxDone counter
+  uint64_t   first;     // first TxDone time [us] (64 bit)
+  uint64_t   last;      // last TxDone time [us] (64 bit)
+  uint64_t   dt_min;    // minimal TxDone interval [us]
+  uint64_t   dt_max;    // maximal TxDone interval [us]
+  uint32_t   wraps;     // TIME_FUNC() wraps
+  uint32_t   rx;        // received packets
+  uint32_t   seq_err;   // sequence errors
+  uint32_t   seq;       // next expected sequence number
+  lat_hist_t lat;       // stamp -> RxDone latency [us]
+  uint32_t   lat_max;   // maximal latency [us]
+} Res;
+//-----------------------------------------------------------------------------
+// Arduino API by virtual clock
+unsigned long millis() { return vclock_ms(); }
+unsigned long micros() { return vclock_us(); }
+void pinMode(int pin, int mode) {}
+void digitalWrite(int pin, int val) {}
+//-----------------------------------------------------------------------------
+static void wt_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+//-----------------------------------------------------------------------------
+static uint32_t wt_get32(const uint8_t *p)
+{
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+//-----------------------------------------------------------------------------
+// FSM event callback: stamp packet by period timer, count TxDone
+static void wt_callback(uint8_t ev, int8_t err, unsigned long t)
+{
+  wt_node_t *n = Cur;
+
+  if (err != SX128X_ERR_NONE) n->errors++;
+
+  if (ev == AFSM_EV_PERIOD && n->fsm.mode() == AFSM_TX)
+  { // packet will be sent after wakeup
+    wt_put32(n->data,     Res.sent);
+    wt_put32(n->data + 4, (uint32_t) t);
+  }
+  else if (ev == AFSM_EV_TX_DONE)
+  {
+    uint64_t now = vclock_now();
+    if (Res.sent)
+    {
+      uint64_t dt = now - Res.last;
+      if (Res.sent == 1 || dt < Res.dt_min) Res.dt_min = dt;
+      if (Res.sent == 1 || dt > Res.dt_max) Res.dt_max = dt;
+    }
+    else
+      Res.first = now;
+    Res.last = now;
+    Res.sent++;
+  }
+}
+//-----------------------------------------------------------------------------
+// DIO1 interrupt handler (like sx128x_irq())
+static void wt_irq(wt_node_t *n)
+{
+  unsigned long t = TIME_FUNC();
+  uint16_t irq;
+
+  if (sx128x_get_irq(&n->radio, &irq) != SX128X_ERR_NONE) return;
+  if (irq) sx128x_clear_irq(&n->radio, irq);
+
+  if (irq & SX128X_IRQ_TX_DONE)
+  {
+    n->fsm.tx_done_dt(t);
+    n->fsm.tx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_DONE)
+  {
+    sx128x_rx_t rx;
+    uint8_t data[255], size = 0;
+
+    n->fsm.rx_done_dt(t);
+    if (sx128x_get_recv(&n->radio, irq, sizeof(data), &rx, data, &size) ==
+          SX128X_ERR_NONE && rx.crc_ok && size >= 8)
+    {
+      uint32_t lat = (uint32_t) t - wt_get32(data + 4); // wrap safe
+      if (wt_get32(data) != Res.seq) Res.seq_err++;
+      Res.seq = wt_get32(data) + 1;
+      lat_add(&Res.lat, lat);
+      if (lat > Res.lat_max) Res.lat_max = lat;
+      Res.rx++;
+    }
+    n->fsm.rx_done();
+  }
+
+  if (irq & SX128X_IRQ_RX_TX_TIMEOUT)
+    n->fsm.rxtx_timeout();
+}
+//-----------------------------------------------------------------------------
+// init node `id` (0 - TX, 1 - RX)
+static int wt_node_init(wt_node_t *n, int id)
+{
+  int8_t retv;
+
+  emu_init(&n->emu, &Chan, id, id ? 10. : 0., 0.);
+  chan_add(&Chan, &n->emu);
+
+  n->pars              = sx128x_pars_default;
+  n->pars.mode         = SX128X_LORA;
+  n->pars.fixed        = 1;
+  n->pars.payload_size = 16;
+
+  retv = sx128x_init(&n->radio, emu_busy_wait, emu_spi_exchange,
+                     &n->pars, (void*) &n->emu);
+  if (retv != SX128X_ERR_NONE) return retv;
+
+  n->fsm_pars      = afsm_pars_default;
+  n->fsm_pars.mode = id ? AFSM_RX : AFSM_TX;
+  n->fsm_pars.t    = WT_PERIOD;
+
+  memset((void*) n->data, 0, sizeof(n->data));
+  n->data_size  = 16;
+  n->tx_timeout = 0;
+  n->errors     = 0;
+
+  n->led.begin();
+  n->fsm.begin(&n->led, &n->fsm_pars, n->data, &n->data_size,
+               &n->pars.fixed, NULL, &n->radio,
+               &n->tx_timeout, NULL, NULL, wt_callback);
+  return SX128X_ERR_NONE;
+}
+//-----------------------------------------------------------------------------
+int main()
+{
+  uint64_t end = WT_T0 + (uint64_t) WT_HOURS * 3600ull * 1000000ull;
+  uint64_t period = (uint64_t) WT_PERIOD * 1000, span, exp;
+  unsigned long t_prev;
+  unsigned bad = 0;
+  int i;
+
+  vclock_reset(WT_T0);
+  chan_init(&Chan, &chan_pars_default);
+  memset((void*) &Res, 0, sizeof(Res));
+  lat_clear(&Res.lat);
+
+  for (i = 0; i < 2; i++)
+    if (wt_node_init(&Node[i], i) != SX128X_ERR_NONE)
+    {
+      printf("# FAIL: sx128x_init() node %i\n", i);
+      return 1;
+    }
+
+  Node[1].fsm.start(); // RX
+  Node[0].fsm.start(); // TX
+  t_prev = TIME_FUNC();
+
+  while (vclock_now() < end)
+  {
+    unsigned long t = TIME_FUNC();
+    if (t < t_prev) Res.wraps++;
+    t_prev = t;
+
+    for (i = 0; i < 2; i++)
+    {
+      wt_node_t *n = Cur = &Node[i];
+      n->fsm.yield(TIME_FUNC());
+      if (emu_dio1(&n->emu)) wt_irq(n);
+    }
+    vclock_step(WT_STEP_US);
+  }
+
+  // all periods: first TxDone at start + period, last not after end
+  span = Res.last - Res.first;
+  exp  = (end - WT_T0) / period;
+  if (Res.sent != exp && Res.sent + 1 != exp) bad++;
+  if (Res.dt_min + WT_STEP_US < period || Res.dt_max > period + WT_STEP_US)
+    bad++;
+  if (span + WT_STEP_US < (Res.sent - 1) * period ||
+      span > (Res.sent - 1) * period + WT_STEP_US)
+    bad++; // drift
+  if (Res.rx != Res.sent || Res.seq_err) bad++;
+  if (Res.lat_max > period) bad++;
+  if (Node[0].errors || Node[1].errors) bad++;
+  if (Node[0].fsm.drops() || Node[1].fsm.drops()) bad++;
+  if (Res.wraps < WT_HOURS * 3600ull * 1000000ull / 0x100000000ull) bad++;
+
+  printf("# period=%ums step=%uus time=%uh t0=0x%llX (5 s before wrap)\n",
+         (unsigned) WT_PERIOD, (unsigned) WT_STEP_US, (unsigned) WT_HOURS,
+         (unsigned long long) WT_T0);
+  printf("# wraps    sent      rx  dt_min[us]  dt_max[us]  drift[us]"
+         "  p50[us]  max[us]  err  drops  bad\n");
+  printf("%7u %7u %7u %11llu %11llu %10lld %8u %8u %4u %6u %4u\n",
+         (unsigned) Res.wraps, (unsigned) Res.sent, (unsigned) Res.rx,
+         (unsigned long long) Res.dt_min, (unsigned long long) Res.dt_max,
+         (long long) span - (long long) ((Res.sent - 1) * period),
+         (unsigned) lat_percentile(&Res.lat, 500), (unsigned) Res.lat_max,
+         (unsigned) (Node[0].errors + Node[1].errors),
+         (unsigned) (Node[0].fsm.drops() + Node[1].fsm.drops()), bad);
+
+  if (bad) printf("# FAIL: %u checks\n", bad);
+  return bad ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "wrap_test.cpp" file ***/